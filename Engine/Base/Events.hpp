@@ -0,0 +1,53 @@
+/**
+ * Event types shared by the engine, publish and subscribe them with
+ * `GWORLD.Events`.
+ */
+#pragma once
+
+#include "Base/Types.hpp"
+#include "Global.hpp"
+
+namespace aEngine {
+
+// Two colliders start or stop overlapping, for the collision system to
+// publish once it has a broad phase, nothing publishes it yet.
+struct CollisionContactEvent {
+  EntityID first = (EntityID)(0), second = (EntityID)(0);
+  // true when the contact begins, false when it ends
+  bool begin = true;
+  glm::vec3 point = glm::vec3(0.0f);
+  // from first to second
+  glm::vec3 normal = glm::vec3(0.0f);
+  float depth = 0.0f;
+};
+
+enum class InputDevice { Keyboard, Mouse, Joystick };
+
+// Published from the window callbacks, `code` is the glfw key, mouse button or
+// joystick id, `action` is the glfw action for keyboard and mouse buttons,
+// GLFW_CONNECTED or GLFW_DISCONNECTED for joysticks.
+struct InputEvent {
+  InputDevice device = InputDevice::Keyboard;
+  int code = 0;
+  int action = 0;
+  int mods = 0;
+  // scroll offsets for mouse scroll, cursor position for mouse buttons
+  glm::vec2 value = glm::vec2(0.0f);
+  bool scroll = false;
+};
+
+enum class AssetType { Texture, Model, Motion, Shader };
+
+// Published by the assets loader when a new asset is loaded into the cache.
+struct AssetLoadedEvent {
+  AssetType type = AssetType::Texture;
+  std::string path = "";
+};
+
+// Published when an entity is destroyed, the entity is no longer valid when
+// the event is delivered.
+struct EntityDestroyedEvent {
+  EntityID entity = (EntityID)(0);
+};
+
+}; // namespace aEngine
@@ -0,0 +1,159 @@
+/**
+ * Interned strings for entity names, joint names, asset paths and shader
+ * identifiers. Each distinct string is stored only once in a global table,
+ * a `Name` keeps the 32-bit index to that string, so the comparison and hashing
+ * of names are O(1). The string can be retrieved with `str()` for display and
+ * serialization.
+ *
+ * Interning a new string takes a lock, looking up the string of an existing
+ * name is lock free, names can be created and read from any thread.
+ *
+ * The ordering of names follows the order they are first interned, not the
+ * lexicographical order of the strings.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace aEngine {
+
+class NameTable {
+public:
+  // The table is never destroyed, so names stay valid during the
+  // destruction of other static objects.
+  static NameTable &Ref() {
+    static NameTable *reference = new NameTable();
+    return *reference;
+  }
+
+  // Returns the index to the string, insert the string if it's new.
+  uint32_t Intern(std::string_view str) {
+    if (str.empty())
+      return 0;
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      auto it = lookup.find(str);
+      if (it != lookup.end())
+        return it->second;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = lookup.find(str);
+    if (it != lookup.end())
+      return it->second;
+    uint32_t id = count;
+    if ((id >> ChunkBits) >= MaxChunks)
+      throw std::runtime_error("Name table is full");
+    auto chunk = chunks[id >> ChunkBits].load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+      chunk = new std::string[ChunkSize];
+      chunks[id >> ChunkBits].store(chunk, std::memory_order_release);
+    }
+    chunk[id & ChunkMask] = std::string(str);
+    lookup.emplace(std::string_view(chunk[id & ChunkMask]), id);
+    count++;
+    return id;
+  }
+
+  // Reverse lookup from the index to the string.
+  const std::string &Lookup(uint32_t id) const {
+    auto chunk = chunks[id >> ChunkBits].load(std::memory_order_acquire);
+    return chunk[id & ChunkMask];
+  }
+
+  uint32_t Size() const { return count; }
+
+private:
+  NameTable() {
+    for (auto &chunk : chunks)
+      chunk.store(nullptr);
+    // index 0 is reserved for the empty string
+    chunks[0].store(new std::string[ChunkSize]);
+    count = 1;
+  }
+
+  // strings are stored in fixed size chunks so that the address of a string
+  // never changes after it's interned
+  static const uint32_t ChunkBits = 12;
+  static const uint32_t ChunkSize = 1u << ChunkBits;
+  static const uint32_t ChunkMask = ChunkSize - 1;
+  static const uint32_t MaxChunks = 4096;
+
+  std::atomic<std::string *> chunks[MaxChunks];
+  std::unordered_map<std::string_view, uint32_t> lookup;
+  std::atomic<uint32_t> count;
+  mutable std::shared_mutex mutex;
+};
+
+class Name {
+public:
+  Name() : id(0) {}
+  Name(const std::string &str) : id(NameTable::Ref().Intern(str)) {}
+  Name(const char *str) : id(NameTable::Ref().Intern(str)) {}
+  Name(std::string_view str) : id(NameTable::Ref().Intern(str)) {}
+
+  uint32_t ID() const { return id; }
+  const std::string &str() const { return NameTable::Ref().Lookup(id); }
+  const char *c_str() const { return str().c_str(); }
+  size_t size() const { return str().size(); }
+  bool empty() const { return id == 0; }
+
+  operator const std::string &() const { return str(); }
+
+  bool operator==(const Name &other) const { return id == other.id; }
+  bool operator!=(const Name &other) const { return id != other.id; }
+  bool operator<(const Name &other) const { return id < other.id; }
+  // compare with plain strings without interning them
+  bool operator==(const std::string &other) const { return str() == other; }
+  bool operator!=(const std::string &other) const { return str() != other; }
+  bool operator==(const char *other) const { return str() == other; }
+  bool operator!=(const char *other) const { return str() != other; }
+
+  // names are serialized as plain strings
+  template <typename Archive>
+  std::string save_minimal(const Archive &ar) const {
+    return str();
+  }
+  template <typename Archive>
+  void load_minimal(const Archive &ar, const std::string &value) {
+    id = NameTable::Ref().Intern(value);
+  }
+
+private:
+  uint32_t id;
+};
+
+inline std::string operator+(const Name &a, const std::string &b) {
+  return a.str() + b;
+}
+inline std::string operator+(const std::string &a, const Name &b) {
+  return a + b.str();
+}
+inline std::string operator+(const Name &a, const char *b) {
+  return a.str() + b;
+}
+inline std::string operator+(const char *a, const Name &b) {
+  return a + b.str();
+}
+inline std::ostream &operator<<(std::ostream &os, const Name &name) {
+  return os << name.str();
+}
+
+}; // namespace aEngine
+
+namespace std {
+template <> struct hash<aEngine::Name> {
+  size_t operator()(const aEngine::Name &name) const noexcept {
+    return std::hash<uint32_t>()(name.ID());
+  }
+};
+}; // namespace std
@@ -30,6 +30,9 @@ Animator::Animator(EntityID id, Animation::Motion *m)
 Animator::~Animator() {}
 
 void Animator::BuildMappings() {
+  InvalidatePoseBinding();
+  lodJointMask.clear();
+  skippedLeafLevels = 0;
   jointEntityMap.clear();
   jointEntityMap.resize(actor->GetNumJoints(), nullptr);
   jointActiveMap.clear();
@@ -62,42 +65,129 @@ void Animator::BuildMappings() {
 }
 
 void Animator::ApplyPoseToSkeleton(Animation::Pose &pose) {
-  int motionJointNum = pose.skeleton->GetNumJoints();
-  if (skeleton == nullptr) {
-    LOG_F(WARNING,
-          "actor has no skeleton entity root, can't apply motion to it");
+  auto binding = bindPoseJoints(pose.skeleton, pose.jointRotations.size());
+  if (binding == nullptr)
     return;
+  // apply root translation
+  jointEntityMap[binding->jointIndices[0]]->SetLocalPosition(
+      pose.rootLocalPosition);
+  // apply joint rotations for joints defined in the pose
+  const bool masked = !lodJointMask.empty();
+  for (int poseJointInd = 0; poseJointInd < binding->numJoints;
+       ++poseJointInd) {
+    if (binding->missing[poseJointInd])
+      continue;
+    int jointInd = binding->jointIndices[poseJointInd];
+    if (!masked || lodJointMask[jointInd])
+      jointEntityMap[jointInd]->SetLocalRotation(
+          pose.jointRotations[poseJointInd]);
   }
-  auto root = jointNameToInd.find(pose.skeleton->jointNames[0]);
-  if (root == jointNameToInd.end()) {
-    LOG_F(ERROR, "root joint %s not found in skeleton, can't apply motion",
-          pose.skeleton->jointNames[0].c_str());
+}
+
+void Animator::ApplyPoseToSkeleton(Animation::PoseBuffer &pose) {
+  auto binding = bindPoseJoints(pose.skeleton, pose.numJoints);
+  if (binding == nullptr)
     return;
-  }
-  int missingJointsFromEntity = 0;
-  std::vector<std::string> missingJointsName;
   // apply root translation
-  jointEntityMap[root->second]->SetLocalPosition(pose.rootLocalPosition);
+  jointEntityMap[binding->jointIndices[0]]->SetLocalPosition(
+      pose.rootLocalPosition);
   // apply joint rotations for joints defined in the pose
-  for (int poseJointInd = 0; poseJointInd < motionJointNum; ++poseJointInd) {
-    auto boneName = pose.skeleton->jointNames[poseJointInd];
+  const bool masked = !lodJointMask.empty();
+  for (int poseJointInd = 0; poseJointInd < binding->numJoints;
+       ++poseJointInd) {
+    if (binding->missing[poseJointInd])
+      continue;
+    int jointInd = binding->jointIndices[poseJointInd];
+    if (!masked || lodJointMask[jointInd])
+      jointEntityMap[jointInd]->SetLocalRotation(
+          pose.GetRotation(poseJointInd));
+  }
+}
+
+const Animator::PoseBinding *
+Animator::bindPoseJoints(Animation::Skeleton *poseSkeleton, int numJoints) {
+  if (poseSkeleton == nullptr ||
+      (int)poseSkeleton->jointNames.size() < numJoints)
+    return nullptr;
+  auto names = poseSkeleton->jointNames.begin();
+  for (auto &binding : poseBindings)
+    if (binding.numJoints == numJoints &&
+        std::equal(binding.jointNames.begin(), binding.jointNames.end(),
+                   names))
+      return binding.valid ? &binding : nullptr;
+  // poses usually come from a handful of skeletons, don't keep bindings of
+  // temporary ones around forever
+  if (poseBindings.size() >= 8)
+    poseBindings.clear();
+  auto &binding = poseBindings.emplace_back();
+  binding.jointNames.assign(names, names + numJoints);
+  binding.numJoints = numJoints;
+  binding.jointIndices.assign(numJoints, -1);
+  binding.missing.assign(numJoints, true);
+  // everything below is only reported once per binding
+  if (skeleton == nullptr) {
+    LOG_F(WARNING,
+          "actor has no skeleton entity root, can't apply motion to it");
+    return nullptr;
+  }
+  if (numJoints == 0)
+    return nullptr;
+  int missingJointsFromEntity = 0;
+  std::string nameString = "";
+  for (int poseJointInd = 0; poseJointInd < numJoints; ++poseJointInd) {
+    auto &boneName = poseSkeleton->jointNames[poseJointInd];
     auto jointActorInd = jointNameToInd.find(boneName);
-    if (jointActorInd == jointNameToInd.end()) {
+    if (jointActorInd == jointNameToInd.end() ||
+        jointActorInd->second >= jointEntityMap.size() ||
+        jointEntityMap[jointActorInd->second] == nullptr) {
       missingJointsFromEntity++;
-      missingJointsName.push_back(boneName);
+      nameString = nameString + ", " + boneName;
     } else {
-      auto jointEntity = jointEntityMap[jointActorInd->second];
-      jointEntity->SetLocalRotation(pose.jointRotations[poseJointInd]);
+      binding.jointIndices[poseJointInd] = jointActorInd->second;
+      binding.missing[poseJointInd] = false;
     }
   }
-  // output the missing joints
-  if (missingJointsFromEntity > 0) {
-    std::string nameString = "";
-    for (auto &name : missingJointsName)
-      nameString = nameString + ", " + name;
+  if (missingJointsFromEntity > 0)
     LOG_F(WARNING, "%d joints missing from entity skeleton, names: %s",
           missingJointsFromEntity, nameString.c_str());
+  if (binding.missing[0]) {
+    LOG_F(ERROR, "root joint %s not found in skeleton, can't apply motion",
+          poseSkeleton->jointNames[0].c_str());
+    return nullptr;
+  }
+  binding.valid = true;
+  return &binding;
+}
+
+void Animator::SetSkippedLeafLevels(int levels) {
+  if (levels == skippedLeafLevels &&
+      (levels <= 0 || lodJointMask.size() == jointEntityMap.size()))
+    return;
+  skippedLeafLevels = levels;
+  if (levels <= 0) {
+    lodJointMask.clear();
+    return;
+  }
+  // levels of descendants below each actor joint, deeper joints go first
+  int numJoints = actor->GetNumJoints();
+  std::vector<int> depth(numJoints, 0), order(numJoints), height(numJoints, 0);
+  for (int jointInd = 0; jointInd < numJoints; ++jointInd) {
+    order[jointInd] = jointInd;
+    for (int cur = actor->jointParent[jointInd]; cur != -1;
+         cur = actor->jointParent[cur])
+      depth[jointInd]++;
+  }
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return depth[a] > depth[b]; });
+  for (int jointInd : order) {
+    int parent = actor->jointParent[jointInd];
+    if (parent != -1)
+      height[parent] = std::max(height[parent], height[jointInd] + 1);
   }
+  // the additional joints not defined in actor are always updated
+  lodJointMask.assign(jointEntityMap.size(), true);
+  for (int jointInd = 0; jointInd < numJoints; ++jointInd)
+    lodJointMask[jointInd] = height[jointInd] >= levels;
 }
 
 void Animator::createSkeletonEntities() {
@@ -184,7 +274,18 @@ void Animator::DrawInspectorGUI() {
   ImGui::MenuItem("Motion", nullptr, nullptr, false);
   ImGui::TextWrapped("FPS: %d", motion == nullptr ? -1 : motion->fps);
   ImGui::TextWrapped("Duration: %d",
-                     motion == nullptr ? -1 : motion->poses.size());
+                     motion == nullptr ? -1 : motion->NumFrames());
+  if (graph != nullptr && ImGui::TreeNode("Blend Graph")) {
+    auto &blendGraph = *graph->Graph();
+    ImGui::TextWrapped("Nodes: %d", blendGraph.NumNodes());
+    ImGui::TextWrapped("Evaluation: %.1f us", graph->EvaluationTime);
+    for (int i = 0; i < blendGraph.NumParameters(); ++i) {
+      float value = graph->GetParameter(i);
+      if (ImGui::DragFloat(blendGraph.ParameterName(i).c_str(), &value, 0.01f))
+        graph->SetParameter(i, value);
+    }
+    ImGui::TreePop();
+  }
   if (ImGui::TreeNode("Trajectory")) {
     ImGui::Checkbox("Show Trajectory", &ShowTrajectory);
     ImGui::SliderInt("Trajectory Count", &TrajCount, 1, 5);
@@ -205,6 +306,7 @@ void Animator::DrawInspectorGUI() {
         auto extension = filepath.extension().string();
         if (extension == ".bvh" || extension == ".fbx") {
           motion = Loader.GetMotion(filename);
+          InvalidatePoseBinding();
           if (motion != nullptr)
             return true;
           else
@@ -217,6 +319,7 @@ void Animator::DrawInspectorGUI() {
       motionPathBuffer,
       [&]() {
         motion = nullptr;
+        InvalidatePoseBinding();
         auto restPose = actor->GetRestPose();
         ApplyPoseToSkeleton(restPose);
       });
@@ -232,6 +335,7 @@ void Animator::DrawInspectorGUI() {
             Animation::MakeLoopMotion(*motion));
         motion = loopMotionBackup.get();
       }
+      InvalidatePoseBinding();
     }
     if (motion == nullptr)
       ImGui::EndDisabled();
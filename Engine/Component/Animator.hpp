@@ -11,17 +11,14 @@
 #include "Base/BaseComponent.hpp"
 #include "Entity.hpp"
 
+#include "Function/Animation/BlendGraph.hpp"
+#include "Function/Animation/IK.hpp"
 #include "Function/Animation/Motion.hpp"
 #include "Function/Render/Buffers.hpp"
 #include "Function/Render/Mesh.hpp"
 
 namespace aEngine {
 
-struct BoneMatrixBlock {
-  glm::mat4 BoneModelMatrix;
-  glm::mat4 BoneOffsetMatrix;
-};
-
 // Each animator must bind to one actor (Skeleton),
 // the entity structure will be created when one animator gets created
 struct Animator : public BaseComponent {
@@ -35,12 +32,20 @@ struct Animator : public BaseComponent {
   // Get transformation matrics needed for skeleton animation
   std::vector<BoneMatrixBlock> GetSkeletonTransforms();
 
-  // Apply the motion to skeleton entities
+  // Apply the motion to skeleton entities, the joints of the pose are
+  // matched to the joint entities by name once per list of joint names, see
+  // `PoseBinding`. Applying a pose each frame does no lookup, allocation or
+  // logging.
   void ApplyPoseToSkeleton(Animation::Pose &pose);
+  void ApplyPoseToSkeleton(Animation::PoseBuffer &pose);
   // Maintain member variables `jointEntityMap`,
   // call this function after you made modifications to the joint entities. (add
   // additional joints, rename joints etc.)
   void BuildMappings();
+  // Match the joints of the next applied pose by name again. The bindings
+  // are keyed by the joint names of the pose, so only a change of the joint
+  // entities requires this, `BuildMappings` calls it.
+  void InvalidatePoseBinding() { poseBindings.clear(); }
 
   std::string getInspectorWindowName() override { return "Animator"; }
 
@@ -103,20 +108,68 @@ struct Animator : public BaseComponent {
   // joint name -> joint index.
   // if there are joints not defined in actor, additional indices will be
   // assigned
-  std::map<std::string, std::size_t> jointNameToInd;
+  std::unordered_map<Name, std::size_t> jointNameToInd;
 
   // Stores the motion data
   Animation::Motion *motion = nullptr;
+  // Sampled pose of `motion`, reused across frames
+  Animation::PoseBuffer poseBuffer;
+  // Drives the skeleton instead of `motion` when set, the graph is built
+  // from code and not serialized
+  std::shared_ptr<Animation::BlendGraphInstance> graph = nullptr;
+  // Plants the feet of the sampled pose on the ground before it's applied,
+  // the poses of all the animators sharing it are solved in one batch. Built
+  // from code and not serialized.
+  std::shared_ptr<Animation::FootPlanting> footPlanting = nullptr;
 
   bool ShowTrajectory = false;
   int TrajCount = 3;
   float TrajInterval = 0.2f;
 
+  // Level of detail, maintained by `AnimationSystem`, see `AnimationLOD`.
+  int LOD = 0;
+  // the pose is sampled and applied every `UpdateInterval` frames,
+  // `FramesSinceUpdate` is 0 in the frames it's applied
+  int UpdateInterval = 1, FramesSinceUpdate = 0;
+  // time of the skipped frames, passed to the blend graph on the next update
+  float SkippedTime = 0.0f;
+  // off screen, neither the pose nor the skinned meshes are updated
+  bool Frozen = false;
+  // Don't update joints with fewer than `levels` levels of descendants, this
+  // skips fingers and face joints of distant characters. The mask is only
+  // rebuilt when `levels` changes.
+  void SetSkippedLeafLevels(int levels);
+
 private:
   bool makeLoopMotion = false;
   Animation::Motion *motionBackup = nullptr;
   std::unique_ptr<Animation::Motion> loopMotionBackup = nullptr;
 
+  // Maps the joints of a pose skeleton to the joint entities, one binding
+  // is kept for each list of joint names applied to this animator. The
+  // skeleton pointer isn't used as the key, a skeleton allocated where a
+  // freed one was would get its binding.
+  struct PoseBinding {
+    // the names of the pose joints, compared by their interned ids
+    std::vector<Name> jointNames;
+    int numJoints = 0;
+    // pose joint index -> index in `jointEntityMap`
+    std::vector<int> jointIndices;
+    // pose joint index -> whether the joint has no entity
+    std::vector<bool> missing;
+    // the root has an entity, nothing is applied otherwise
+    bool valid = false;
+  };
+  std::vector<PoseBinding> poseBindings;
+  // index in `jointEntityMap` -> whether the joint is updated at the current
+  // level of detail, empty to update all joints
+  std::vector<bool> lodJointMask;
+  int skippedLeafLevels = 0;
+  // find or build the binding of `poseSkeleton`, returns nullptr if the pose
+  // can't be applied
+  const PoseBinding *bindPoseJoints(Animation::Skeleton *poseSkeleton,
+                                    int numJoints);
+
   // only joints defined in actor will be drawn
   void drawSkeletonHierarchy();
   // create skeleton entities from actor, initialize mappings
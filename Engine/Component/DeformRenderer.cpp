@@ -13,50 +13,163 @@ DeformRenderer::DeformRenderer(EntityID id, EntityID anim)
   FillBlendShapeDataBuffer();
 }
 
-DeformRenderer::~DeformRenderer() {}
+DeformRenderer::~DeformRenderer() {
+  if (blendShapeFillTask != 0)
+    GWORLD.Scheduler.Cancel(blendShapeFillTask);
+}
 
-void DeformRenderer::FillBlendShapeDataBuffer() {
-  struct blendshapedata {
-    glm::vec4 posOffset[MAX_BLEND_SHAPES];
-    glm::vec4 normalOffset[MAX_BLEND_SHAPES];
-  };
-  if (auto meshInstance =
-          GWORLD.GetComponent<Mesh>(entityID)->GetMeshInstance()) {
-    std::vector<blendshapedata> data(meshInstance->vertices.size());
-    for (int i = 0; i < meshInstance->vertices.size(); ++i) {
-      for (int j = 0; j < meshInstance->blendShapes.size(); ++j) {
-        data[i].posOffset[j] = glm::vec4(
-            meshInstance->blendShapes[j].data[i].BlendShapeOffset, 0.0f);
-        data[i].normalOffset[j] = glm::vec4(
-            meshInstance->blendShapes[j].data[i].BlendShapeNormal, 0.0f);
-      }
-    }
-    blendShapeDataBuffer.SetDataAs(GL_SHADER_STORAGE_BUFFER, data);
-  } else {
+bool DeformRenderer::fillBlendShapeData(size_t maxShapes) {
+  auto meshInstance = GWORLD.GetComponent<Mesh>(entityID)->GetMeshInstance();
+  if (meshInstance == nullptr) {
     LOG_F(ERROR, "please set <Mesh> component before <DeformRenderer> "
-                 "component, blendShapeDataBuffer not setup");
+                 "component, blendShapeData not setup");
+    blendShapeData.Clear(0);
+    return true;
+  }
+  auto &shapes = meshInstance->blendShapes;
+  if (blendShapeFilled == 0)
+    blendShapeData.Clear(meshInstance->vertices.size());
+  size_t end = std::min(shapes.size(), blendShapeFilled + maxShapes);
+  for (size_t i = blendShapeFilled; i < end; ++i)
+    blendShapeData.AddShape(shapes[i]);
+  blendShapeFilled = end;
+  if (blendShapeFilled < shapes.size())
+    return false;
+  blendShapeBuffers.Upload(blendShapeData);
+  blendShapeDataReady = true;
+  blendShapeFilled = 0;
+  return true;
+}
+
+void DeformRenderer::FillBlendShapeDataBuffer() {
+  if (blendShapeFillTask != 0) {
+    GWORLD.Scheduler.Cancel(blendShapeFillTask);
+    blendShapeFillTask = 0;
   }
+  blendShapeDataReady = false;
+  blendShapeFilled = 0;
+  fillBlendShapeData(std::numeric_limits<size_t>::max());
+}
+
+void DeformRenderer::ScheduleBlendShapeDataFill() {
+  if (blendShapeFillTask != 0)
+    GWORLD.Scheduler.Cancel(blendShapeFillTask);
+  blendShapeDataReady = false;
+  blendShapeFilled = 0;
+  blendShapeFillTask = GWORLD.Scheduler.Submit(
+      "Blend Shape Fill " + std::to_string(entityID),
+      [this]() {
+        // a shape is one pass over the vertices of the mesh
+        if (fillBlendShapeData(4)) {
+          blendShapeFillTask = 0;
+          return true;
+        }
+        return false;
+      },
+      0.5f);
+}
+
+const std::vector<BoneMatrixBlock> &
+DeformRenderer::updateTransforms(Animator *anim) {
+  if (anim->UpdateInterval <= 1) {
+    currentTransforms = anim->GetSkeletonTransforms();
+    previousTransforms.clear();
+    return currentTransforms;
+  }
+  if (anim->FramesSinceUpdate == 0 || previousTransforms.empty()) {
+    previousTransforms.swap(currentTransforms);
+    currentTransforms = anim->GetSkeletonTransforms();
+    if (previousTransforms.size() != currentTransforms.size())
+      previousTransforms = currentTransforms;
+  }
+  // trail the latest pose by one update, reaching it right before the next
+  float t = (anim->FramesSinceUpdate + 1) / (float)anim->UpdateInterval;
+  blendedTransforms.resize(currentTransforms.size());
+  for (int i = 0; i < currentTransforms.size(); ++i) {
+    blendedTransforms[i].BoneModelMatrix =
+        previousTransforms[i].BoneModelMatrix * (1.0f - t) +
+        currentTransforms[i].BoneModelMatrix * t;
+    blendedTransforms[i].BoneOffsetMatrix =
+        currentTransforms[i].BoneOffsetMatrix;
+  }
+  return blendedTransforms;
+}
+
+void DeformRenderer::deformMeshCPU(
+    std::shared_ptr<Mesh> mesh,
+    const std::vector<BoneMatrixBlock> &transforms, bool blendShapes) {
+  auto meshInstance = mesh->GetMeshInstance();
+  if (cpuSkinning.NumVertices() != meshInstance->vertices.size())
+    cpuSkinning.Build(meshInstance->vertices);
+  if (blendShapes)
+    cpuSkinning.Deform(transforms, blendShapeData, blendShapeWeights);
+  else
+    cpuSkinning.Deform(transforms);
+  // the target is allocated with the size of the mesh when it's created
+  mesh->target.UpdateDataAs(GL_SHADER_STORAGE_BUFFER, cpuSkinning.Output, 0);
+}
+
+float DeformRenderer::CompareSkinningBackends() {
+  auto mesh = GWORLD.GetComponent<Mesh>(entityID);
+  auto meshInstance = mesh->GetMeshInstance();
+  if (animator == 0 || meshInstance == nullptr ||
+      meshInstance->vertices.empty())
+    return 0.0f;
+  auto transforms =
+      GWORLD.GetComponent<Animator>(animator)->GetSkeletonTransforms();
+  DeformSkinnedMesh(transforms, meshInstance->vbo,
+                    meshInstance->vertices.size(), mesh->target,
+                    skeletonMatrices);
+  std::vector<Vertex> gpuVertices(meshInstance->vertices.size());
+  mesh->target.BindAs(GL_SHADER_STORAGE_BUFFER);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                     gpuVertices.size() * sizeof(Vertex), gpuVertices.data());
+  mesh->target.UnbindAs(GL_SHADER_STORAGE_BUFFER);
+  if (cpuSkinning.NumVertices() != meshInstance->vertices.size())
+    cpuSkinning.Build(meshInstance->vertices);
+  cpuSkinning.Deform(transforms);
+  float difference = 0.0f;
+  for (int i = 0; i < gpuVertices.size(); ++i) {
+    auto &cpu = cpuSkinning.Output[i], &gpu = gpuVertices[i];
+    for (int c = 0; c < 4; ++c)
+      difference = std::max({difference,
+                             std::abs(cpu.Position[c] - gpu.Position[c]),
+                             std::abs(cpu.Normal[c] - gpu.Normal[c])});
+  }
+  return difference;
 }
 
 void DeformRenderer::DeformMesh(std::shared_ptr<Mesh> mesh) {
   // setup targetVBO of the renderer
   if (animator != 0) {
+    auto anim = GWORLD.GetComponent<Animator>(animator).get();
+    // the skinned vertices of a frozen character are kept from the last frame
+    if (anim->Frozen && skinned) {
+      mesh->Deformed = true;
+      return;
+    }
+    auto &transforms = updateTransforms(anim);
     auto meshInstace = mesh->GetMeshInstance();
-    if (enableBlendShape) {
-      std::vector<float> weights;
+    bool blendShapes = enableBlendShape && blendShapeDataReady;
+    if (blendShapes) {
+      blendShapeWeights.clear();
       for (auto &bs : meshInstace->blendShapes)
-        weights.push_back(bs.weight);
-      blendShapeWeightsBuffer.SetDataAs(GL_SHADER_STORAGE_BUFFER, weights);
-      DeformBlendSkinnedMesh(GWORLD.GetComponent<Animator>(animator).get(),
-                             meshInstace->vbo, meshInstace->vertices.size(),
-                             mesh->target, skeletonMatrices,
-                             meshInstace->blendShapes.size(),
-                             blendShapeWeightsBuffer, blendShapeDataBuffer);
+        blendShapeWeights.push_back(bs.weight);
+    }
+    if (UseCPUSkinning) {
+      deformMeshCPU(mesh, transforms, blendShapes);
+    } else if (blendShapes) {
+      DeformBlendSkinnedMesh(transforms, meshInstace->vbo,
+                             meshInstace->vertices.size(), mesh->target,
+                             skeletonMatrices, blendShapeWeights,
+                             blendShapeBuffers);
     } else {
-      DeformSkinnedMesh(GWORLD.GetComponent<Animator>(animator).get(),
-                        meshInstace->vbo, meshInstace->vertices.size(),
-                        mesh->target, skeletonMatrices);
+      DeformSkinnedMesh(transforms, meshInstace->vbo,
+                        meshInstace->vertices.size(), mesh->target,
+                        skeletonMatrices);
     }
+    skinned = true;
     mesh->Deformed = true; // setup the flag
   }
 }
@@ -65,6 +178,10 @@ void DeformRenderer::DrawInspectorGUI() {
   if (ImGui::TreeNode("Blend Shapes")) {
     auto mesh = GWORLD.GetComponent<Mesh>(entityID)->GetMeshInstance();
     ImGui::Checkbox("Enable Blend Shapes", &enableBlendShape);
+    if (blendShapeDataReady)
+      ImGui::Text("%d deltas, %.1f KB",
+                  (int)blendShapeData.vertexIndices.size(),
+                  blendShapeData.MemoryBytes() / 1024.0f);
     if (!enableBlendShape)
       ImGui::BeginDisabled();
     for (auto &bs : mesh->blendShapes)
@@ -74,6 +191,20 @@ void DeformRenderer::DrawInspectorGUI() {
     ImGui::TreePop();
   }
 
+  if (ImGui::TreeNode("Skinning")) {
+    ImGui::Checkbox("CPU Skinning", &UseCPUSkinning);
+    if (UseCPUSkinning)
+      ImGui::Text("%d vertices in %.3f ms", cpuSkinning.NumVertices(),
+                  cpuSkinning.DeformTime);
+    if (ImGui::Button("Compare With Shader"))
+      skinningDifference = CompareSkinningBackends();
+    if (skinningDifference >= 0.0f) {
+      ImGui::SameLine();
+      ImGui::Text("max difference %g", skinningDifference);
+    }
+    ImGui::TreePop();
+  }
+
   if (ImGui::TreeNode("Renderer")) {
     renderer->DrawInspectorGUI();
     ImGui::TreePop();
@@ -3,6 +3,8 @@
 #include "Base/BaseComponent.hpp"
 #include "Function/Render/Buffers.hpp"
 #include "Function/Render/Mesh.hpp"
+#include "Function/General/Scheduler.hpp"
+#include "Function/Animation/Deform.hpp"
 
 #include "Component/Animator.hpp"
 #include "Component/Mesh.hpp"
@@ -21,10 +23,13 @@ struct DeformRenderer : public aEngine::BaseComponent {
   EntityID animator;
   std::shared_ptr<MeshRenderer> renderer;
   Render::Buffer skeletonMatrices;
-  // This buffer gets updated per frame
-  Render::Buffer blendShapeWeightsBuffer;
-  // This buffer only gets updated when blend shape itself changes
-  Render::Buffer blendShapeDataBuffer;
+  // These only get updated when the blend shapes themselves change
+  SparseBlendShapes blendShapeData;
+  BlendShapeBuffers blendShapeBuffers;
+
+  // Skin the mesh on the cpu and upload the vertices instead of running the
+  // compute shader.
+  bool UseCPUSkinning = false;
 
   std::string getInspectorWindowName() override { return "Deform Renderer"; }
 
@@ -39,10 +44,41 @@ struct DeformRenderer : public aEngine::BaseComponent {
 
   void FillBlendShapeDataBuffer();
 
+  // Fill the blend shape data across frames with the scene scheduler, blend
+  // shapes are ignored in deformation until all the shapes are filled.
+  void ScheduleBlendShapeDataFill();
+
+  // Skin the mesh with both the compute shader and the cpu in the current
+  // pose, returns the largest difference of a position or normal component.
+  float CompareSkinningBackends();
+
   void DrawInspectorGUI() override;
 
 private:
   bool enableBlendShape = false;
+
+  // bone matrices of the last two pose updates of an animator updating at
+  // a reduced rate, the matrices are interpolated in the frames between
+  std::vector<BoneMatrixBlock> previousTransforms, currentTransforms,
+      blendedTransforms;
+  // the mesh is skinned at least once, so it can stay as is while frozen
+  bool skinned = false;
+  SkinnedMeshCPU cpuSkinning;
+  float skinningDifference = -1.0f;
+  // skin the mesh on the cpu and upload the result to `mesh->target`
+  void deformMeshCPU(std::shared_ptr<Mesh> mesh,
+                     const std::vector<BoneMatrixBlock> &transforms,
+                     bool blendShapes);
+  // returns the bone matrices to skin the mesh with in this frame
+  const std::vector<BoneMatrixBlock> &updateTransforms(Animator *anim);
+
+  bool blendShapeDataReady = false;
+  TaskHandle blendShapeFillTask = 0;
+  // shapes added to `blendShapeData`
+  size_t blendShapeFilled = 0;
+  std::vector<float> blendShapeWeights;
+  // returns true when all the shapes are filled
+  bool fillBlendShapeData(size_t maxShapes);
 };
 
 }; // namespace aEngine
\ No newline at end of file
@@ -48,6 +48,11 @@ Engine::Engine(int width, int height)
   MouseScrollCallbacks.push_back([](Engine *engine, double x, double y) {
     engine->_mouseScrollOffsets = glm::vec2(x, y);
     engine->ActionQueue.push_back({ACTION_TYPE::MOUSE_SCROLL, (void*)&engine->_mouseScrollOffsets});
+    InputEvent event;
+    event.device = InputDevice::Mouse;
+    event.scroll = true;
+    event.value = glm::vec2(x, y);
+    GWORLD.Events.Publish(event);
   });
 
   // set the verbosity message written to stderr
@@ -69,6 +74,33 @@ Engine::Engine(int width, int height)
     for (auto mscb : engine->MouseScrollCallbacks)
       mscb(engine, x, y);
   });
+  glfwSetKeyCallback(
+      window, [](GLFWwindow *wnd, int key, int scancode, int action, int mods) {
+        InputEvent event;
+        event.device = InputDevice::Keyboard;
+        event.code = key;
+        event.action = action;
+        event.mods = mods;
+        GWORLD.Events.Publish(event);
+      });
+  glfwSetMouseButtonCallback(
+      window, [](GLFWwindow *wnd, int button, int action, int mods) {
+        InputEvent event;
+        event.device = InputDevice::Mouse;
+        event.code = button;
+        event.action = action;
+        event.mods = mods;
+        event.value = GWORLD.Context.currentMousePosition;
+        GWORLD.Events.Publish(event);
+      });
+  // joystick callback is global, not bound to the window
+  glfwSetJoystickCallback([](int jid, int event) {
+    InputEvent joystickEvent;
+    joystickEvent.device = InputDevice::Joystick;
+    joystickEvent.code = jid;
+    joystickEvent.action = event;
+    GWORLD.Events.Publish(joystickEvent);
+  });
   glfwSetFramebufferSizeCallback(window, [](GLFWwindow *wnd, int width, int height) {
     auto engine = static_cast<Engine *>(glfwGetWindowUserPointer(wnd));
     for (auto fbrcb : engine->ResizeCallbacks)
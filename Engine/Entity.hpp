@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Base/Name.hpp"
 #include "Base/Types.hpp"
 #include "Global.hpp"
 #include "Scene.hpp"
@@ -9,6 +10,7 @@ namespace aEngine {
 class Entity {
 public:
   friend class Scene;
+  friend class WorldSnapshot;
   // default constructor for serialization only
   Entity() {}
   Entity(EntityID id) : ID(id) {
@@ -106,7 +108,7 @@ public:
   bool Enabled = true;
 
   EntityID ID;
-  std::string name = "New Entity ";
+  Name name = "New Entity ";
   Entity *parent = nullptr;
   std::vector<Entity *> children;
 
@@ -0,0 +1,642 @@
+#include "Function/Animation/BlendGraph.hpp"
+#include "Function/General/Utils.hpp"
+#include "Function/Math/SIMD.hpp"
+
+#include <algorithm>
+
+namespace aEngine {
+
+namespace Animation {
+
+using Math::FloatN;
+
+void BlendPoses(const PoseBuffer &a, const PoseBuffer &b, float weight,
+                PoseBuffer &out, const float *weights) {
+  glm::vec3 root =
+      glm::mix(a.rootLocalPosition, b.rootLocalPosition,
+               weights == nullptr ? weight : weight * weights[0]);
+  out.skeleton = a.skeleton;
+  out.Resize(a.numJoints);
+  const int s = a.jointStride;
+  const float *pa = a.rotations.data(), *pb = b.rotations.data();
+  float *po = out.rotations.data();
+  const FloatN uniform(weight);
+  for (int j = 0; j < s; j += FloatN::Width) {
+    FloatN x = FloatN::Load(pa + j), y = FloatN::Load(pa + s + j),
+           z = FloatN::Load(pa + 2 * s + j), w = FloatN::Load(pa + 3 * s + j);
+    FloatN t = weights == nullptr ? uniform : FloatN::Load(weights + j) * uniform;
+    Math::QuatNlerp(x, y, z, w, FloatN::Load(pb + j), FloatN::Load(pb + s + j),
+                    FloatN::Load(pb + 2 * s + j),
+                    FloatN::Load(pb + 3 * s + j), t);
+    x.Store(po + j);
+    y.Store(po + s + j);
+    z.Store(po + 2 * s + j);
+    w.Store(po + 3 * s + j);
+  }
+  out.rootLocalPosition = root;
+}
+
+void AddPoses(const PoseBuffer &base, const PoseBuffer &additive, float weight,
+              PoseBuffer &out, const float *weights) {
+  glm::vec3 root =
+      base.rootLocalPosition +
+      additive.rootLocalPosition *
+          (weights == nullptr ? weight : weight * weights[0]);
+  out.skeleton = base.skeleton;
+  out.Resize(base.numJoints);
+  const int s = base.jointStride;
+  const float *pb = base.rotations.data(), *pa = additive.rotations.data();
+  float *po = out.rotations.data();
+  const FloatN uniform(weight);
+  for (int j = 0; j < s; j += FloatN::Width) {
+    // scale the additive rotation by its weight
+    FloatN dx(0.0f), dy(0.0f), dz(0.0f), dw(1.0f);
+    FloatN t = weights == nullptr ? uniform : FloatN::Load(weights + j) * uniform;
+    Math::QuatNlerp(dx, dy, dz, dw, FloatN::Load(pa + j),
+                    FloatN::Load(pa + s + j), FloatN::Load(pa + 2 * s + j),
+                    FloatN::Load(pa + 3 * s + j), t);
+    // out = base * delta
+    FloatN bx = FloatN::Load(pb + j), by = FloatN::Load(pb + s + j),
+           bz = FloatN::Load(pb + 2 * s + j), bw = FloatN::Load(pb + 3 * s + j);
+    (bw * dw - bx * dx - by * dy - bz * dz).Store(po + 3 * s + j);
+    (bw * dx + bx * dw + by * dz - bz * dy).Store(po + j);
+    (bw * dy + by * dw + bz * dx - bx * dz).Store(po + s + j);
+    (bw * dz + bz * dw + bx * dy - by * dx).Store(po + 2 * s + j);
+  }
+  out.rootLocalPosition = root;
+}
+
+void SubtractPoses(const PoseBuffer &pose, const PoseBuffer &reference,
+                   PoseBuffer &out) {
+  glm::vec3 root = pose.rootLocalPosition - reference.rootLocalPosition;
+  out.skeleton = pose.skeleton;
+  out.Resize(pose.numJoints);
+  const int s = pose.jointStride;
+  const float *pp = pose.rotations.data(), *pr = reference.rotations.data();
+  float *po = out.rotations.data();
+  for (int j = 0; j < s; j += FloatN::Width) {
+    FloatN rx = FloatN::Load(pr + j), ry = FloatN::Load(pr + s + j),
+           rz = FloatN::Load(pr + 2 * s + j), rw = FloatN::Load(pr + 3 * s + j);
+    FloatN qx = FloatN::Load(pp + j), qy = FloatN::Load(pp + s + j),
+           qz = FloatN::Load(pp + 2 * s + j), qw = FloatN::Load(pp + 3 * s + j);
+    // out = conjugate(reference) * pose
+    (rw * qw + rx * qx + ry * qy + rz * qz).Store(po + 3 * s + j);
+    (rw * qx - rx * qw - ry * qz + rz * qy).Store(po + j);
+    (rw * qy - ry * qw - rz * qx + rx * qz).Store(po + s + j);
+    (rw * qz - rz * qw - rx * qy + ry * qx).Store(po + 2 * s + j);
+  }
+  out.rootLocalPosition = root;
+}
+
+static void setIdentityPose(PoseBuffer &pose, Skeleton *skeleton) {
+  pose.skeleton = skeleton;
+  pose.Resize(skeleton->GetNumJoints());
+  std::fill(pose.rotations.begin(), pose.rotations.end(), 0.0f);
+  std::fill(pose.rotations.begin() + 3 * pose.jointStride,
+            pose.rotations.end(), 1.0f);
+  pose.rootLocalPosition = glm::vec3(0.0f);
+}
+
+struct BlendNodeState {
+  // playback time of clips in seconds, normalized time of synced blend spaces
+  float time = 0.0f;
+  // the evaluation in which the node advanced last time
+  unsigned int lastAdvance = 0;
+  // weights of the children of blend spaces
+  std::vector<float> weights;
+  // the child of a selector that's playing and the child fading out, -1
+  // fades out from `frozen`, which is the pose when the crossfade starts
+  int current = -1, previous = -1;
+  float fade = 1.0f;
+  PoseBuffer frozen, last;
+  std::unique_ptr<BlendGraphInstance> subgraph;
+};
+
+// State of one evaluation of a graph instance.
+struct BlendContext {
+  BlendGraphInstance &instance;
+  const BlendGraph &graph;
+  float dt;
+  // normalized time set by a synced blend space, negative if not synced
+  float phase = -1.0f;
+  int stackDepth = 0;
+
+  float Parameter(int index) const {
+    return index < 0 ? 1.0f : instance.parameters[index];
+  }
+  BlendNodeState &State(int node) { return instance.states[node]; }
+  // Returns true on the first call for a node in this evaluation, time
+  // only advances once even if the node is used by several parents.
+  bool Advance(int node) {
+    auto &state = State(node);
+    if (state.lastAdvance == instance.evaluationCount)
+      return false;
+    state.lastAdvance = instance.evaluationCount;
+    return true;
+  }
+  PoseBuffer &PushPose() {
+    if (stackDepth == instance.poseStack.size())
+      instance.poseStack.push_back(std::make_unique<PoseBuffer>());
+    return *instance.poseStack[stackDepth++];
+  }
+  void PopPose() { stackDepth--; }
+  // start a new evaluation of `other`, used by subgraphs
+  static void NextEvaluation(BlendGraphInstance &other) {
+    other.evaluationCount++;
+  }
+
+  void Evaluate(int node, PoseBuffer &out);
+  float Duration(int node);
+};
+
+struct BlendNode {
+  virtual ~BlendNode() {}
+  virtual void InitState(BlendNodeState &state) const {}
+  virtual void Evaluate(BlendContext &ctx, PoseBuffer &out) const = 0;
+  // Length of one cycle in seconds, 0 if the node has no natural length.
+  virtual float Duration(BlendContext &ctx) const { return 0.0f; }
+
+  int index = -1;
+};
+
+void BlendContext::Evaluate(int node, PoseBuffer &out) {
+  graph.nodes[node]->Evaluate(*this, out);
+}
+
+float BlendContext::Duration(int node) {
+  return graph.nodes[node]->Duration(*this);
+}
+
+struct ClipNode : public BlendNode {
+  Motion *motion;
+  float playRate;
+  bool loop;
+
+  float length() const {
+    return std::max(motion->NumFrames() - 1, 0) / (float)motion->fps;
+  }
+
+  float Duration(BlendContext &ctx) const override {
+    return playRate > 0.0f ? length() / playRate : 0.0f;
+  }
+
+  void Evaluate(BlendContext &ctx, PoseBuffer &out) const override {
+    auto &state = ctx.State(index);
+    float frame;
+    if (ctx.phase >= 0.0f) {
+      frame = ctx.phase * std::max(motion->NumFrames() - 1, 0);
+    } else {
+      if (ctx.Advance(index)) {
+        float clipLength = length();
+        state.time += ctx.dt * playRate;
+        if (loop && clipLength > 0.0f) {
+          state.time = std::fmod(state.time, clipLength);
+          if (state.time < 0.0f)
+            state.time += clipLength;
+        } else
+          state.time = std::clamp(state.time, 0.0f, clipLength);
+      }
+      frame = state.time * motion->fps;
+    }
+    if (!motion->SampleInto(frame, out))
+      setIdentityPose(out, ctx.graph.GetSkeleton());
+  }
+};
+
+struct BlendSpaceNode : public BlendNode {
+  std::vector<int> children;
+  bool syncPhase;
+
+  virtual void computeWeights(BlendContext &ctx,
+                              std::vector<float> &weights) const = 0;
+
+  void InitState(BlendNodeState &state) const override {
+    state.weights.resize(children.size());
+  }
+
+  // weighted duration of the children with a natural length
+  float childrenDuration(BlendContext &ctx,
+                         const std::vector<float> &weights) const {
+    float duration = 0.0f, weightSum = 0.0f;
+    for (int i = 0; i < children.size(); ++i) {
+      if (weights[i] <= 0.0f)
+        continue;
+      float childDuration = ctx.Duration(children[i]);
+      if (childDuration > 0.0f) {
+        duration += weights[i] * childDuration;
+        weightSum += weights[i];
+      }
+    }
+    return weightSum > 0.0f ? duration / weightSum : 0.0f;
+  }
+
+  float Duration(BlendContext &ctx) const override {
+    auto &state = ctx.State(index);
+    computeWeights(ctx, state.weights);
+    return childrenDuration(ctx, state.weights);
+  }
+
+  void Evaluate(BlendContext &ctx, PoseBuffer &out) const override {
+    auto &state = ctx.State(index);
+    computeWeights(ctx, state.weights);
+    float parentPhase = ctx.phase;
+    if (syncPhase && ctx.phase < 0.0f) {
+      float duration = childrenDuration(ctx, state.weights);
+      if (duration > 0.0f) {
+        if (ctx.Advance(index)) {
+          state.time += ctx.dt / duration;
+          state.time -= std::floor(state.time);
+        }
+        ctx.phase = state.time;
+      }
+    }
+    // blend the children one by one, each time with its share of the
+    // weights accumulated so far
+    float accumulated = 0.0f;
+    for (int i = 0; i < children.size(); ++i) {
+      float weight = state.weights[i];
+      if (weight <= 1e-5f)
+        continue;
+      if (accumulated == 0.0f) {
+        ctx.Evaluate(children[i], out);
+      } else {
+        auto &childPose = ctx.PushPose();
+        ctx.Evaluate(children[i], childPose);
+        BlendPoses(out, childPose, weight / (accumulated + weight), out);
+        ctx.PopPose();
+      }
+      accumulated += weight;
+    }
+    if (accumulated == 0.0f)
+      setIdentityPose(out, ctx.graph.GetSkeleton());
+    ctx.phase = parentPhase;
+  }
+};
+
+struct BlendSpace1DNode : public BlendSpaceNode {
+  int parameter;
+  // sorted positions of the children
+  std::vector<float> positions;
+
+  void computeWeights(BlendContext &ctx,
+                      std::vector<float> &weights) const override {
+    std::fill(weights.begin(), weights.end(), 0.0f);
+    float value = ctx.Parameter(parameter);
+    if (value <= positions.front()) {
+      weights.front() = 1.0f;
+      return;
+    }
+    if (value >= positions.back()) {
+      weights.back() = 1.0f;
+      return;
+    }
+    int upper = std::upper_bound(positions.begin(), positions.end(), value) -
+                positions.begin();
+    int lower = upper - 1;
+    float t = (value - positions[lower]) /
+              (positions[upper] - positions[lower]);
+    weights[lower] = 1.0f - t;
+    weights[upper] = t;
+  }
+};
+
+struct BlendSpace2DNode : public BlendSpaceNode {
+  int parameterX, parameterY;
+  std::vector<glm::vec2> positions;
+
+  // gradient band interpolation, see Johansen, "Automated Semi-Procedural
+  // Animation for Character Locomotion", 2009
+  void computeWeights(BlendContext &ctx,
+                      std::vector<float> &weights) const override {
+    glm::vec2 p(ctx.Parameter(parameterX), ctx.Parameter(parameterY));
+    float sum = 0.0f;
+    for (int i = 0; i < positions.size(); ++i) {
+      float weight = 1.0f;
+      for (int j = 0; j < positions.size() && weight > 0.0f; ++j) {
+        if (i == j)
+          continue;
+        glm::vec2 pij = positions[j] - positions[i];
+        weight = std::min(
+            weight, 1.0f - glm::dot(p - positions[i], pij) / glm::dot(pij, pij));
+      }
+      weights[i] = std::max(weight, 0.0f);
+      sum += weights[i];
+    }
+    for (auto &weight : weights)
+      weight = sum > 0.0f ? weight / sum : 1.0f / weights.size();
+  }
+};
+
+struct LayerNode : public BlendNode {
+  int base, layer, weightParameter;
+  // padded to the joint stride, empty for all joints
+  std::vector<float> mask;
+  bool additive;
+  PoseBuffer reference;
+
+  float Duration(BlendContext &ctx) const override {
+    return ctx.Duration(base);
+  }
+
+  void Evaluate(BlendContext &ctx, PoseBuffer &out) const override {
+    ctx.Evaluate(base, out);
+    float weight = ctx.Parameter(weightParameter);
+    if (weight <= 0.0f)
+      return;
+    auto &layerPose = ctx.PushPose();
+    ctx.Evaluate(layer, layerPose);
+    const float *weights = mask.empty() ? nullptr : mask.data();
+    if (additive) {
+      SubtractPoses(layerPose, reference, layerPose);
+      AddPoses(out, layerPose, weight, out, weights);
+    } else
+      BlendPoses(out, layerPose, weight, out, weights);
+    ctx.PopPose();
+  }
+};
+
+struct SelectorNode : public BlendNode {
+  int parameter;
+  std::vector<int> children;
+  float fadeTime;
+
+  int selected(BlendContext &ctx) const {
+    int child = (int)std::round(ctx.Parameter(parameter));
+    return std::clamp(child, 0, (int)children.size() - 1);
+  }
+
+  float Duration(BlendContext &ctx) const override {
+    return ctx.Duration(children[selected(ctx)]);
+  }
+
+  void Evaluate(BlendContext &ctx, PoseBuffer &out) const override {
+    auto &state = ctx.State(index);
+    int target = selected(ctx);
+    if (state.current == -1) {
+      state.current = target;
+    } else if (target != state.current) {
+      if (state.fade < 1.0f) {
+        // switched again during a crossfade, fade out from where it is
+        std::swap(state.frozen, state.last);
+        state.previous = -1;
+      } else
+        state.previous = state.current;
+      state.current = target;
+      state.fade = fadeTime > 0.0f ? 0.0f : 1.0f;
+    }
+    if (ctx.Advance(index) && state.fade < 1.0f)
+      state.fade = std::min(1.0f, state.fade + ctx.dt / fadeTime);
+    ctx.Evaluate(children[state.current], out);
+    if (state.fade < 1.0f) {
+      float t = state.fade * state.fade * (3.0f - 2.0f * state.fade);
+      if (state.previous != -1) {
+        auto &previousPose = ctx.PushPose();
+        ctx.Evaluate(children[state.previous], previousPose);
+        BlendPoses(previousPose, out, t, out);
+        ctx.PopPose();
+      } else
+        BlendPoses(state.frozen, out, t, out);
+      state.last = out;
+    }
+  }
+};
+
+struct SubgraphNode : public BlendNode {
+  std::shared_ptr<const BlendGraph> subgraph;
+  // parameter of this graph -> parameter of the subgraph
+  std::vector<std::pair<int, int>> forwardedParameters;
+
+  void InitState(BlendNodeState &state) const override {
+    state.subgraph = std::make_unique<BlendGraphInstance>(subgraph);
+  }
+
+  float Duration(BlendContext &ctx) const override {
+    auto &instance = *ctx.State(index).subgraph;
+    BlendContext subContext{instance, *subgraph, 0.0f};
+    return subContext.Duration(subgraph->Root());
+  }
+
+  void Evaluate(BlendContext &ctx, PoseBuffer &out) const override {
+    auto &instance = *ctx.State(index).subgraph;
+    for (auto &forward : forwardedParameters)
+      instance.SetParameter(forward.second, ctx.Parameter(forward.first));
+    float dt = 0.0f;
+    if (ctx.Advance(index)) {
+      dt = ctx.dt;
+      BlendContext::NextEvaluation(instance);
+    }
+    BlendContext subContext{instance, *subgraph, dt, ctx.phase};
+    subContext.Evaluate(subgraph->Root(), out);
+  }
+};
+
+BlendGraph::BlendGraph(Skeleton *skel) : skeleton(skel) {
+  if (skeleton == nullptr)
+    throw std::runtime_error("blend graph needs a skeleton");
+}
+
+BlendGraph::~BlendGraph() {}
+
+int BlendGraph::addParameter(const std::string &name) {
+  if (name.empty())
+    return -1;
+  int index = FindParameter(name);
+  if (index != -1)
+    return index;
+  parameters.push_back(name);
+  return parameters.size() - 1;
+}
+
+int BlendGraph::FindParameter(const std::string &name) const {
+  auto it = std::find(parameters.begin(), parameters.end(), name);
+  return it == parameters.end() ? -1 : it - parameters.begin();
+}
+
+int BlendGraph::addNode(std::unique_ptr<BlendNode> node) {
+  node->index = nodes.size();
+  nodes.push_back(std::move(node));
+  root = nodes.size() - 1;
+  return root;
+}
+
+void BlendGraph::checkNode(int node) const {
+  if (node < 0 || node >= nodes.size())
+    throw std::runtime_error("invalid blend graph node " +
+                             std::to_string(node));
+}
+
+std::vector<float> BlendGraph::paddedMask(std::vector<float> mask) const {
+  if (mask.empty())
+    return mask;
+  if (mask.size() != skeleton->GetNumJoints())
+    throw std::runtime_error("the mask has a different number of joints "
+                             "than the blend graph");
+  mask.resize(Math::PadToSIMD(skeleton->GetNumJoints()), 0.0f);
+  return mask;
+}
+
+int BlendGraph::AddClip(Motion *motion, float playRate, bool loop) {
+  if (motion == nullptr ||
+      motion->skeleton.GetNumJoints() != skeleton->GetNumJoints())
+    throw std::runtime_error("the clip has different joints than the blend "
+                             "graph");
+  // pack the frames now, instances sharing the clip may sample it from
+  // different threads
+  motion->EnsurePackedFrames();
+  auto node = std::make_unique<ClipNode>();
+  node->motion = motion;
+  node->playRate = playRate;
+  node->loop = loop;
+  return addNode(std::move(node));
+}
+
+int BlendGraph::AddBlendSpace1D(const std::string &parameter,
+                                std::vector<std::pair<float, int>> samples,
+                                bool syncPhase) {
+  if (samples.empty())
+    throw std::runtime_error("blend space without samples");
+  std::sort(samples.begin(), samples.end(),
+            [](auto &a, auto &b) { return a.first < b.first; });
+  auto node = std::make_unique<BlendSpace1DNode>();
+  node->parameter = addParameter(parameter);
+  node->syncPhase = syncPhase;
+  for (auto &sample : samples) {
+    checkNode(sample.second);
+    node->positions.push_back(sample.first);
+    node->children.push_back(sample.second);
+  }
+  return addNode(std::move(node));
+}
+
+int BlendGraph::AddBlendSpace2D(const std::string &parameterX,
+                                const std::string &parameterY,
+                                std::vector<std::pair<glm::vec2, int>> samples,
+                                bool syncPhase) {
+  if (samples.empty())
+    throw std::runtime_error("blend space without samples");
+  auto node = std::make_unique<BlendSpace2DNode>();
+  node->parameterX = addParameter(parameterX);
+  node->parameterY = addParameter(parameterY);
+  node->syncPhase = syncPhase;
+  for (auto &sample : samples) {
+    checkNode(sample.second);
+    for (auto &position : node->positions)
+      if (position == sample.first)
+        throw std::runtime_error("blend space samples at the same position");
+    node->positions.push_back(sample.first);
+    node->children.push_back(sample.second);
+  }
+  return addNode(std::move(node));
+}
+
+int BlendGraph::AddLayer(int base, int layer,
+                         const std::string &weightParameter,
+                         std::vector<float> mask) {
+  checkNode(base);
+  checkNode(layer);
+  auto node = std::make_unique<LayerNode>();
+  node->base = base;
+  node->layer = layer;
+  node->weightParameter = addParameter(weightParameter);
+  node->mask = paddedMask(std::move(mask));
+  node->additive = false;
+  return addNode(std::move(node));
+}
+
+int BlendGraph::AddAdditiveLayer(int base, int layer, const Pose &reference,
+                                 const std::string &weightParameter,
+                                 std::vector<float> mask) {
+  if (reference.jointRotations.size() != skeleton->GetNumJoints())
+    throw std::runtime_error("the reference pose has different joints than "
+                             "the blend graph");
+  int index = AddLayer(base, layer, weightParameter, std::move(mask));
+  auto node = static_cast<LayerNode *>(nodes[index].get());
+  node->additive = true;
+  Pose referencePose = reference;
+  node->reference.FromPose(referencePose);
+  return index;
+}
+
+int BlendGraph::AddSelector(const std::string &parameter,
+                            std::vector<int> children, float fadeTime) {
+  if (children.empty())
+    throw std::runtime_error("selector without children");
+  for (auto child : children)
+    checkNode(child);
+  auto node = std::make_unique<SelectorNode>();
+  node->parameter = addParameter(parameter);
+  node->children = std::move(children);
+  node->fadeTime = fadeTime;
+  return addNode(std::move(node));
+}
+
+int BlendGraph::AddSubgraph(std::shared_ptr<const BlendGraph> graph) {
+  if (graph == nullptr || graph->root == -1 ||
+      graph->skeleton->GetNumJoints() != skeleton->GetNumJoints())
+    throw std::runtime_error("the subgraph has different joints than the "
+                             "blend graph");
+  auto node = std::make_unique<SubgraphNode>();
+  for (int i = 0; i < graph->NumParameters(); ++i)
+    node->forwardedParameters.push_back(
+        std::make_pair(addParameter(graph->ParameterName(i)), i));
+  node->subgraph = std::move(graph);
+  return addNode(std::move(node));
+}
+
+void BlendGraph::SetRoot(int node) {
+  checkNode(node);
+  root = node;
+}
+
+std::vector<float> BlendGraph::MaskFromJoint(const std::string &jointName,
+                                             float weight) const {
+  int numJoints = skeleton->GetNumJoints();
+  auto it =
+      std::find(skeleton->jointNames.begin(), skeleton->jointNames.end(),
+                Name(jointName));
+  if (it == skeleton->jointNames.end())
+    throw std::runtime_error("joint " + jointName + " not found");
+  int rootJoint = it - skeleton->jointNames.begin();
+  // the parent of a joint always has a lower index
+  std::vector<float> mask(numJoints, 0.0f);
+  mask[rootJoint] = weight;
+  for (int jointInd = rootJoint + 1; jointInd < numJoints; ++jointInd) {
+    int parent = skeleton->jointParent[jointInd];
+    if (parent >= rootJoint && mask[parent] != 0.0f)
+      mask[jointInd] = weight;
+  }
+  return mask;
+}
+
+BlendGraphInstance::BlendGraphInstance(std::shared_ptr<const BlendGraph> g)
+    : graph(std::move(g)) {
+  if (graph == nullptr || graph->root == -1)
+    throw std::runtime_error("can't instantiate an empty blend graph");
+  parameters.assign(graph->parameters.size(), 0.0f);
+  states.resize(graph->nodes.size());
+  for (auto &node : graph->nodes)
+    node->InitState(states[node->index]);
+  setIdentityPose(Output, graph->skeleton);
+}
+
+BlendGraphInstance::~BlendGraphInstance() {}
+
+void BlendGraphInstance::SetParameter(const std::string &name, float value) {
+  int index = graph->FindParameter(name);
+  if (index != -1)
+    parameters[index] = value;
+}
+
+PoseBuffer &BlendGraphInstance::Evaluate(float dt) {
+  Timer timer;
+  evaluationCount++;
+  BlendContext ctx{*this, *graph, dt};
+  ctx.Evaluate(graph->root, Output);
+  Output.skeleton = graph->skeleton;
+  EvaluationTime = timer.ElapsedMilliseconds() * 1000.0;
+  return Output;
+}
+
+}; // namespace Animation
+
+}; // namespace aEngine
@@ -0,0 +1,164 @@
+/**
+ * Layered animation blending.
+ *
+ * A `BlendGraph` describes how a pose is produced from clips: blend spaces
+ * over one or two parameters, layers that override or add to a base pose
+ * with per-joint masks, selectors that crossfade between their children and
+ * other graphs used as subgraphs. The graph itself is never modified during
+ * evaluation, everything that changes per character (clip times,
+ * parameters, running crossfades) lives in a `BlendGraphInstance`. Any
+ * number of characters can share one graph, and a graph can be used as a
+ * subgraph of many others.
+ *
+ * Each node evaluates into a `PoseBuffer` taken from a stack owned by the
+ * instance, the buffers are reused across frames and the blend kernels
+ * process `FloatN::Width` joints at a time. The final pose is written to
+ * the skeleton once, see `Animator::ApplyPoseToSkeleton`.
+ */
+#pragma once
+
+#include "Function/Animation/Motion.hpp"
+
+#include <memory>
+
+namespace aEngine {
+
+namespace Animation {
+
+// The blend kernels work on buffers with the same number of joints, `out`
+// may be any of the inputs. `weights` holds one weight per joint, nullptr
+// means a weight of 1 for all joints, the root translation follows the
+// weight of joint 0.
+
+// `out = nlerp(a, b, weight * weights[joint])`, the root translation is
+// interpolated linearly.
+void BlendPoses(const PoseBuffer &a, const PoseBuffer &b, float weight,
+                PoseBuffer &out, const float *weights = nullptr);
+// `out = base * nlerp(identity, additive, weight * weights[joint])`, the root
+// translation of `additive` is added to the base.
+void AddPoses(const PoseBuffer &base, const PoseBuffer &additive, float weight,
+              PoseBuffer &out, const float *weights = nullptr);
+// The additive pose that turns `reference` into `pose`,
+// `out = inverse(reference) * pose`.
+void SubtractPoses(const PoseBuffer &pose, const PoseBuffer &reference,
+                   PoseBuffer &out);
+
+struct BlendNode;
+
+class BlendGraph {
+public:
+  // All the clips in the graph must have the same joints as `skeleton`.
+  BlendGraph(Skeleton *skeleton);
+  ~BlendGraph();
+
+  BlendGraph(BlendGraph &) = delete;
+  const BlendGraph &operator=(BlendGraph &) = delete;
+
+  // The functions below add a node and return its index, nodes can only
+  // reference nodes added before them, the last added node is the root
+  // unless `SetRoot` is called.
+
+  // Play a clip at `playRate` times its speed.
+  int AddClip(Motion *motion, float playRate = 1.0f, bool loop = true);
+  // Blend between the nodes placed at the given values of `parameter`.
+  // With `syncPhase`, clips below this node play at the same normalized
+  // time, so that blending a walk with a run keeps the feet in phase.
+  int AddBlendSpace1D(const std::string &parameter,
+                      std::vector<std::pair<float, int>> samples,
+                      bool syncPhase = true);
+  // Same as above on two parameters, the weights come from gradient band
+  // interpolation over the sample positions.
+  int AddBlendSpace2D(const std::string &parameterX,
+                      const std::string &parameterY,
+                      std::vector<std::pair<glm::vec2, int>> samples,
+                      bool syncPhase = true);
+  // Blend `layer` over `base` with `weightParameter` (1 if empty) times the
+  // mask of each joint, an empty mask covers all joints.
+  int AddLayer(int base, int layer, const std::string &weightParameter = "",
+               std::vector<float> mask = {});
+  // Add the difference between `layer` and `reference` on top of `base`.
+  int AddAdditiveLayer(int base, int layer, const Pose &reference,
+                       const std::string &weightParameter = "",
+                       std::vector<float> mask = {});
+  // Play the child selected by the value of `parameter`, switching to
+  // another child crossfades over `fadeTime` seconds.
+  int AddSelector(const std::string &parameter, std::vector<int> children,
+                  float fadeTime = 0.2f);
+  // Evaluate another graph as a node, parameters of the subgraph are added
+  // to this graph and forwarded by name.
+  int AddSubgraph(std::shared_ptr<const BlendGraph> graph);
+
+  void SetRoot(int node);
+
+  // Mask with `weight` on `jointName` and all its descendants.
+  std::vector<float> MaskFromJoint(const std::string &jointName,
+                                   float weight = 1.0f) const;
+
+  // Returns -1 if there's no such parameter.
+  int FindParameter(const std::string &name) const;
+  int NumParameters() const { return parameters.size(); }
+  const std::string &ParameterName(int index) const {
+    return parameters[index];
+  }
+
+  Skeleton *GetSkeleton() const { return skeleton; }
+  int NumNodes() const { return nodes.size(); }
+  int Root() const { return root; }
+
+private:
+  friend class BlendGraphInstance;
+  friend struct BlendContext;
+
+  Skeleton *skeleton;
+  int root = -1;
+  std::vector<std::unique_ptr<BlendNode>> nodes;
+  std::vector<std::string> parameters;
+
+  // find the parameter, add it if not exists
+  int addParameter(const std::string &name);
+  int addNode(std::unique_ptr<BlendNode> node);
+  void checkNode(int node) const;
+  std::vector<float> paddedMask(std::vector<float> mask) const;
+};
+
+struct BlendNodeState;
+
+class BlendGraphInstance {
+public:
+  BlendGraphInstance(std::shared_ptr<const BlendGraph> graph);
+  ~BlendGraphInstance();
+
+  BlendGraphInstance(BlendGraphInstance &) = delete;
+  const BlendGraphInstance &operator=(BlendGraphInstance &) = delete;
+
+  // Unknown parameter names are ignored.
+  void SetParameter(const std::string &name, float value);
+  void SetParameter(int index, float value) { parameters[index] = value; }
+  float GetParameter(int index) const { return parameters[index]; }
+
+  // Advance the clips by `dt` seconds and evaluate the root node into
+  // `Output`, the pose uses the skeleton of the graph.
+  PoseBuffer &Evaluate(float dt);
+
+  const std::shared_ptr<const BlendGraph> &Graph() const { return graph; }
+
+  PoseBuffer Output;
+  // Wall time of the last `Evaluate` in microseconds.
+  float EvaluationTime = 0.0f;
+
+private:
+  friend struct BlendContext;
+
+  std::shared_ptr<const BlendGraph> graph;
+  std::vector<float> parameters;
+  std::vector<BlendNodeState> states;
+  // temporary poses of the nodes being evaluated, only grows
+  std::vector<std::unique_ptr<PoseBuffer>> poseStack;
+  // number of `Evaluate` calls, a node shared by several parents only
+  // advances once per evaluation
+  unsigned int evaluationCount = 0;
+};
+
+}; // namespace Animation
+
+}; // namespace aEngine
@@ -0,0 +1,368 @@
+#include "Function/Animation/Compression.hpp"
+#include "Function/Animation/Kinematics.hpp"
+#include "Function/Math/SIMD.hpp"
+
+#include <algorithm>
+#include <stack>
+
+namespace aEngine {
+
+namespace Animation {
+
+using Math::FloatN;
+
+// range of the three smallest components of a unit quaternion
+static const float smallestThreeRange = 0.70710678f;
+static const float smallestThreeScale = 32767.0f;
+
+void QuantizeRotation(glm::quat q, uint16_t out[3]) {
+  float c[4] = {q.x, q.y, q.z, q.w};
+  int largest = 0;
+  for (int i = 1; i < 4; ++i)
+    if (std::abs(c[i]) > std::abs(c[largest]))
+      largest = i;
+  // q and -q are the same rotation, keep the largest component positive
+  float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+  uint64_t bits = (uint64_t)largest << 45;
+  int shift = 30;
+  for (int i = 0; i < 4; ++i) {
+    if (i == largest)
+      continue;
+    float v = (c[i] * sign + smallestThreeRange) / (2.0f * smallestThreeRange);
+    v = std::min(std::max(v, 0.0f), 1.0f);
+    bits |= (uint64_t)(v * smallestThreeScale + 0.5f) << shift;
+    shift -= 15;
+  }
+  out[0] = (uint16_t)(bits >> 32);
+  out[1] = (uint16_t)(bits >> 16);
+  out[2] = (uint16_t)bits;
+}
+
+glm::quat DequantizeRotation(const uint16_t in[3]) {
+  uint64_t bits =
+      ((uint64_t)in[0] << 32) | ((uint64_t)in[1] << 16) | (uint64_t)in[2];
+  int largest = (bits >> 45) & 3;
+  float c[4];
+  float sum = 0.0f;
+  int shift = 30;
+  for (int i = 0; i < 4; ++i) {
+    if (i == largest)
+      continue;
+    float v = ((bits >> shift) & 0x7fff) / smallestThreeScale;
+    c[i] = v * 2.0f * smallestThreeRange - smallestThreeRange;
+    sum += c[i] * c[i];
+    shift -= 15;
+  }
+  c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+  return glm::quat(c[3], c[0], c[1], c[2]);
+}
+
+// the same interpolation used by the sampler, evaluated for one joint
+static glm::quat interpolateRotation(glm::quat a, glm::quat b, float t) {
+  FloatN x(a.x), y(a.y), z(a.z), w(a.w);
+  Math::QuatNlerp(x, y, z, w, FloatN(b.x), FloatN(b.y), FloatN(b.z),
+                  FloatN(b.w), FloatN(t));
+  float r[4][FloatN::Width];
+  x.Store(r[0]), y.Store(r[1]), z.Store(r[2]), w.Store(r[3]);
+  return glm::quat(r[3][0], r[0][0], r[1][0], r[2][0]);
+}
+
+// Displacement of a point `distance` away from the rotation center, that is
+// `2 * distance * sin(angle / 2)`. It's computed from the chord `|a - b|`
+// instead of the dot product, which rounds to 1 for small angles.
+static float rotationError(glm::quat a, glm::quat b, float distance) {
+  if (glm::dot(a, b) < 0.0f)
+    b = -b;
+  float chord = glm::length(glm::vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w));
+  chord = std::min(chord, std::sqrt(2.0f));
+  return 2.0f * distance * chord * std::sqrt(1.0f - 0.25f * chord * chord);
+}
+
+// Douglas-Peucker style key reduction, `error(a, b, f)` is the error at
+// frame `f` when it's interpolated from keys `a` and `b`
+template <typename ErrorFunc>
+static std::vector<uint16_t> reduceKeys(int numFrames, float tolerance,
+                                        ErrorFunc error) {
+  std::vector<char> isKey(numFrames, 0);
+  isKey[0] = isKey[numFrames - 1] = 1;
+  std::stack<std::pair<int, int>> segments;
+  if (numFrames > 2)
+    segments.push(std::make_pair(0, numFrames - 1));
+  while (!segments.empty()) {
+    auto [a, b] = segments.top();
+    segments.pop();
+    float maxError = 0.0f;
+    int worst = -1;
+    for (int f = a + 1; f < b; ++f) {
+      float e = error(a, b, f);
+      if (e > maxError) {
+        maxError = e;
+        worst = f;
+      }
+    }
+    if (worst != -1 && maxError > tolerance) {
+      isKey[worst] = 1;
+      if (worst - a > 1)
+        segments.push(std::make_pair(a, worst));
+      if (b - worst > 1)
+        segments.push(std::make_pair(worst, b));
+    }
+  }
+  std::vector<uint16_t> keyFrames;
+  for (int f = 0; f < numFrames; ++f)
+    if (isKey[f])
+      keyFrames.push_back(f);
+  return keyFrames;
+}
+
+CompressedMotion CompressMotion(Motion &motion,
+                                const CompressionSettings &settings) {
+  CompressedMotion result;
+  // motions loaded from the cache only hold the packed frames
+  motion.EnsurePoses();
+  const int numFrames = motion.poses.size();
+  const int jointNum = motion.skeleton.GetNumJoints();
+  if (numFrames > 65535)
+    throw std::runtime_error("motion clip is too long to be compressed");
+  result.fps = motion.fps;
+  result.numFrames = numFrames;
+  result.skeleton = motion.skeleton;
+  result.path = motion.path;
+  if (numFrames == 0)
+    return result;
+
+  // Split the error bound between the root translation and the rotations of
+  // all joints along the longest chain, `reach` is the furthest distance a
+  // point moved by this joint can be from it.
+  auto &parent = motion.skeleton.jointParent;
+  std::vector<int> depth(jointNum, 0), maxLeafDepth(jointNum, 0);
+  std::vector<float> reach(jointNum, settings.leafShellDistance);
+  for (int j = 0; j < jointNum; ++j)
+    depth[j] = parent[j] == -1 ? 0 : depth[parent[j]] + 1;
+  for (int j = 0; j < jointNum; ++j)
+    maxLeafDepth[j] = depth[j];
+  std::vector<bool> hasChild(jointNum, false);
+  for (int j = jointNum - 1; j >= 0; --j) {
+    int p = parent[j];
+    if (p == -1)
+      continue;
+    float childReach = glm::length(motion.skeleton.jointOffset[j]) + reach[j];
+    reach[p] = hasChild[p] ? std::max(reach[p], childReach) : childReach;
+    hasChild[p] = true;
+    maxLeafDepth[p] = std::max(maxLeafDepth[p], maxLeafDepth[j]);
+  }
+  int deepest = *std::max_element(maxLeafDepth.begin(), maxLeafDepth.end());
+
+  result.rotationTracks.resize(jointNum);
+  std::vector<glm::quat> original(numFrames), quantized(numFrames);
+  for (int j = 0; j < jointNum; ++j) {
+    auto &track = result.rotationTracks[j];
+    std::vector<uint16_t> allKeys(3 * numFrames);
+    // keys carry quantization error already, leave the rest for reduction
+    float quantizationError = 0.0f;
+    for (int f = 0; f < numFrames; ++f) {
+      original[f] = motion.poses[f].jointRotations[j];
+      QuantizeRotation(original[f], &allKeys[3 * f]);
+      quantized[f] = DequantizeRotation(&allKeys[3 * f]);
+      quantizationError = std::max(
+          quantizationError, rotationError(quantized[f], original[f], reach[j]));
+    }
+    float tolerance = std::max(
+        settings.maxPositionError / (maxLeafDepth[j] + 2) - quantizationError,
+        0.0f);
+    track.keyFrames = reduceKeys(numFrames, tolerance, [&](int a, int b, int f) {
+      float t = (f - a) / (float)(b - a);
+      auto q = interpolateRotation(quantized[a], quantized[b], t);
+      return rotationError(q, original[f], reach[j]);
+    });
+    for (auto f : track.keyFrames)
+      track.keys.insert(track.keys.end(), &allKeys[3 * f], &allKeys[3 * f + 3]);
+  }
+
+  // root translation, 16 bits per component unless the range of the track
+  // is too large for the error bound, e.g. long locomotion clips
+  glm::vec3 rootMax(std::numeric_limits<float>::lowest());
+  result.rootMin = glm::vec3(std::numeric_limits<float>::max());
+  for (auto &pose : motion.poses) {
+    result.rootMin = glm::min(result.rootMin, pose.rootLocalPosition);
+    rootMax = glm::max(rootMax, pose.rootLocalPosition);
+  }
+  result.rootExtent = rootMax - result.rootMin;
+  float rootTolerance = settings.maxPositionError / (deepest + 2);
+  float maxExtent = glm::max(result.rootExtent.x,
+                             glm::max(result.rootExtent.y, result.rootExtent.z));
+  result.rootBits = maxExtent / 65535.0f > 0.25f * rootTolerance ? 32 : 16;
+  const int words = result.rootBits / 16;
+  std::vector<uint16_t> allRootKeys(3 * words * numFrames);
+  std::vector<glm::vec3> rootQuantized(numFrames);
+  for (int f = 0; f < numFrames; ++f) {
+    uint16_t *key = &allRootKeys[3 * words * f];
+    for (int c = 0; c < 3; ++c) {
+      float extent = result.rootExtent[c];
+      double v = extent > 0.0f ? (motion.poses[f].rootLocalPosition[c] -
+                                  result.rootMin[c]) /
+                                     (double)extent
+                               : 0.0;
+      if (words == 1) {
+        key[c] = (uint16_t)(v * 65535.0 + 0.5);
+      } else {
+        uint32_t q = (uint32_t)(v * 4294967295.0 + 0.5);
+        key[2 * c] = (uint16_t)(q >> 16);
+        key[2 * c + 1] = (uint16_t)q;
+      }
+    }
+    rootQuantized[f] = result.decodeRootKey(key);
+  }
+  result.rootKeyFrames =
+      reduceKeys(numFrames, rootTolerance, [&](int a, int b, int f) {
+        float t = (f - a) / (float)(b - a);
+        auto p = rootQuantized[a] * (1.0f - t) + rootQuantized[b] * t;
+        return glm::length(p - motion.poses[f].rootLocalPosition);
+      });
+  for (auto f : result.rootKeyFrames)
+    result.rootKeys.insert(result.rootKeys.end(), &allRootKeys[3 * words * f],
+                           &allRootKeys[3 * words * (f + 1)]);
+  return result;
+}
+
+// index of the first key of the segment containing `frame`
+static int findSegment(const std::vector<uint16_t> &keyFrames, float frame) {
+  int k = std::upper_bound(keyFrames.begin(), keyFrames.end(), frame,
+                           [](float f, uint16_t key) { return f < key; }) -
+          keyFrames.begin() - 1;
+  return std::min(std::max(k, 0), std::max((int)keyFrames.size() - 2, 0));
+}
+
+static float segmentAlpha(const std::vector<uint16_t> &keyFrames, int k,
+                          float frame) {
+  if (k + 1 >= keyFrames.size())
+    return 0.0f;
+  float t = (frame - keyFrames[k]) / (float)(keyFrames[k + 1] - keyFrames[k]);
+  return std::min(std::max(t, 0.0f), 1.0f);
+}
+
+bool CompressedMotion::SampleInto(float frame, PoseBuffer &buffer) {
+  if (numFrames == 0)
+    return false;
+  frame = std::min(std::max(frame, 0.0f), (float)(numFrames - 1));
+  const int jointNum = rotationTracks.size();
+  buffer.skeleton = &skeleton;
+  buffer.Resize(jointNum);
+  const int s = buffer.jointStride;
+  // second key of each segment and the per joint interpolation parameter
+  thread_local std::vector<float> scratch;
+  scratch.resize(5 * s);
+  float *a = buffer.rotations.data(), *b = scratch.data(),
+        *t = scratch.data() + 4 * s;
+  for (int j = 0; j < jointNum; ++j) {
+    auto &track = rotationTracks[j];
+    int k = findSegment(track.keyFrames, frame);
+    int k1 = std::min<int>(k + 1, track.keyFrames.size() - 1);
+    glm::quat qa = DequantizeRotation(&track.keys[3 * k]);
+    glm::quat qb = DequantizeRotation(&track.keys[3 * k1]);
+    a[j] = qa.x, a[s + j] = qa.y, a[2 * s + j] = qa.z, a[3 * s + j] = qa.w;
+    b[j] = qb.x, b[s + j] = qb.y, b[2 * s + j] = qb.z, b[3 * s + j] = qb.w;
+    t[j] = segmentAlpha(track.keyFrames, k, frame);
+  }
+  for (int j = jointNum; j < s; ++j) {
+    a[j] = a[s + j] = a[2 * s + j] = 0.0f, a[3 * s + j] = 1.0f;
+    b[j] = b[s + j] = b[2 * s + j] = 0.0f, b[3 * s + j] = 1.0f;
+    t[j] = 0.0f;
+  }
+  for (int j = 0; j < s; j += FloatN::Width) {
+    FloatN x = FloatN::Load(a + j), y = FloatN::Load(a + s + j),
+           z = FloatN::Load(a + 2 * s + j), w = FloatN::Load(a + 3 * s + j);
+    Math::QuatNlerp(x, y, z, w, FloatN::Load(b + j), FloatN::Load(b + s + j),
+                    FloatN::Load(b + 2 * s + j), FloatN::Load(b + 3 * s + j),
+                    FloatN::Load(t + j));
+    x.Store(a + j);
+    y.Store(a + s + j);
+    z.Store(a + 2 * s + j);
+    w.Store(a + 3 * s + j);
+  }
+  // root translation
+  const int words = rootBits / 16;
+  int k = findSegment(rootKeyFrames, frame);
+  int k1 = std::min<int>(k + 1, rootKeyFrames.size() - 1);
+  float alpha = segmentAlpha(rootKeyFrames, k, frame);
+  buffer.rootLocalPosition =
+      decodeRootKey(&rootKeys[3 * words * k]) * (1.0f - alpha) +
+      decodeRootKey(&rootKeys[3 * words * k1]) * alpha;
+  return true;
+}
+
+glm::vec3 CompressedMotion::decodeRootKey(const uint16_t *key) const {
+  glm::vec3 result;
+  for (int c = 0; c < 3; ++c) {
+    double v = rootBits == 16
+                   ? key[c] / 65535.0
+                   : (((uint32_t)key[2 * c] << 16) | key[2 * c + 1]) /
+                         4294967295.0;
+    result[c] = rootMin[c] + (float)(v * rootExtent[c]);
+  }
+  return result;
+}
+
+void CompressedMotion::Decompress(Motion &motion) {
+  motion.fps = fps;
+  motion.skeleton = skeleton;
+  motion.path = path;
+  motion.poses.resize(numFrames);
+  PoseBuffer buffer;
+  for (int f = 0; f < numFrames; ++f) {
+    SampleInto(f, buffer);
+    motion.poses[f] = buffer.ToPose();
+    motion.poses[f].skeleton = &motion.skeleton;
+  }
+  motion.UpdatePackedFrames();
+}
+
+size_t CompressedMotion::KeyBytes() const {
+  size_t bytes = (rootKeyFrames.size() + rootKeys.size()) * sizeof(uint16_t);
+  for (auto &track : rotationTracks)
+    bytes += (track.keyFrames.size() + track.keys.size()) * sizeof(uint16_t);
+  return bytes;
+}
+
+CompressionReport EvaluateCompression(Motion &original,
+                                      CompressedMotion &compressed) {
+  CompressionReport report;
+  original.EnsurePoses();
+  const int numFrames = original.poses.size();
+  const int jointNum = original.skeleton.GetNumJoints();
+  report.rawBytes =
+      numFrames * (jointNum * sizeof(glm::quat) + sizeof(glm::vec3));
+  report.compressedBytes = compressed.KeyBytes();
+  report.ratio = report.compressedBytes == 0
+                     ? 0.0f
+                     : report.rawBytes / (float)report.compressedBytes;
+  if (numFrames == 0)
+    return report;
+  Motion decompressed;
+  compressed.Decompress(decompressed);
+  std::vector<glm::vec3> originalPositions, decompressedPositions;
+  std::vector<glm::quat> originalOrientations, decompressedOrientations;
+  ForwardKinematics(original.skeleton, original.poses, originalPositions,
+                    originalOrientations);
+  ForwardKinematics(decompressed.skeleton, decompressed.poses,
+                    decompressedPositions, decompressedOrientations);
+  double sum = 0.0;
+  for (int f = 0; f < numFrames; ++f) {
+    for (int j = 0; j < jointNum; ++j) {
+      float e = glm::length(originalPositions[f * jointNum + j] -
+                            decompressedPositions[f * jointNum + j]);
+      sum += e;
+      if (e > report.maxError) {
+        report.maxError = e;
+        report.maxErrorFrame = f;
+        report.maxErrorJoint = j;
+      }
+    }
+  }
+  report.meanError = sum / ((double)numFrames * jointNum);
+  return report;
+}
+
+}; // namespace Animation
+
+}; // namespace aEngine
@@ -0,0 +1,98 @@
+/**
+ * Compressed representation of a motion clip.
+ *
+ * Rotations are stored with smallest-three quantization in 48 bits: 2 bits
+ * for the index of the largest component and 15 bits for each of the
+ * remaining three. The root translation is range quantized with the range
+ * of the track, to 16 bits per component, or to 32 bits when a step of 16
+ * bits over the range would take too much of the error bound, e.g. on long
+ * locomotion clips.
+ *
+ * Every track keeps only the keys needed to reconstruct the motion within
+ * an error bound. The bound is measured as world space position error, a
+ * rotation error on a joint moves all of its descendants, so each joint
+ * gets a share of the bound by the length of the chain it belongs to and
+ * the distance to its furthest descendant.
+ */
+#pragma once
+
+#include "Function/Animation/Motion.hpp"
+
+#include <cstdint>
+
+namespace aEngine {
+
+namespace Animation {
+
+struct CompressionSettings {
+  // maximum world space position error of any joint, in the same unit as
+  // the skeleton offsets. The error can't go below what 48 bits rotations
+  // give, roughly 1e-4 rad on each joint along a chain.
+  float maxPositionError = 0.001f;
+  // rotations of leaf joints still move the mesh skinned to them, the
+  // error is measured on a virtual point this far away from the joint
+  float leafShellDistance = 0.1f;
+};
+
+struct CompressedMotion {
+  int fps = 30, numFrames = 0;
+  Skeleton skeleton;
+  // file containing the original data
+  std::string path;
+
+  // Rotation keys of one joint, `keys` holds 3 quantized values per key.
+  // The first and last frames are always keys.
+  struct RotationTrack {
+    std::vector<uint16_t> keyFrames;
+    std::vector<uint16_t> keys;
+  };
+  std::vector<RotationTrack> rotationTracks;
+
+  // Root translation keys, 3 quantized values of `rootBits` (16 or 32) bits
+  // per key, 32 bits values are stored as two words, high word first.
+  std::vector<uint16_t> rootKeyFrames;
+  std::vector<uint16_t> rootKeys;
+  int rootBits = 16;
+  glm::vec3 rootMin = glm::vec3(0.0f), rootExtent = glm::vec3(0.0f);
+
+  // Same clamping rules as `Motion::At`, keys are decoded straight into the
+  // buffer and interpolated `FloatN::Width` joints at a time.
+  bool SampleInto(float frame, PoseBuffer &buffer);
+
+  // Expand to a full motion clip.
+  void Decompress(Motion &motion);
+
+  // Bytes used by the keys of this clip.
+  size_t KeyBytes() const;
+
+private:
+  glm::vec3 decodeRootKey(const uint16_t *key) const;
+  friend CompressedMotion CompressMotion(Motion &motion,
+                                         const CompressionSettings &settings);
+};
+
+// Compress a motion clip, throws if the clip is longer than 65535 frames.
+CompressedMotion CompressMotion(Motion &motion,
+                                const CompressionSettings &settings = {});
+
+struct CompressionReport {
+  // bytes of the full precision poses
+  size_t rawBytes = 0;
+  size_t compressedBytes = 0;
+  float ratio = 0.0f;
+  // world space joint position error over all frames and joints
+  float maxError = 0.0f, meanError = 0.0f;
+  int maxErrorFrame = 0, maxErrorJoint = 0;
+};
+
+// Compare the compressed clip with the original one.
+CompressionReport EvaluateCompression(Motion &original,
+                                      CompressedMotion &compressed);
+
+// Smallest-three quantization of a unit quaternion.
+void QuantizeRotation(glm::quat q, uint16_t out[3]);
+glm::quat DequantizeRotation(const uint16_t in[3]);
+
+}; // namespace Animation
+
+}; // namespace aEngine
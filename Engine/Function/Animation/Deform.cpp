@@ -55,17 +55,16 @@ void main() {
 }
 )";
 
-void DeformSkinnedMesh(Animator *animator, Render::Buffer &inputVBO,
-                       unsigned int elementNum, Render::Buffer &targetVBO,
-                       Render::Buffer &matrices) {
+void DeformSkinnedMesh(const std::vector<BoneMatrixBlock> &transforms,
+                       Render::Buffer &inputVBO, unsigned int elementNum,
+                       Render::Buffer &targetVBO, Render::Buffer &matrices) {
   static ComputeShader cs(skinnedMeshDeform);
   cs.Use();
   // configure the inputs
   inputVBO.BindAs(GL_SHADER_STORAGE_BUFFER);
   inputVBO.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 0);
   matrices.BindAs(GL_SHADER_STORAGE_BUFFER);
-  matrices.SetDataAs(GL_SHADER_STORAGE_BUFFER,
-                     animator->GetSkeletonTransforms());
+  matrices.SetDataAs(GL_SHADER_STORAGE_BUFFER, transforms);
   matrices.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 1);
   // configure the outputs
   targetVBO.BindAs(GL_SHADER_STORAGE_BUFFER);
@@ -78,11 +77,37 @@ void DeformSkinnedMesh(Animator *animator, Render::Buffer &inputVBO,
   glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 }
 
+static std::string blendShapeAccumulate = R"(
+#version 430 core
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+layout(std430, binding = 0) buffer ShapeVertexIndices {
+  int vertexIndices[];
+};
+layout(std430, binding = 1) buffer ShapePositionDeltas {
+  vec4 positionDeltas[];
+};
+layout(std430, binding = 2) buffer BlendShapeOffsets {
+  vec4 offsets[];
+};
+// the deltas of the shape are [shapeStart, shapeStart + shapeSize)
+uniform int shapeStart;
+uniform int shapeSize;
+uniform float weight;
+
+void main() {
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= shapeSize) return;
+  int delta = shapeStart + int(index);
+  // a shape moves each vertex at most once, so there are no conflicting
+  // writes within one dispatch
+  offsets[vertexIndices[delta]] += weight * positionDeltas[delta];
+}
+)";
+
 static std::string blendShapeGS = R"(
 #version 430 core
 layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
 #define MAX_BONES 4
-#define MAX_BLEND_SHAPES 52
 struct Vertex {
   vec4 Position;
   vec4 Normal;
@@ -104,17 +129,9 @@ layout(std430, binding = 1) buffer BoneTransforms {
 layout(std430, binding = 2) buffer VertexOutput {
   Vertex vOut[];
 };
-layout(std430, binding = 3) buffer BlendShapeWeightsBuffer {
-  float blendShapeWeights[];
-};
-struct BlendShapeData {
-  vec4 posOffset[MAX_BLEND_SHAPES];
-  vec4 normalOffset[MAX_BLEND_SHAPES];
+layout(std430, binding = 3) buffer BlendShapeOffsets {
+  vec4 offsets[];
 };
-layout(std430, binding = 4) buffer BlendShapeDataBuffer {
-  BlendShapeData blendShapeOffset[];
-};
-uniform int numBlendShapes;
 
 void main() {
   uint index = gl_GlobalInvocationID.x;
@@ -124,9 +141,7 @@ void main() {
   vec4 newPosition = vec4(0.0);
   vec4 newNormal = vec4(0.0);
 
-  vec4 blendedPosition = vtx.Position;
-  for (int j = 0; j < numBlendShapes; j++)
-    blendedPosition += blendShapeWeights[j] * blendShapeOffset[index].posOffset[j];
+  vec4 blendedPosition = vtx.Position + offsets[index];
 
   // Apply skinning
   for (int i = 0; i < MAX_BONES; i++) {
@@ -147,42 +162,97 @@ void main() {
   vOut[index].Normal = normalize(newNormal);
 }
 )";
-struct TmpBlendVertex {
-  glm::vec4 posOffset = glm::vec4(0.0f), normalOffset = glm::vec4(0.0f);
-};
-void DeformBlendSkinnedMesh(Animator *animator, Render::Buffer &inputVBO,
-                            unsigned int elementNum, Render::Buffer &targetVBO,
-                            Render::Buffer &matrices,
-                            int numBlendShapes,
-                            Render::Buffer &blendShapeWeightsBuffer,
-                            Render::Buffer &blendShapeOffsetBuffer) {
+
+void BlendShapeBuffers::Upload(const SparseBlendShapes &blendShapes) {
+  vertexIndices.SetDataAs(GL_SHADER_STORAGE_BUFFER, blendShapes.vertexIndices);
+  positionDeltas.SetDataAs(GL_SHADER_STORAGE_BUFFER,
+                           blendShapes.positionDeltas);
+  offsets.SetDataAs(GL_SHADER_STORAGE_BUFFER,
+                    std::vector<glm::vec4>(blendShapes.numVertices),
+                    GL_DYNAMIC_DRAW);
+  offsets.UnbindAs(GL_SHADER_STORAGE_BUFFER);
+  shapeStart = blendShapes.shapeStart;
+  numVertices = blendShapes.numVertices;
+  mismatchReported = false;
+}
+
+void DeformBlendSkinnedMesh(const std::vector<BoneMatrixBlock> &transforms,
+                            Render::Buffer &inputVBO, unsigned int elementNum,
+                            Render::Buffer &targetVBO, Render::Buffer &matrices,
+                            const std::vector<float> &weights,
+                            BlendShapeBuffers &blendShapes) {
+  static ComputeShader accumulate(blendShapeAccumulate);
   static ComputeShader cs(blendShapeGS);
+  if (!glIsBuffer(inputVBO.GetID()) || !glIsBuffer(targetVBO.GetID()))
+    return;
+  if (blendShapes.numVertices != elementNum) {
+    if (!blendShapes.mismatchReported)
+      LOG_F(WARNING,
+            "blend shapes built for %d vertices but the mesh has %u, the mesh "
+            "won't be deformed",
+            blendShapes.numVertices, elementNum);
+    blendShapes.mismatchReported = true;
+    return;
+  }
+
+  // sum up the weighted deltas, the vertices no shape moves stay zero
+  blendShapes.offsets.BindAs(GL_SHADER_STORAGE_BUFFER);
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32F, GL_RGBA, GL_FLOAT,
+                    nullptr);
+  accumulate.Use();
+  blendShapes.vertexIndices.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 0);
+  blendShapes.positionDeltas.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 1);
+  blendShapes.offsets.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 2);
+  int numShapes =
+      std::min<int>(blendShapes.shapeStart.size() - 1, weights.size());
+  for (int s = 0; s < numShapes; ++s) {
+    int shapeSize = blendShapes.shapeStart[s + 1] - blendShapes.shapeStart[s];
+    if (weights[s] == 0.0f || shapeSize == 0)
+      continue;
+    // the shapes may move the same vertices
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glUniform1i(glGetUniformLocation(accumulate.ID, "shapeStart"),
+                blendShapes.shapeStart[s]);
+    glUniform1i(glGetUniformLocation(accumulate.ID, "shapeSize"), shapeSize);
+    glUniform1f(glGetUniformLocation(accumulate.ID, "weight"), weights[s]);
+    accumulate.Dispatch((shapeSize + 63) / 64, 1, 1);
+  }
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
   cs.Use();
   // configure the inputs
   inputVBO.BindAs(GL_SHADER_STORAGE_BUFFER);
   inputVBO.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 0);
 
   matrices.BindAs(GL_SHADER_STORAGE_BUFFER);
-  matrices.SetDataAs(GL_SHADER_STORAGE_BUFFER,
-                     animator->GetSkeletonTransforms());
+  matrices.SetDataAs(GL_SHADER_STORAGE_BUFFER, transforms);
   matrices.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 1);
   // configure the outputs
   targetVBO.BindAs(GL_SHADER_STORAGE_BUFFER);
   targetVBO.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 2);
-
-
-  glUniform1i(glGetUniformLocation(cs.ID, "numBlendShapes"), numBlendShapes);
-  // Create and bind buffer for blend shape data
-  blendShapeWeightsBuffer.BindAs(GL_SHADER_STORAGE_BUFFER);
-  blendShapeWeightsBuffer.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 3);
-  blendShapeOffsetBuffer.BindAs(GL_SHADER_STORAGE_BUFFER);
-  blendShapeOffsetBuffer.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 4);
+  blendShapes.offsets.BindToPointAs(GL_SHADER_STORAGE_BUFFER, 3);
 
   int numVertices = elementNum;
   int numWorkGroups = (numVertices + 63) / 64;
-  if (glIsBuffer(inputVBO.GetID()) && glIsBuffer(targetVBO.GetID()))
-    cs.Dispatch(numWorkGroups, 1, 1);
+  cs.Dispatch(numWorkGroups, 1, 1);
   glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 }
 
+void DeformSkinnedMesh(Animator *animator, Render::Buffer &inputVBO,
+                       unsigned int elementNum, Render::Buffer &targetVBO,
+                       Render::Buffer &matrices) {
+  DeformSkinnedMesh(animator->GetSkeletonTransforms(), inputVBO, elementNum,
+                    targetVBO, matrices);
+}
+
+void DeformBlendSkinnedMesh(Animator *animator, Render::Buffer &inputVBO,
+                            unsigned int elementNum, Render::Buffer &targetVBO,
+                            Render::Buffer &matrices,
+                            const std::vector<float> &weights,
+                            BlendShapeBuffers &blendShapes) {
+  DeformBlendSkinnedMesh(animator->GetSkeletonTransforms(), inputVBO,
+                         elementNum, targetVBO, matrices, weights,
+                         blendShapes);
+}
+
 }; // namespace aEngine
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "Global.hpp"
 #include "Scene.hpp"
 
+#include "Function/Animation/Skinning.hpp"
 #include "Function/General/ComputeShader.hpp"
 #include "Function/Render/Buffers.hpp"
 #include "Function/Render/Mesh.hpp"
@@ -12,12 +13,38 @@
 
 namespace aEngine {
 
+// Gpu copy of `SparseBlendShapes`, `offsets` holds the weighted sum of the
+// deltas of each vertex and is rebuilt by every deformation.
+struct BlendShapeBuffers {
+  Render::Buffer vertexIndices, positionDeltas, offsets;
+  // `shapeStart` stays on the cpu to dispatch the shapes one by one
+  std::vector<int> shapeStart = {0};
+  int numVertices = 0;
+  // a mesh with a different vertex count is reported once per upload
+  bool mismatchReported = false;
+
+  void Upload(const SparseBlendShapes &blendShapes);
+};
+
+// Skin the mesh with the given bone matrices. Only the shapes with a
+// non-zero weight are added, each by one dispatch over the vertices it
+// moves.
+void DeformBlendSkinnedMesh(const std::vector<BoneMatrixBlock> &transforms,
+                            Render::Buffer &inputVBO, unsigned int elementNum,
+                            Render::Buffer &targetVBO, Render::Buffer &matrices,
+                            const std::vector<float> &weights,
+                            BlendShapeBuffers &blendShapes);
+
+void DeformSkinnedMesh(const std::vector<BoneMatrixBlock> &transforms,
+                       Render::Buffer &inputVBO, unsigned int elementNum,
+                       Render::Buffer &targetVBO, Render::Buffer &matrices);
+
+// Same as above with the current pose of `animator`.
 void DeformBlendSkinnedMesh(Animator *animator, Render::Buffer &inputVBO,
                             unsigned int elementNum, Render::Buffer &targetVBO,
                             Render::Buffer &matrices,
-                            int numBlendShapes,
-                            Render::Buffer &blendShapeWeightsBuffer,
-                            Render::Buffer &blendShapeOffsetBuffer);
+                            const std::vector<float> &weights,
+                            BlendShapeBuffers &blendShapes);
 
 void DeformSkinnedMesh(Animator *animator, Render::Buffer &inputVBO,
                        unsigned int elementNum, Render::Buffer &targetVBO,
@@ -0,0 +1,189 @@
+/**
+ * Compile time layout of the motion matching features.
+ *
+ * A schema is a list of feature blocks, e.g. the position of a joint
+ * relative to the root or the future trajectory, each block knows its
+ * dimension and how to pack itself, so the dimension, the offset of every
+ * block and the packing code of a schema are all resolved at compile time.
+ * Weights are given per block at runtime and expanded to one weight per
+ * dimension for the search.
+ *
+ * The joints are indices into the skeleton, declare one schema per skeleton
+ * type like `PFNNFeatures`. A database remembers the `Signature` of the
+ * schema it was built with, so a database built for another skeleton is
+ * never searched with the wrong layout.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+namespace aEngine {
+
+namespace Animation {
+
+// What the feature blocks are packed from, one frame of a clip in the
+// database or the state of a character at runtime.
+struct FeatureFrame {
+  // global positions and velocities of all the joints
+  const glm::vec3 *positions = nullptr, *velocities = nullptr;
+  // trajectory samples on the xz plane, positions relative to the root and
+  // facing directions
+  const glm::vec2 *trajectory = nullptr, *facing = nullptr;
+};
+
+// A schema without the template, what `MotionDatabase` needs to compute the
+// features of its frames.
+struct FeatureExtractor {
+  int dim = 0;
+  uint64_t signature = 0;
+  // the joint the trajectory is sampled from
+  int root = 0;
+  int trajectorySamples = 0;
+  void (*pack)(const FeatureFrame &frame, float *feature) = nullptr;
+};
+
+// Position of `Joint` relative to the root.
+template <int Joint> struct JointPosition {
+  static constexpr int Dim = 3, Samples = 0;
+  static constexpr uint64_t Code = 0x100 | Joint;
+  template <int Root>
+  static void Pack(const FeatureFrame &frame, float *out) {
+    glm::vec3 p = frame.positions[Joint] - frame.positions[Root];
+    out[0] = p.x, out[1] = p.y, out[2] = p.z;
+  }
+  static std::string Name() {
+    return "Joint " + std::to_string(Joint) + " Position";
+  }
+};
+
+// Global velocity of `Joint`.
+template <int Joint> struct JointVelocity {
+  static constexpr int Dim = 3, Samples = 0;
+  static constexpr uint64_t Code = 0x200 | Joint;
+  template <int Root>
+  static void Pack(const FeatureFrame &frame, float *out) {
+    glm::vec3 v = frame.velocities[Joint];
+    out[0] = v.x, out[1] = v.y, out[2] = v.z;
+  }
+  static std::string Name() {
+    return "Joint " + std::to_string(Joint) + " Velocity";
+  }
+};
+
+// The first `N` trajectory positions.
+template <int N> struct TrajectoryPositions {
+  static constexpr int Dim = 2 * N, Samples = N;
+  static constexpr uint64_t Code = 0x300 | N;
+  template <int Root>
+  static void Pack(const FeatureFrame &frame, float *out) {
+    for (int i = 0; i < N; ++i) {
+      out[2 * i] = frame.trajectory[i].x;
+      out[2 * i + 1] = frame.trajectory[i].y;
+    }
+  }
+  static std::string Name() { return "Trajectory"; }
+};
+
+// The first `N` trajectory facing directions.
+template <int N> struct TrajectoryDirections {
+  static constexpr int Dim = 2 * N, Samples = N;
+  static constexpr uint64_t Code = 0x400 | N;
+  template <int Root>
+  static void Pack(const FeatureFrame &frame, float *out) {
+    for (int i = 0; i < N; ++i) {
+      out[2 * i] = frame.facing[i].x;
+      out[2 * i + 1] = frame.facing[i].y;
+    }
+  }
+  static std::string Name() { return "Facing"; }
+};
+
+template <int RootJoint, typename... Blocks> struct FeatureSchema {
+  static_assert(sizeof...(Blocks) > 0, "a schema needs at least one block");
+
+  static constexpr int Root = RootJoint;
+  static constexpr int NumBlocks = sizeof...(Blocks);
+  static constexpr int Dim = (Blocks::Dim + ...);
+  static constexpr int TrajectorySamples = std::max({0, Blocks::Samples...});
+  // first dimension of every block, `Offsets[NumBlocks]` is `Dim`
+  static constexpr std::array<int, NumBlocks + 1> Offsets = [] {
+    std::array<int, NumBlocks + 1> offsets{};
+    int dims[] = {Blocks::Dim...};
+    for (int i = 0; i < NumBlocks; ++i)
+      offsets[i + 1] = offsets[i] + dims[i];
+    return offsets;
+  }();
+  // 64 bits FNV-1a hash of the root and the blocks
+  static constexpr uint64_t Signature = [] {
+    uint64_t hash = 14695981039346656037ull;
+    for (uint64_t code : {(uint64_t)Root, Blocks::Code...}) {
+      hash ^= code;
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }();
+
+  using Feature = std::array<float, Dim>;
+  using BlockWeights = std::array<float, NumBlocks>;
+
+  static void Pack(const FeatureFrame &frame, float *feature) {
+    packBlocks(frame, feature, std::index_sequence_for<Blocks...>());
+  }
+  static Feature Pack(const FeatureFrame &frame) {
+    Feature feature;
+    Pack(frame, feature.data());
+    return feature;
+  }
+
+  // One weight per dimension from one weight per block.
+  static Feature ExpandWeights(const BlockWeights &weights) {
+    Feature expanded;
+    for (int b = 0; b < NumBlocks; ++b)
+      std::fill(expanded.begin() + Offsets[b],
+                expanded.begin() + Offsets[b + 1], weights[b]);
+    return expanded;
+  }
+
+  static std::array<std::string, NumBlocks> BlockNames() {
+    return {Blocks::Name()...};
+  }
+
+  static FeatureExtractor Extractor() {
+    FeatureExtractor extractor;
+    extractor.dim = Dim;
+    extractor.signature = Signature;
+    extractor.root = Root;
+    extractor.trajectorySamples = TrajectorySamples;
+    extractor.pack = &FeatureSchema::Pack;
+    return extractor;
+  }
+
+private:
+  template <std::size_t... I>
+  static void packBlocks(const FeatureFrame &frame, float *feature,
+                         std::index_sequence<I...>) {
+    (Blocks::template Pack<Root>(frame, feature + Offsets[I]), ...);
+  }
+};
+
+// The pfnn mocap skeleton.
+namespace PFNN {
+static constexpr int Hip = 0, LeftFoot = 4, RightFoot = 9;
+}; // namespace PFNN
+
+using PFNNFeatures =
+    FeatureSchema<PFNN::Hip, JointVelocity<PFNN::Hip>,
+                  JointPosition<PFNN::LeftFoot>, JointVelocity<PFNN::LeftFoot>,
+                  JointPosition<PFNN::RightFoot>,
+                  JointVelocity<PFNN::RightFoot>, TrajectoryPositions<4>,
+                  TrajectoryDirections<4>>;
+
+}; // namespace Animation
+
+}; // namespace aEngine
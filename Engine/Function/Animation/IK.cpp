@@ -0,0 +1,739 @@
+#include "Function/Animation/IK.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/Math/SIMD.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace aEngine {
+
+namespace Animation {
+
+using Math::FloatN;
+
+// poses per task of the thread pool, a multiple of the simd width
+static const int ikGrain = 64;
+static const float ikEpsilon = 1e-6f;
+
+void IKTarget::Resize(int poseNum) {
+  poseStride = Math::PadToSIMD(poseNum);
+  positions.assign(3 * poseStride, 0.0f);
+  weights.assign(poseStride, 0.0f);
+}
+
+void IKTarget::Set(int poseInd, glm::vec3 position, float weight) {
+  positions[poseInd] = position.x;
+  positions[poseStride + poseInd] = position.y;
+  positions[2 * poseStride + poseInd] = position.z;
+  weights[poseInd] = weight;
+}
+
+void IKChain::Build(const std::vector<int> &jointParent, int root,
+                    std::vector<int> effectorJoints) {
+  effectors = std::move(effectorJoints);
+  std::vector<bool> inChain(jointParent.size(), false);
+  inChain[root] = true;
+  for (int effector : effectors) {
+    for (int joint = effector; !inChain[joint]; joint = jointParent[joint]) {
+      if (jointParent[joint] == -1)
+        throw std::runtime_error("ik effector is not below the chain root");
+      if (jointParent[joint] > joint)
+        throw std::runtime_error("ik joints must come after their parents");
+      inChain[joint] = true;
+    }
+  }
+  joints.clear();
+  for (int joint = 0; joint < inChain.size(); ++joint)
+    if (inChain[joint])
+      joints.push_back(joint);
+}
+
+// `FloatN::Width` vectors and quaternions, components are ordered as x, y,
+// z, w like the batch
+struct Vec3N {
+  FloatN x, y, z;
+};
+struct QuatN {
+  FloatN x, y, z, w;
+};
+
+static Vec3N broadcast(glm::vec3 v) {
+  return {FloatN(v.x), FloatN(v.y), FloatN(v.z)};
+}
+static QuatN broadcast(glm::quat q) {
+  return {FloatN(q.x), FloatN(q.y), FloatN(q.z), FloatN(q.w)};
+}
+static QuatN identityN() {
+  return {FloatN(0.0f), FloatN(0.0f), FloatN(0.0f), FloatN(1.0f)};
+}
+
+static Vec3N loadVec3(const float *p, int stride) {
+  return {FloatN::Load(p), FloatN::Load(p + stride),
+          FloatN::Load(p + 2 * stride)};
+}
+static void storeVec3(const Vec3N &v, float *p, int stride) {
+  v.x.Store(p), v.y.Store(p + stride), v.z.Store(p + 2 * stride);
+}
+static QuatN loadQuat(const float *p, int stride) {
+  return {FloatN::Load(p), FloatN::Load(p + stride),
+          FloatN::Load(p + 2 * stride), FloatN::Load(p + 3 * stride)};
+}
+static void storeQuat(const QuatN &q, float *p, int stride) {
+  q.x.Store(p), q.y.Store(p + stride), q.z.Store(p + 2 * stride),
+      q.w.Store(p + 3 * stride);
+}
+
+static Vec3N add(const Vec3N &a, const Vec3N &b) {
+  return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+static Vec3N sub(const Vec3N &a, const Vec3N &b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+static Vec3N scale(const Vec3N &a, FloatN k) {
+  return {a.x * k, a.y * k, a.z * k};
+}
+static FloatN dot(const Vec3N &a, const Vec3N &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+static Vec3N cross(const Vec3N &a, const Vec3N &b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+static FloatN length(const Vec3N &a) { return Math::Sqrt(dot(a, a)); }
+// zero length vectors stay (close to) zero
+static Vec3N normalize(const Vec3N &a) {
+  return scale(a, FloatN(1.0f) /
+                      Math::Sqrt(Math::Max(dot(a, a),
+                                           FloatN(ikEpsilon * ikEpsilon))));
+}
+static Vec3N select(FloatN mask, const Vec3N &a, const Vec3N &b) {
+  return {Math::Select(mask, a.x, b.x), Math::Select(mask, a.y, b.y),
+          Math::Select(mask, a.z, b.z)};
+}
+
+// same operation order as glm's `qua * qua`
+static QuatN mul(const QuatN &p, const QuatN &q) {
+  return {p.w * q.x + p.x * q.w + p.y * q.z - p.z * q.y,
+          p.w * q.y + p.y * q.w + p.z * q.x - p.x * q.z,
+          p.w * q.z + p.z * q.w + p.x * q.y - p.y * q.x,
+          p.w * q.w - p.x * q.x - p.y * q.y - p.z * q.z};
+}
+static QuatN conj(const QuatN &q) { return {-q.x, -q.y, -q.z, q.w}; }
+static Vec3N rotate(const QuatN &q, const Vec3N &v) {
+  Vec3N u = {q.x, q.y, q.z};
+  Vec3N uv = cross(u, v), uuv = cross(u, uv);
+  return add(v, scale(add(scale(uv, q.w), uuv), FloatN(2.0f)));
+}
+static QuatN normalize(const QuatN &q) {
+  FloatN inv = FloatN(1.0f) /
+               Math::Sqrt(Math::Max(q.x * q.x + q.y * q.y + q.z * q.z +
+                                        q.w * q.w,
+                                    FloatN(ikEpsilon * ikEpsilon)));
+  return {q.x * inv, q.y * inv, q.z * inv, q.w * inv};
+}
+static QuatN select(FloatN mask, const QuatN &a, const QuatN &b) {
+  return {Math::Select(mask, a.x, b.x), Math::Select(mask, a.y, b.y),
+          Math::Select(mask, a.z, b.z), Math::Select(mask, a.w, b.w)};
+}
+// nlerp from `a` to `b`
+static QuatN blend(QuatN a, const QuatN &b, FloatN t) {
+  Math::QuatNlerp(a.x, a.y, a.z, a.w, b.x, b.y, b.z, b.w, t);
+  return a;
+}
+
+// Rotation around the unit `axis` by the angle of cosine `cosAngle` and
+// sine `sinAngle`.
+static QuatN axisAngle(const Vec3N &axis, FloatN cosAngle, FloatN sinAngle) {
+  const FloatN zero(0.0f), half(0.5f), one(1.0f);
+  FloatN c = Math::Sqrt(Math::Max((one + cosAngle) * half, zero));
+  FloatN s = Math::Sqrt(Math::Max((one - cosAngle) * half, zero)) ^
+             Math::SignBit(sinAngle);
+  return {axis.x * s, axis.y * s, axis.z * s, c};
+}
+
+// Shortest rotation from the unit `u` to the unit `v`, identity if either
+// is zero.
+static QuatN fromTo(const Vec3N &u, const Vec3N &v) {
+  const FloatN zero(0.0f), one(1.0f);
+  Vec3N c = cross(u, v);
+  QuatN q = {c.x, c.y, c.z, one + dot(u, v)};
+  // opposite vectors, half a turn around any axis orthogonal to `u`
+  FloatN opposite = q.w < FloatN(ikEpsilon);
+  FloatN useX = Math::Abs(u.x) < FloatN(0.9f);
+  Vec3N orthogonal = {Math::Select(useX, zero, -u.z),
+                      Math::Select(useX, u.z, zero),
+                      Math::Select(useX, -u.y, u.x)};
+  QuatN halfTurn = {orthogonal.x, orthogonal.y, orthogonal.z, zero};
+  return normalize(select(opposite, halfTurn, q));
+}
+
+// Rotation around the unit `axis` turning `from` towards `to`, both are
+// projected to the plane orthogonal to the axis first. Identity where
+// either projection vanishes.
+static QuatN turnAround(const Vec3N &axis, Vec3N from, Vec3N to) {
+  const FloatN eps(ikEpsilon);
+  from = sub(from, scale(axis, dot(from, axis)));
+  to = sub(to, scale(axis, dot(to, axis)));
+  FloatN valid = (length(from) > eps) & (length(to) > eps);
+  from = normalize(from), to = normalize(to);
+  return axisAngle(
+      axis, Math::Select(valid, dot(from, to), FloatN(1.0f)),
+      Math::Select(valid, dot(cross(from, to), axis), FloatN(0.0f)));
+}
+
+static FloatN clampUnit(FloatN x) {
+  return Math::Min(Math::Max(x, FloatN(-1.0f)), FloatN(1.0f));
+}
+static FloatN sinFromCos(FloatN c) {
+  return Math::Sqrt(Math::Max(FloatN(1.0f) - c * c, FloatN(0.0f)));
+}
+
+// `IKJointLimit` broadcast once per solve, the angles are stored as the
+// sines and cosines of the half angles used by quaternions
+struct JointLimitN {
+  QuatN rest;
+  Vec3N axis;
+  FloatN sinMinTwist, sinMaxTwist, sinMaxSwing, cosMaxSwing;
+};
+
+static JointLimitN broadcast(const IKJointLimit &limit) {
+  JointLimitN limitN;
+  limitN.rest = broadcast(glm::normalize(limit.Rest));
+  limitN.axis = broadcast(glm::normalize(limit.TwistAxis));
+  limitN.sinMinTwist = FloatN(std::sin(0.5f * limit.MinTwist));
+  limitN.sinMaxTwist = FloatN(std::sin(0.5f * limit.MaxTwist));
+  limitN.sinMaxSwing = FloatN(std::sin(0.5f * limit.MaxSwing));
+  limitN.cosMaxSwing = FloatN(std::cos(0.5f * limit.MaxSwing));
+  return limitN;
+}
+
+// Split the rotation from the rest pose into a swing followed by a twist
+// around the axis and clamp both.
+static QuatN applyLimit(const QuatN &local, const JointLimitN &limit) {
+  const FloatN zero(0.0f), one(1.0f), eps(ikEpsilon);
+  QuatN q = mul(conj(limit.rest), local);
+  // the short way around, so that the twist is within [-pi, pi]
+  FloatN sign = Math::SignBit(q.w);
+  q = {q.x ^ sign, q.y ^ sign, q.z ^ sign, q.w ^ sign};
+  FloatN projection = dot({q.x, q.y, q.z}, limit.axis);
+  FloatN twistLength = Math::Sqrt(projection * projection + q.w * q.w);
+  // a half turn swing leaves no twist
+  FloatN hasTwist = twistLength > eps;
+  FloatN invLength = one / Math::Max(twistLength, eps);
+  FloatN twistSin = Math::Select(hasTwist, projection * invLength, zero),
+         twistCos = Math::Select(hasTwist, q.w * invLength, one);
+  QuatN twist = {limit.axis.x * twistSin, limit.axis.y * twistSin,
+                 limit.axis.z * twistSin, twistCos};
+  QuatN swing = mul(q, conj(twist));
+  twistSin = Math::Min(Math::Max(twistSin, limit.sinMinTwist),
+                       limit.sinMaxTwist);
+  twistCos = sinFromCos(twistSin);
+  twist = {limit.axis.x * twistSin, limit.axis.y * twistSin,
+           limit.axis.z * twistSin, twistCos};
+  Vec3N swingAxis = {swing.x, swing.y, swing.z};
+  FloatN swingSin = length(swingAxis);
+  FloatN outside = swingSin > limit.sinMaxSwing;
+  swingAxis = select(
+      outside, scale(swingAxis, limit.sinMaxSwing / Math::Max(swingSin, eps)),
+      swingAxis);
+  swing = {swingAxis.x, swingAxis.y, swingAxis.z,
+           Math::Select(outside, limit.cosMaxSwing, swing.w)};
+  return mul(limit.rest, mul(swing, twist));
+}
+
+// The global rotation the local rotation of `joint` is applied to, root
+// joints follow `ForwardKinematics`.
+static QuatN parentRotation(const std::vector<int> &jointParent,
+                            const PoseBatch &batch, int joint, int p) {
+  int parent = jointParent[joint];
+  int source = parent == -1 ? (joint == 0 ? -1 : 0) : parent;
+  if (source == -1)
+    return identityN();
+  return loadQuat(batch.globalRotations.data() + source * 4 * batch.poseStride +
+                      p,
+                  batch.poseStride);
+}
+
+// Call `solveRange` on ranges of poses covering the batch, both ends of a
+// range are multiples of the simd width.
+template <typename Func>
+static void forEachPoseRange(PoseBatch &batch, bool parallel,
+                             const Func &solveRange) {
+  if (!parallel || batch.poseStride <= ikGrain) {
+    solveRange(0, batch.poseStride);
+    return;
+  }
+  ThreadPool::Ref().ParallelFor(0, batch.poseStride, ikGrain, solveRange);
+}
+
+static void solveTwoBoneRange(const std::vector<int> &jointParent,
+                              const std::vector<glm::vec3> &jointOffset,
+                              PoseBatch &batch, const TwoBoneChain &chain,
+                              const IKTarget &target, const IKTarget *pole,
+                              int poseBegin, int poseEnd) {
+  const int s = batch.poseStride;
+  const FloatN zero(0.0f), one(1.0f), two(2.0f), eps(ikEpsilon);
+  // never stretch the limb completely, the bend axis is lost otherwise
+  const FloatN maxReach(0.9999f);
+  float *local = batch.localRotations.data();
+  float *globalRot = batch.globalRotations.data();
+  float *globalPos = batch.globalPositions.data();
+  const int upper = chain.upper, middle = chain.middle, end = chain.end;
+  Vec3N bendAxis = broadcast(glm::normalize(chain.BendAxis));
+  Vec3N middleOffset = broadcast(jointOffset[middle]),
+        endOffset = broadcast(jointOffset[end]);
+  for (int p = poseBegin; p < poseEnd; p += FloatN::Width) {
+    FloatN weight = FloatN::Load(target.weights.data() + p);
+    FloatN active = weight > zero;
+    if (Math::MoveMask(active) == 0)
+      continue;
+    QuatN parentRot = parentRotation(jointParent, batch, upper, p);
+    QuatN upperLocal = loadQuat(local + upper * 4 * s + p, s),
+          middleLocal = loadQuat(local + middle * 4 * s + p, s),
+          endLocal = loadQuat(local + end * 4 * s + p, s);
+    QuatN upperRot = loadQuat(globalRot + upper * 4 * s + p, s),
+          middleRot = loadQuat(globalRot + middle * 4 * s + p, s),
+          endRot = loadQuat(globalRot + end * 4 * s + p, s);
+    Vec3N a = loadVec3(globalPos + upper * 3 * s + p, s),
+          b = loadVec3(globalPos + middle * 3 * s + p, s),
+          c = loadVec3(globalPos + end * 3 * s + p, s);
+    Vec3N t = loadVec3(target.positions.data() + p, s);
+
+    Vec3N ab = sub(b, a), bc = sub(c, b), ac = sub(c, a), at = sub(t, a);
+    FloatN lab = length(ab), lbc = length(bc), lac = length(ac);
+    FloatN lat = Math::Min(Math::Max(length(at), eps), (lab + lbc) * maxReach);
+    // current and wanted inner angles of the triangle at `a` and `b`
+    FloatN cosA0 = clampUnit(dot(ac, ab) / Math::Max(lac * lab, eps)),
+           cosB0 = clampUnit(-dot(ab, bc) / Math::Max(lab * lbc, eps));
+    FloatN cosA1 = clampUnit((lab * lab + lat * lat - lbc * lbc) /
+                             Math::Max(two * lab * lat, eps)),
+           cosB1 = clampUnit((lab * lab + lbc * lbc - lat * lat) /
+                             Math::Max(two * lab * lbc, eps));
+    FloatN sinA0 = sinFromCos(cosA0), sinB0 = sinFromCos(cosB0),
+           sinA1 = sinFromCos(cosA1), sinB1 = sinFromCos(cosB1);
+
+    // bend both joints by the differences of the angles, around the normal
+    // of the triangle
+    Vec3N normal = cross(ac, ab);
+    FloatN normalLength = length(normal);
+    FloatN straight =
+        normalLength < FloatN(1e-4f) * Math::Max(lac * lab, eps);
+    Vec3N axis = select(straight, rotate(middleRot, bendAxis),
+                        scale(normal, one / Math::Max(normalLength, eps)));
+    QuatN bendA = axisAngle(axis, cosA1 * cosA0 + sinA1 * sinA0,
+                            sinA1 * cosA0 - cosA1 * sinA0);
+    QuatN bendB = mul(axisAngle(axis, cosB1 * cosB0 + sinB1 * sinB0,
+                                sinB1 * cosB0 - cosB1 * sinB0),
+                      bendA);
+    Vec3N newAB = rotate(bendA, ab);
+    Vec3N newAC = add(newAB, rotate(bendB, bc));
+    // then swing the limb towards the target
+    Vec3N toTarget = normalize(at);
+    QuatN swing = fromTo(normalize(newAC), toTarget);
+    QuatN newUpperRot = mul(swing, mul(bendA, upperRot)),
+          newMiddleRot = mul(swing, mul(bendB, middleRot));
+    if (pole != nullptr) {
+      // turn around the target direction so that `b` faces the pole
+      QuatN turn =
+          turnAround(toTarget, rotate(swing, newAB),
+                     sub(loadVec3(pole->positions.data() + p, s), a));
+      newUpperRot = mul(turn, newUpperRot);
+      newMiddleRot = mul(turn, newMiddleRot);
+    }
+
+    // back to local rotations blended with the animated pose, the end
+    // keeps its global rotation
+    QuatN newUpperLocal =
+        blend(upperLocal, mul(conj(parentRot), newUpperRot), weight);
+    newUpperRot = mul(parentRot, newUpperLocal);
+    QuatN newMiddleLocal =
+        blend(middleLocal, mul(conj(newUpperRot), newMiddleRot), weight);
+    newMiddleRot = mul(newUpperRot, newMiddleLocal);
+    QuatN newEndLocal = mul(conj(newMiddleRot), endRot);
+    Vec3N newB = add(a, rotate(newUpperRot, middleOffset));
+    Vec3N newC = add(newB, rotate(newMiddleRot, endOffset));
+
+    storeQuat(select(active, newUpperLocal, upperLocal),
+              local + upper * 4 * s + p, s);
+    storeQuat(select(active, newMiddleLocal, middleLocal),
+              local + middle * 4 * s + p, s);
+    storeQuat(select(active, newEndLocal, endLocal), local + end * 4 * s + p,
+              s);
+    storeQuat(select(active, newUpperRot, upperRot),
+              globalRot + upper * 4 * s + p, s);
+    storeQuat(select(active, newMiddleRot, middleRot),
+              globalRot + middle * 4 * s + p, s);
+    storeVec3(select(active, newB, b), globalPos + middle * 3 * s + p, s);
+    storeVec3(select(active, newC, c), globalPos + end * 3 * s + p, s);
+  }
+}
+
+void SolveTwoBone(const std::vector<int> &jointParent,
+                  const std::vector<glm::vec3> &jointOffset, PoseBatch &batch,
+                  const TwoBoneChain &chain, const IKTarget &target,
+                  const IKTarget *pole, bool parallel) {
+  int numJoints = std::min<int>(jointParent.size(), jointOffset.size());
+  auto inSkeleton = [&](int joint) { return joint >= 0 && joint < numJoints; };
+  if (!inSkeleton(chain.upper) || !inSkeleton(chain.middle) ||
+      !inSkeleton(chain.end) || jointParent[chain.middle] != chain.upper ||
+      jointParent[chain.end] != chain.middle)
+    throw std::runtime_error("invalid two bone ik chain");
+  if (target.poseStride != batch.poseStride ||
+      (pole != nullptr && pole->poseStride != batch.poseStride))
+    throw std::runtime_error("ik target doesn't match the pose batch");
+  forEachPoseRange(batch, parallel, [&](int poseBegin, int poseEnd) {
+    solveTwoBoneRange(jointParent, jointOffset, batch, chain, target, pole,
+                      poseBegin, poseEnd);
+  });
+}
+
+// `IKChain` in chain indices, the index of a joint in `IKChain::joints`
+struct ChainLayout {
+  int numJoints = 0;
+  // chain index -> parent chain index, -1 for the chain root
+  std::vector<int> parent;
+  // chain index -> effector index, -1 for other joints
+  std::vector<int> effector;
+  // effector index -> chain index
+  std::vector<int> effectorJoint;
+  std::vector<Vec3N> offsets;
+  std::vector<FloatN> lengths;
+  // chain index -> index in `limits`, -1 if the joint is free
+  std::vector<int> limit;
+  std::vector<JointLimitN> limits;
+  // chain index -> children, effectors and joints below it
+  std::vector<std::vector<int>> children, effectorsBelow, descendants;
+};
+
+static ChainLayout layoutChain(const std::vector<int> &jointParent,
+                               const std::vector<glm::vec3> &jointOffset,
+                               const IKChain &chain,
+                               const std::vector<IKTarget> &targets,
+                               int poseStride) {
+  if (targets.size() != chain.effectors.size())
+    throw std::runtime_error("ik chain needs one target per effector");
+  for (auto &target : targets)
+    if (target.poseStride != poseStride)
+      throw std::runtime_error("ik target doesn't match the pose batch");
+  ChainLayout layout;
+  int n = layout.numJoints = chain.joints.size();
+  std::vector<int> chainIndex(std::min(jointParent.size(), jointOffset.size()),
+                              -1);
+  for (int i = 0; i < n; ++i) {
+    if (chain.joints[i] >= chainIndex.size())
+      throw std::runtime_error("ik chain doesn't match the skeleton");
+    chainIndex[chain.joints[i]] = i;
+  }
+  layout.parent.assign(n, -1);
+  layout.effector.assign(n, -1);
+  layout.limit.assign(n, -1);
+  layout.children.resize(n);
+  layout.effectorsBelow.resize(n);
+  layout.descendants.resize(n);
+  for (int i = 0; i < n; ++i) {
+    int joint = chain.joints[i];
+    layout.offsets.push_back(broadcast(jointOffset[joint]));
+    layout.lengths.push_back(FloatN(glm::length(jointOffset[joint])));
+    if (i == 0)
+      continue;
+    int parent = jointParent[joint];
+    if (parent == -1 || chainIndex[parent] == -1)
+      throw std::runtime_error("ik chain joints must be connected");
+    layout.parent[i] = chainIndex[parent];
+    layout.children[layout.parent[i]].push_back(i);
+    for (int j = layout.parent[i]; j != -1; j = layout.parent[j])
+      layout.descendants[j].push_back(i);
+  }
+  for (int e = 0; e < chain.effectors.size(); ++e) {
+    int i = chainIndex[chain.effectors[e]];
+    if (i == -1)
+      throw std::runtime_error("ik effector is not in the chain");
+    layout.effector[i] = e;
+    layout.effectorJoint.push_back(i);
+    for (int j = layout.parent[i]; j != -1; j = layout.parent[j])
+      layout.effectorsBelow[j].push_back(e);
+  }
+  // nothing would pull a leaf without a target, `IKChain::Build` never
+  // creates one
+  for (int i = 0; i < n; ++i)
+    if (layout.children[i].empty() && layout.effector[i] == -1)
+      throw std::runtime_error("ik chain leaves must be effectors");
+  for (auto &limit : chain.limits) {
+    if (limit.joint < 0 || limit.joint >= chainIndex.size() ||
+        chainIndex[limit.joint] == -1)
+      continue;
+    layout.limit[chainIndex[limit.joint]] = layout.limits.size();
+    layout.limits.push_back(broadcast(limit));
+  }
+  return layout;
+}
+
+enum class ChainSolver { FABRIK, CCD };
+
+// Working set of one simd block of poses.
+struct ChainState {
+  std::vector<Vec3N> positions, desired, targets;
+  std::vector<QuatN> globals, locals, animated;
+  // global rotation of the parent of the chain root
+  QuatN rootParent;
+};
+
+static QuatN parentGlobal(const ChainLayout &layout, const ChainState &state,
+                          int i) {
+  return i == 0 ? state.rootParent : state.globals[layout.parent[i]];
+}
+
+// Rotate joint `i` by `delta` in the global space and apply its limit.
+static void rotateJoint(const ChainLayout &layout, ChainState &state, int i,
+                        const QuatN &delta) {
+  QuatN parentRot = parentGlobal(layout, state, i);
+  // renormalized, the rounding errors would grow with every iteration
+  QuatN local =
+      normalize(mul(conj(parentRot), mul(delta, state.globals[i])));
+  if (layout.limit[i] != -1)
+    local = applyLimit(local, layout.limits[layout.limit[i]]);
+  state.locals[i] = local;
+  state.globals[i] = mul(parentRot, local);
+}
+
+static void iterateFABRIK(const ChainLayout &layout, ChainState &state) {
+  const int n = layout.numJoints;
+  auto &desired = state.desired;
+  desired = state.positions;
+  // forward, each joint is pulled by the joints below, a joint shared by
+  // several effectors takes the average
+  for (int i = n - 1; i > 0; --i) {
+    if (layout.effector[i] != -1) {
+      desired[i] = state.targets[layout.effector[i]];
+      continue;
+    }
+    Vec3N sum = broadcast(glm::vec3(0.0f));
+    for (int c : layout.children[i])
+      sum = add(sum, add(desired[c],
+                         scale(normalize(sub(desired[i], desired[c])),
+                               layout.lengths[c])));
+    desired[i] = scale(sum, FloatN(1.0f / layout.children[i].size()));
+  }
+  // backward from the root, which stays in place
+  desired[0] = state.positions[0];
+  for (int i = 1; i < n; ++i) {
+    int parent = layout.parent[i];
+    desired[i] = add(desired[parent],
+                     scale(normalize(sub(desired[i], desired[parent])),
+                           layout.lengths[i]));
+  }
+  // rotate the joints towards the new positions of their children, root
+  // first so that the limits are taken into account below
+  for (int i = 0; i < n; ++i) {
+    QuatN parentRot = parentGlobal(layout, state, i);
+    if (i > 0)
+      state.positions[i] =
+          add(state.positions[layout.parent[i]],
+              rotate(parentRot, layout.offsets[i]));
+    state.globals[i] = mul(parentRot, state.locals[i]);
+    if (layout.children[i].empty())
+      continue;
+    QuatN sum = {FloatN(0.0f), FloatN(0.0f), FloatN(0.0f), FloatN(0.0f)};
+    for (int c : layout.children[i]) {
+      QuatN q = fromTo(
+          normalize(rotate(state.globals[i], layout.offsets[c])),
+          normalize(sub(desired[c], state.positions[i])));
+      sum = {sum.x + q.x, sum.y + q.y, sum.z + q.z, sum.w + q.w};
+    }
+    QuatN delta = normalize(sum);
+    if (layout.children[i].size() == 1) {
+      // the bone only fixes the direction to the child, the twist around it
+      // is chosen so that the grandchild lies in the plane it's wanted in,
+      // otherwise a hinge below can't bend towards the target
+      int c = layout.children[i][0];
+      if (layout.children[c].size() == 1) {
+        int g = layout.children[c][0];
+        QuatN rotated = mul(delta, state.globals[i]);
+        Vec3N bone = rotate(rotated, layout.offsets[c]);
+        Vec3N child = add(state.positions[i], bone);
+        Vec3N grandchild = rotate(mul(rotated, state.locals[c]),
+                                  layout.offsets[g]);
+        delta = mul(turnAround(normalize(bone), grandchild,
+                               sub(desired[g], child)),
+                    delta);
+      }
+    }
+    rotateJoint(layout, state, i, delta);
+  }
+}
+
+static void iterateCCD(const ChainLayout &layout, ChainState &state) {
+  for (int i = layout.numJoints - 1; i >= 0; --i) {
+    if (layout.effectorsBelow[i].empty())
+      continue;
+    QuatN sum = {FloatN(0.0f), FloatN(0.0f), FloatN(0.0f), FloatN(0.0f)};
+    for (int e : layout.effectorsBelow[i]) {
+      QuatN q = fromTo(
+          normalize(sub(state.positions[layout.effectorJoint[e]],
+                        state.positions[i])),
+          normalize(sub(state.targets[e], state.positions[i])));
+      sum = {sum.x + q.x, sum.y + q.y, sum.z + q.z, sum.w + q.w};
+    }
+    rotateJoint(layout, state, i, normalize(sum));
+    // carry the joints below
+    for (int d : layout.descendants[i]) {
+      int parent = layout.parent[d];
+      state.globals[d] = mul(state.globals[parent], state.locals[d]);
+      state.positions[d] =
+          add(state.positions[parent],
+              rotate(state.globals[parent], layout.offsets[d]));
+    }
+  }
+}
+
+static void solveChainRange(const std::vector<int> &jointParent,
+                            PoseBatch &batch, const IKChain &chain,
+                            const ChainLayout &layout,
+                            const std::vector<IKTarget> &targets,
+                            ChainSolver solver, int poseBegin, int poseEnd) {
+  const int s = batch.poseStride, n = layout.numJoints;
+  const FloatN zero(0.0f),
+      tolerance(chain.Tolerance * chain.Tolerance);
+  float *local = batch.localRotations.data();
+  float *globalRot = batch.globalRotations.data();
+  float *globalPos = batch.globalPositions.data();
+  ChainState state;
+  state.positions.resize(n);
+  state.globals.resize(n);
+  state.locals.resize(n);
+  state.targets.resize(targets.size());
+  for (int p = poseBegin; p < poseEnd; p += FloatN::Width) {
+    FloatN active = zero;
+    for (auto &target : targets)
+      active = Math::Max(active, FloatN::Load(target.weights.data() + p));
+    active = active > zero;
+    if (Math::MoveMask(active) == 0)
+      continue;
+    for (int i = 0; i < n; ++i) {
+      int joint = chain.joints[i];
+      state.positions[i] = loadVec3(globalPos + joint * 3 * s + p, s);
+      state.globals[i] = loadQuat(globalRot + joint * 4 * s + p, s);
+      state.locals[i] = loadQuat(local + joint * 4 * s + p, s);
+    }
+    state.animated = state.locals;
+    state.rootParent = parentRotation(jointParent, batch, chain.joints[0], p);
+    // partial weights move the targets towards the animated effectors
+    for (int e = 0; e < targets.size(); ++e) {
+      Vec3N animated = state.positions[layout.effectorJoint[e]];
+      state.targets[e] = add(
+          animated,
+          scale(sub(loadVec3(targets[e].positions.data() + p, s), animated),
+                FloatN::Load(targets[e].weights.data() + p)));
+    }
+    for (int iteration = 0; iteration < chain.Iterations; ++iteration) {
+      FloatN error = zero;
+      for (int e = 0; e < targets.size(); ++e) {
+        Vec3N d = sub(state.positions[layout.effectorJoint[e]],
+                      state.targets[e]);
+        error = Math::Max(error, dot(d, d));
+      }
+      if (Math::MoveMask(error > tolerance) == 0)
+        break;
+      if (solver == ChainSolver::FABRIK)
+        iterateFABRIK(layout, state);
+      else
+        iterateCCD(layout, state);
+    }
+    for (int i = 0; i < n; ++i) {
+      int joint = chain.joints[i];
+      storeQuat(select(active, state.locals[i], state.animated[i]),
+                local + joint * 4 * s + p, s);
+      QuatN global = loadQuat(globalRot + joint * 4 * s + p, s);
+      storeQuat(select(active, state.globals[i], global),
+                globalRot + joint * 4 * s + p, s);
+      Vec3N position = loadVec3(globalPos + joint * 3 * s + p, s);
+      storeVec3(select(active, state.positions[i], position),
+                globalPos + joint * 3 * s + p, s);
+    }
+  }
+}
+
+static void solveChain(const std::vector<int> &jointParent,
+                       const std::vector<glm::vec3> &jointOffset,
+                       PoseBatch &batch, const IKChain &chain,
+                       const std::vector<IKTarget> &targets,
+                       ChainSolver solver, bool parallel) {
+  if (chain.joints.empty())
+    return;
+  ChainLayout layout =
+      layoutChain(jointParent, jointOffset, chain, targets, batch.poseStride);
+  forEachPoseRange(batch, parallel, [&](int poseBegin, int poseEnd) {
+    solveChainRange(jointParent, batch, chain, layout, targets, solver,
+                    poseBegin, poseEnd);
+  });
+}
+
+void SolveFABRIK(const std::vector<int> &jointParent,
+                 const std::vector<glm::vec3> &jointOffset, PoseBatch &batch,
+                 const IKChain &chain, const std::vector<IKTarget> &targets,
+                 bool parallel) {
+  solveChain(jointParent, jointOffset, batch, chain, targets,
+             ChainSolver::FABRIK, parallel);
+}
+
+void SolveCCD(const std::vector<int> &jointParent,
+              const std::vector<glm::vec3> &jointOffset, PoseBatch &batch,
+              const IKChain &chain, const std::vector<IKTarget> &targets,
+              bool parallel) {
+  solveChain(jointParent, jointOffset, batch, chain, targets,
+             ChainSolver::CCD, parallel);
+}
+
+void FootPlanting::Solve(const std::vector<int> &jointParent,
+                         const std::vector<glm::vec3> &jointOffset,
+                         PoseBatch &batch,
+                         const std::vector<glm::mat4> &toWorld,
+                         bool parallel) {
+  if (toWorld.size() < batch.numPoses)
+    throw std::runtime_error("foot planting needs a transform per pose");
+  ForwardKinematics(jointParent, jointOffset, batch, parallel);
+  if (Legs.empty() || !GroundHeight || Weight <= 0.0f)
+    return;
+  targets.resize(Legs.size());
+  for (auto &target : targets)
+    target.Resize(batch.numPoses);
+  const int s = batch.poseStride;
+  // the ground queries are scalar, each task plants its own poses
+  auto plantRange = [&](int begin, int end) {
+    end = std::min(end, batch.numPoses);
+    for (int p = begin; p < end; ++p) {
+      const glm::mat4 &m = toWorld[p];
+      glm::mat3 fromWorld = glm::inverse(glm::mat3(m));
+      float lowest = 0.0f;
+      for (int leg = 0; leg < Legs.size(); ++leg) {
+        glm::vec3 foot = batch.GetGlobalPosition(p, Legs[leg].end);
+        glm::vec3 world = m * glm::vec4(foot, 1.0f);
+        // height of the ground over the flat ground of the animation
+        float flat = (m * glm::vec4(foot.x, 0.0f, foot.z, 1.0f)).y;
+        float height = GroundHeight(world.x, world.z) - flat;
+        targets[leg].Set(p, foot + fromWorld * glm::vec3(0.0f, height, 0.0f),
+                         Weight);
+        lowest = std::min(lowest, height);
+      }
+      if (AdjustRoot && lowest < 0.0f) {
+        glm::vec3 shift = fromWorld * glm::vec3(0.0f, Weight * lowest, 0.0f);
+        batch.rootPositions[p] += shift.x;
+        batch.rootPositions[s + p] += shift.y;
+        batch.rootPositions[2 * s + p] += shift.z;
+      }
+    }
+  };
+  if (!parallel || batch.poseStride <= ikGrain)
+    plantRange(0, batch.poseStride);
+  else
+    ThreadPool::Ref().ParallelFor(0, batch.poseStride, ikGrain, plantRange);
+  if (AdjustRoot)
+    ForwardKinematics(jointParent, jointOffset, batch, parallel);
+  for (int leg = 0; leg < Legs.size(); ++leg)
+    SolveTwoBone(jointParent, jointOffset, batch, Legs[leg], targets[leg],
+                 nullptr, parallel);
+}
+
+}; // namespace Animation
+
+}; // namespace aEngine
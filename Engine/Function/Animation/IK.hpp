@@ -0,0 +1,131 @@
+/**
+ * Inverse kinematics on a `PoseBatch`, the poses of many characters sharing
+ * a skeleton are solved together before they are applied to the joint
+ * entities.
+ *
+ * Every solver works on `FloatN::Width` poses at once with the quaternion
+ * math written against `Math::FloatN`, and splits the batch across the
+ * thread pool. No trigonometric function is evaluated, the angles are
+ * carried around as cosines and sines.
+ *
+ * The solvers read the global rotations and positions computed by
+ * `ForwardKinematics`, they write the local rotations of the solved joints
+ * along with the global rotations and positions of these joints only. Run
+ * `ForwardKinematics` again before solving joints below them.
+ */
+#pragma once
+
+#include "Function/Animation/Kinematics.hpp"
+
+#include <functional>
+
+namespace aEngine {
+
+namespace Animation {
+
+// Target position of an effector for every pose of a batch.
+struct IKTarget {
+  int poseStride = 0;
+  // `[component * poseStride + pose]`
+  std::vector<float> positions;
+  // 0 keeps the animated pose, the padding poses are always 0
+  std::vector<float> weights;
+
+  // All the weights are reset to 0.
+  void Resize(int poseNum);
+  void Set(int poseInd, glm::vec3 position, float weight = 1.0f);
+};
+
+// Swing twist limit of the local rotation of `joint`, measured from `Rest`.
+struct IKJointLimit {
+  int joint = -1;
+  glm::quat Rest = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  // unit axis in the rest space of the joint, the direction to the child
+  // joint for a ball joint, the hinge axis for a hinge
+  glm::vec3 TwistAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+  // half angle of the swing cone in radians, 0 for a hinge
+  float MaxSwing = glm::pi<float>();
+  // twist range in radians, within [-pi, pi]
+  float MinTwist = -glm::pi<float>(), MaxTwist = glm::pi<float>();
+};
+
+// A limb solved analytically, `middle` is the child of `upper` and `end` is
+// the child of `middle`, e.g. the thigh, the knee and the ankle.
+struct TwoBoneChain {
+  int upper = -1, middle = -1, end = -1;
+  // Axis in the space of `middle` the limb bends around when it's fully
+  // stretched, it points along `cross(end - upper, middle - upper)` when
+  // the limb bends the natural way.
+  glm::vec3 BendAxis = glm::vec3(1.0f, 0.0f, 0.0f);
+};
+
+// Joints solved together by `SolveFABRIK` or `SolveCCD`, e.g. a leg, or the
+// spine pulled by both hands.
+struct IKChain {
+  // the joints between `root` and the effectors sorted by index, the root
+  // stays in place
+  std::vector<int> joints;
+  // each effector has a target in the solvers
+  std::vector<int> effectors;
+  std::vector<IKJointLimit> limits;
+  int Iterations = 10;
+  // stop early when every effector of every pose is this close
+  float Tolerance = 1e-3f;
+
+  // Collect the joints from `root` down to each of the `effectors`, the
+  // parent of a joint must have a smaller index than the joint.
+  void Build(const std::vector<int> &jointParent, int root,
+             std::vector<int> effectorJoints);
+};
+
+// Rotate `chain.upper` and `chain.middle` so that `chain.end` reaches the
+// target, the global rotation of `chain.end` is kept. `pole` turns the limb
+// so that `chain.middle` points towards it, its weights are ignored.
+void SolveTwoBone(const std::vector<int> &jointParent,
+                  const std::vector<glm::vec3> &jointOffset, PoseBatch &batch,
+                  const TwoBoneChain &chain, const IKTarget &target,
+                  const IKTarget *pole = nullptr, bool parallel = true);
+
+// Forward and backward reaching, a joint shared by several effectors is
+// placed at the average of the positions they ask for. `targets` has one
+// target per effector of `chain`, the limits are applied after each
+// iteration.
+void SolveFABRIK(const std::vector<int> &jointParent,
+                 const std::vector<glm::vec3> &jointOffset, PoseBatch &batch,
+                 const IKChain &chain, const std::vector<IKTarget> &targets,
+                 bool parallel = true);
+
+// Cyclic coordinate descent, each joint from the effectors to the root
+// takes the average of the rotations bringing the effectors below it
+// towards their targets, then its limit.
+void SolveCCD(const std::vector<int> &jointParent,
+              const std::vector<glm::vec3> &jointOffset, PoseBatch &batch,
+              const IKChain &chain, const std::vector<IKTarget> &targets,
+              bool parallel = true);
+
+// Keeps the feet of a crowd on uneven ground, the animations are expected
+// to be authored on flat ground at height 0.
+struct FootPlanting {
+  std::vector<TwoBoneChain> Legs;
+  // height of the ground at (x, z) in the world, called from the worker
+  // threads
+  std::function<float(float x, float z)> GroundHeight;
+  float Weight = 1.0f;
+  // lower the root so that the foot on the lowest ground can reach it
+  bool AdjustRoot = true;
+
+  // Run forward kinematics and move the feet of every pose by the height of
+  // the ground under them, `toWorld[pose]` is the rigid transform from the
+  // space of the pose to the world.
+  void Solve(const std::vector<int> &jointParent,
+             const std::vector<glm::vec3> &jointOffset, PoseBatch &batch,
+             const std::vector<glm::mat4> &toWorld, bool parallel = true);
+
+private:
+  // one per leg, reused across frames
+  std::vector<IKTarget> targets;
+};
+
+}; // namespace Animation
+
+}; // namespace aEngine
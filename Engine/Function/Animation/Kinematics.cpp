@@ -0,0 +1,216 @@
+#include "Function/Animation/Kinematics.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/Math/SIMD.hpp"
+
+#include <algorithm>
+
+namespace aEngine {
+
+namespace Animation {
+
+using Math::FloatN;
+
+void PoseBatch::Resize(int jointNum, int poseNum) {
+  numJoints = jointNum;
+  numPoses = poseNum;
+  poseStride = Math::PadToSIMD(poseNum);
+  localRotations.assign(4 * numJoints * poseStride, 0.0f);
+  for (int jointInd = 0; jointInd < numJoints; ++jointInd)
+    std::fill_n(localRotations.begin() + (jointInd * 4 + 3) * poseStride,
+                poseStride, 1.0f);
+  rootPositions.assign(3 * poseStride, 0.0f);
+  globalRotations.resize(4 * numJoints * poseStride);
+  globalPositions.resize(3 * numJoints * poseStride);
+}
+
+void PoseBatch::SetPose(int poseInd, const Pose &pose) {
+  int jointNum = std::min<int>(numJoints, pose.jointRotations.size());
+  for (int jointInd = 0; jointInd < jointNum; ++jointInd) {
+    auto &q = pose.jointRotations[jointInd];
+    float *rot = localRotations.data() + jointInd * 4 * poseStride + poseInd;
+    rot[0] = q.x;
+    rot[poseStride] = q.y;
+    rot[2 * poseStride] = q.z;
+    rot[3 * poseStride] = q.w;
+  }
+  rootPositions[poseInd] = pose.rootLocalPosition.x;
+  rootPositions[poseStride + poseInd] = pose.rootLocalPosition.y;
+  rootPositions[2 * poseStride + poseInd] = pose.rootLocalPosition.z;
+}
+
+void PoseBatch::SetPose(int poseInd, const PoseBuffer &pose) {
+  int jointNum = std::min(numJoints, pose.numJoints);
+  for (int jointInd = 0; jointInd < jointNum; ++jointInd) {
+    auto q = pose.GetRotation(jointInd);
+    float *rot = localRotations.data() + jointInd * 4 * poseStride + poseInd;
+    rot[0] = q.x;
+    rot[poseStride] = q.y;
+    rot[2 * poseStride] = q.z;
+    rot[3 * poseStride] = q.w;
+  }
+  rootPositions[poseInd] = pose.rootLocalPosition.x;
+  rootPositions[poseStride + poseInd] = pose.rootLocalPosition.y;
+  rootPositions[2 * poseStride + poseInd] = pose.rootLocalPosition.z;
+}
+
+void PoseBatch::GetPose(int poseInd, PoseBuffer &pose) const {
+  int jointNum = std::min(numJoints, pose.numJoints);
+  for (int jointInd = 0; jointInd < jointNum; ++jointInd) {
+    const float *rot =
+        localRotations.data() + jointInd * 4 * poseStride + poseInd;
+    pose.SetRotation(jointInd, glm::quat(rot[3 * poseStride], rot[0],
+                                         rot[poseStride],
+                                         rot[2 * poseStride]));
+  }
+  pose.rootLocalPosition =
+      glm::vec3(rootPositions[poseInd], rootPositions[poseStride + poseInd],
+                rootPositions[2 * poseStride + poseInd]);
+}
+
+glm::quat PoseBatch::GetGlobalRotation(int poseInd, int jointInd) const {
+  const float *rot =
+      globalRotations.data() + jointInd * 4 * poseStride + poseInd;
+  return glm::quat(rot[3 * poseStride], rot[0], rot[poseStride],
+                   rot[2 * poseStride]);
+}
+
+glm::vec3 PoseBatch::GetGlobalPosition(int poseInd, int jointInd) const {
+  const float *pos =
+      globalPositions.data() + jointInd * 3 * poseStride + poseInd;
+  return glm::vec3(pos[0], pos[poseStride], pos[2 * poseStride]);
+}
+
+// FK for the poses [poseBegin, poseEnd) of a batch, both ends are multiples
+// of the simd width
+static void forwardKinematicsRange(const std::vector<int> &jointParent,
+                                   const std::vector<glm::vec3> &jointOffset,
+                                   PoseBatch &batch, int poseBegin,
+                                   int poseEnd) {
+  const int s = batch.poseStride;
+  const float *local = batch.localRotations.data();
+  float *globalRot = batch.globalRotations.data();
+  float *globalPos = batch.globalPositions.data();
+  const float *root = batch.rootPositions.data();
+  // joints are the outer loop so that memory is accessed sequentially,
+  // the parent of a joint is always finished before the joint itself
+  for (int joint = 0; joint < batch.numJoints; ++joint) {
+    int parent = jointParent[joint];
+    // the scalar version uses the (identity initialized) orientation of
+    // the first joint as the parent orientation of root joints
+    int oriSource = parent == -1 ? (joint == 0 ? -1 : 0) : parent;
+    FloatN vx(jointOffset[joint].x), vy(jointOffset[joint].y),
+        vz(jointOffset[joint].z), two(2.0f);
+    for (int p = poseBegin; p < poseEnd; p += FloatN::Width) {
+      const float *q = local + joint * 4 * s + p;
+      FloatN qx = FloatN::Load(q), qy = FloatN::Load(q + s),
+             qz = FloatN::Load(q + 2 * s), qw = FloatN::Load(q + 3 * s);
+      FloatN px(0.0f), py(0.0f), pz(0.0f), pw(1.0f);
+      if (oriSource != -1) {
+        const float *pr = globalRot + oriSource * 4 * s + p;
+        px = FloatN::Load(pr), py = FloatN::Load(pr + s),
+        pz = FloatN::Load(pr + 2 * s), pw = FloatN::Load(pr + 3 * s);
+      }
+      // orientation = parentOrientation * rotation, same order as glm
+      float *gr = globalRot + joint * 4 * s + p;
+      (pw * qw - px * qx - py * qy - pz * qz).Store(gr + 3 * s);
+      (pw * qx + px * qw + py * qz - pz * qy).Store(gr);
+      (pw * qy + py * qw + pz * qx - px * qz).Store(gr + s);
+      (pw * qz + pz * qw + px * qy - py * qx).Store(gr + 2 * s);
+      float *gp = globalPos + joint * 3 * s + p;
+      if (parent == -1) {
+        FloatN::Load(root + p).Store(gp);
+        FloatN::Load(root + s + p).Store(gp + s);
+        FloatN::Load(root + 2 * s + p).Store(gp + 2 * s);
+        continue;
+      }
+      // position = parentPosition + parentOrientation * offset,
+      // rotating a vector follows glm's `qua * vec3`
+      const float *pp = globalPos + parent * 3 * s + p;
+      FloatN uvx = py * vz - vy * pz, uvy = pz * vx - vz * px,
+             uvz = px * vy - vx * py;
+      FloatN uuvx = py * uvz - uvy * pz, uuvy = pz * uvx - uvz * px,
+             uuvz = px * uvy - uvx * py;
+      FloatN rx = vx + ((uvx * pw) + uuvx) * two,
+             ry = vy + ((uvy * pw) + uuvy) * two,
+             rz = vz + ((uvz * pw) + uuvz) * two;
+      (FloatN::Load(pp) + rx).Store(gp);
+      (FloatN::Load(pp + s) + ry).Store(gp + s);
+      (FloatN::Load(pp + 2 * s) + rz).Store(gp + 2 * s);
+    }
+  }
+}
+
+void ForwardKinematics(const std::vector<int> &jointParent,
+                       const std::vector<glm::vec3> &jointOffset,
+                       PoseBatch &batch, bool parallel) {
+  if (jointParent.size() < batch.numJoints ||
+      jointOffset.size() < batch.numJoints)
+    throw std::runtime_error(
+        "inconsistent joint number between skeleton and pose batch");
+  // each thread works on its own range of poses, all joints included
+  const int grain = 64;
+  if (!parallel || batch.poseStride <= grain) {
+    forwardKinematicsRange(jointParent, jointOffset, batch, 0,
+                           batch.poseStride);
+    return;
+  }
+  ThreadPool::Ref().ParallelFor(
+      0, batch.poseStride, grain, [&](int poseBegin, int poseEnd) {
+        forwardKinematicsRange(jointParent, jointOffset, batch, poseBegin,
+                               poseEnd);
+      });
+}
+
+void ForwardKinematics(Skeleton &skeleton, const std::vector<Pose> &poses,
+                       std::vector<glm::vec3> &positions,
+                       std::vector<glm::quat> &orientations) {
+  const int jointNum = skeleton.GetNumJoints();
+  const int poseNum = poses.size();
+  positions.resize((size_t)poseNum * jointNum);
+  orientations.resize((size_t)poseNum * jointNum);
+  for (auto &pose : poses)
+    if (pose.jointRotations.size() != jointNum)
+      throw std::runtime_error(
+          "inconsistent joint number between skeleton and pose data");
+  // each chunk fills its own small batch, so the working set stays in cache
+  const int chunkSize = 256;
+  ThreadPool::Ref().ParallelFor(0, poseNum, chunkSize, [&](int begin,
+                                                           int end) {
+    PoseBatch batch;
+    batch.Resize(jointNum, end - begin);
+    const int s = batch.poseStride;
+    for (int poseInd = begin; poseInd < end; ++poseInd) {
+      auto &root = poses[poseInd].rootLocalPosition;
+      batch.rootPositions[poseInd - begin] = root.x;
+      batch.rootPositions[s + poseInd - begin] = root.y;
+      batch.rootPositions[2 * s + poseInd - begin] = root.z;
+    }
+    // transpose joint by joint, so the batch is written sequentially
+    for (int jointInd = 0; jointInd < jointNum; ++jointInd) {
+      float *rot = batch.localRotations.data() + jointInd * 4 * s - begin;
+      for (int poseInd = begin; poseInd < end; ++poseInd) {
+        auto &q = poses[poseInd].jointRotations[jointInd];
+        rot[poseInd] = q.x;
+        rot[s + poseInd] = q.y;
+        rot[2 * s + poseInd] = q.z;
+        rot[3 * s + poseInd] = q.w;
+      }
+    }
+    ForwardKinematics(skeleton.jointParent, skeleton.jointOffset, batch,
+                      false);
+    for (int jointInd = 0; jointInd < jointNum; ++jointInd) {
+      const float *rot = batch.globalRotations.data() + jointInd * 4 * s;
+      const float *pos = batch.globalPositions.data() + jointInd * 3 * s;
+      for (int p = 0; p < end - begin; ++p) {
+        size_t outInd = (size_t)(begin + p) * jointNum + jointInd;
+        positions[outInd] = glm::vec3(pos[p], pos[s + p], pos[2 * s + p]);
+        orientations[outInd] =
+            glm::quat(rot[3 * s + p], rot[p], rot[s + p], rot[2 * s + p]);
+      }
+    }
+  });
+}
+
+}; // namespace Animation
+
+}; // namespace aEngine
@@ -0,0 +1,60 @@
+/**
+ * Batched forward kinematics for many poses of the same skeleton.
+ *
+ * The poses are stored as structure of arrays with the pose index changing
+ * fastest, so the same joint of `FloatN::Width` poses goes through the
+ * quaternion math together, the batch is also split across the thread pool.
+ *
+ * The kernel follows the exact operation order of glm, the results are
+ * bitwise identical to `Pose::GetGlobalPositionOrientation`.
+ */
+#pragma once
+
+#include "Function/Animation/Motion.hpp"
+
+namespace aEngine {
+
+namespace Animation {
+
+struct PoseBatch {
+  int numJoints = 0, numPoses = 0;
+  // number of poses padded for simd access
+  int poseStride = 0;
+  // local rotations, `[(joint * 4 + component) * poseStride + pose]`,
+  // components are ordered as x, y, z, w
+  std::vector<float> localRotations;
+  // local root positions, `[component * poseStride + pose]`
+  std::vector<float> rootPositions;
+  // global rotations, same layout as `localRotations`
+  std::vector<float> globalRotations;
+  // global positions, `[(joint * 3 + component) * poseStride + pose]`
+  std::vector<float> globalPositions;
+
+  // Padding poses are set to identity rotations.
+  void Resize(int jointNum, int poseNum);
+
+  void SetPose(int poseInd, const Pose &pose);
+  void SetPose(int poseInd, const PoseBuffer &pose);
+  // Write the local rotations and the root position back to `pose`.
+  void GetPose(int poseInd, PoseBuffer &pose) const;
+
+  glm::quat GetGlobalRotation(int poseInd, int jointInd) const;
+  glm::vec3 GetGlobalPosition(int poseInd, int jointInd) const;
+};
+
+// Compute the global rotations and positions of all poses in the batch,
+// `self.ori = parent.ori * self.rot`,
+// `self.pos = parent.pos + parent.ori * self.offset`.
+void ForwardKinematics(const std::vector<int> &jointParent,
+                       const std::vector<glm::vec3> &jointOffset,
+                       PoseBatch &batch, bool parallel = true);
+
+// Forward kinematics for a sequence of poses, the results are stored as
+// `[poseInd * numJoints + jointInd]`.
+void ForwardKinematics(Skeleton &skeleton, const std::vector<Pose> &poses,
+                       std::vector<glm::vec3> &positions,
+                       std::vector<glm::quat> &orientations);
+
+}; // namespace Animation
+
+}; // namespace aEngine
@@ -1,4 +1,5 @@
 #include "Function/Animation/Metrics.hpp"
+#include "Function/Animation/Kinematics.hpp"
 
 namespace aEngine {
 
@@ -36,13 +37,21 @@ float SlideMetrics(vector<vec3> &prev, vector<vec3> &current,
 
 float SlideMetrics(Motion &motion, float heightThreshold) {
   float metricValue = 0.0f;
-  auto prevPositions = motion.poses[0].GetGlobalPositions();
-  auto currentPositions = prevPositions;
+  vector<vec3> allPositions;
+  vector<glm::quat> allOrientations;
+  motion.EnsurePoses();
+  ForwardKinematics(motion.skeleton, motion.poses, allPositions,
+                    allOrientations);
+  const int jointNum = motion.skeleton.GetNumJoints();
+  vector<vec3> prevPositions(allPositions.begin(),
+                             allPositions.begin() + jointNum);
+  vector<vec3> currentPositions;
   for (int i = 1; i < motion.poses.size(); ++i) {
-    currentPositions = motion.poses[i].GetGlobalPositions();
+    currentPositions.assign(allPositions.begin() + i * jointNum,
+                            allPositions.begin() + (i + 1) * jointNum);
     metricValue +=
         SlideMetrics(prevPositions, currentPositions, heightThreshold);
-    prevPositions = currentPositions;
+    std::swap(prevPositions, currentPositions);
   }
   return metricValue / (motion.poses.size());
 }
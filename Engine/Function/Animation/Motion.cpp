@@ -1,19 +1,25 @@
 #include "Function/Animation/Motion.hpp"
+#include "Function/Animation/Kinematics.hpp"
+#include "Function/General/MappedFile.hpp"
+#include "Function/General/ThreadPool.hpp"
 #include "Function/Math/Math.hpp"
+#include "Function/Math/SIMD.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <set>
 #include <stack>
+#include <string_view>
 
 using glm::cross;
 using glm::dot;
 using glm::quat;
 using glm::vec3;
-using std::getline;
 using std::stack;
 using std::string;
 using std::vector;
@@ -38,24 +44,68 @@ inline bool EndsWith(string target, string pattern) {
   return true;
 }
 
-// split a string by white space
-vector<string> SplitByWhiteSpace(string str) {
-  int last = 0, cur = 0;
-  vector<string> result;
-  while (cur < str.size() && IsWhiteSpace(str[cur]))
+// Cursor over the text of a bvh file, tokens are separated by white spaces.
+struct BVHTokenizer {
+  const char *cur, *end;
+
+  std::string_view Next() {
+    while (cur < end && IsWhiteSpace(*cur))
+      cur++;
+    const char *begin = cur;
+    while (cur < end && !IsWhiteSpace(*cur))
+      cur++;
+    return std::string_view(begin, cur - begin);
+  }
+  std::string_view Peek() {
+    const char *saved = cur;
+    auto token = Next();
+    cur = saved;
+    return token;
+  }
+  void Expect(std::string_view label, const char *message) {
+    if (Next() != label)
+      throw std::runtime_error(message);
+  }
+  float NextFloat() {
+    auto token = Next();
+    float value;
+    auto result =
+        std::from_chars(token.data(), token.data() + token.size(), value);
+    if (result.ec != std::errc() || token.empty())
+      throw std::runtime_error("invalid number " + string(token) +
+                               " in bvh file");
+    return value;
+  }
+  int NextInt() {
+    auto token = Next();
+    int value;
+    auto result =
+        std::from_chars(token.data(), token.data() + token.size(), value);
+    if (result.ec != std::errc() || token.empty())
+      throw std::runtime_error("invalid number " + string(token) +
+                               " in bvh file");
+    return value;
+  }
+  // Move to the start of the next line.
+  void SkipLine() {
+    while (cur < end && *cur != '\n')
+      cur++;
+    if (cur < end)
+      cur++;
+  }
+};
+
+// Parse the float value starting at `cur`, skipping the white spaces in front
+// of it, returns the end of the value or nullptr if there's no valid value.
+inline const char *ParseBVHFloat(const char *cur, const char *end,
+                                 float &value) {
+  while (cur < end && IsWhiteSpace(*cur))
     cur++;
-  last = cur;
-  while (cur <= str.size()) {
-    if (cur == str.size() || IsWhiteSpace(str[cur])) {
-      if (cur > last)
-        result.push_back(str.substr(last, cur - last));
-      while (cur < str.size() && IsWhiteSpace(str[cur]))
-        cur++;
-      last = cur;
-    }
+  // std::from_chars doesn't accept a leading plus sign
+  if (cur < end && *cur == '+')
     cur++;
-  }
-  return result;
+  auto result = std::from_chars(cur, end, value);
+  return result.ec == std::errc() ? result.ptr : nullptr;
 }
 
 #define EULER_XYZ 12
@@ -86,172 +136,178 @@ quat QuatFromEulers(vec3 angles, int order) {
 }
 
 bool Motion::LoadFromBVH(string filename, float scale) {
-  std::ifstream fileInput(filename);
-  if (!fileInput.is_open()) {
+  MappedFile file;
+  if (!file.Open(filename)) {
     printf("failed to open file %s\n", filename.c_str());
-    fileInput.close();
     return false;
-  } else {
-    skeleton.skeletonName = std::filesystem::path(filename).stem().string();
-    vector<int> jointChannels;
-    vector<int> jointChannelsOrder;
-    string line;
-    getline(fileInput, line);
-    if (line == "HIERARCHY") {
-      getline(fileInput, line);
-      auto lineSeg = SplitByWhiteSpace(line);
-      if (lineSeg[0] == "ROOT") {
-        int currentJoint = 0, parentJoint = -1;
-        stack<int> s;
-        s.push(currentJoint);
-        skeleton.jointNames.push_back(lineSeg[1]);   // the name
-        skeleton.jointParent.push_back(parentJoint); // the parent
-        while (!s.empty()) {
-          getline(fileInput, line);
-          lineSeg = SplitByWhiteSpace(line);
-          if (lineSeg.size() == 0)
-            continue; // skip blank lines
-          if (lineSeg[0] == "{") {
-            currentJoint++;
-          } else if (lineSeg[0] == "}") {
-            s.pop();
-          } else if (lineSeg[0] == "OFFSET") {
-            float xOffset = std::stof(lineSeg[1]) * scale;
-            float yOffset = std::stof(lineSeg[2]) * scale;
-            float zOffset = std::stof(lineSeg[3]) * scale;
-            skeleton.jointOffset.push_back(vec3(xOffset, yOffset, zOffset));
-            // ready to recieve children
-            skeleton.jointChildren.push_back(vector<int>());
-            getline(fileInput, line);
-            lineSeg = SplitByWhiteSpace(line);
-            if (lineSeg[0] == "CHANNELS") {
-              int numChannels = std::stoi(lineSeg[1]);
-              jointChannels.push_back(numChannels);
-              // process the channels, assume that the rotation channels
-              // are always behind the position channels
-              if (numChannels == 3 || numChannels == 6) {
-                // only rotation channels
-                int a = lineSeg[numChannels - 1][0] - 'X';
-                int b = lineSeg[numChannels][0] - 'X';
-                int c = lineSeg[numChannels + 1][0] - 'X';
-                jointChannelsOrder.push_back(a * 100 + b * 10 + c);
-              } else
-                throw std::runtime_error(
-                    "number of channels in bvh must be either 3 or 6");
-            } else if (lineSeg[0] == "}") {
-              jointChannels.push_back(0);
-              jointChannelsOrder.push_back(0);
-              s.pop(); // this is a end effector
-            } else
-              throw std::runtime_error(
-                  ("this label should be CHANNELS or `}` instead of " +
-                   lineSeg[0])
-                      .c_str());
-          } else if (lineSeg[0] == "JOINT") {
-            parentJoint = s.top();
-            skeleton.jointParent.push_back(parentJoint);
-            skeleton.jointChildren[parentJoint].push_back(currentJoint);
-            skeleton.jointNames.push_back(lineSeg[1]); // name of this joint
-            s.push(currentJoint); // keep record of this child joint
-          } else if (lineSeg[0] == "End") {
-            parentJoint = s.top();
-            skeleton.jointParent.push_back(parentJoint);
-            skeleton.jointChildren[parentJoint].push_back(currentJoint);
-            skeleton.jointNames.push_back(skeleton.jointNames[parentJoint] +
-                                          "_End"); // the end effector's name
-            getline(fileInput, line);              // {
-            getline(fileInput, line);              // OFFSET
-            lineSeg = SplitByWhiteSpace(line);
-            if (lineSeg[0] == "OFFSET") {
-              float xOffset = std::stof(lineSeg[1]) * scale;
-              float yOffset = std::stof(lineSeg[2]) * scale;
-              float zOffset = std::stof(lineSeg[3]) * scale;
-              skeleton.jointOffset.push_back(vec3(xOffset, yOffset, zOffset));
-              skeleton.jointChildren.push_back(vector<int>());
-              jointChannels.push_back(0); // 0 for end effector
-              jointChannelsOrder.push_back(0);
-            } else
-              throw std::runtime_error(
-                  "the label should be OFFSET for end effector");
-            getline(fileInput, line); // }
-            currentJoint++;           // move to the next joint index
-          }
-        }
+  }
+  // the previous content of this motion is replaced
+  skeleton = Skeleton();
+  poses.clear();
+  viewFrames = 0;
+  viewRotations = nullptr;
+  viewRootPositions = nullptr;
+  viewOwner.reset();
+  skeleton.skeletonName = std::filesystem::path(filename).stem().string();
 
-        // initialize jointRotation and jointScale
-        // bvh format don't store localRotation and localScale
-        // of a skeleton hierarchy, initialize to identity transform
-        skeleton.jointRotation = std::vector<glm::quat>(
-            skeleton.GetNumJoints(), glm::quat(1.0f, vec3(0.0f)));
-        skeleton.jointScale =
-            std::vector<glm::vec3>(skeleton.GetNumJoints(), glm::vec3(1.0f));
-
-        // parse pose data
-        getline(fileInput, line);
-        lineSeg = SplitByWhiteSpace(line);
-        if (lineSeg[0] == "MOTION") {
-          getline(fileInput, line);
-          lineSeg = SplitByWhiteSpace(line);
-          if (lineSeg[0] == "Frames:") {
-            poses.resize(std::stoi(lineSeg[1]));
-            getline(fileInput, line);
-            lineSeg = SplitByWhiteSpace(line);
-            if (lineSeg[0] == "Frame" && lineSeg[1] == "Time:") {
-              float timePerFrame = std::stof(lineSeg[2]);
-              fps = glm::round(1.0f / timePerFrame);
-              const int jointNumber = skeleton.GetNumJoints();
-              for (int frameInd = 0; frameInd < poses.size(); ++frameInd) {
-                getline(fileInput, line);
-                lineSeg = SplitByWhiteSpace(line);
-                vector<vec3> jointPositions(jointNumber, vec3(0.0f));
-                poses[frameInd].skeleton = &this->skeleton;
-                poses[frameInd].jointRotations.resize(jointNumber, vec3(0.0f));
-                int segInd = 0;
-                for (int jointInd = 0; jointInd < jointNumber; ++jointInd) {
-                  if (jointChannels[jointInd] == 6) {
-                    // set up the positions if exists
-                    float x = std::stof(lineSeg[segInd++]) * scale,
-                          y = std::stof(lineSeg[segInd++]) * scale,
-                          z = std::stof(lineSeg[segInd++]) * scale;
-                    jointPositions[jointInd] = vec3(x, y, z);
-                  }
-                  if (jointChannels[jointInd] != 0) {
-                    // set up rotations
-                    vec3 v(0.0f);
-                    int rotationOrder = jointChannelsOrder[jointInd];
-                    int o1 = rotationOrder / 100;
-                    int o2 = (rotationOrder - o1 * 100) / 10;
-                    int o3 = rotationOrder - o1 * 100 - o2 * 10;
-                    v[o1] = std::stof(lineSeg[segInd++]);
-                    v[o2] = std::stof(lineSeg[segInd++]);
-                    v[o3] = std::stof(lineSeg[segInd++]);
-                    poses[frameInd].jointRotations[jointInd] =
-                        QuatFromEulers(glm::radians(v), rotationOrder);
-                  } else {
-                    // set the rotation of end effectors to normal quaternion
-                    poses[frameInd].jointRotations[jointInd] =
-                        quat(1.0f, vec3(0.0f));
-                  }
-                }
-                // setup the root translation only
-                poses[frameInd].rootLocalPosition = jointPositions[0];
-              }
-            }
-          } else
-            throw std::runtime_error("number of frames must be specified");
-        } else
+  // number of channels of each joint, 0 for end effectors, and the order of
+  // the rotation channels, see `QuatFromEulers`
+  vector<int> jointChannels, jointChannelsOrder;
+  auto addJoint = [&](string name, int parent) {
+    int jointInd = skeleton.jointNames.size();
+    skeleton.jointNames.push_back(name);
+    skeleton.jointParent.push_back(parent);
+    skeleton.jointOffset.push_back(vec3(0.0f));
+    skeleton.jointChildren.push_back(vector<int>());
+    if (parent != -1)
+      skeleton.jointChildren[parent].push_back(jointInd);
+    jointChannels.push_back(0);
+    jointChannelsOrder.push_back(0);
+    return jointInd;
+  };
+
+  BVHTokenizer tokens{file.Data(), file.Data() + file.Size()};
+  tokens.Expect("HIERARCHY", "bvh file should start with HIERARCHY");
+  auto label = tokens.Next();
+  if (label != "ROOT")
+    throw std::runtime_error("the label should be ROOT instead of " +
+                             string(label));
+  stack<int> s;
+  s.push(addJoint(string(tokens.Next()), -1));
+  while (!s.empty()) {
+    label = tokens.Next();
+    if (label.empty()) {
+      throw std::runtime_error("unexpected end of bvh hierarchy");
+    } else if (label == "{") {
+      continue;
+    } else if (label == "}") {
+      s.pop();
+    } else if (label == "OFFSET") {
+      float xOffset = tokens.NextFloat() * scale;
+      float yOffset = tokens.NextFloat() * scale;
+      float zOffset = tokens.NextFloat() * scale;
+      skeleton.jointOffset[s.top()] = vec3(xOffset, yOffset, zOffset);
+      // a joint without channels is an end effector
+      if (tokens.Peek() == "CHANNELS") {
+        tokens.Next();
+        int numChannels = tokens.NextInt();
+        if (numChannels != 3 && numChannels != 6)
           throw std::runtime_error(
-              "pose data should start with a MOTION label");
-        fileInput.close();
-        return true;
-      } else
-        throw std::runtime_error("the label should be ROOT instead of " +
-                                 lineSeg[0]);
+              "number of channels in bvh must be either 3 or 6");
+        // assume that the rotation channels are always behind the position
+        // channels, only the axis of rotation channels matters
+        int order = 0;
+        for (int channelInd = 0; channelInd < numChannels; ++channelInd) {
+          auto channel = tokens.Next();
+          if (channelInd < numChannels - 3)
+            continue;
+          int axis = channel.empty() ? -1 : channel[0] - 'X';
+          if (axis < 0 || axis > 2)
+            throw std::runtime_error("invalid rotation channel " +
+                                     string(channel));
+          order = order * 10 + axis;
+        }
+        jointChannels[s.top()] = numChannels;
+        jointChannelsOrder[s.top()] = order;
+      }
+    } else if (label == "JOINT") {
+      int parentJoint = s.top();
+      s.push(addJoint(string(tokens.Next()), parentJoint));
+    } else if (label == "End") {
+      tokens.Next(); // Site
+      int parentJoint = s.top();
+      // the end effector's name
+      s.push(addJoint(skeleton.jointNames[parentJoint].str() + "_End",
+                      parentJoint));
     } else
-      throw std::runtime_error("bvh file should start with HIERARCHY");
-    fileInput.close();
-    return false;
+      throw std::runtime_error("unexpected label " + string(label) +
+                               " in bvh hierarchy");
+  }
+
+  // bvh format don't store localRotation and localScale
+  // of a skeleton hierarchy, initialize to identity transform
+  const int jointNumber = skeleton.GetNumJoints();
+  skeleton.jointRotation =
+      std::vector<glm::quat>(jointNumber, glm::quat(1.0f, vec3(0.0f)));
+  skeleton.jointScale = std::vector<glm::vec3>(jointNumber, glm::vec3(1.0f));
+
+  // parse pose data
+  tokens.Expect("MOTION", "pose data should start with a MOTION label");
+  tokens.Expect("Frames:", "number of frames must be specified");
+  int numFrames = tokens.NextInt();
+  if (numFrames < 0)
+    throw std::runtime_error("number of frames must not be negative");
+  if (tokens.Next() != "Frame" || tokens.Next() != "Time:")
+    throw std::runtime_error("frame time must be specified");
+  float timePerFrame = tokens.NextFloat();
+  fps = glm::round(1.0f / timePerFrame);
+  tokens.SkipLine();
+
+  // locate the line of each frame, blank lines are skipped
+  vector<std::pair<const char *, const char *>> frameLines;
+  frameLines.reserve(numFrames);
+  const char *cur = tokens.cur;
+  while (frameLines.size() < numFrames && cur < tokens.end) {
+    auto lineEnd = static_cast<const char *>(
+        std::memchr(cur, '\n', tokens.end - cur));
+    if (lineEnd == nullptr)
+      lineEnd = tokens.end;
+    const char *lineBegin = cur;
+    while (lineBegin < lineEnd && IsWhiteSpace(*lineBegin))
+      lineBegin++;
+    if (lineBegin < lineEnd)
+      frameLines.push_back(std::make_pair(lineBegin, lineEnd));
+    cur = lineEnd + 1;
   }
+  if (frameLines.size() < numFrames)
+    throw std::runtime_error("bvh file has " +
+                             std::to_string(frameLines.size()) +
+                             " frames, less than specified");
+
+  // frames are independent of each other, decode them in parallel
+  poses.resize(numFrames);
+  ThreadPool::Ref().ParallelFor(0, numFrames, 64, [&](int begin, int end) {
+    for (int frameInd = begin; frameInd < end; ++frameInd) {
+      auto &pose = poses[frameInd];
+      pose.skeleton = &this->skeleton;
+      pose.jointRotations.resize(jointNumber);
+      pose.rootLocalPosition = vec3(0.0f);
+      const char *cur = frameLines[frameInd].first;
+      const char *lineEnd = frameLines[frameInd].second;
+      for (int jointInd = 0; jointInd < jointNumber; ++jointInd) {
+        const int numChannels = jointChannels[jointInd];
+        if (numChannels == 0) {
+          // set the rotation of end effectors to normal quaternion
+          pose.jointRotations[jointInd] = quat(1.0f, vec3(0.0f));
+          continue;
+        }
+        float values[6];
+        for (int channelInd = 0; channelInd < numChannels; ++channelInd) {
+          cur = ParseBVHFloat(cur, lineEnd, values[channelInd]);
+          if (cur == nullptr)
+            throw std::runtime_error("invalid or missing value at frame " +
+                                     std::to_string(frameInd));
+        }
+        const float *rotation = values;
+        if (numChannels == 6) {
+          // setup the root translation only
+          if (jointInd == 0)
+            pose.rootLocalPosition = vec3(
+                values[0] * scale, values[1] * scale, values[2] * scale);
+          rotation += 3;
+        }
+        vec3 v(0.0f);
+        int rotationOrder = jointChannelsOrder[jointInd];
+        v[rotationOrder / 100] = rotation[0];
+        v[rotationOrder / 10 % 10] = rotation[1];
+        v[rotationOrder % 10] = rotation[2];
+        pose.jointRotations[jointInd] =
+            QuatFromEulers(glm::radians(v), rotationOrder);
+      }
+    }
+  });
+  UpdatePackedFrames();
+  return true;
 }
 
 inline void BVHPadding(std::ostream &out, int depth) {
@@ -259,7 +315,13 @@ inline void BVHPadding(std::ostream &out, int depth) {
     out << "\t";
 }
 
+// Same text as `std::ostream << value` with the default precision.
+inline char *WriteBVHFloat(char *out, char *end, float value) {
+  return std::to_chars(out, end, value, std::chars_format::general, 6).ptr;
+}
+
 bool Motion::SaveToBVH(string filename, bool keepJointNames, float scale) {
+  EnsurePoses();
   // apply the initial rotations of skeleton joints
   // the motion data remains unchanged
   auto restPose = skeleton.GetRestPose();
@@ -281,9 +343,9 @@ bool Motion::SaveToBVH(string filename, bool keepJointNames, float scale) {
     fileOutput.close();
     return false;
   } else {
-    fileOutput << "HIERARCHY" << std::endl;
+    fileOutput << "HIERARCHY\n";
     // write the skeleton hierarchy
-    std::set<int> incorrectNamedEE;
+    vector<bool> incorrectNamedEE(jointNumber, false);
     int depth = 0;
     for (int jointInd = 0; jointInd < skeleton.GetNumJoints(); ++jointInd) {
       BVHPadding(fileOutput, depth);
@@ -293,7 +355,7 @@ bool Motion::SaveToBVH(string filename, bool keepJointNames, float scale) {
           // force rename end effector
           fileOutput << "End Site\n";
         } else {
-          incorrectNamedEE.insert(jointInd);
+          incorrectNamedEE[jointInd] = true;
           fileOutput << "JOINT " << skeleton.jointNames[jointInd] << "\n";
         }
         BVHPadding(fileOutput, depth++);
@@ -302,7 +364,7 @@ bool Motion::SaveToBVH(string filename, bool keepJointNames, float scale) {
         fileOutput << "OFFSET " << flattenJointOffset[jointInd].x * scale << " "
                    << flattenJointOffset[jointInd].y * scale << " "
                    << flattenJointOffset[jointInd].z * scale << "\n";
-        if (incorrectNamedEE.count(jointInd) != 0) {
+        if (incorrectNamedEE[jointInd]) {
           // add an end effector with no offset to the end
           BVHPadding(fileOutput, depth);
           fileOutput << "CHANNELS 3 Zrotation Yrotation Xrotation\n";
@@ -353,51 +415,75 @@ bool Motion::SaveToBVH(string filename, bool keepJointNames, float scale) {
         }
       }
     }
-    fileOutput.flush();
-
     // write the pose data
-    fileOutput << "MOTION\nFrames: " << poses.size() << "\n"
+    const int numFrames = poses.size();
+    fileOutput << "MOTION\nFrames: " << numFrames << "\n"
                << "Frame Time: " << 1.0f / fps << "\n";
-    for (int frameInd = 0; frameInd < poses.size(); ++frameInd) {
-      fileOutput << poses[frameInd].rootLocalPosition.x * scale << " "
-                 << poses[frameInd].rootLocalPosition.y * scale << " "
-                 << poses[frameInd].rootLocalPosition.z * scale << " ";
-      vector<quat> frameJointRot(jointNumber, quat(1.0f, vec3(0.0f)));
-      vector<quat> newOrien(jointNumber, quat(1.0f, vec3(0.0f)));
-      vector<quat> oldOrien;
-      // oldOrien is the ground truth rotation we need
-      poses[frameInd].GetGlobalPositionOrientation(oldOrien);
-      for (int jointInd = 0; jointInd < jointNumber; ++jointInd) {
-        int parentInd = skeleton.jointParent[jointInd];
-        // `newOrien` is the delta rotation in each frame
-        // oldOrien = newOrien * globalJointOrien
-        // meaning that we can get the ground truth rotation with the skeleton
-        // initial rotation and a delta rotation stored in each frame,
-        // we will get local rotation of each joint from this delta global
-        // rotation
-        newOrien[jointInd] =
-            oldOrien[jointInd] * glm::inverse(globalJointOrien[jointInd]);
-        if (parentInd == -1) {
-          frameJointRot[jointInd] = newOrien[jointInd];
-        } else {
-          frameJointRot[jointInd] =
-              glm::inverse(newOrien[parentInd]) * newOrien[jointInd];
-        }
-      }
-      for (int jointInd = 0; jointInd < jointNumber; ++jointInd) {
-        if (skeleton.jointChildren[jointInd].size() != 0) {
-          vec3 euler = glm::eulerAngles(frameJointRot[jointInd]);
-          vec3 eulerDegree = glm::degrees(euler);
-          fileOutput << eulerDegree.z << " " << eulerDegree.y << " "
-                     << eulerDegree.x << " ";
-        } else {
-          if (incorrectNamedEE.count(jointInd) != 0) {
-            // if this joint is a incorrectly named ee
-            fileOutput << "0 0 0 ";
-          }
-        }
-      }
-      fileOutput << "\n";
+    // global orientations of all frames, the ground truth rotation we need
+    vector<vec3> allPositions;
+    vector<quat> allOrien;
+    ForwardKinematics(skeleton, poses, allPositions, allOrien);
+    vector<quat> inverseRestOrien(jointNumber);
+    for (int jointInd = 0; jointInd < jointNumber; ++jointInd)
+      inverseRestOrien[jointInd] = glm::inverse(globalJointOrien[jointInd]);
+    // frames are formatted in parallel chunks, then written in order, one
+    // block of chunks is kept in memory at a time
+    const int chunkSize = 64, chunksPerBlock = 64;
+    const size_t maxFrameChars = (size_t)(3 + 3 * jointNumber) * 16 + 1;
+    vector<string> chunkText(chunksPerBlock);
+    for (int blockBegin = 0; blockBegin < numFrames;
+         blockBegin += chunkSize * chunksPerBlock) {
+      int blockEnd =
+          std::min(numFrames, blockBegin + chunkSize * chunksPerBlock);
+      ThreadPool::Ref().ParallelFor(
+          blockBegin, blockEnd, chunkSize, [&](int begin, int end) {
+            string &text = chunkText[(begin - blockBegin) / chunkSize];
+            text.resize((end - begin) * maxFrameChars);
+            char *out = text.data(), *outEnd = text.data() + text.size();
+            vector<quat> newOrien(jointNumber);
+            for (int frameInd = begin; frameInd < end; ++frameInd) {
+              auto &rootPosition = poses[frameInd].rootLocalPosition;
+              for (int axis = 0; axis < 3; ++axis) {
+                out = WriteBVHFloat(out, outEnd, rootPosition[axis] * scale);
+                *out++ = ' ';
+              }
+              auto oldOrien = allOrien.begin() + (size_t)frameInd * jointNumber;
+              for (int jointInd = 0; jointInd < jointNumber; ++jointInd) {
+                int parentInd = skeleton.jointParent[jointInd];
+                // `newOrien` is the delta rotation in each frame
+                // oldOrien = newOrien * globalJointOrien
+                // meaning that we can get the ground truth rotation with the
+                // skeleton initial rotation and a delta rotation stored in
+                // each frame, we will get local rotation of each joint from
+                // this delta global rotation
+                newOrien[jointInd] =
+                    oldOrien[jointInd] * inverseRestOrien[jointInd];
+                if (skeleton.jointChildren[jointInd].size() != 0) {
+                  quat frameJointRot =
+                      parentInd == -1
+                          ? newOrien[jointInd]
+                          : glm::inverse(newOrien[parentInd]) *
+                                newOrien[jointInd];
+                  vec3 eulerDegree =
+                      glm::degrees(glm::eulerAngles(frameJointRot));
+                  for (int axis = 2; axis >= 0; --axis) {
+                    out = WriteBVHFloat(out, outEnd, eulerDegree[axis]);
+                    *out++ = ' ';
+                  }
+                } else if (incorrectNamedEE[jointInd]) {
+                  // if this joint is a incorrectly named ee
+                  std::memcpy(out, "0 0 0 ", 6);
+                  out += 6;
+                }
+              }
+              *out++ = '\n';
+            }
+            text.resize(out - text.data());
+          });
+      for (int chunkInd = 0; chunkInd * chunkSize < blockEnd - blockBegin;
+           ++chunkInd)
+        fileOutput.write(chunkText[chunkInd].data(),
+                         chunkText[chunkInd].size());
     }
     fileOutput.close();
     return true;
@@ -442,6 +528,7 @@ vector<vec3> Pose::GetGlobalPositions() {
 }
 
 Pose Motion::At(float frame) {
+  EnsurePoses();
   if (frame <= 0.0f)
     return poses[0];
   if (frame >= poses.size() - 1)
@@ -463,6 +550,162 @@ Pose Motion::At(float frame) {
   return result;
 }
 
+void Motion::UpdatePackedFrames() {
+  EnsurePoses();
+  int jointNum = skeleton.GetNumJoints();
+  int nFrames = poses.size();
+  jointStride = Math::PadToSIMD(jointNum);
+  packedRotations.assign((size_t)nFrames * 4 * jointStride, 0.0f);
+  packedRootPositions.resize(nFrames);
+  for (int frameInd = 0; frameInd < nFrames; ++frameInd) {
+    auto &pose = poses[frameInd];
+    float *x = packedRotations.data() + (size_t)frameInd * 4 * jointStride;
+    float *y = x + jointStride, *z = y + jointStride, *w = z + jointStride;
+    int poseJointNum = std::min<int>(jointNum, pose.jointRotations.size());
+    for (int jointInd = 0; jointInd < poseJointNum; ++jointInd) {
+      auto &q = pose.jointRotations[jointInd];
+      x[jointInd] = q.x;
+      y[jointInd] = q.y;
+      z[jointInd] = q.z;
+      w[jointInd] = q.w;
+    }
+    // missing and padding joints are identity rotations
+    for (int jointInd = poseJointNum; jointInd < jointStride; ++jointInd)
+      w[jointInd] = 1.0f;
+    packedRootPositions[frameInd] = pose.rootLocalPosition;
+  }
+  UpdateRootTrack();
+}
+
+void Motion::EnsurePackedFrames() {
+  if (!viewOwner &&
+      (packedRootPositions.size() != poses.size() ||
+       jointStride != Math::PadToSIMD(skeleton.GetNumJoints())))
+    UpdatePackedFrames();
+}
+
+bool Motion::SampleInto(float frame, PoseBuffer &buffer) {
+  int nFrames = NumFrames();
+  if (nFrames == 0)
+    return false;
+  int jointNum = skeleton.GetNumJoints();
+  EnsurePackedFrames();
+  buffer.skeleton = &skeleton;
+  buffer.Resize(jointNum);
+  const int frameSize = 4 * jointStride;
+  const float *rotations = PackedRotations();
+  const glm::vec3 *rootPositions = PackedRootPositions();
+  if (frame <= 0.0f || frame >= nFrames - 1) {
+    int frameInd = frame <= 0.0f ? 0 : nFrames - 1;
+    std::copy_n(rotations + (size_t)frameInd * frameSize, frameSize,
+                buffer.rotations.data());
+    buffer.rootLocalPosition = rootPositions[frameInd];
+    return true;
+  }
+  unsigned int start = (unsigned int)frame;
+  unsigned int end = start + 1;
+  float alpha = frame - start;
+  buffer.rootLocalPosition = rootPositions[start] * (1.0f - alpha) +
+                             rootPositions[end] * alpha;
+  const float *a = rotations + (size_t)start * frameSize;
+  const float *b = rotations + (size_t)end * frameSize;
+  float *r = buffer.rotations.data();
+  const int s = jointStride;
+  using Math::FloatN;
+  const FloatN t(alpha);
+  for (int j = 0; j < s; j += FloatN::Width) {
+    FloatN x = FloatN::Load(a + j), y = FloatN::Load(a + s + j),
+           z = FloatN::Load(a + 2 * s + j), w = FloatN::Load(a + 3 * s + j);
+    Math::QuatNlerp(x, y, z, w, FloatN::Load(b + j), FloatN::Load(b + s + j),
+                    FloatN::Load(b + 2 * s + j), FloatN::Load(b + 3 * s + j),
+                    t);
+    x.Store(r + j);
+    y.Store(r + s + j);
+    z.Store(r + 2 * s + j);
+    w.Store(r + 3 * s + j);
+  }
+  return true;
+}
+
+int Motion::NumFrames() const {
+  return viewOwner ? viewFrames : (int)poses.size();
+}
+
+const float *Motion::PackedRotations() const {
+  return viewOwner ? viewRotations : packedRotations.data();
+}
+
+const glm::vec3 *Motion::PackedRootPositions() const {
+  return viewOwner ? viewRootPositions : packedRootPositions.data();
+}
+
+void Motion::SetPackedFramesView(int numFrames, const float *rotations,
+                                 const glm::vec3 *rootPositions,
+                                 std::shared_ptr<const void> owner) {
+  poses.clear();
+  packedRotations.clear();
+  packedRootPositions.clear();
+  rootTrack.clear();
+  jointStride = Math::PadToSIMD(skeleton.GetNumJoints());
+  viewFrames = numFrames;
+  viewRotations = rotations;
+  viewRootPositions = rootPositions;
+  viewOwner = std::move(owner);
+}
+
+void Motion::EnsurePoses() {
+  if (!viewOwner)
+    return;
+  int jointNum = skeleton.GetNumJoints();
+  const size_t frameSize = 4 * jointStride;
+  poses.resize(viewFrames);
+  for (int frameInd = 0; frameInd < viewFrames; ++frameInd) {
+    auto &pose = poses[frameInd];
+    const float *x = viewRotations + frameInd * frameSize;
+    const float *y = x + jointStride, *z = y + jointStride,
+                *w = z + jointStride;
+    pose.skeleton = &skeleton;
+    pose.jointRotations.resize(jointNum);
+    for (int jointInd = 0; jointInd < jointNum; ++jointInd)
+      pose.jointRotations[jointInd] =
+          quat(w[jointInd], x[jointInd], y[jointInd], z[jointInd]);
+    pose.rootLocalPosition = viewRootPositions[frameInd];
+  }
+  packedRotations.assign(viewRotations, viewRotations + viewFrames * frameSize);
+  packedRootPositions.assign(viewRootPositions,
+                             viewRootPositions + viewFrames);
+  viewFrames = 0;
+  viewRotations = nullptr;
+  viewRootPositions = nullptr;
+  viewOwner.reset();
+}
+
+void PoseBuffer::Resize(int jointNum) {
+  numJoints = jointNum;
+  jointStride = Math::PadToSIMD(jointNum);
+  rotations.resize(4 * jointStride);
+}
+
+void PoseBuffer::FromPose(Pose &pose) {
+  skeleton = pose.skeleton;
+  Resize(pose.jointRotations.size());
+  std::fill(rotations.begin(), rotations.end(), 0.0f);
+  std::fill(rotations.begin() + 3 * jointStride, rotations.end(), 1.0f);
+  for (int jointInd = 0; jointInd < numJoints; ++jointInd)
+    SetRotation(jointInd, pose.jointRotations[jointInd]);
+  rootLocalPosition = pose.rootLocalPosition;
+}
+
+Pose PoseBuffer::ToPose() {
+  Pose result;
+  result.skeleton = skeleton;
+  result.rootLocalPosition = rootLocalPosition;
+  result.jointRotations.resize(numJoints);
+  for (int jointInd = 0; jointInd < numJoints; ++jointInd)
+    result.jointRotations[jointInd] = GetRotation(jointInd);
+  return result;
+}
+
 Pose Skeleton::GetRestPose() {
   Pose p;
   p.skeleton = this;
@@ -486,14 +729,79 @@ void Skeleton::ExportAsBVH(std::string filepath, bool keepJointNames) {
   tmpMotion.SaveToBVH(filepath, keepJointNames);
 }
 
-vec3 Pose::GetFacingDirection(vec3 restFacing) {
-  auto q = jointRotations[0];
+// Remove the tilt of the root rotation `q` and rotate `restFacing` with
+// the remaining rotation around the up axis.
+static vec3 facingDirection(quat q, vec3 restFacing) {
   auto xzRot = q * vec3(0.0f, 1.0f, 0.0f);
   auto qxz = Math::FromToRotation(vec3(0.0f, 1.0f, 0.0f), xzRot);
   auto qy = glm::inverse(qxz) * q;
   return qy * restFacing;
 }
 
+vec3 Pose::GetFacingDirection(vec3 restFacing) {
+  return facingDirection(jointRotations[0], restFacing);
+}
+
+void Motion::UpdateRootTrack() {
+  int nFrames = NumFrames();
+  rootTrack.resize(nFrames);
+  if (nFrames == 0 || skeleton.GetNumJoints() == 0) {
+    rootTrack.clear();
+    return;
+  }
+  EnsurePackedFrames();
+  const size_t frameSize = 4 * jointStride;
+  const float *rotations = PackedRotations();
+  const glm::vec3 *rootPositions = PackedRootPositions();
+  for (int frameInd = 0; frameInd < nFrames; ++frameInd) {
+    const float *x = rotations + frameInd * frameSize;
+    const float *y = x + jointStride, *z = y + jointStride,
+                *w = z + jointStride;
+    auto &sample = rootTrack[frameInd];
+    sample.position = rootPositions[frameInd];
+    sample.position.y = 0.0f;
+    sample.facing = facingDirection(quat(w[0], x[0], y[0], z[0]),
+                                    vec3(0.0f, 0.0f, 1.0f));
+    if (frameInd == 0)
+      continue;
+    // backward differences, the first frame copies the second one
+    auto &last = rootTrack[frameInd - 1];
+    sample.velocity = (sample.position - last.position) * (float)fps;
+    sample.angularVelocity =
+        std::atan2(cross(last.facing, sample.facing).y,
+                   dot(last.facing, sample.facing)) *
+        fps;
+  }
+  if (nFrames > 1) {
+    rootTrack[0].velocity = rootTrack[1].velocity;
+    rootTrack[0].angularVelocity = rootTrack[1].angularVelocity;
+  }
+}
+
+void Motion::EnsureRootTrack() {
+  if (rootTrack.size() != NumFrames())
+    UpdateRootTrack();
+}
+
+RootSample Motion::SampleRootTrack(float frame) const {
+  int nFrames = rootTrack.size();
+  if (nFrames == 0)
+    return RootSample();
+  if (frame <= 0.0f || frame >= nFrames - 1)
+    return rootTrack[frame <= 0.0f ? 0 : nFrames - 1];
+  unsigned int start = (unsigned int)frame;
+  float alpha = frame - start;
+  auto &a = rootTrack[start], &b = rootTrack[start + 1];
+  RootSample sample;
+  sample.position = glm::mix(a.position, b.position, alpha);
+  sample.velocity = glm::mix(a.velocity, b.velocity, alpha);
+  sample.angularVelocity = glm::mix(a.angularVelocity, b.angularVelocity, alpha);
+  vec3 facing = glm::mix(a.facing, b.facing, alpha);
+  float length = glm::length(facing);
+  sample.facing = length > 1e-6f ? facing / length : a.facing;
+  return sample;
+}
+
 }; // namespace Animation
 
 }; // namespace aEngine
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <cmath>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -26,18 +27,21 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "Base/Name.hpp"
+
 namespace aEngine {
 
 namespace Animation {
 
 struct Skeleton;
 struct Pose;
+struct PoseBuffer;
 struct Motion;
 
 // The parent joint has a lower index than all its children
 struct Skeleton {
   std::string skeletonName;
-  std::vector<std::string> jointNames;
+  std::vector<Name> jointNames;
   // local position to joints' parent
   std::vector<glm::vec3> jointOffset;
   // local rotation to joints' parent
@@ -104,6 +108,54 @@ struct Pose {
   // glm::vec2 GetFacingDirection();
 };
 
+// Caller owned storage for a sampled pose, the rotations are stored as
+// structure of arrays: `x[jointStride] y[jointStride] z[jointStride]
+// w[jointStride]`, with `jointStride` padded for SIMD access. Resizing to
+// the same or a smaller joint count never reallocates, so a buffer kept
+// alive across frames makes sampling allocation free.
+struct PoseBuffer {
+  Skeleton *skeleton = nullptr;
+  int numJoints = 0, jointStride = 0;
+  // local position for root joint only
+  glm::vec3 rootLocalPosition = glm::vec3(0.0f);
+  std::vector<float> rotations;
+
+  void Resize(int jointNum);
+
+  float *X() { return rotations.data(); }
+  float *Y() { return rotations.data() + jointStride; }
+  float *Z() { return rotations.data() + 2 * jointStride; }
+  float *W() { return rotations.data() + 3 * jointStride; }
+
+  glm::quat GetRotation(int joint) const {
+    return glm::quat(rotations[3 * jointStride + joint], rotations[joint],
+                     rotations[jointStride + joint],
+                     rotations[2 * jointStride + joint]);
+  }
+  void SetRotation(int joint, glm::quat q) {
+    rotations[joint] = q.x;
+    rotations[jointStride + joint] = q.y;
+    rotations[2 * jointStride + joint] = q.z;
+    rotations[3 * jointStride + joint] = q.w;
+  }
+
+  // Convert from and to the vector based pose, these allocate.
+  void FromPose(Pose &pose);
+  Pose ToPose();
+};
+
+// Root motion of one frame projected to the ground plane (xz), the rates
+// are per second at the motion's fps.
+struct RootSample {
+  glm::vec3 position = glm::vec3(0.0f);
+  // unit length, same as `Pose::GetFacingDirection`
+  glm::vec3 facing = glm::vec3(0.0f, 0.0f, 1.0f);
+  glm::vec3 velocity = glm::vec3(0.0f);
+  // yaw rate around the up axis in radians, positive is counter clockwise
+  // seen from above
+  float angularVelocity = 0.0f;
+};
+
 struct Motion {
   Motion() {}
   ~Motion() {}
@@ -135,6 +187,68 @@ struct Motion {
   // If the frame is not valid (out of [0, nframe) range), returns the first
   // frame or last frame respectively.
   Pose At(float frame);
+
+  // Same clamping rules as `At`, but writes into caller provided storage
+  // and interpolates `FloatN::Width` joints at a time from the packed
+  // frames. The packed frames are rebuilt first if their size no longer
+  // matches `poses`, returns false if the motion is empty.
+  bool SampleInto(float frame, PoseBuffer &buffer);
+
+  // Rebuild the packed frames from `poses`, call this after modifying
+  // the content of `poses` in place.
+  void UpdatePackedFrames();
+  // Rebuild the packed frames only if their size no longer matches
+  // `poses`. `SampleInto` doesn't modify the motion after this, so several
+  // threads can sample the same motion at once.
+  void EnsurePackedFrames();
+
+  // Number of frames, also valid when the frames are only available as a
+  // view into a cache file.
+  int NumFrames() const;
+
+  // A motion loaded from a cache file starts with an empty `poses`, call
+  // this before accessing `poses`. The frames are copied out of the cache
+  // and the motion owns its data from then on.
+  void EnsurePoses();
+
+  // Use frames stored elsewhere as the packed frames, `owner` keeps the
+  // memory alive. `poses` is cleared, the layout must match
+  // `packedRotations` with the current skeleton.
+  void SetPackedFramesView(int numFrames, const float *rotations,
+                           const glm::vec3 *rootPositions,
+                           std::shared_ptr<const void> owner);
+
+  const float *PackedRotations() const;
+  const glm::vec3 *PackedRootPositions() const;
+
+  // Rebuild `rootTrack` from the packed frames, `UpdatePackedFrames` does
+  // this already.
+  void UpdateRootTrack();
+  // Rebuild `rootTrack` only if its size no longer matches the frames.
+  void EnsureRootTrack();
+  // Same clamping rules as `At`, the position and velocity are linearly
+  // interpolated and the facing direction is renormalized. Call
+  // `EnsureRootTrack` first if the frames may have changed.
+  RootSample SampleRootTrack(float frame) const;
+
+  // One sample per frame, computed once when the frames are packed or
+  // loaded from the motion cache. `SetPackedFramesView` clears it, the
+  // owner of the view is expected to fill it.
+  std::vector<RootSample> rootTrack;
+
+  // Packed copy of `poses`, frame `f` starts at
+  // `packedRotations[f * 4 * jointStride]` with the same layout as
+  // `PoseBuffer::rotations`.
+  int jointStride = 0;
+  std::vector<float> packedRotations;
+  std::vector<glm::vec3> packedRootPositions;
+
+  // External packed frames set by `SetPackedFramesView`, they take
+  // precedence over `packedRotations` while `viewOwner` is set.
+  int viewFrames = 0;
+  const float *viewRotations = nullptr;
+  const glm::vec3 *viewRootPositions = nullptr;
+  std::shared_ptr<const void> viewOwner;
 };
 
 }; // namespace Animation
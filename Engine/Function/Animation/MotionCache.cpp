@@ -0,0 +1,319 @@
+#include "Function/Animation/MotionCache.hpp"
+#include "Function/General/MappedFile.hpp"
+#include "Function/Math/SIMD.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace aEngine {
+
+namespace Animation {
+
+namespace fs = std::filesystem;
+
+static const char cacheMagic[4] = {'A', 'M', 'O', 'T'};
+// bump this whenever the layout of the file or of the packed frames changes
+static const uint32_t cacheVersion = 2;
+// frame data starts at a multiple of this, so that it can be used directly
+// by simd kernels
+static const size_t cacheAlignment = 64;
+
+struct MotionCacheHeader {
+  char magic[4];
+  uint32_t version;
+  // identify the source file the cache is built from
+  uint64_t sourceSize;
+  int64_t sourceTime;
+  uint64_t sourcePathHash;
+  int32_t fps, numFrames, numJoints, jointStride;
+  // byte offsets from the start of the file
+  uint64_t skeletonOffset, rotationsOffset, rootPositionsOffset,
+      rootTrackOffset, fileSize;
+};
+
+struct MotionCacheKey {
+  uint64_t size = 0;
+  int64_t time = 0;
+  uint64_t pathHash = 0;
+};
+
+// FNV-1a, stable across runs and standard libraries unlike `std::hash`
+static uint64_t hashString(const std::string &str) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : str) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static bool getCacheKey(const std::string &sourcePath, MotionCacheKey &key) {
+  std::error_code ec;
+  auto size = fs::file_size(sourcePath, ec);
+  if (ec)
+    return false;
+  auto time = fs::last_write_time(sourcePath, ec);
+  if (ec)
+    return false;
+  auto absolutePath = fs::absolute(sourcePath, ec);
+  if (ec)
+    return false;
+  key.size = size;
+  key.time = time.time_since_epoch().count();
+  key.pathHash = hashString(absolutePath.lexically_normal().generic_string());
+  return true;
+}
+
+template <typename T>
+static void writeArray(std::string &out, const T *data, size_t count) {
+  out.append(reinterpret_cast<const char *>(data), sizeof(T) * count);
+}
+
+static void writeCount(std::string &out, size_t count) {
+  uint32_t n = count;
+  writeArray(out, &n, 1);
+}
+
+static void writeString(std::string &out, const std::string &str) {
+  writeCount(out, str.size());
+  out.append(str);
+}
+
+template <typename T>
+static void writeVector(std::string &out, const std::vector<T> &data) {
+  writeCount(out, data.size());
+  writeArray(out, data.data(), data.size());
+}
+
+// Reads from a range of the mapped file, any read past the end of the range
+// fails and leaves `ok` false.
+struct MotionCacheReader {
+  const char *cur, *end;
+  bool ok = true;
+
+  template <typename T> bool ReadArray(T *data, size_t count) {
+    size_t bytes = sizeof(T) * count;
+    if (!ok || (size_t)(end - cur) < bytes)
+      return ok = false;
+    std::memcpy(data, cur, bytes);
+    cur += bytes;
+    return true;
+  }
+  bool ReadCount(size_t &count) {
+    uint32_t n = 0;
+    ReadArray(&n, 1);
+    count = n;
+    return ok;
+  }
+  bool ReadString(std::string &str) {
+    size_t n;
+    if (!ReadCount(n) || (size_t)(end - cur) < n)
+      return ok = false;
+    str.assign(cur, n);
+    cur += n;
+    return true;
+  }
+  template <typename T> bool ReadVector(std::vector<T> &data) {
+    size_t n;
+    if (!ReadCount(n) || (size_t)(end - cur) < sizeof(T) * n)
+      return ok = false;
+    data.resize(n);
+    return ReadArray(data.data(), n);
+  }
+};
+
+static void writeSkeleton(std::string &out, Skeleton &skeleton) {
+  writeString(out, skeleton.skeletonName);
+  writeCount(out, skeleton.GetNumJoints());
+  for (int jointInd = 0; jointInd < skeleton.GetNumJoints(); ++jointInd) {
+    writeString(out, skeleton.jointNames[jointInd].str());
+    int32_t parent = skeleton.jointParent[jointInd];
+    writeArray(out, &parent, 1);
+    writeVector(out, skeleton.jointChildren[jointInd]);
+  }
+  writeVector(out, skeleton.jointOffset);
+  writeVector(out, skeleton.jointRotation);
+  writeVector(out, skeleton.jointScale);
+  writeVector(out, skeleton.offsetMatrices);
+}
+
+static bool readSkeleton(MotionCacheReader &reader, Skeleton &skeleton) {
+  size_t numJoints;
+  reader.ReadString(skeleton.skeletonName);
+  if (!reader.ReadCount(numJoints))
+    return false;
+  skeleton.jointNames.resize(numJoints);
+  skeleton.jointParent.resize(numJoints);
+  skeleton.jointChildren.resize(numJoints);
+  std::string name;
+  for (int jointInd = 0; jointInd < numJoints && reader.ok; ++jointInd) {
+    int32_t parent;
+    reader.ReadString(name);
+    reader.ReadArray(&parent, 1);
+    reader.ReadVector(skeleton.jointChildren[jointInd]);
+    skeleton.jointNames[jointInd] = Name(name);
+    skeleton.jointParent[jointInd] = parent;
+    // forward kinematics expects the parents before their children
+    if (parent < -1 || parent >= jointInd)
+      return false;
+    for (int child : skeleton.jointChildren[jointInd])
+      if (child < 0 || child >= numJoints)
+        return false;
+  }
+  reader.ReadVector(skeleton.jointOffset);
+  reader.ReadVector(skeleton.jointRotation);
+  reader.ReadVector(skeleton.jointScale);
+  reader.ReadVector(skeleton.offsetMatrices);
+  // skeletons loaded from bvh files have no offset matrices
+  return reader.ok && skeleton.jointOffset.size() == numJoints &&
+         skeleton.jointRotation.size() == numJoints &&
+         skeleton.jointScale.size() == numJoints &&
+         (skeleton.offsetMatrices.empty() ||
+          skeleton.offsetMatrices.size() == numJoints);
+}
+
+static void padTo(std::string &out, size_t alignment) {
+  out.resize((out.size() + alignment - 1) / alignment * alignment, '\0');
+}
+
+std::string MotionCachePath(const std::string &sourcePath,
+                            const std::string &cacheDir) {
+  if (cacheDir.empty())
+    return sourcePath + ".amot";
+  // files with the same name from different folders share the cache dir
+  std::error_code ec;
+  auto absolutePath = fs::absolute(sourcePath, ec);
+  char hashText[17];
+  snprintf(hashText, sizeof(hashText), "%016llx",
+           (unsigned long long)hashString(
+               absolutePath.lexically_normal().generic_string()));
+  return (fs::path(cacheDir) /
+          (fs::path(sourcePath).filename().string() + "." + hashText +
+           ".amot"))
+      .string();
+}
+
+bool SaveMotionCache(Motion &motion, const std::string &sourcePath,
+                     const std::string &cacheDir) {
+  MotionCacheKey key;
+  if (!getCacheKey(sourcePath, key))
+    return false;
+  int jointNum = motion.skeleton.GetNumJoints();
+  motion.EnsurePackedFrames();
+  int nFrames = motion.NumFrames();
+  if (nFrames == 0 || jointNum == 0)
+    return false;
+
+  MotionCacheHeader header;
+  std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+  header.version = cacheVersion;
+  header.sourceSize = key.size;
+  header.sourceTime = key.time;
+  header.sourcePathHash = key.pathHash;
+  header.fps = motion.fps;
+  header.numFrames = nFrames;
+  header.numJoints = jointNum;
+  header.jointStride = motion.jointStride;
+
+  std::string content(sizeof(MotionCacheHeader), '\0');
+  header.skeletonOffset = content.size();
+  writeSkeleton(content, motion.skeleton);
+  padTo(content, cacheAlignment);
+  header.rotationsOffset = content.size();
+  writeArray(content, motion.PackedRotations(),
+             (size_t)nFrames * 4 * motion.jointStride);
+  padTo(content, cacheAlignment);
+  header.rootPositionsOffset = content.size();
+  writeArray(content, motion.PackedRootPositions(), nFrames);
+  padTo(content, cacheAlignment);
+  motion.EnsureRootTrack();
+  header.rootTrackOffset = content.size();
+  writeArray(content, motion.rootTrack.data(), nFrames);
+  header.fileSize = content.size();
+  std::memcpy(content.data(), &header, sizeof(header));
+
+  std::error_code ec;
+  if (!cacheDir.empty())
+    fs::create_directories(cacheDir, ec);
+  std::string cachePath = MotionCachePath(sourcePath, cacheDir);
+  std::string tempPath = cachePath + ".tmp";
+  {
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open())
+      return false;
+    output.write(content.data(), content.size());
+    if (!output.good()) {
+      output.close();
+      fs::remove(tempPath, ec);
+      return false;
+    }
+  }
+  fs::rename(tempPath, cachePath, ec);
+  if (ec) {
+    fs::remove(tempPath, ec);
+    return false;
+  }
+  return true;
+}
+
+bool LoadMotionCache(Motion &motion, const std::string &sourcePath,
+                     const std::string &cacheDir) {
+  MotionCacheKey key;
+  if (!getCacheKey(sourcePath, key))
+    return false;
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(MotionCachePath(sourcePath, cacheDir)) ||
+      file->Size() < sizeof(MotionCacheHeader))
+    return false;
+  MotionCacheHeader header;
+  std::memcpy(&header, file->Data(), sizeof(header));
+  if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+      header.version != cacheVersion || header.sourceSize != key.size ||
+      header.sourceTime != key.time || header.sourcePathHash != key.pathHash)
+    return false;
+
+  // validate the layout before pointing anything into the file
+  const uint64_t rotationBytes =
+      (uint64_t)header.numFrames * 4 * header.jointStride * sizeof(float);
+  const uint64_t rootBytes = (uint64_t)header.numFrames * sizeof(glm::vec3);
+  const uint64_t trackBytes = (uint64_t)header.numFrames * sizeof(RootSample);
+  if (header.fileSize != file->Size() || header.numFrames <= 0 ||
+      header.numJoints <= 0 ||
+      header.jointStride != Math::PadToSIMD(header.numJoints) ||
+      header.rotationsOffset % cacheAlignment != 0 ||
+      header.rootPositionsOffset % cacheAlignment != 0 ||
+      header.rootTrackOffset % cacheAlignment != 0 ||
+      header.skeletonOffset > header.rotationsOffset ||
+      header.rotationsOffset + rotationBytes > header.rootPositionsOffset ||
+      header.rootPositionsOffset + rootBytes > header.rootTrackOffset ||
+      header.rootTrackOffset + trackBytes > header.fileSize)
+    return false;
+
+  Skeleton skeleton;
+  MotionCacheReader reader{file->Data() + header.skeletonOffset,
+                           file->Data() + header.rotationsOffset};
+  if (!readSkeleton(reader, skeleton) ||
+      skeleton.GetNumJoints() != header.numJoints)
+    return false;
+
+  auto rotations =
+      reinterpret_cast<const float *>(file->Data() + header.rotationsOffset);
+  auto rootPositions = reinterpret_cast<const glm::vec3 *>(
+      file->Data() + header.rootPositionsOffset);
+  motion.fps = header.fps;
+  motion.skeleton = std::move(skeleton);
+  auto rootTrack = reinterpret_cast<const RootSample *>(
+      file->Data() + header.rootTrackOffset);
+  motion.SetPackedFramesView(header.numFrames, rotations, rootPositions,
+                             std::move(file));
+  // the track is small, keep a copy so it doesn't depend on the view
+  motion.rootTrack.assign(rootTrack, rootTrack + header.numFrames);
+  return true;
+}
+
+}; // namespace Animation
+
+}; // namespace aEngine
@@ -0,0 +1,41 @@
+/**
+ * Cooked binary motion clips (`.amot`) that load without parsing.
+ *
+ * A cache file holds the skeleton followed by the packed frames in the
+ * exact layout of `Motion::packedRotations` and `Motion::packedRootPositions`.
+ * The root track is stored after the frames and copied on load, it's a
+ * single sample per frame.
+ * Loading a cache maps the file and points the motion's packed frames into
+ * the mapping, frame data is neither parsed nor copied, the os pages it in
+ * when a frame is first sampled.
+ *
+ * A cache is keyed by the path, size and modification time of its source
+ * file, it's rejected and rewritten as soon as the source changes.
+ */
+#pragma once
+
+#include "Function/Animation/Motion.hpp"
+
+namespace aEngine {
+
+namespace Animation {
+
+// Path of the cache file of `sourcePath`, the cache is placed next to the
+// source when `cacheDir` is empty.
+std::string MotionCachePath(const std::string &sourcePath,
+                            const std::string &cacheDir = "");
+
+// Write `motion` as the cache of `sourcePath`, the file is written to a
+// temporary path first so that a partially written cache is never loaded.
+bool SaveMotionCache(Motion &motion, const std::string &sourcePath,
+                     const std::string &cacheDir = "");
+
+// Map the cache of `sourcePath` into `motion`, returns false if there's no
+// cache or it's outdated, `motion` is left unchanged in that case. The
+// motion's `poses` stays empty until `Motion::EnsurePoses` is called.
+bool LoadMotionCache(Motion &motion, const std::string &sourcePath,
+                     const std::string &cacheDir = "");
+
+}; // namespace Animation
+
+}; // namespace aEngine
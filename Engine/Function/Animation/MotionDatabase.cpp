@@ -0,0 +1,466 @@
+#include "Function/Animation/MotionDatabase.hpp"
+#include "Function/Animation/Kinematics.hpp"
+#include "Function/Animation/Motion.hpp"
+#include "Function/General/MappedFile.hpp"
+#include "Function/General/ThreadPool.hpp"
+
+#include "Global.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace aEngine {
+
+namespace Animation {
+
+namespace fs = std::filesystem;
+
+static const char databaseMagic[4] = {'A', 'M', 'D', 'B'};
+// bump this whenever the layout of the file changes
+static const uint32_t databaseVersion = 3;
+static const size_t databaseAlignment = 64;
+
+struct MotionDatabaseHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t numFrames, numJoints, numClips, featureDim, dataFPS;
+  float trajInterval;
+  uint64_t featureSignature;
+  // byte offsets from the start of the file, the ranges are stored as pairs
+  // of int32, the clip hashes as uint64 and the feature mean is followed by
+  // the deviation
+  uint64_t rangeOffset, clipHashesOffset, positionsOffset, rotationsOffset,
+      velocitiesOffset, angularVelocitiesOffset, facingOffset,
+      featureStatsOffset, featuresOffset, fileSize;
+};
+
+static uint64_t writeAligned(std::string &out, const void *data,
+                             size_t bytes) {
+  out.resize((out.size() + databaseAlignment - 1) / databaseAlignment *
+                 databaseAlignment,
+             '\0');
+  uint64_t offset = out.size();
+  out.append(static_cast<const char *>(data), bytes);
+  return offset;
+}
+
+void MotionDatabase::Clear() {
+  mapping.reset();
+  owned = Storage();
+  range.clear();
+  clipHashes.clear();
+  featureMean.clear();
+  featureStd.clear();
+  numFrames = numJoints = featureDim = 0;
+  featureSignature = 0;
+  bindOwned();
+}
+
+void MotionDatabase::bindOwned() {
+  positions = owned.positions.data();
+  rotations = owned.rotations.data();
+  velocities = owned.velocities.data();
+  angularVelocities = owned.angularVelocities.data();
+  facing = owned.facing.data();
+  features = owned.features.empty() ? nullptr : owned.features.data();
+}
+
+void MotionDatabase::detach() {
+  if (!mapping)
+    return;
+  size_t n = (size_t)numFrames * numJoints;
+  owned.positions.assign(positions, positions + n);
+  owned.rotations.assign(rotations, rotations + n);
+  owned.velocities.assign(velocities, velocities + n);
+  owned.angularVelocities.assign(angularVelocities, angularVelocities + n);
+  owned.facing.assign(facing, facing + numFrames);
+  owned.features.assign(features, features + (size_t)numFrames * featureDim);
+  mapping.reset();
+  bindOwned();
+}
+
+void MotionDatabase::AddClip(int clipFrames, int clipJoints,
+                             const glm::vec3 *clipPositions,
+                             const glm::quat *clipRotations,
+                             const glm::vec3 *clipFacing, int fps,
+                             uint64_t hash) {
+  if (numFrames > 0 && clipJoints != numJoints) {
+    LOG_F(ERROR, "clip with %d joints added to a database of %d joints",
+          clipJoints, numJoints);
+    return;
+  }
+  detach();
+  size_t n = (size_t)clipFrames * clipJoints;
+  owned.positions.insert(owned.positions.end(), clipPositions,
+                         clipPositions + n);
+  owned.rotations.insert(owned.rotations.end(), clipRotations,
+                         clipRotations + n);
+  owned.facing.insert(owned.facing.end(), clipFacing, clipFacing + clipFrames);
+  owned.velocities.resize(owned.positions.size(), glm::vec3(0.0f));
+  owned.angularVelocities.resize(owned.positions.size(), glm::vec3(0.0f));
+  size_t clipStart = (size_t)numFrames * clipJoints;
+  for (int f = 1; f < clipFrames; ++f) {
+    for (int j = 0; j < clipJoints; ++j) {
+      size_t cur = clipStart + (size_t)f * clipJoints + j,
+             last = cur - clipJoints;
+      owned.velocities[cur] =
+          (owned.positions[cur] - owned.positions[last]) * (float)fps;
+      auto delta =
+          owned.rotations[cur] * glm::inverse(owned.rotations[last]);
+      owned.angularVelocities[cur] =
+          2.0f * fps * glm::vec3(delta.x, delta.y, delta.z);
+    }
+  }
+  range.push_back(std::make_pair(numFrames, numFrames + clipFrames));
+  clipHashes.push_back(hash);
+  numFrames += clipFrames;
+  numJoints = clipJoints;
+  dataFPS = fps;
+  // the features no longer match the frames
+  owned.features.clear();
+  bindOwned();
+}
+
+void MotionDatabase::AddClip(const MotionDatabase &source, int clip) {
+  int begin = source.range[clip].first, end = source.range[clip].second;
+  AddClip(end - begin, source.numJoints, source.Positions(begin),
+          source.Rotations(begin), source.facing + begin, source.dataFPS,
+          source.clipHashes[clip]);
+}
+
+uint64_t MotionDatabase::HashFile(const std::string &path) {
+  MappedFile file;
+  if (!file.Open(path))
+    return 0;
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < file.Size(); ++i) {
+    hash ^= (unsigned char)file.Data()[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+int MotionDatabase::Build(const std::vector<std::string> &files,
+                          const FeatureExtractor &extractor) {
+  auto &pool = ThreadPool::Ref();
+  std::vector<uint64_t> hashes(files.size());
+  pool.ParallelFor(0, files.size(), 1, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i)
+      hashes[i] = HashFile(files[i]);
+  });
+  std::unordered_map<uint64_t, int> clipOfHash;
+  for (int clip = 0; clip < clipHashes.size(); ++clip)
+    if (clipHashes[clip] != 0)
+      clipOfHash[clipHashes[clip]] = clip;
+  // the clip reused for each file, -1 if the file has to be loaded
+  std::vector<int> reused(files.size(), -1);
+  std::vector<int> toLoad;
+  for (int i = 0; i < files.size(); ++i) {
+    auto it = clipOfHash.find(hashes[i]);
+    if (hashes[i] != 0 && it != clipOfHash.end())
+      reused[i] = it->second;
+    else
+      toLoad.push_back(i);
+  }
+
+  struct LoadedClip {
+    bool valid = false;
+    int numFrames = 0, numJoints = 0, fps = 0;
+    std::vector<glm::vec3> positions, facing;
+    std::vector<glm::quat> rotations;
+  };
+  std::vector<LoadedClip> loaded(files.size());
+  pool.ParallelFor(0, toLoad.size(), 1, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      int fileInd = toLoad[i];
+      Motion motion;
+      try {
+        if (!motion.LoadFromBVH(files[fileInd]))
+          continue;
+      } catch (std::exception &e) {
+        LOG_F(ERROR, "failed to load %s: %s", files[fileInd].c_str(),
+              e.what());
+        continue;
+      }
+      motion.EnsureRootTrack();
+      auto &clip = loaded[fileInd];
+      ForwardKinematics(motion.skeleton, motion.poses, clip.positions,
+                        clip.rotations);
+      clip.facing.resize(motion.rootTrack.size());
+      for (int f = 0; f < clip.facing.size(); ++f)
+        clip.facing[f] = motion.rootTrack[f].facing;
+      clip.numFrames = motion.poses.size();
+      clip.numJoints = motion.skeleton.GetNumJoints();
+      clip.fps = motion.fps;
+      clip.valid = clip.numFrames > 0;
+    }
+  });
+
+  MotionDatabase next;
+  next.trajInterval = trajInterval;
+  for (int i = 0; i < files.size(); ++i) {
+    if (reused[i] != -1) {
+      next.AddClip(*this, reused[i]);
+      continue;
+    }
+    auto &clip = loaded[i];
+    if (!clip.valid)
+      continue;
+    next.AddClip(clip.numFrames, clip.numJoints, clip.positions.data(),
+                 clip.rotations.data(), clip.facing.data(), clip.fps,
+                 hashes[i]);
+    // release the frames as soon as they are copied
+    clip = LoadedClip();
+  }
+  next.ComputeFeatures(extractor);
+  *this = std::move(next);
+  return toLoad.size();
+}
+
+// Mean and sum of squared deviations of the features of some frames.
+struct FeatureMoments {
+  double count = 0.0;
+  std::vector<double> mean, m2;
+
+  FeatureMoments(int dim = 0) : mean(dim, 0.0), m2(dim, 0.0) {}
+  // Welford's update with one more row.
+  void Add(const float *row) {
+    count += 1.0;
+    for (int k = 0; k < mean.size(); ++k) {
+      double delta = row[k] - mean[k];
+      mean[k] += delta / count;
+      m2[k] += delta * (row[k] - mean[k]);
+    }
+  }
+  // Merge the moments of disjoint sets of rows, Chan et al.
+  void Add(const FeatureMoments &other) {
+    double total = count + other.count;
+    if (other.count == 0.0)
+      return;
+    for (int k = 0; k < mean.size(); ++k) {
+      double delta = other.mean[k] - mean[k];
+      mean[k] += delta * other.count / total;
+      m2[k] += other.m2[k] + delta * delta * count * other.count / total;
+    }
+    count = total;
+  }
+};
+
+// Features of the frames of a clip before normalization, written to
+// `rows` and accumulated to `moments`.
+static void computeClipFeatures(const MotionDatabase &db, int clip,
+                                int interval,
+                                const FeatureExtractor &extractor,
+                                float *rows, FeatureMoments &moments) {
+  int start = db.range[clip].first;
+  int end = db.range[clip].second;
+  int root = extractor.root;
+  std::vector<glm::vec2> trajectory(extractor.trajectorySamples),
+      facing(extractor.trajectorySamples);
+  FeatureFrame frame;
+  frame.trajectory = trajectory.data();
+  frame.facing = facing.data();
+  for (int f = start; f < end; ++f) {
+    frame.positions = db.Positions(f);
+    frame.velocities = db.Velocities(f);
+    // sample trajectories
+    auto rootPosProj =
+        glm::vec2(frame.positions[root].x, frame.positions[root].z);
+    for (int i = 1; i <= extractor.trajectorySamples; ++i) {
+      int sampleF = std::min(end - 1, f + i * interval);
+      glm::vec3 sampleRoot = db.Positions(sampleF)[root];
+      trajectory[i - 1] = glm::vec2(sampleRoot.x, sampleRoot.z) - rootPosProj;
+      glm::vec3 sampleFacingDir = db.FacingDir(sampleF);
+      facing[i - 1] = glm::vec2(sampleFacingDir.x, sampleFacingDir.z);
+    }
+    float *row = rows + (size_t)f * extractor.dim;
+    extractor.pack(frame, row);
+    moments.Add(row);
+  }
+}
+
+void MotionDatabase::ComputeFeatures(const FeatureExtractor &extractor) {
+  detach();
+  featureDim = extractor.dim;
+  featureSignature = extractor.signature;
+  featureMean.assign(featureDim, 0.0f);
+  featureStd.assign(featureDim, 1.0f);
+  owned.features.clear();
+  if (numFrames == 0) {
+    bindOwned();
+    return;
+  }
+  int interval = trajInterval * dataFPS;
+  owned.features.resize((size_t)numFrames * featureDim);
+  auto &pool = ThreadPool::Ref();
+  std::vector<FeatureMoments> clipMoments(range.size(),
+                                          FeatureMoments(featureDim));
+  pool.ParallelFor(0, range.size(), 1, [&](int clipBegin, int clipEnd) {
+    for (int animInd = clipBegin; animInd < clipEnd; ++animInd)
+      computeClipFeatures(*this, animInd, interval, extractor,
+                          owned.features.data(), clipMoments[animInd]);
+  });
+  // merged in clip order, the result doesn't depend on the scheduling
+  FeatureMoments moments(featureDim);
+  for (auto &clip : clipMoments)
+    moments.Add(clip);
+  for (int k = 0; k < featureDim; ++k) {
+    featureMean[k] = moments.mean[k];
+    featureStd[k] = std::sqrt(moments.m2[k] / std::max(moments.count, 1.0));
+    // a constant dimension is only centered
+    if (featureStd[k] == 0.0f)
+      featureStd[k] = 1.0f;
+  }
+  float *rows = owned.features.data();
+  pool.ParallelFor(0, numFrames, 4096, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      float *row = rows + (size_t)i * featureDim;
+      for (int k = 0; k < featureDim; ++k)
+        row[k] = (row[k] - featureMean[k]) / featureStd[k];
+    }
+  });
+  bindOwned();
+}
+
+bool MotionDatabase::Save(const std::string &path) const {
+  if (numFrames == 0 || features == nullptr)
+    return false;
+  MotionDatabaseHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, databaseMagic, sizeof(databaseMagic));
+  header.version = databaseVersion;
+  header.numFrames = numFrames;
+  header.numJoints = numJoints;
+  header.numClips = range.size();
+  header.featureDim = featureDim;
+  header.dataFPS = dataFPS;
+  header.trajInterval = trajInterval;
+  header.featureSignature = featureSignature;
+
+  std::vector<int32_t> ranges;
+  for (auto &clip : range)
+    ranges.insert(ranges.end(), {clip.first, clip.second});
+  size_t n = (size_t)numFrames * numJoints;
+  std::string content(sizeof(MotionDatabaseHeader), '\0');
+  header.rangeOffset =
+      writeAligned(content, ranges.data(), sizeof(int32_t) * ranges.size());
+  header.clipHashesOffset = writeAligned(content, clipHashes.data(),
+                                         sizeof(uint64_t) * clipHashes.size());
+  header.positionsOffset =
+      writeAligned(content, positions, sizeof(glm::vec3) * n);
+  header.rotationsOffset =
+      writeAligned(content, rotations, sizeof(glm::quat) * n);
+  header.velocitiesOffset =
+      writeAligned(content, velocities, sizeof(glm::vec3) * n);
+  header.angularVelocitiesOffset =
+      writeAligned(content, angularVelocities, sizeof(glm::vec3) * n);
+  header.facingOffset =
+      writeAligned(content, facing, sizeof(glm::vec3) * numFrames);
+  std::vector<float> stats(featureMean);
+  stats.insert(stats.end(), featureStd.begin(), featureStd.end());
+  header.featureStatsOffset =
+      writeAligned(content, stats.data(), sizeof(float) * stats.size());
+  header.featuresOffset = writeAligned(
+      content, features, sizeof(float) * featureDim * numFrames);
+  header.fileSize = content.size();
+  std::memcpy(content.data(), &header, sizeof(header));
+
+  std::error_code ec;
+  std::string tempPath = path + ".tmp";
+  {
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open())
+      return false;
+    output.write(content.data(), content.size());
+    if (!output.good()) {
+      output.close();
+      fs::remove(tempPath, ec);
+      return false;
+    }
+  }
+  fs::rename(tempPath, path, ec);
+  if (ec) {
+    fs::remove(tempPath, ec);
+    return false;
+  }
+  return true;
+}
+
+bool MotionDatabase::Load(const std::string &path) {
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(path) || file->Size() < sizeof(MotionDatabaseHeader))
+    return false;
+  MotionDatabaseHeader header;
+  std::memcpy(&header, file->Data(), sizeof(header));
+  if (std::memcmp(header.magic, databaseMagic, sizeof(databaseMagic)) != 0 ||
+      header.version != databaseVersion || header.featureDim <= 0 ||
+      header.fileSize != file->Size() || header.numFrames <= 0 ||
+      header.numJoints <= 0 || header.numClips < 0)
+    return false;
+
+  // validate the layout before pointing anything into the file
+  const uint64_t n = (uint64_t)header.numFrames * header.numJoints;
+  auto fits = [&](uint64_t offset, uint64_t bytes) {
+    return offset % databaseAlignment == 0 && offset <= header.fileSize &&
+           bytes <= header.fileSize - offset;
+  };
+  if (!fits(header.rangeOffset, sizeof(int32_t) * 2 * header.numClips) ||
+      !fits(header.clipHashesOffset, sizeof(uint64_t) * header.numClips) ||
+      !fits(header.positionsOffset, sizeof(glm::vec3) * n) ||
+      !fits(header.rotationsOffset, sizeof(glm::quat) * n) ||
+      !fits(header.velocitiesOffset, sizeof(glm::vec3) * n) ||
+      !fits(header.angularVelocitiesOffset, sizeof(glm::vec3) * n) ||
+      !fits(header.facingOffset, sizeof(glm::vec3) * header.numFrames) ||
+      !fits(header.featureStatsOffset,
+            sizeof(float) * 2 * header.featureDim) ||
+      !fits(header.featuresOffset,
+            sizeof(float) * header.featureDim * header.numFrames))
+    return false;
+  std::vector<std::pair<int, int>> ranges(header.numClips);
+  const char *rangeData = file->Data() + header.rangeOffset;
+  for (int i = 0; i < header.numClips; ++i) {
+    int32_t clip[2];
+    std::memcpy(clip, rangeData + sizeof(clip) * i, sizeof(clip));
+    if (clip[0] < 0 || clip[0] > clip[1] || clip[1] > header.numFrames)
+      return false;
+    ranges[i] = {clip[0], clip[1]};
+  }
+
+  const char *base = file->Data();
+  owned = Storage();
+  range = std::move(ranges);
+  clipHashes.resize(header.numClips);
+  std::memcpy(clipHashes.data(), base + header.clipHashesOffset,
+              sizeof(uint64_t) * header.numClips);
+  numFrames = header.numFrames;
+  numJoints = header.numJoints;
+  dataFPS = header.dataFPS;
+  trajInterval = header.trajInterval;
+  featureDim = header.featureDim;
+  featureSignature = header.featureSignature;
+  const float *stats =
+      reinterpret_cast<const float *>(base + header.featureStatsOffset);
+  featureMean.assign(stats, stats + featureDim);
+  featureStd.assign(stats + featureDim, stats + 2 * featureDim);
+  positions =
+      reinterpret_cast<const glm::vec3 *>(base + header.positionsOffset);
+  rotations =
+      reinterpret_cast<const glm::quat *>(base + header.rotationsOffset);
+  velocities =
+      reinterpret_cast<const glm::vec3 *>(base + header.velocitiesOffset);
+  angularVelocities = reinterpret_cast<const glm::vec3 *>(
+      base + header.angularVelocitiesOffset);
+  facing = reinterpret_cast<const glm::vec3 *>(base + header.facingOffset);
+  features = reinterpret_cast<const float *>(base + header.featuresOffset);
+  mapping = std::move(file);
+  return true;
+}
+
+}; // namespace Animation
+
+}; // namespace aEngine
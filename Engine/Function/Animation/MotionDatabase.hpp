@@ -0,0 +1,139 @@
+/**
+ * Frames and features of the clips searched by motion matching.
+ *
+ * All the per joint data is stored in flat frames x joints arrays, joint `j`
+ * of frame `f` is at `f * NumJoints() + j`, and the features are
+ * `NumFrames()` rows of `FeatureDim()` floats laid out by a `FeatureSchema`.
+ * A database built from clips owns these arrays, a database loaded with
+ * `Load` maps the file and points into the mapping instead, so loading costs
+ * one `mmap` no matter how many frames the file holds. The file is written
+ * in native byte order with a versioned header, every array starts at a 64
+ * bytes boundary.
+ *
+ * Every clip remembers the content hash of its source file, `Build` only
+ * loads the files that are not in the database yet and copies the frames
+ * of the others.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Function/Animation/FeatureSchema.hpp"
+
+namespace aEngine {
+
+namespace Animation {
+
+class MotionDatabase {
+public:
+  MotionDatabase() {}
+  // the arrays point into the storage of the database
+  MotionDatabase(const MotionDatabase &) = delete;
+  MotionDatabase &operator=(const MotionDatabase &) = delete;
+  MotionDatabase(MotionDatabase &&) = default;
+  MotionDatabase &operator=(MotionDatabase &&) = default;
+
+  // Rebuild the database from bvh files, one clip per file in the given
+  // order, and compute the features, e.g. with
+  // `PFNNFeatures::Extractor()`. Clips of the current database with the
+  // same content hash are reused, the other files are loaded and processed
+  // in parallel on the thread pool. Files that fail to load are skipped.
+  // Returns the number of files loaded.
+  int Build(const std::vector<std::string> &files,
+            const FeatureExtractor &extractor);
+  // 64 bits FNV-1a hash of the content of a file, 0 if it can't be read.
+  static uint64_t HashFile(const std::string &path);
+
+  // Remove all the clips and features.
+  void Clear();
+  // Append a clip of `numFrames` frames of `numJoints` global positions and
+  // rotations each, `facing` holds one direction per frame. All the clips
+  // must have the same number of joints. Velocities are computed from the
+  // previous frame, the first frame of a clip has zero velocities.
+  void AddClip(int numFrames, int numJoints, const glm::vec3 *positions,
+               const glm::quat *rotations, const glm::vec3 *facing, int fps,
+               uint64_t hash = 0);
+  // Append clip `clip` of another database.
+  void AddClip(const MotionDatabase &source, int clip);
+  // Compute and normalize the features of all the frames with a schema, a
+  // mapped database is copied first. Clips are processed in parallel and
+  // the mean and deviation are reduced per clip. The trajectory of a frame
+  // is sampled every `trajInterval` seconds after it, clamped to its clip.
+  void ComputeFeatures(const FeatureExtractor &extractor);
+
+  // Write the database to `path` through a temporary file.
+  bool Save(const std::string &path) const;
+  // Map the database stored at `path`, returns false and leaves the
+  // database unchanged if the file is missing, from an older version or
+  // truncated.
+  bool Load(const std::string &path);
+  bool IsMapped() const { return mapping != nullptr; }
+
+  int NumFrames() const { return numFrames; }
+  int NumJoints() const { return numJoints; }
+  int FeatureDim() const { return featureDim; }
+  // `FeatureSchema::Signature` of the schema of the features
+  uint64_t FeatureSignature() const { return featureSignature; }
+
+  const glm::vec3 *Positions(int frame) const {
+    return positions + (size_t)frame * numJoints;
+  }
+  const glm::quat *Rotations(int frame) const {
+    return rotations + (size_t)frame * numJoints;
+  }
+  const glm::vec3 *Velocities(int frame) const {
+    return velocities + (size_t)frame * numJoints;
+  }
+  const glm::vec3 *AngularVelocities(int frame) const {
+    return angularVelocities + (size_t)frame * numJoints;
+  }
+  glm::vec3 FacingDir(int frame) const { return facing[frame]; }
+  // `NumFrames()` rows of `FeatureDim()` normalized features
+  const float *Features() const { return features; }
+  const float *Feature(int frame) const {
+    return features + (size_t)frame * featureDim;
+  }
+
+  // nanim * 2 (begin, end)
+  std::vector<std::pair<int, int>> range;
+  // content hash of the source file of each clip, 0 if unknown
+  std::vector<uint64_t> clipHashes;
+  // `FeatureDim()` floats each, the features are normalized with them
+  std::vector<float> featureMean, featureStd;
+  int dataFPS = 60;
+  float trajInterval = 0.2f;
+
+private:
+  int numFrames = 0, numJoints = 0, featureDim = 0;
+  uint64_t featureSignature = 0;
+  const glm::vec3 *positions = nullptr, *velocities = nullptr,
+                  *angularVelocities = nullptr, *facing = nullptr;
+  const glm::quat *rotations = nullptr;
+  const float *features = nullptr;
+
+  // arrays of a database built from clips
+  struct Storage {
+    std::vector<glm::vec3> positions, velocities, angularVelocities, facing;
+    std::vector<glm::quat> rotations;
+    std::vector<float> features;
+  } owned;
+  // the mapped file of a loaded database, `owned` is empty while it's set
+  std::shared_ptr<const void> mapping;
+
+  // Copy a mapped database into `owned` before modifying it.
+  void detach();
+  // Point the arrays into `owned`.
+  void bindOwned();
+};
+
+}; // namespace Animation
+
+}; // namespace aEngine
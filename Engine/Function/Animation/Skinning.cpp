@@ -0,0 +1,177 @@
+#include "Function/Animation/Skinning.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/General/Utils.hpp"
+#include "Function/Math/SIMD.hpp"
+
+#include <cstring>
+
+namespace aEngine {
+
+using Math::FloatN;
+
+// vertices per chunk of the parallel loop, a multiple of `SIMD_PADDING`
+static const int skinningGrain = 1024;
+
+size_t SparseBlendShapes::MemoryBytes() const {
+  return shapeStart.size() * sizeof(int) + vertexIndices.size() * sizeof(int) +
+         positionDeltas.size() * sizeof(glm::vec4);
+}
+
+void SparseBlendShapes::Clear(int vertexNum) {
+  numVertices = vertexNum;
+  shapeStart.assign(1, 0);
+  vertexIndices.clear();
+  positionDeltas.clear();
+}
+
+void SparseBlendShapes::AddShape(const BlendShape &shape, float threshold) {
+  int vertexNum = std::min<int>(numVertices, shape.data.size());
+  float threshold2 = threshold * threshold;
+  for (int i = 0; i < vertexNum; ++i) {
+    auto &offset = shape.data[i].BlendShapeOffset;
+    if (offset == glm::vec3(0.0f) || glm::dot(offset, offset) <= threshold2)
+      continue;
+    vertexIndices.push_back(i);
+    positionDeltas.push_back(glm::vec4(offset, 0.0f));
+  }
+  shapeStart.push_back(vertexIndices.size());
+}
+
+void SparseBlendShapes::Build(const std::vector<BlendShape> &shapes,
+                              int vertexNum, float threshold) {
+  Clear(vertexNum);
+  for (auto &shape : shapes)
+    AddShape(shape, threshold);
+}
+
+void SkinnedMeshCPU::Build(const std::vector<Vertex> &vertices) {
+  numVertices = vertices.size();
+  vertexStride = Math::PadToSIMD(numVertices);
+  positions.assign(4 * vertexStride, 0.0f);
+  normals.assign(4 * vertexStride, 0.0f);
+  paletteOffsets.assign(MAX_BONES * vertexStride, 0);
+  boneWeights.assign(MAX_BONES * vertexStride, 0.0f);
+  numPaletteBones = 1;
+  for (int i = 0; i < numVertices; ++i) {
+    auto &vertex = vertices[i];
+    for (int c = 0; c < 4; ++c) {
+      positions[c * vertexStride + i] = vertex.Position[c];
+      normals[c * vertexStride + i] = vertex.Normal[c];
+    }
+    for (int b = 0; b < MAX_BONES; ++b) {
+      // the shaders skip these, a zero weight on bone 0 adds nothing
+      if (vertex.BoneWeight[b] <= 0.0f || vertex.BoneId[b] < 0)
+        continue;
+      paletteOffsets[b * vertexStride + i] = vertex.BoneId[b] * 16;
+      boneWeights[b * vertexStride + i] = vertex.BoneWeight[b];
+      numPaletteBones = std::max(numPaletteBones, vertex.BoneId[b] + 1);
+    }
+  }
+  blendedPositions = positions;
+  Output = vertices;
+}
+
+void SkinnedMeshCPU::Deform(const std::vector<BoneMatrixBlock> &transforms) {
+  Timer timer;
+  skin(transforms, positions.data());
+  DeformTime = timer.ElapsedMilliseconds();
+}
+
+void SkinnedMeshCPU::Deform(const std::vector<BoneMatrixBlock> &transforms,
+                            const SparseBlendShapes &blendShapes,
+                            const std::vector<float> &weights) {
+  Timer timer;
+  int numShapes = std::min<int>(blendShapes.NumShapes(), weights.size());
+  if (blendShapes.numVertices != numVertices)
+    numShapes = 0;
+  float *x = blendedPositions.data(), *y = x + vertexStride,
+        *z = y + vertexStride;
+  // same order of additions as the shader
+  for (int s = 0; s < numShapes; ++s) {
+    if (weights[s] == 0.0f)
+      continue;
+    for (int k = blendShapes.shapeStart[s]; k < blendShapes.shapeStart[s + 1];
+         ++k) {
+      int v = blendShapes.vertexIndices[k];
+      auto &delta = blendShapes.positionDeltas[k];
+      x[v] += weights[s] * delta.x;
+      y[v] += weights[s] * delta.y;
+      z[v] += weights[s] * delta.z;
+    }
+  }
+  skin(transforms, blendedPositions.data());
+  for (int s = 0; s < numShapes; ++s) {
+    if (weights[s] == 0.0f)
+      continue;
+    for (int k = blendShapes.shapeStart[s]; k < blendShapes.shapeStart[s + 1];
+         ++k) {
+      int v = blendShapes.vertexIndices[k];
+      for (int c = 0; c < 3; ++c)
+        blendedPositions[c * vertexStride + v] =
+            positions[c * vertexStride + v];
+    }
+  }
+  DeformTime = timer.ElapsedMilliseconds();
+}
+
+// bones referenced by the mesh but missing in `transforms` stay zero
+void SkinnedMeshCPU::skin(const std::vector<BoneMatrixBlock> &transforms,
+                          const float *sourcePositions) {
+  palette.assign(
+      16 * std::max<size_t>(numPaletteBones, transforms.size()), 0.0f);
+  for (int b = 0; b < transforms.size(); ++b) {
+    glm::mat4 boneMatrix =
+        transforms[b].BoneModelMatrix * transforms[b].BoneOffsetMatrix;
+    std::memcpy(palette.data() + 16 * b, glm::value_ptr(boneMatrix),
+                16 * sizeof(float));
+  }
+
+  auto skinRange = [&](int begin, int end) {
+    alignas(32) float lanes[8][FloatN::Width];
+    for (int i = begin; i < end; i += FloatN::Width) {
+      FloatN p[4], n[4], skinnedP[4], skinnedN[4];
+      for (int c = 0; c < 4; ++c) {
+        p[c] = FloatN::Load(sourcePositions + c * vertexStride + i);
+        n[c] = FloatN::Load(normals.data() + c * vertexStride + i);
+        skinnedP[c] = skinnedN[c] = FloatN(0.0f);
+      }
+      for (int b = 0; b < MAX_BONES; ++b) {
+        const int *offsets = paletteOffsets.data() + b * vertexStride + i;
+        FloatN weight =
+            FloatN::Load(boneWeights.data() + b * vertexStride + i);
+        for (int row = 0; row < 4; ++row) {
+          FloatN m0 = Math::Gather(palette.data() + row, offsets);
+          FloatN m1 = Math::Gather(palette.data() + 4 + row, offsets);
+          FloatN m2 = Math::Gather(palette.data() + 8 + row, offsets);
+          FloatN m3 = Math::Gather(palette.data() + 12 + row, offsets);
+          skinnedP[row] =
+              skinnedP[row] +
+              (m0 * p[0] + m1 * p[1] + m2 * p[2] + m3 * p[3]) * weight;
+          skinnedN[row] =
+              skinnedN[row] +
+              (m0 * n[0] + m1 * n[1] + m2 * n[2] + m3 * n[3]) * weight;
+        }
+      }
+      FloatN invLength =
+          FloatN(1.0f) / Math::Sqrt(skinnedN[0] * skinnedN[0] +
+                                    skinnedN[1] * skinnedN[1] +
+                                    skinnedN[2] * skinnedN[2] +
+                                    skinnedN[3] * skinnedN[3]);
+      for (int c = 0; c < 4; ++c) {
+        skinnedP[c].Store(lanes[c]);
+        (skinnedN[c] * invLength).Store(lanes[4 + c]);
+      }
+      int laneNum = std::min(FloatN::Width, numVertices - i);
+      for (int lane = 0; lane < laneNum; ++lane) {
+        auto &vertex = Output[i + lane];
+        vertex.Position = glm::vec4(lanes[0][lane], lanes[1][lane],
+                                    lanes[2][lane], lanes[3][lane]);
+        vertex.Normal = glm::vec4(lanes[4][lane], lanes[5][lane],
+                                  lanes[6][lane], lanes[7][lane]);
+      }
+    }
+  };
+  ThreadPool::Ref().ParallelFor(0, vertexStride, skinningGrain, skinRange);
+}
+
+}; // namespace aEngine
@@ -0,0 +1,82 @@
+/**
+ * Linear blend skinning on the cpu, producing the same vertices as the
+ * compute shaders in `Deform.cpp` without a gl context, so that skinned
+ * positions are available for collision, picking or baking.
+ *
+ * The bone palette (`BoneModelMatrix * BoneOffsetMatrix`) is computed once
+ * per call, the vertices are kept as structure of arrays and skinned
+ * `Math::FloatN::Width` at a time, in parallel over vertex ranges on the
+ * thread pool.
+ *
+ * Blend shapes are stored sparse, see `SparseBlendShapes`, and only the
+ * vertices moved by shapes with a non-zero weight are visited.
+ */
+#pragma once
+
+#include "Function/AssetsType.hpp"
+
+namespace aEngine {
+
+// Blend shapes as compressed sparse rows, one row per shape holding the
+// vertices it moves and their position deltas. Facial shapes usually move
+// a small part of the mesh, so this is a fraction of a dense table. Only
+// the positions are blended, the same as the shaders do.
+struct SparseBlendShapes {
+  int numVertices = 0;
+  // the deltas of shape `s` are in [shapeStart[s], shapeStart[s + 1])
+  std::vector<int> shapeStart = {0};
+  std::vector<int> vertexIndices;
+  // w is unused, vec4 matches the std430 layout on the gpu
+  std::vector<glm::vec4> positionDeltas;
+
+  int NumShapes() const { return shapeStart.size() - 1; }
+  size_t MemoryBytes() const;
+
+  void Clear(int vertexNum);
+  // Append a row with the vertices whose offset is longer than `threshold`.
+  void AddShape(const BlendShape &shape, float threshold = 0.0f);
+  void Build(const std::vector<BlendShape> &shapes, int vertexNum,
+             float threshold = 0.0f);
+};
+
+class SkinnedMeshCPU {
+public:
+  // Split `vertices` into streams, call this again whenever the mesh
+  // changes. Bone weights that are not positive are ignored, the same as
+  // the shaders do.
+  void Build(const std::vector<Vertex> &vertices);
+
+  // Skin the vertices with `transforms` into `Output`.
+  void Deform(const std::vector<BoneMatrixBlock> &transforms);
+  // Add the blend shapes with `weights` to the positions before skinning,
+  // the shapes with zero weight are skipped.
+  void Deform(const std::vector<BoneMatrixBlock> &transforms,
+              const SparseBlendShapes &blendShapes,
+              const std::vector<float> &weights);
+
+  int NumVertices() const { return numVertices; }
+
+  // Same layout as the output of the compute shaders, only the positions
+  // and normals change after `Build`, so this can be uploaded as is.
+  std::vector<Vertex> Output;
+  // wall time of the last `Deform` in milliseconds
+  float DeformTime = 0.0f;
+
+private:
+  int numVertices = 0, vertexStride = 0, numPaletteBones = 0;
+  // x y z w planes of `vertexStride` floats each
+  std::vector<float> positions, normals;
+  // `positions` with the blend shapes added, only the vertices moved by the
+  // shapes differ and they're restored after skinning
+  std::vector<float> blendedPositions;
+  // `MAX_BONES` planes, the bone ids are stored as offsets into `palette`
+  std::vector<int> paletteOffsets;
+  std::vector<float> boneWeights;
+  // 16 floats per bone, column major like glm
+  std::vector<float> palette;
+
+  void skin(const std::vector<BoneMatrixBlock> &transforms,
+            const float *sourcePositions);
+};
+
+}; // namespace aEngine
@@ -3,6 +3,7 @@
 #include "Component/MeshRenderer.hpp"
 #include "Component/NativeScript.hpp"
 
+#include "Function/Animation/MotionCache.hpp"
 #include "Function/AssetsLoader.hpp"
 #include "Function/Math/Math.hpp"
 #include "Function/Render/Mesh.hpp"
@@ -142,9 +143,11 @@ std::vector<std::string> AssetsLoader::GetIndetifiersForAllCachedMaterials() {
 
 std::vector<std::string> AssetsLoader::GetIdentifiersForAllCachedShaders() {
   std::vector<std::string> result;
-  for (auto s : allShaders) {
+  for (auto &s : allShaders) {
     result.push_back(s.first);
   }
+  // the cache is unordered, sort the identifiers for display
+  std::sort(result.begin(), result.end());
   return result;
 }
 std::shared_ptr<Render::Shader>
@@ -171,6 +174,8 @@ AssetsLoader::GetShader(std::string vsp, std::string fsp, std::string gsp) {
     LOG_F(INFO,
           "load shader from path, identifier as %s vsp=%s, fsp=%s, gsp=%s",
           newShader->identifier.c_str(), vsp.c_str(), fsp.c_str(), gsp.c_str());
+    GWORLD.Events.Publish(
+        AssetLoadedEvent{AssetType::Shader, newShader->identifier});
     return newShader;
   } else
     return GetShader(":error");
@@ -194,12 +199,20 @@ Animation::Motion *AssetsLoader::GetMotion(std::string motionPath) {
     Animation::Motion *motion = new Animation::Motion();
     std::string extension = fs::path(motionPath).extension().string();
     if (extension == ".bvh") {
-      LOG_F(INFO, "load motion data from %s", motionPath.c_str());
-      motion->LoadFromBVH(motionPath);
+      if (Animation::LoadMotionCache(*motion, motionPath, MotionCacheDir)) {
+        LOG_F(INFO, "load cooked motion data of %s", motionPath.c_str());
+      } else {
+        LOG_F(INFO, "load motion data from %s", motionPath.c_str());
+        if (motion->LoadFromBVH(motionPath) &&
+            !Animation::SaveMotionCache(*motion, motionPath, MotionCacheDir))
+          LOG_F(WARNING, "failed to write motion cache of %s",
+                motionPath.c_str());
+      }
       motion->path = motionPath;
       motion->skeleton.path = motionPath;
       allMotions.insert(std::make_pair(motionPath, motion));
       allSkeletons.insert(std::make_pair(motionPath, &motion->skeleton));
+      GWORLD.Events.Publish(AssetLoadedEvent{AssetType::Motion, motionPath});
       return motion;
     } else if (extension == ".fbx") {
       LOG_F(INFO, "load motion data from %s", motionPath.c_str());
@@ -209,8 +222,8 @@ Animation::Motion *AssetsLoader::GetMotion(std::string motionPath) {
       auto it = allMotions.find(motionPath);
       if (it == allMotions.end())
         return nullptr;
-      else
-        return it->second;
+      GWORLD.Events.Publish(AssetLoadedEvent{AssetType::Motion, motionPath});
+      return it->second;
     } else {
       LOG_F(ERROR, "GetMotion only loads bvh and fbx motion");
       return nullptr;
@@ -233,6 +246,7 @@ Texture *AssetsLoader::GetTexture(string texturePath, bool flipVertically) {
       newTexture->id = id;
       newTexture->path = texturePath;
       allTextures[texturePath] = newTexture;
+      GWORLD.Events.Publish(AssetLoadedEvent{AssetType::Texture, texturePath});
       return newTexture;
     }
   } else {
@@ -253,6 +267,7 @@ Texture *AssetsLoader::GetHDRTexture(std::string texturePath,
       newTexture->id = id;
       newTexture->path = texturePath;
       allTextures[texturePath] = newTexture;
+      GWORLD.Events.Publish(AssetLoadedEvent{AssetType::Texture, texturePath});
       return newTexture;
     }
   } else {
@@ -271,6 +286,7 @@ std::vector<Render::Mesh *> AssetsLoader::GetModel(std::string modelPath) {
     }
     LOG_F(INFO, "load model at %s", modelPath.c_str());
     allMeshes[modelPath] = modelMeshes;
+    GWORLD.Events.Publish(AssetLoadedEvent{AssetType::Model, modelPath});
     return modelMeshes;
   } else {
     auto meshes = allMeshes[modelPath];
@@ -292,6 +308,7 @@ Render::Mesh *AssetsLoader::GetMesh(string modelPath, string identifier) {
     }
     // cache the model
     allMeshes.insert(std::make_pair(modelPath, modelMeshes));
+    GWORLD.Events.Publish(AssetLoadedEvent{AssetType::Model, modelPath});
     for (auto mesh : modelMeshes) {
       if (mesh->identifier == identifier) {
         LOG_F(INFO, "load model at %s, get mesh named %s", modelPath.c_str(),
@@ -30,9 +30,15 @@ public:
   Texture *GetHDRTexture(std::string texturePath, bool flipVertically = true);
   Render::Mesh *GetMesh(std::string modelPath, std::string identifier);
   std::vector<Render::Mesh *> GetModel(std::string modelPath);
+  // Load and cache a motion, bvh and fbx motions are cooked into a `.amot`
+  // cache on first load, later loads map the cache instead of parsing.
   Animation::Motion *GetMotion(std::string motionPath);
   Animation::Skeleton *GetActor(std::string filepath);
 
+  // Directory holding the cooked motion clips, the cache of a motion file
+  // is placed next to the file when this is empty.
+  std::string MotionCacheDir = "";
+
   // Create a new instance of this material by the type,
   // cache it in an internal array
   template <typename T>
@@ -55,15 +61,15 @@ public:
   std::shared_ptr<Entity> LoadAndCreateEntityFromFile(std::string modelPath);
 
   // path to texture
-  std::map<std::string, Texture *> allTextures;
+  std::unordered_map<Name, Texture *> allTextures;
   // path to model, one model could contain multiple meshes
-  std::map<std::string, std::vector<Render::Mesh *>> allMeshes;
+  std::unordered_map<Name, std::vector<Render::Mesh *>> allMeshes;
   // from filepath to skeleton (actor)
-  std::map<std::string, Animation::Skeleton *> allSkeletons;
+  std::unordered_map<Name, Animation::Skeleton *> allSkeletons;
   // identifier to shader data
-  std::map<std::string, std::shared_ptr<Render::Shader>> allShaders;
+  std::unordered_map<Name, std::shared_ptr<Render::Shader>> allShaders;
   // path to motion data
-  std::map<std::string, Animation::Motion *> allMotions;
+  std::unordered_map<Name, Animation::Motion *> allMotions;
 
   std::vector<std::shared_ptr<Render::BasePass>> allMaterials;
 
@@ -25,6 +25,11 @@ struct Vertex {
   int BoneId[MAX_BONES];
   float BoneWeight[MAX_BONES];
 };
+// one entry of the bone palette used by the skinning, on the cpu and the gpu
+struct BoneMatrixBlock {
+  glm::mat4 BoneModelMatrix;
+  glm::mat4 BoneOffsetMatrix;
+};
 
 struct Texture {
   unsigned int id;
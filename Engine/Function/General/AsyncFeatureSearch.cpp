@@ -0,0 +1,86 @@
+#include "Function/General/AsyncFeatureSearch.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/General/Utils.hpp"
+
+namespace aEngine {
+
+void AsyncFeatureSearch::Launch(std::vector<FeatureSearchQuery> queries) {
+  if (queries.empty())
+    return;
+  bool start = false;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (auto &query : queries)
+      queued.push_back(std::move(query));
+    if (!running)
+      running = start = true;
+  }
+  // the worker keeps draining the queue until it's empty
+  if (start)
+    ThreadPool::Ref().Submit([this]() { run(); });
+}
+
+void AsyncFeatureSearch::Wait() {
+  std::unique_lock<std::mutex> lock(queueMutex);
+  idle.wait(lock, [this]() { return !running; });
+}
+
+void AsyncFeatureSearch::UseApproximate(const ApproximateFeatureIndex *index) {
+  Wait();
+  approximate = index;
+}
+
+void AsyncFeatureSearch::run() {
+  std::vector<FeatureSearchQuery> batch;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(queueMutex);
+      if (queued.empty()) {
+        running = false;
+        idle.notify_all();
+        return;
+      }
+      batch.clear();
+      batch.swap(queued);
+    }
+    searchBatch(batch);
+  }
+}
+
+void AsyncFeatureSearch::searchBatch(std::vector<FeatureSearchQuery> &batch) {
+  // the queries cancelled while they were queued are never searched
+  std::vector<FeatureSearchQuery *> live;
+  for (auto &query : batch)
+    if (!query.ticket->Cancelled.load(std::memory_order_relaxed))
+      live.push_back(&query);
+  int numQueries = live.size(), dim = matrix.NumDims();
+  std::vector<float> features((size_t)numQueries * dim),
+      weights((size_t)numQueries * dim), maxCosts(numQueries);
+  for (int q = 0; q < numQueries; ++q) {
+    std::copy(live[q]->features.begin(), live[q]->features.end(),
+              features.begin() + (size_t)q * dim);
+    std::copy(live[q]->weights.begin(), live[q]->weights.end(),
+              weights.begin() + (size_t)q * dim);
+    maxCosts[q] = live[q]->maxCost;
+  }
+  std::vector<FeatureMatrix::SearchResult> results(numQueries);
+  Timer timer;
+  if (approximate != nullptr) {
+    for (int q = 0; q < numQueries; ++q)
+      results[q] = approximate->Search(matrix,
+                                       features.data() + (size_t)q * dim,
+                                       weights.data() + (size_t)q * dim);
+  } else if (numQueries > 0) {
+    matrix.SearchBatch(features.data(), numQueries, weights.data(),
+                       maxCosts.data(), results.data());
+  }
+  LastBatchTime = timer.ElapsedMilliseconds();
+  LastBatchSize = numQueries;
+  LastBatchCancelled = (int)batch.size() - numQueries;
+  for (int q = 0; q < numQueries; ++q) {
+    live[q]->ticket->Result = results[q];
+    live[q]->ticket->Ready.store(true, std::memory_order_release);
+  }
+}
+
+}; // namespace aEngine
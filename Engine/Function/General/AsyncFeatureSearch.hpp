@@ -0,0 +1,79 @@
+/**
+ * Feature searches answered on a worker thread of the `ThreadPool`, so a
+ * slow search never stalls the frame that asked for it.
+ *
+ * `Launch` returns right away, the queries are searched with
+ * `FeatureMatrix::SearchBatch` on a worker and each result is written to the
+ * ticket of its query. The queries launched while the worker is busy are
+ * searched together in the next batch. The owner of a ticket polls `Ready`,
+ * typically at its next update, and keeps doing something sensible while
+ * the result is late. A query that is no longer relevant is cancelled
+ * through its ticket, the worker skips it if it hasn't been searched yet.
+ *
+ * The matrix and the index are read by the worker, call `Wait` before
+ * modifying them.
+ */
+#pragma once
+
+#include "Function/General/FeatureIndex.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace aEngine {
+
+struct FeatureSearchTicket {
+  // set by the worker once `Result` is written
+  std::atomic<bool> Ready{false};
+  // set by the owner when the result isn't needed anymore
+  std::atomic<bool> Cancelled{false};
+  FeatureMatrix::SearchResult Result;
+
+  bool IsReady() const { return Ready.load(std::memory_order_acquire); }
+  void Cancel() { Cancelled.store(true, std::memory_order_relaxed); }
+};
+
+struct FeatureSearchQuery {
+  // one float per dimension of the matrix each
+  std::vector<float> features, weights;
+  float maxCost = std::numeric_limits<float>::infinity();
+  std::shared_ptr<FeatureSearchTicket> ticket;
+};
+
+class AsyncFeatureSearch {
+public:
+  AsyncFeatureSearch(const FeatureMatrix &matrix) : matrix(matrix) {}
+  ~AsyncFeatureSearch() { Wait(); }
+  AsyncFeatureSearch(const AsyncFeatureSearch &) = delete;
+  const AsyncFeatureSearch &operator=(const AsyncFeatureSearch &) = delete;
+
+  // Queue the queries for the worker and return.
+  void Launch(std::vector<FeatureSearchQuery> queries);
+  // Block until all the launched queries are answered or skipped.
+  void Wait();
+
+  // Answer the queries with `index` instead of the exact search, nullptr
+  // for the exact search. Waits for the worker.
+  void UseApproximate(const ApproximateFeatureIndex *index);
+
+  // size, search time and skipped queries of the last batch
+  std::atomic<int> LastBatchSize{0}, LastBatchCancelled{0};
+  std::atomic<float> LastBatchTime{0.0f};
+
+private:
+  const FeatureMatrix &matrix;
+  const ApproximateFeatureIndex *approximate = nullptr;
+
+  std::mutex queueMutex;
+  std::condition_variable idle;
+  std::vector<FeatureSearchQuery> queued;
+  // a worker is draining `queued`
+  bool running = false;
+
+  void run();
+  void searchBatch(std::vector<FeatureSearchQuery> &batch);
+};
+
+}; // namespace aEngine
@@ -0,0 +1,305 @@
+/**
+ * A typed event bus for the communications between systems and scripts.
+ *
+ * Events can be published from any thread, each thread writes into its own
+ * single producer queue for each event type, so publishing is lock free
+ * except for the first event a thread publishes of some type (the queue gets
+ * registered at that time). The main thread collects all the queues and
+ * delivers the events in batches when `Dispatch` is called with some phase,
+ * the scene dispatches the events at fixed phases in `Scene::Update`.
+ *
+ * Every subscriber gets each event exactly once, at the first dispatch of its
+ * own phase after the event gets collected. The events published during a
+ * dispatch are delivered at the next dispatch.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace aEngine {
+
+using EventTypeID = size_t;
+using SubscriptionID = uint64_t;
+
+const size_t MAX_EVENT_TYPES = 64;
+
+enum class EventPhase {
+  // after the hierarchy update, before the PreUpdate of systems
+  FrameBegin = 0,
+  // after the Update of all systems, before LateUpdate of scripts
+  PostUpdate = 1,
+  // after the LateUpdate of scripts, before rendering
+  PostLateUpdate = 2,
+  Count = 3
+};
+
+inline EventTypeID GetRuntimeEventTypeID() {
+  static std::atomic<EventTypeID> typeID(0u);
+  return typeID++;
+}
+
+template <typename T> inline EventTypeID EventType() noexcept {
+  static const EventTypeID typeID = GetRuntimeEventTypeID();
+  return typeID;
+}
+
+class EventBus {
+public:
+  EventBus() {
+    static std::atomic<uint64_t> busCounter(1);
+    generation = busCounter++;
+    for (auto &channel : channels)
+      channel.store(nullptr);
+  }
+  ~EventBus() {
+    for (auto &channel : channels)
+      delete channel.load();
+  }
+  EventBus(const EventBus &) = delete;
+  const EventBus &operator=(const EventBus &) = delete;
+
+  // Publish an event, this function is thread safe.
+  template <typename T> void Publish(const T &event) {
+    getChannel<T>()->LocalQueue(generation)->Push(event);
+  }
+
+  // Subscribe to some event type, the handler is called on main thread with
+  // all the events collected since its last call. Only call this function
+  // from the main thread.
+  template <typename T>
+  SubscriptionID
+  Subscribe(EventPhase phase,
+            std::function<void(const std::vector<T> &)> handler) {
+    auto id = nextSubscription++;
+    getChannel<T>()->subscribers.push_back({id, phase, handler, {}, false});
+    return id;
+  }
+
+  // Remove the subscription, it's safe to call inside a handler.
+  void Unsubscribe(SubscriptionID id) {
+    for (auto &channel : channels) {
+      auto ptr = channel.load(std::memory_order_acquire);
+      if (ptr)
+        ptr->Remove(id);
+    }
+  }
+
+  // Collect all the published events and deliver them to subscribers of this
+  // phase, only call this function from the main thread.
+  void Dispatch(EventPhase phase) {
+    for (auto &channel : channels) {
+      auto ptr = channel.load(std::memory_order_acquire);
+      if (ptr) {
+        ptr->Collect();
+        ptr->Deliver(phase);
+      }
+    }
+  }
+
+  // Drop all the events not delivered yet, subscriptions are kept.
+  void Clear() {
+    for (auto &channel : channels) {
+      auto ptr = channel.load(std::memory_order_acquire);
+      if (ptr)
+        ptr->Clear();
+    }
+  }
+
+private:
+  // Unbounded single producer single consumer queue made of fixed size
+  // blocks, the producer only writes to the tail block and the consumer only
+  // frees the blocks the producer has left.
+  template <typename T> struct ProducerQueue {
+    static const int BlockSize = 128;
+    struct Block {
+      T items[BlockSize];
+      std::atomic<int> committed{0};
+      std::atomic<Block *> next{nullptr};
+    };
+
+    ProducerQueue() {
+      head = tail = new Block();
+      headIndex = tailIndex = 0;
+    }
+    ~ProducerQueue() {
+      while (head) {
+        auto next = head->next.load();
+        delete head;
+        head = next;
+      }
+    }
+
+    // called by the producer thread only
+    void Push(const T &item) {
+      if (tailIndex == BlockSize) {
+        auto block = new Block();
+        tail->next.store(block, std::memory_order_release);
+        tail = block;
+        tailIndex = 0;
+      }
+      tail->items[tailIndex++] = item;
+      tail->committed.store(tailIndex, std::memory_order_release);
+    }
+
+    // called by the consumer thread only
+    void Drain(std::vector<T> &out) {
+      while (true) {
+        int committed = head->committed.load(std::memory_order_acquire);
+        while (headIndex < committed)
+          out.push_back(std::move(head->items[headIndex++]));
+        if (headIndex < BlockSize)
+          return;
+        auto next = head->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+          return;
+        delete head;
+        head = next;
+        headIndex = 0;
+      }
+    }
+
+    std::thread::id owner;
+    ProducerQueue *nextQueue = nullptr;
+
+    // consumer side
+    Block *head;
+    int headIndex;
+    // producer side
+    Block *tail;
+    int tailIndex;
+  };
+
+  struct IChannel {
+    virtual ~IChannel() {}
+    virtual void Collect() = 0;
+    virtual void Deliver(EventPhase phase) = 0;
+    virtual void Remove(SubscriptionID id) = 0;
+    virtual void Clear() = 0;
+  };
+
+  template <typename T> struct Channel : public IChannel {
+    struct Subscriber {
+      SubscriptionID id;
+      EventPhase phase;
+      std::function<void(const std::vector<T> &)> handler;
+      // events waiting for the phase of this subscriber
+      std::vector<T> inbox;
+      bool removed;
+    };
+
+    ~Channel() {
+      auto queue = queues.load();
+      while (queue) {
+        auto next = queue->nextQueue;
+        delete queue;
+        queue = next;
+      }
+    }
+
+    ProducerQueue<T> *LocalQueue(uint64_t busGeneration) {
+      thread_local uint64_t cachedGeneration = 0;
+      thread_local ProducerQueue<T> *cached = nullptr;
+      if (cachedGeneration == busGeneration)
+        return cached;
+      // slow path, first event of this type published from current thread
+      auto self = std::this_thread::get_id();
+      auto queue = queues.load(std::memory_order_acquire);
+      while (queue && queue->owner != self)
+        queue = queue->nextQueue;
+      if (queue == nullptr) {
+        queue = new ProducerQueue<T>();
+        queue->owner = self;
+        queue->nextQueue = queues.load(std::memory_order_relaxed);
+        while (!queues.compare_exchange_weak(queue->nextQueue, queue,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed))
+          ;
+      }
+      cachedGeneration = busGeneration;
+      cached = queue;
+      return queue;
+    }
+
+    void Collect() override {
+      collected.clear();
+      auto queue = queues.load(std::memory_order_acquire);
+      while (queue) {
+        queue->Drain(collected);
+        queue = queue->nextQueue;
+      }
+      if (collected.empty())
+        return;
+      for (auto &sub : subscribers)
+        if (!sub.removed)
+          sub.inbox.insert(sub.inbox.end(), collected.begin(),
+                           collected.end());
+    }
+
+    void Deliver(EventPhase phase) override {
+      // the handler could subscribe new handlers, use index here
+      for (size_t i = 0; i < subscribers.size(); ++i) {
+        if (subscribers[i].phase != phase || subscribers[i].removed ||
+            subscribers[i].inbox.empty())
+          continue;
+        std::vector<T> batch;
+        batch.swap(subscribers[i].inbox);
+        auto handler = subscribers[i].handler;
+        handler(batch);
+      }
+      subscribers.erase(
+          std::remove_if(subscribers.begin(), subscribers.end(),
+                         [](const Subscriber &s) { return s.removed; }),
+          subscribers.end());
+    }
+
+    void Remove(SubscriptionID id) override {
+      for (auto &sub : subscribers)
+        if (sub.id == id) {
+          sub.removed = true;
+          sub.inbox.clear();
+        }
+    }
+
+    void Clear() override {
+      Collect();
+      collected.clear();
+      for (auto &sub : subscribers)
+        sub.inbox.clear();
+    }
+
+    std::atomic<ProducerQueue<T> *> queues{nullptr};
+    std::vector<Subscriber> subscribers;
+    std::vector<T> collected;
+  };
+
+  template <typename T> Channel<T> *getChannel() {
+    auto typeID = EventType<T>();
+    if (typeID >= MAX_EVENT_TYPES)
+      throw std::runtime_error("Event type limit reached (MAX_EVENT_TYPES)");
+    auto ptr = channels[typeID].load(std::memory_order_acquire);
+    if (ptr == nullptr) {
+      std::lock_guard<std::mutex> lock(channelMutex);
+      ptr = channels[typeID].load(std::memory_order_acquire);
+      if (ptr == nullptr) {
+        ptr = new Channel<T>();
+        channels[typeID].store(ptr, std::memory_order_release);
+      }
+    }
+    return static_cast<Channel<T> *>(ptr);
+  }
+
+  std::array<std::atomic<IChannel *>, MAX_EVENT_TYPES> channels;
+  std::mutex channelMutex;
+  SubscriptionID nextSubscription = 1;
+  uint64_t generation;
+};
+
+}; // namespace aEngine
@@ -0,0 +1,213 @@
+#include "Function/General/FeatureIndex.hpp"
+#include "Function/General/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <random>
+
+namespace aEngine {
+
+static const int groupSize = FeatureMatrix::GroupSize;
+
+// Index of the closest of `centers` for each of the `n` points.
+static void assignPoints(const float *points, int n, int dim,
+                         const FeatureMatrix &centers,
+                         std::vector<int> &assignment) {
+  assignment.resize(n);
+  ThreadPool::Ref().ParallelFor(0, n, 1024, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i)
+      assignment[i] = centers.Search(points + (size_t)i * dim).index;
+  });
+}
+
+// Lloyd's k-means on `n` points of `dim` floats, `centers` gets `k` rows.
+static void kmeans(const float *points, int n, int dim, int k, int iterations,
+                   std::mt19937 &gen, std::vector<float> &centers) {
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), gen);
+  centers.resize((size_t)k * dim);
+  for (int c = 0; c < k; ++c)
+    std::copy_n(points + (size_t)order[c % n] * dim, dim,
+                centers.data() + (size_t)c * dim);
+  FeatureMatrix centerMatrix;
+  std::vector<int> assignment, counts(k);
+  std::uniform_int_distribution<int> pick(0, n - 1);
+  for (int iter = 0; iter < iterations; ++iter) {
+    centerMatrix.Build(centers.data(), k, dim);
+    assignPoints(points, n, dim, centerMatrix, assignment);
+    std::fill(centers.begin(), centers.end(), 0.0f);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (int i = 0; i < n; ++i) {
+      counts[assignment[i]]++;
+      for (int d = 0; d < dim; ++d)
+        centers[(size_t)assignment[i] * dim + d] += points[(size_t)i * dim + d];
+    }
+    for (int c = 0; c < k; ++c) {
+      // move an empty cluster onto a random point
+      if (counts[c] == 0) {
+        std::copy_n(points + (size_t)pick(gen) * dim, dim,
+                    centers.data() + (size_t)c * dim);
+        continue;
+      }
+      for (int d = 0; d < dim; ++d)
+        centers[(size_t)c * dim + d] /= counts[c];
+    }
+  }
+}
+
+void ApproximateFeatureIndex::Build(const float *rows, int rowNum, int dimNum,
+                                    const Settings &settings) {
+  numRows = rowNum;
+  numDims = dimNum;
+  numGroups = (numDims + groupSize - 1) / groupSize;
+  numCells = settings.numCells > 0 ? settings.numCells
+                                   : (int)std::sqrt((double)numRows);
+  numCells = std::max(1, std::min(numCells, numRows));
+  centroids.clear(), codebooks.clear(), codes.clear();
+  cellStart.assign(numCells + 1, 0);
+  rowIds.clear();
+  if (numRows == 0)
+    return;
+
+  std::mt19937 gen(settings.seed);
+  std::vector<int> sample(numRows);
+  std::iota(sample.begin(), sample.end(), 0);
+  std::shuffle(sample.begin(), sample.end(), gen);
+  sample.resize(std::min(numRows, std::max(settings.trainingRows, numCells)));
+  int numSamples = sample.size();
+
+  // coarse cells
+  std::vector<float> training((size_t)numSamples * numDims);
+  for (int i = 0; i < numSamples; ++i)
+    std::copy_n(rows + (size_t)sample[i] * numDims, numDims,
+                training.data() + (size_t)i * numDims);
+  kmeans(training.data(), numSamples, numDims, numCells, settings.iterations,
+         gen, centroids);
+  FeatureMatrix cellMatrix;
+  cellMatrix.Build(centroids.data(), numCells, numDims);
+  std::vector<int> cells;
+  assignPoints(rows, numRows, numDims, cellMatrix, cells);
+
+  // one codebook per group of dimensions, the padding dimensions are zero
+  int numCodes = std::min(codebookSize, numSamples);
+  codebooks.assign((size_t)numGroups * codebookSize * groupSize, 0.0f);
+  std::vector<FeatureMatrix> codebookMatrices(numGroups);
+  std::vector<float> subvectors((size_t)numSamples * groupSize), centers;
+  for (int g = 0; g < numGroups; ++g) {
+    std::fill(subvectors.begin(), subvectors.end(), 0.0f);
+    for (int i = 0; i < numSamples; ++i)
+      for (int k = 0; k < groupSize && g * groupSize + k < numDims; ++k)
+        subvectors[(size_t)i * groupSize + k] =
+            training[(size_t)i * numDims + g * groupSize + k];
+    kmeans(subvectors.data(), numSamples, groupSize, numCodes,
+           settings.iterations, gen, centers);
+    std::copy(centers.begin(), centers.end(),
+              codebooks.begin() + (size_t)g * codebookSize * groupSize);
+    codebookMatrices[g].Build(centers.data(), numCodes, groupSize);
+  }
+
+  // sort the rows by cell and encode them
+  for (int r = 0; r < numRows; ++r)
+    cellStart[cells[r] + 1]++;
+  std::partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+  rowIds.resize(numRows);
+  std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+  for (int r = 0; r < numRows; ++r)
+    rowIds[fill[cells[r]]++] = r;
+  codes.resize((size_t)numRows * numGroups);
+  ThreadPool::Ref().ParallelFor(0, numRows, 1024, [&](int begin, int end) {
+    float subvector[groupSize];
+    for (int i = begin; i < end; ++i) {
+      const float *row = rows + (size_t)rowIds[i] * numDims;
+      for (int g = 0; g < numGroups; ++g) {
+        for (int k = 0; k < groupSize; ++k) {
+          int d = g * groupSize + k;
+          subvector[k] = d < numDims ? row[d] : 0.0f;
+        }
+        codes[(size_t)i * numGroups + g] =
+            codebookMatrices[g].Search(subvector).index;
+      }
+    }
+  });
+}
+
+FeatureMatrix::SearchResult
+ApproximateFeatureIndex::Search(const FeatureMatrix &exact, const float *query,
+                                const float *weights) const {
+  FeatureMatrix::SearchResult result;
+  if (numRows == 0)
+    return result;
+  auto weight = [&](int d) { return weights ? weights[d] : 1.0f; };
+
+  // the closest cells
+  std::vector<std::pair<float, int>> cellCosts(numCells);
+  for (int c = 0; c < numCells; ++c) {
+    const float *centroid = centroids.data() + (size_t)c * numDims;
+    float cost = 0.0f;
+    for (int d = 0; d < numDims; ++d)
+      cost += weight(d) * (centroid[d] - query[d]) * (centroid[d] - query[d]);
+    cellCosts[c] = {cost, c};
+  }
+  int probes = std::max(1, std::min(Probes, numCells));
+  std::partial_sort(cellCosts.begin(), cellCosts.begin() + probes,
+                    cellCosts.end());
+
+  // cost of every code of every group
+  std::vector<float> table((size_t)numGroups * codebookSize, 0.0f);
+  for (int g = 0; g < numGroups; ++g) {
+    for (int code = 0; code < codebookSize; ++code) {
+      const float *center =
+          codebooks.data() + ((size_t)g * codebookSize + code) * groupSize;
+      float cost = 0.0f;
+      for (int k = 0; k < groupSize && g * groupSize + k < numDims; ++k) {
+        int d = g * groupSize + k;
+        cost += weight(d) * (center[k] - query[d]) * (center[k] - query[d]);
+      }
+      table[(size_t)g * codebookSize + code] = cost;
+    }
+  }
+
+  // keep the candidates with the smallest approximate cost, the excluded
+  // rows would take the place of valid ones
+  int rerank = std::max(1, Rerank);
+  std::priority_queue<std::pair<float, int>> candidates;
+  for (int p = 0; p < probes; ++p) {
+    int cell = cellCosts[p].second;
+    for (int i = cellStart[cell]; i < cellStart[cell + 1]; ++i) {
+      if (exact.IsExcluded(rowIds[i]))
+        continue;
+      const uint8_t *code = codes.data() + (size_t)i * numGroups;
+      float cost = 0.0f;
+      for (int g = 0; g < numGroups; ++g)
+        cost += table[(size_t)g * codebookSize + code[g]];
+      if ((int)candidates.size() < rerank) {
+        candidates.push({cost, rowIds[i]});
+      } else if (cost < candidates.top().first) {
+        candidates.pop();
+        candidates.push({cost, rowIds[i]});
+      }
+    }
+  }
+  while (!candidates.empty()) {
+    int row = candidates.top().second;
+    candidates.pop();
+    float cost = exact.Cost(row, query, weights);
+    if (cost < result.cost || (cost == result.cost && row < result.index)) {
+      result.cost = cost;
+      result.index = row;
+    }
+  }
+  if (result.cost == std::numeric_limits<float>::infinity())
+    result.index = -1;
+  return result;
+}
+
+size_t ApproximateFeatureIndex::MemoryBytes() const {
+  return (centroids.size() + codebooks.size()) * sizeof(float) +
+         (cellStart.size() + rowIds.size()) * sizeof(int) + codes.size();
+}
+
+}; // namespace aEngine
@@ -0,0 +1,68 @@
+/**
+ * Approximate nearest neighbour search for very large motion databases, an
+ * inverted file with product quantization (IVF-PQ).
+ *
+ * The rows are clustered into cells with k-means, and every group of
+ * `FeatureMatrix::GroupSize` dimensions of a row is encoded as one byte,
+ * the index of the closest of 256 centroids trained for that group. A query
+ * ranks the cells by their centroids, scans the codes of the `Probes`
+ * closest cells with a table of per-group costs, and computes the exact
+ * cost of the `Rerank` best candidates with the `FeatureMatrix` holding the
+ * rows. More probes and candidates give better recall at a higher latency.
+ */
+#pragma once
+
+#include "Function/General/FeatureMatrix.hpp"
+
+#include <cstdint>
+
+namespace aEngine {
+
+class ApproximateFeatureIndex {
+public:
+  struct Settings {
+    // number of cells, the square root of the number of rows if not positive
+    int numCells = 0;
+    // k-means runs on a random subset of the rows of this size
+    int trainingRows = 32768;
+    int iterations = 8;
+    unsigned int seed = 0;
+  };
+
+  // Index `numRows` rows of `numDims` floats each, stored row after row.
+  void Build(const float *rows, int numRows, int numDims,
+             const Settings &settings);
+  template <std::size_t Dim>
+  void Build(const std::vector<std::array<float, Dim>> &rows,
+             const Settings &settings) {
+    Build(rows.empty() ? nullptr : rows[0].data(), rows.size(), Dim,
+          settings);
+  }
+
+  // Same cost and result as `FeatureMatrix::Search`, `exact` must hold the
+  // indexed rows and its excluded rows are never returned.
+  FeatureMatrix::SearchResult Search(const FeatureMatrix &exact,
+                                     const float *query,
+                                     const float *weights = nullptr) const;
+
+  int NumCells() const { return numCells; }
+  // Heap memory of the index, without the rows kept by `FeatureMatrix`.
+  size_t MemoryBytes() const;
+
+  int Probes = 8;
+  int Rerank = 32;
+
+private:
+  static constexpr int codebookSize = 256;
+  int numRows = 0, numDims = 0, numGroups = 0, numCells = 0;
+  // `numCells` rows of `numDims` floats
+  std::vector<float> centroids;
+  // `codebookSize` centroids of `FeatureMatrix::GroupSize` floats per group
+  std::vector<float> codebooks;
+  // the rows of cell `c` are `rowIds[cellStart[c]]` to
+  // `rowIds[cellStart[c + 1] - 1]`, their codes are stored in the same order
+  std::vector<int> cellStart, rowIds;
+  std::vector<uint8_t> codes;
+};
+
+}; // namespace aEngine
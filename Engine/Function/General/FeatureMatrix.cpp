@@ -0,0 +1,352 @@
+#include "Function/General/FeatureMatrix.hpp"
+#include "Function/General/ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace aEngine {
+
+using Math::FloatN;
+
+static const float infinity = std::numeric_limits<float>::infinity();
+// blocks per chunk of a parallel search, smaller matrices are searched on
+// the calling thread
+static const int searchGrain = 4096;
+
+void FeatureMatrix::Build(const float *rows, int rowNum, int dimNum) {
+  numRows = rowNum;
+  numDims = dimNum;
+  numBlocks = (numRows + BlockSize - 1) / BlockSize;
+  numGroups = (numDims + GroupSize - 1) / GroupSize;
+  data.assign((size_t)numGroups * numBlocks * GroupSize * BlockSize, 0.0f);
+  for (int r = 0; r < numRows; ++r)
+    for (int d = 0; d < numDims; ++d)
+      data[index(r, d)] = rows[(size_t)r * numDims + d];
+  rowPenalty.assign((size_t)numBlocks * BlockSize, infinity);
+  ClearExcluded();
+  ClearBounds();
+}
+
+void FeatureMatrix::BuildBounds() {
+  const int smallRows = SmallBoxBlocks * BlockSize;
+  const int largeRows = smallRows * LargeBoxSmallBoxes;
+  numSmallBoxes = (numRows + smallRows - 1) / smallRows;
+  numLargeBoxes = (numRows + largeRows - 1) / largeRows;
+  // the small boxes of the last large box are loaded as a whole vector
+  smallBoxStride = Math::PadToSIMD(numSmallBoxes) + Math::SIMD_PADDING;
+  largeBoxStride = Math::PadToSIMD(numLargeBoxes);
+  smallMin.assign((size_t)numDims * smallBoxStride, infinity);
+  smallMax.assign((size_t)numDims * smallBoxStride, infinity);
+  largeMin.assign((size_t)numDims * largeBoxStride, infinity);
+  largeMax.assign((size_t)numDims * largeBoxStride, infinity);
+  for (int d = 0; d < numDims; ++d) {
+    float *sMin = smallMin.data() + (size_t)d * smallBoxStride,
+          *sMax = smallMax.data() + (size_t)d * smallBoxStride;
+    for (int box = 0; box < numSmallBoxes; ++box) {
+      float lo = infinity, hi = -infinity;
+      int end = std::min(numRows, (box + 1) * smallRows);
+      for (int r = box * smallRows; r < end; ++r) {
+        lo = std::min(lo, data[index(r, d)]);
+        hi = std::max(hi, data[index(r, d)]);
+      }
+      sMin[box] = lo, sMax[box] = hi;
+    }
+    float *lMin = largeMin.data() + (size_t)d * largeBoxStride,
+          *lMax = largeMax.data() + (size_t)d * largeBoxStride;
+    for (int box = 0; box < numLargeBoxes; ++box) {
+      float lo = infinity, hi = -infinity;
+      int end = std::min(numSmallBoxes, (box + 1) * LargeBoxSmallBoxes);
+      for (int small = box * LargeBoxSmallBoxes; small < end; ++small) {
+        lo = std::min(lo, sMin[small]);
+        hi = std::max(hi, sMax[small]);
+      }
+      lMin[box] = lo, lMax[box] = hi;
+    }
+  }
+}
+
+void FeatureMatrix::ClearBounds() {
+  numSmallBoxes = numLargeBoxes = 0;
+  smallBoxStride = largeBoxStride = 0;
+  smallMin.clear(), smallMax.clear(), largeMin.clear(), largeMax.clear();
+}
+
+size_t FeatureMatrix::MemoryBytes() const {
+  return (data.size() + rowPenalty.size() + smallMin.size() + smallMax.size() +
+          largeMin.size() + largeMax.size()) *
+         sizeof(float);
+}
+
+void FeatureMatrix::SetExcluded(int begin, int end, bool excluded) {
+  begin = std::max(begin, 0);
+  end = std::min(end, numRows);
+  for (int r = begin; r < end; ++r)
+    rowPenalty[r] = excluded ? infinity : 0.0f;
+}
+
+void FeatureMatrix::ExcludeRangeEnds(
+    const std::vector<std::pair<int, int>> &ranges, int frames) {
+  for (auto &range : ranges)
+    SetExcluded(std::max(range.first, range.second - frames), range.second);
+}
+
+void FeatureMatrix::ClearExcluded() { SetExcluded(0, numRows, false); }
+
+template <int Groups>
+FeatureMatrix::SearchResult
+FeatureMatrix::searchGroups(int begin, int end, const float *query,
+                            const float *weights, float maxCost) const {
+  // a constant number of groups unrolls the loop over the dimensions
+  const int groups = Groups > 0 ? Groups : numGroups;
+  SearchResult result;
+  result.cost = maxCost;
+  alignas(32) float costs[FloatN::Width];
+  const size_t groupStride = (size_t)numBlocks * GroupSize * BlockSize;
+  for (int b = begin; b < end; ++b) {
+    const float *block = data.data() + (size_t)b * GroupSize * BlockSize;
+    for (int lane = 0; lane < BlockSize; lane += FloatN::Width) {
+      FloatN best(result.cost);
+      FloatN cost = FloatN::Load(rowPenalty.data() + b * BlockSize + lane);
+      for (int g = 0; g < groups; ++g) {
+        const float *group = block + g * groupStride + lane;
+        for (int i = 0; i < GroupSize; ++i) {
+          int d = g * GroupSize + i;
+          FloatN diff = FloatN::Load(group + i * BlockSize) - FloatN(query[d]);
+          cost = cost + FloatN(weights[d]) * diff * diff;
+        }
+        // none of the rows can beat the best one anymore
+        if (Math::MoveMask(cost < best) == 0)
+          break;
+      }
+      int better = Math::MoveMask(cost < best);
+      if (better == 0)
+        continue;
+      cost.Store(costs);
+      for (int i = 0; i < FloatN::Width; ++i) {
+        if ((better >> i & 1) && costs[i] < result.cost) {
+          result.cost = costs[i];
+          result.index = b * BlockSize + lane + i;
+        }
+      }
+    }
+  }
+  if (result.index == -1)
+    result.cost = infinity;
+  return result;
+}
+
+FeatureMatrix::SearchResult
+FeatureMatrix::searchBlocks(int begin, int end, const float *query,
+                            const float *weights, float maxCost) const {
+  switch (numGroups) {
+  case 1:
+    return searchGroups<1>(begin, end, query, weights, maxCost);
+  case 2:
+    return searchGroups<2>(begin, end, query, weights, maxCost);
+  case 3:
+    return searchGroups<3>(begin, end, query, weights, maxCost);
+  case 4:
+    return searchGroups<4>(begin, end, query, weights, maxCost);
+  case 5:
+    return searchGroups<5>(begin, end, query, weights, maxCost);
+  case 6:
+    return searchGroups<6>(begin, end, query, weights, maxCost);
+  case 7:
+    return searchGroups<7>(begin, end, query, weights, maxCost);
+  case 8:
+    return searchGroups<8>(begin, end, query, weights, maxCost);
+  default:
+    return searchGroups<0>(begin, end, query, weights, maxCost);
+  }
+}
+
+// Lower bound of the cost of `FloatN::Width` boxes starting at `box`, stops
+// early once none of them can beat `maxCost`.
+static FloatN boxCost(const float *boxMin, const float *boxMax, int stride,
+                      int box, int numDims, const float *query,
+                      const float *weights, float maxCost) {
+  const FloatN zero(0.0f), best(maxCost);
+  FloatN cost = zero;
+  for (int d = 0; d < numDims; ++d) {
+    FloatN lo = FloatN::Load(boxMin + (size_t)d * stride + box);
+    FloatN hi = FloatN::Load(boxMax + (size_t)d * stride + box);
+    // at most one of the two is positive
+    FloatN q(query[d]);
+    FloatN gap = Math::Max(lo - q, zero) + Math::Max(q - hi, zero);
+    cost = cost + FloatN(weights[d]) * gap * gap;
+    if (d % FeatureMatrix::GroupSize == FeatureMatrix::GroupSize - 1 &&
+        Math::MoveMask(cost < best) == 0)
+      break;
+  }
+  return cost;
+}
+
+FeatureMatrix::SearchResult
+FeatureMatrix::searchBounds(const float *query, const float *weights,
+                            float maxCost, int largeBegin,
+                            int largeEnd) const {
+  SearchResult result;
+  result.cost = maxCost;
+  alignas(32) float largeCosts[FloatN::Width], smallCosts[FloatN::Width];
+  for (int large = largeBegin; large < largeEnd; large += FloatN::Width) {
+    FloatN cost = boxCost(largeMin.data(), largeMax.data(), largeBoxStride,
+                          large, numDims, query, weights, result.cost);
+    int candidates = Math::MoveMask(cost < FloatN(result.cost));
+    if (candidates == 0)
+      continue;
+    cost.Store(largeCosts);
+    for (int i = 0; i < FloatN::Width && large + i < largeEnd; ++i) {
+      // the best cost may have improved since the boxes were tested
+      if (!(candidates >> i & 1) || largeCosts[i] >= result.cost)
+        continue;
+      int smallBegin = (large + i) * LargeBoxSmallBoxes;
+      int smallEnd = std::min(numSmallBoxes, smallBegin + LargeBoxSmallBoxes);
+      for (int small = smallBegin; small < smallEnd;
+           small += FloatN::Width) {
+        boxCost(smallMin.data(), smallMax.data(), smallBoxStride, small,
+                numDims, query, weights, result.cost)
+            .Store(smallCosts);
+        int lanes = std::min(FloatN::Width, smallEnd - small);
+        for (int j = 0; j < lanes; ++j) {
+          if (smallCosts[j] >= result.cost)
+            continue;
+          int blockBegin = (small + j) * SmallBoxBlocks;
+          int blockEnd = std::min(numBlocks, blockBegin + SmallBoxBlocks);
+          auto rows = searchBlocks(blockBegin, blockEnd, query, weights,
+                                   result.cost);
+          if (rows.index != -1)
+            result = rows;
+        }
+      }
+    }
+  }
+  if (result.index == -1)
+    result.cost = infinity;
+  return result;
+}
+
+FeatureMatrix::SearchResult FeatureMatrix::Search(const float *query,
+                                                  const float *weights,
+                                                  float maxCost) const {
+  // the padding dimensions have zero weight
+  std::vector<float> queryN(numGroups * GroupSize, 0.0f),
+      weightsN(numGroups * GroupSize, 0.0f);
+  for (int d = 0; d < numDims; ++d) {
+    queryN[d] = query[d];
+    weightsN[d] = weights ? weights[d] : 1.0f;
+  }
+  if (HasBounds())
+    return searchBounds(queryN.data(), weightsN.data(), maxCost, 0,
+                        numLargeBoxes);
+  if (numBlocks <= searchGrain)
+    return searchBlocks(0, numBlocks, queryN.data(), weightsN.data(),
+                        maxCost);
+
+  // the chunks share their best cost to reject more blocks
+  std::atomic<float> sharedBest(maxCost);
+  std::mutex resultMutex;
+  SearchResult result;
+  ThreadPool::Ref().ParallelFor(
+      0, numBlocks, searchGrain, [&](int begin, int end) {
+        auto chunk = searchBlocks(begin, end, queryN.data(), weightsN.data(),
+                                  sharedBest.load(std::memory_order_relaxed));
+        if (chunk.index == -1)
+          return;
+        std::lock_guard<std::mutex> lock(resultMutex);
+        if (chunk.cost < result.cost ||
+            (chunk.cost == result.cost && chunk.index < result.index)) {
+          result = chunk;
+          sharedBest.store(chunk.cost, std::memory_order_relaxed);
+        }
+      });
+  return result;
+}
+
+void FeatureMatrix::SearchBatch(const float *queries, int numQueries,
+                                const float *weights, const float *maxCosts,
+                                SearchResult *results) const {
+  auto &pool = ThreadPool::Ref();
+  auto maxCost = [&](int q) { return maxCosts ? maxCosts[q] : infinity; };
+  if (numQueries == 1) {
+    pool.ParallelFor(0, numQueries, 16, [&](int begin, int end) {
+      for (int q = begin; q < end; ++q)
+        results[q] = Search(queries + (size_t)q * numDims,
+                            weights ? weights + (size_t)q * numDims : nullptr,
+                            maxCost(q));
+    });
+    return;
+  }
+
+  // the padding dimensions have zero weight
+  const int stride = numGroups * GroupSize;
+  std::vector<float> queryN((size_t)numQueries * stride, 0.0f),
+      weightsN((size_t)numQueries * stride, 0.0f);
+  for (int q = 0; q < numQueries; ++q) {
+    for (int d = 0; d < numDims; ++d) {
+      queryN[(size_t)q * stride + d] = queries[(size_t)q * numDims + d];
+      weightsN[(size_t)q * stride + d] =
+          weights ? weights[(size_t)q * numDims + d] : 1.0f;
+    }
+  }
+
+  // the tiles share the best cost of each query to reject more blocks
+  const int numTiles = (numBlocks + BatchTileBlocks - 1) / BatchTileBlocks;
+  // a tile holds whole vectors of large boxes
+  constexpr int largeBlocks = SmallBoxBlocks * LargeBoxSmallBoxes;
+  static_assert(BatchTileBlocks % (largeBlocks * FloatN::Width) == 0,
+                "tiles must cover whole vectors of large boxes");
+  std::vector<std::atomic<float>> sharedBest(numQueries);
+  for (int q = 0; q < numQueries; ++q)
+    sharedBest[q].store(maxCost(q), std::memory_order_relaxed);
+  std::vector<SearchResult> tileResults((size_t)numTiles * numQueries);
+  pool.ParallelFor(0, numTiles, 1, [&](int tileBegin, int tileEnd) {
+    for (int tile = tileBegin; tile < tileEnd; ++tile) {
+      int begin = tile * BatchTileBlocks;
+      int end = std::min(numBlocks, begin + BatchTileBlocks);
+      for (int q = 0; q < numQueries; ++q) {
+        auto &best = sharedBest[q];
+        const float *query = queryN.data() + q * stride,
+                    *queryWeights = weightsN.data() + q * stride;
+        float bestCost = best.load(std::memory_order_relaxed);
+        auto result =
+            HasBounds()
+                ? searchBounds(query, queryWeights, bestCost,
+                               begin / largeBlocks,
+                               std::min(numLargeBoxes,
+                                        (end + largeBlocks - 1) / largeBlocks))
+                : searchBlocks(begin, end, query, queryWeights, bestCost);
+        if (result.index == -1)
+          continue;
+        tileResults[(size_t)tile * numQueries + q] = result;
+        float current = best.load(std::memory_order_relaxed);
+        while (result.cost < current &&
+               !best.compare_exchange_weak(current, result.cost,
+                                           std::memory_order_relaxed))
+          ;
+      }
+    }
+  });
+  // merged in tile order, ties go to the smallest index like `Search`
+  for (int q = 0; q < numQueries; ++q) {
+    SearchResult result;
+    for (int tile = 0; tile < numTiles; ++tile) {
+      auto &candidate = tileResults[(size_t)tile * numQueries + q];
+      if (candidate.index != -1 && candidate.cost < result.cost)
+        result = candidate;
+    }
+    results[q] = result;
+  }
+}
+
+float FeatureMatrix::Cost(int row, const float *query,
+                          const float *weights) const {
+  float cost = rowPenalty[row];
+  for (int d = 0; d < numDims; ++d) {
+    float diff = data[index(row, d)] - query[d];
+    cost += (weights ? weights[d] : 1.0f) * diff * diff;
+  }
+  return cost;
+}
+
+}; // namespace aEngine
@@ -0,0 +1,131 @@
+/**
+ * Exhaustive nearest neighbour search over the feature vectors of a motion
+ * database, the exact counterpart of `KDTree::BruteForceNearestSearch`.
+ *
+ * The rows are split into blocks of `BlockSize` rows and the dimensions into
+ * groups of `GroupSize`, each group of all the blocks is stored contiguously
+ * and dimension major inside a block. A block is scored one dimension at a
+ * time for all its rows with simd, the cost is the weighted squared
+ * distance without `sqrt`. The block is dropped as soon as its partial
+ * costs after a group can't beat the best cost found so far, so most of the
+ * search only streams through the first group. Rows can be excluded from
+ * the search, e.g. the last frames of each clip.
+ *
+ * `BuildBounds` adds axis aligned bounding boxes over 16 and 64 consecutive
+ * rows, the small and large boxes of
+ * https://github.com/orangeduck/Motion-Matching. Consecutive frames of a
+ * clip are close, so the boxes are tight and whole boxes further from the
+ * query than the best row are skipped without touching their rows.
+ */
+#pragma once
+
+#include "Function/Math/SIMD.hpp"
+
+#include <array>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace aEngine {
+
+class FeatureMatrix {
+public:
+  static constexpr int BlockSize = Math::SIMD_PADDING;
+  static constexpr int GroupSize = 4;
+  // blocks per small box and small boxes per large box
+  static constexpr int SmallBoxBlocks = 2;
+  static constexpr int LargeBoxSmallBoxes = 4;
+
+  struct SearchResult {
+    int index = -1;
+    float cost = std::numeric_limits<float>::infinity();
+  };
+
+  // Copy `numRows` rows of `numDims` floats each, stored row after row.
+  void Build(const float *rows, int numRows, int numDims);
+  template <std::size_t Dim>
+  void Build(const std::vector<std::array<float, Dim>> &rows) {
+    Build(rows.empty() ? nullptr : rows[0].data(), rows.size(), Dim);
+  }
+
+  int NumRows() const { return numRows; }
+  int NumDims() const { return numDims; }
+
+  // Rows in [begin, end) are skipped by `Search` while excluded.
+  void SetExcluded(int begin, int end, bool excluded = true);
+  // Exclude the last `frames` rows of every [begin, end) range, clips
+  // shorter than that are excluded entirely.
+  void ExcludeRangeEnds(const std::vector<std::pair<int, int>> &ranges,
+                        int frames);
+  void ClearExcluded();
+  bool IsExcluded(int row) const { return rowPenalty[row] != 0.0f; }
+
+  // The row with the smallest cost `sum(weights[d] * (row[d] - query[d])^2)`,
+  // `weights` can be nullptr for all ones. Only rows cheaper than `maxCost`
+  // are considered, pass the cost of the current match to reject most blocks
+  // early. The index is -1 if no row qualifies. Large matrices without
+  // bounding boxes are searched in parallel on the thread pool.
+  SearchResult
+  Search(const float *query, const float *weights = nullptr,
+         float maxCost = std::numeric_limits<float>::infinity()) const;
+
+  // Search `numQueries` queries stored row after row at once, e.g. for all
+  // the characters of a crowd. `weights` holds one row per query and
+  // `maxCosts` one cost per query, both can be nullptr. The blocks are
+  // scanned in tiles of `BatchTileBlocks` blocks, all the queries go through
+  // a tile while it's in cache, and the tiles are split across the thread
+  // pool. With bounding boxes each query only visits the blocks of the tile
+  // its boxes can't reject. The results are the same as `Search`.
+  void SearchBatch(const float *queries, int numQueries, const float *weights,
+                   const float *maxCosts, SearchResult *results) const;
+  static constexpr int BatchTileBlocks = 256;
+
+  // Compute the bounding boxes used by `Search`, the boxes are computed
+  // over all the rows so the exclusion can change without rebuilding them.
+  void BuildBounds();
+  void ClearBounds();
+  bool HasBounds() const { return numLargeBoxes > 0; }
+
+  // Heap memory of the rows and the bounding boxes.
+  size_t MemoryBytes() const;
+
+  // Cost of a single row with the same weighting as `Search`.
+  float Cost(int row, const float *query,
+             const float *weights = nullptr) const;
+
+private:
+  int numRows = 0, numDims = 0, numBlocks = 0, numGroups = 0;
+  // dimension `d` of row `r` is at `data[index(r, d)]`, the dimensions are
+  // padded with zeros to whole groups
+  std::vector<float> data;
+  size_t index(int row, int dim) const {
+    return (((size_t)(dim / GroupSize) * numBlocks + row / BlockSize) *
+                GroupSize +
+            dim % GroupSize) *
+               BlockSize +
+           row % BlockSize;
+  }
+  // initial cost of every row, 0 or infinity for excluded and padding rows
+  std::vector<float> rowPenalty;
+
+  // bounding boxes as `numDims` planes of `boxStride` floats each, padding
+  // boxes have infinite bounds
+  int numSmallBoxes = 0, numLargeBoxes = 0;
+  int smallBoxStride = 0, largeBoxStride = 0;
+  std::vector<float> smallMin, smallMax, largeMin, largeMax;
+
+  // `query` and `weights` are padded with zeros to whole groups, the
+  // kernel is instantiated for each number of groups up to 8 (32
+  // dimensions), wider matrices use the generic loop
+  SearchResult searchBlocks(int begin, int end, const float *query,
+                            const float *weights, float maxCost) const;
+  template <int Groups>
+  SearchResult searchGroups(int begin, int end, const float *query,
+                            const float *weights, float maxCost) const;
+  // only the rows of the large boxes in [largeBegin, largeEnd)
+  SearchResult searchBounds(const float *query, const float *weights,
+                            float maxCost, int largeBegin,
+                            int largeEnd) const;
+};
+
+}; // namespace aEngine
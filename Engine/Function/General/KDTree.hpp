@@ -36,7 +36,8 @@ public:
     std::vector<int> ids(data.size());
     std::iota(ids.begin(), ids.end(), 0);
     // root node
-    s.push({true, -1, ids});
+    if (!ids.empty())
+      s.push({true, -1, ids});
     while (!s.empty()) {
       auto entry = s.top();
       s.pop();
@@ -0,0 +1,95 @@
+#include "Function/General/MappedFile.hpp"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace aEngine {
+
+MappedFile::~MappedFile() { Close(); }
+
+#if _WIN32
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  fileHandle = file;
+  mappingHandle = mapping;
+  data = static_cast<const char *>(view);
+  size = (size_t)fileSize.QuadPart;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data)
+    UnmapViewOfFile(data);
+  if (mappingHandle)
+    CloseHandle(mappingHandle);
+  if (fileHandle)
+    CloseHandle(fileHandle);
+  data = nullptr;
+  size = 0;
+  fileHandle = mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  void *view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  close(fd);
+  if (view == MAP_FAILED)
+    return false;
+  data = static_cast<const char *>(view);
+  size = info.st_size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data)
+    munmap(const_cast<char *>(data), size);
+  data = nullptr;
+  size = 0;
+}
+
+#endif
+
+}; // namespace aEngine
@@ -0,0 +1,41 @@
+/**
+ * Read only memory mapping of a whole file.
+ *
+ * The content is paged in by the os on first access, opening a file costs
+ * the same no matter how large it is. The mapping stays valid until the
+ * object is closed or destroyed, hold it with a `std::shared_ptr` when the
+ * data is referenced from other objects.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace aEngine {
+
+class MappedFile {
+public:
+  MappedFile() {}
+  ~MappedFile();
+
+  MappedFile(MappedFile &) = delete;
+  const MappedFile &operator=(MappedFile &) = delete;
+
+  // Map the whole file, returns false if the file can't be opened or is
+  // empty, the previous mapping is released first.
+  bool Open(const std::string &path);
+  void Close();
+
+  bool IsOpen() const { return data != nullptr; }
+  const char *Data() const { return data; }
+  size_t Size() const { return size; }
+
+private:
+  const char *data = nullptr;
+  size_t size = 0;
+#if _WIN32
+  void *fileHandle = nullptr, *mappingHandle = nullptr;
+#endif
+};
+
+}; // namespace aEngine
@@ -0,0 +1,148 @@
+#include "Function/General/Scheduler.hpp"
+#include "Function/General/Utils.hpp"
+#include "Global.hpp"
+
+namespace aEngine {
+
+TaskHandle TaskScheduler::Submit(std::string name, TaskStep step,
+                                 float budgetMs, int priority) {
+  Task task;
+  task.handle = nextHandle++;
+  task.step = step;
+  task.stats.name = name;
+  task.stats.priority = priority;
+  task.stats.budgetMs = budgetMs;
+  // keep the tasks ordered by priority, tasks with the same priority run in
+  // the order they are submitted
+  auto it = std::upper_bound(
+      tasks.begin(), tasks.end(), priority,
+      [](int p, const Task &t) { return p > t.stats.priority; });
+  auto handle = task.handle;
+  tasks.insert(it, std::move(task));
+  return handle;
+}
+
+void TaskScheduler::Cancel(TaskHandle handle) {
+  auto it = std::find_if(tasks.begin(), tasks.end(), [&](const Task &t) {
+    return t.handle == handle;
+  });
+  if (it != tasks.end())
+    tasks.erase(it);
+}
+
+bool TaskScheduler::Pending(TaskHandle handle) const {
+  return std::find_if(tasks.begin(), tasks.end(), [&](const Task &t) {
+           return t.handle == handle;
+         }) != tasks.end();
+}
+
+void TaskScheduler::Run(float availableMs) {
+  Timer frameTimer;
+  lastAvailableMs = availableMs;
+  // the step function could submit or cancel tasks, so only run the tasks
+  // existing at the start of this frame
+  std::vector<TaskHandle> handles;
+  for (auto &task : tasks)
+    handles.push_back(task.handle);
+  // the first task still runs one step when the frame is over budget, so the
+  // tasks keep progressing on a scene that never leaves any time
+  bool progressed = false;
+  for (auto handle : handles) {
+    auto it = std::find_if(tasks.begin(), tasks.end(), [&](const Task &t) {
+      return t.handle == handle;
+    });
+    if (it == tasks.end())
+      continue;
+    float remaining = availableMs - frameTimer.ElapsedMilliseconds();
+    if (remaining <= 0.0f && progressed) {
+      it->stats.starved++;
+      it->stats.starvedLastRun = true;
+      continue;
+    }
+    it->stats.starvedLastRun = false;
+    progressed = true;
+    float slice = std::max(0.0f, std::min(remaining, it->stats.budgetMs));
+    // copy the step function, the vector could be modified inside
+    auto step = it->step;
+    Timer taskTimer;
+    bool done = false;
+    uint64_t steps = 0;
+    do {
+      done = step();
+      steps++;
+    } while (!done && taskTimer.ElapsedMilliseconds() < slice);
+    float used = taskTimer.ElapsedMilliseconds();
+
+    it = std::find_if(tasks.begin(), tasks.end(), [&](const Task &t) {
+      return t.handle == handle;
+    });
+    if (it == tasks.end())
+      continue;
+    auto &stats = it->stats;
+    stats.lastFrameMs = used;
+    stats.totalMs += used;
+    stats.steps += steps;
+    if (used > stats.budgetMs) {
+      stats.overruns++;
+      totalOverruns++;
+      stats.worstOverrunMs =
+          std::max(stats.worstOverrunMs, used - stats.budgetMs);
+    }
+    if (done) {
+      finished.push_front(stats);
+      if (finished.size() > maxFinishedRecords)
+        finished.pop_back();
+      tasks.erase(it);
+    }
+  }
+  lastRunMs = frameTimer.ElapsedMilliseconds();
+}
+
+void TaskScheduler::Clear() { tasks.clear(); }
+
+const std::vector<TaskStats> TaskScheduler::GetPendingStats() const {
+  std::vector<TaskStats> result;
+  for (auto &task : tasks)
+    result.push_back(task.stats);
+  return result;
+}
+
+void TaskScheduler::PlotProfile() {
+  ImGui::Text("Pending Tasks: %d", (int)tasks.size());
+  ImGui::Text("Scheduler Time: %.4f / %.4f ms", lastRunMs,
+              std::max(lastAvailableMs, 0.0f));
+  ImGui::Text("Budget Overruns: %lu", (unsigned long)totalOverruns);
+  auto plotTable = [](const char *label, const TaskStats &stats) {
+    ImGui::TableNextRow();
+    ImGui::TableSetColumnIndex(0);
+    ImGui::Text("%s", stats.name.c_str());
+    ImGui::TableSetColumnIndex(1);
+    ImGui::Text("%d", stats.priority);
+    ImGui::TableSetColumnIndex(2);
+    ImGui::Text("%.2f/%.2f", stats.lastFrameMs, stats.budgetMs);
+    ImGui::TableSetColumnIndex(3);
+    if (stats.overruns > 0)
+      ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%lu (+%.2f ms)",
+                         (unsigned long)stats.overruns, stats.worstOverrunMs);
+    else
+      ImGui::Text("0");
+    ImGui::TableSetColumnIndex(4);
+    ImGui::Text("%s", label);
+  };
+  if (ImGui::BeginTable("scheduler tasks", 5,
+                        ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+    ImGui::TableSetupColumn("Task");
+    ImGui::TableSetupColumn("Priority");
+    ImGui::TableSetupColumn("Last/Budget ms");
+    ImGui::TableSetupColumn("Overruns");
+    ImGui::TableSetupColumn("State");
+    ImGui::TableHeadersRow();
+    for (auto &task : tasks)
+      plotTable(task.stats.starvedLastRun ? "starved" : "running", task.stats);
+    for (auto &stats : finished)
+      plotTable("finished", stats);
+    ImGui::EndTable();
+  }
+}
+
+}; // namespace aEngine
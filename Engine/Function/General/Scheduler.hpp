@@ -0,0 +1,92 @@
+/**
+ * Time sliced scheduler for work that can be spread across frames, like the
+ * blend shape buffer fills after a scene is loaded. A task is a resumable unit of work, the step
+ * function does a small amount of work each time it gets called and returns
+ * true once the whole task is finished.
+ *
+ * The scene runs the scheduler after the main update with the time left
+ * before the frame reaches its target frame time. Tasks with higher priority
+ * run first, each task won't run longer than its own per-frame budget. When no
+ * time is left, the task with the highest priority still runs a single step,
+ * so every task finishes even if the frame is always over budget. When a
+ * single step takes longer than the budget of the task, an overrun is recorded
+ * and shown in the profiler, so the step size can be tuned.
+ *
+ * All the tasks run on the main thread.
+ */
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace aEngine {
+
+using TaskHandle = uint64_t;
+
+// returns true when the task is finished
+using TaskStep = std::function<bool(void)>;
+
+struct TaskStats {
+  std::string name;
+  int priority = 0;
+  float budgetMs = 1.0f;
+  // time spent in the last frame this task got executed
+  float lastFrameMs = 0.0f;
+  float totalMs = 0.0f;
+  uint64_t steps = 0;
+  // frames when the task exceeds its own budget
+  uint64_t overruns = 0;
+  // frames when there's no time left for this task
+  uint64_t starved = 0;
+  bool starvedLastRun = false;
+  float worstOverrunMs = 0.0f;
+};
+
+class TaskScheduler {
+public:
+  TaskScheduler() {}
+  ~TaskScheduler() {}
+
+  // Register a resumable task, `budgetMs` is the maximum time this task can
+  // take in one frame, tasks with larger priority runs first.
+  TaskHandle Submit(std::string name, TaskStep step, float budgetMs = 1.0f,
+                    int priority = 0);
+
+  // Remove the task from scheduler, nothing happens if the task is finished.
+  void Cancel(TaskHandle handle);
+
+  // Returns true if the task is still waiting to be finished.
+  bool Pending(TaskHandle handle) const;
+
+  // Run the tasks for at most `availableMs` milliseconds, at least one step of
+  // the first task runs even if `availableMs` is not positive.
+  void Run(float availableMs);
+
+  // Remove all the tasks without running them.
+  void Clear();
+
+  void PlotProfile();
+
+  const std::vector<TaskStats> GetPendingStats() const;
+
+private:
+  struct Task {
+    TaskHandle handle;
+    TaskStep step;
+    TaskStats stats;
+  };
+  std::vector<Task> tasks;
+  // stats of recently finished tasks
+  std::deque<TaskStats> finished;
+  const size_t maxFinishedRecords = 8;
+  TaskHandle nextHandle = 1;
+
+  // time used by the scheduler in last frame
+  float lastRunMs = 0.0f, lastAvailableMs = 0.0f;
+  uint64_t totalOverruns = 0;
+};
+
+}; // namespace aEngine
@@ -0,0 +1,99 @@
+#include "Function/General/ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace aEngine {
+
+ThreadPool::ThreadPool(int numWorkers) {
+  if (numWorkers < 0)
+    numWorkers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+  for (int i = 0; i < numWorkers; ++i)
+    workers.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    stopping = true;
+  }
+  jobsCondition.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    jobs.push_back(std::move(job));
+  }
+  jobsCondition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(jobsMutex);
+      jobsCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      if (stopping && jobs.empty())
+        return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+void ThreadPool::ParallelFor(int begin, int end, int grain,
+                             const std::function<void(int, int)> &func) {
+  if (end <= begin)
+    return;
+  grain = std::max(grain, 1);
+  int numChunks = (end - begin + grain - 1) / grain;
+  if (numChunks == 1 || workers.empty()) {
+    func(begin, end);
+    return;
+  }
+  // shared with the helper jobs, which may start after this call returns
+  struct ForState {
+    std::atomic<int> nextChunk{0}, finishedChunks{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+  };
+  auto state = std::make_shared<ForState>();
+  auto runChunks = [state, &func, begin, end, grain, numChunks]() {
+    int chunk;
+    while ((chunk = state->nextChunk.fetch_add(1)) < numChunks) {
+      int chunkBegin = begin + chunk * grain;
+      int chunkEnd = std::min(end, chunkBegin + grain);
+      try {
+        func(chunkBegin, chunkEnd);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->error)
+          state->error = std::current_exception();
+      }
+      if (state->finishedChunks.fetch_add(1) + 1 == numChunks) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done.notify_all();
+      }
+    }
+  };
+  int numHelpers = std::min<int>(workers.size(), numChunks - 1);
+  for (int i = 0; i < numHelpers; ++i) {
+    // a helper starting after all chunks are claimed won't touch `func`
+    enqueue([state, numChunks, runChunks]() {
+      if (state->nextChunk.load() < numChunks)
+        runChunks();
+    });
+  }
+  runChunks();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(
+      lock, [&]() { return state->finishedChunks.load() == numChunks; });
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+}; // namespace aEngine
@@ -0,0 +1,69 @@
+/**
+ * A fixed size pool of worker threads shared by the whole engine, used for
+ * data parallel work like batched forward kinematics or offline database
+ * builds.
+ *
+ * `ParallelFor` splits a range into chunks of `grain` elements, the calling
+ * thread works on the chunks too, so it's safe to call `ParallelFor` from
+ * inside another `ParallelFor`, the nested call simply runs on fewer
+ * threads. Exceptions thrown by the chunk function are rethrown on the
+ * calling thread.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aEngine {
+
+class ThreadPool {
+public:
+  ThreadPool(int numWorkers = -1);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool &) = delete;
+  const ThreadPool &operator=(ThreadPool &) = delete;
+
+  static ThreadPool &Ref() {
+    static ThreadPool reference;
+    return reference;
+  }
+
+  // Number of threads working on a `ParallelFor`, including the caller.
+  int NumThreads() const { return workers.size() + 1; }
+
+  // Call `func(chunkBegin, chunkEnd)` for every chunk of [begin, end),
+  // blocks until all the chunks are finished.
+  void ParallelFor(int begin, int end, int grain,
+                   const std::function<void(int, int)> &func);
+
+  // Run `func` on a worker thread.
+  template <typename F> auto Submit(F &&func) {
+    using R = decltype(func());
+    auto task =
+        std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+    auto result = task->get_future();
+    enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> jobs;
+  std::mutex jobsMutex;
+  std::condition_variable jobsCondition;
+  bool stopping = false;
+
+  void enqueue(std::function<void()> job);
+  void workerLoop();
+};
+
+}; // namespace aEngine
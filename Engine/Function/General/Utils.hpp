@@ -8,7 +8,7 @@
 namespace aEngine {
 
 // Returns a double between 0.0 and 1.0
-double RandDouble() {
+inline double RandDouble() {
   std::random_device rd;
   std::mt19937 gen(rd());
   std::uniform_real_distribution<> dis(0.0, 1.0);
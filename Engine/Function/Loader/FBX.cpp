@@ -1,3 +1,4 @@
+#include "Function/Animation/MotionCache.hpp"
 #include "Function/AssetsLoader.hpp"
 #include "System/Animation/AnimationSystem.hpp"
 
@@ -107,13 +108,27 @@ void AssetsLoader::loadFBXModelFile(std::vector<Render::Mesh *> &meshes,
     }
     std::vector<std::vector<KeyFrame>> animationPerJoint(globalBones.size(),
                                                          vector<KeyFrame>());
+    // the frames of a previously imported animation are mapped from its
+    // cache, as long as it was sampled at the same rate
+    Animation::Motion cachedMotion;
+    bool motionCached = false;
     if (longestAnimInd != -1) {
       auto anim = scene->anim_stacks[longestAnimInd]
                       ->anim; // import the active animation only
       auto animSystem = GWORLD.GetSystemInstance<AnimationSystem>();
       auto startTime = anim->time_begin, endTime = anim->time_end;
       double sampleDelta = 1.0 / animSystem->SystemFPS;
-      for (auto jointInd = 0; jointInd < globalBones.size(); ++jointInd) {
+      int numSamples = 0;
+      for (double currentTime = startTime; currentTime < endTime;
+           currentTime += sampleDelta)
+        ++numSamples;
+      motionCached =
+          Animation::LoadMotionCache(cachedMotion, modelPath,
+                                     MotionCacheDir) &&
+          cachedMotion.NumFrames() == numSamples &&
+          cachedMotion.skeleton.GetNumJoints() == globalBones.size();
+      for (auto jointInd = 0; !motionCached && jointInd < globalBones.size();
+           ++jointInd) {
         auto jointNode = globalBones[jointInd].node;
         for (double currentTime = startTime; currentTime < endTime;
              currentTime += sampleDelta) {
@@ -166,7 +181,8 @@ void AssetsLoader::loadFBXModelFile(std::vector<Render::Mesh *> &meshes,
       skel->offsetMatrices.push_back(globalBones[jointInd].offsetMatrix);
     }
     // create motion for the skeleton
-    int numFrames = animationPerJoint[0].size();
+    int numFrames = motionCached ? cachedMotion.NumFrames()
+                                 : animationPerJoint[0].size();
     int numJoints = animationPerJoint.size();
     if (numFrames > 0) {
       Animation::Motion *motion = new Animation::Motion();
@@ -174,20 +190,32 @@ void AssetsLoader::loadFBXModelFile(std::vector<Render::Mesh *> &meshes,
       motion->skeleton = *skel;
       motion->path = modelPath;
       allMotions.insert(std::make_pair(modelPath, motion));
-      for (int frameInd = 0; frameInd < numFrames; ++frameInd) {
-        Animation::Pose pose;
-        pose.skeleton = skel;
-        pose.jointRotations.resize(numJoints, glm::quat(1.0f, glm::vec3(0.0f)));
-        for (int jointInd = 0; jointInd < numJoints; ++jointInd) {
-          if (jointInd == 0) {
-            // process localPosition only for root joint
-            pose.rootLocalPosition =
-                animationPerJoint[jointInd][frameInd].localPosition;
+      if (motionCached) {
+        motion->SetPackedFramesView(numFrames, cachedMotion.PackedRotations(),
+                                    cachedMotion.PackedRootPositions(),
+                                    cachedMotion.viewOwner);
+        motion->rootTrack = std::move(cachedMotion.rootTrack);
+      } else {
+        for (int frameInd = 0; frameInd < numFrames; ++frameInd) {
+          Animation::Pose pose;
+          pose.skeleton = skel;
+          pose.jointRotations.resize(numJoints,
+                                     glm::quat(1.0f, glm::vec3(0.0f)));
+          for (int jointInd = 0; jointInd < numJoints; ++jointInd) {
+            if (jointInd == 0) {
+              // process localPosition only for root joint
+              pose.rootLocalPosition =
+                  animationPerJoint[jointInd][frameInd].localPosition;
+            }
+            pose.jointRotations[jointInd] =
+                animationPerJoint[jointInd][frameInd].localRotation;
           }
-          pose.jointRotations[jointInd] =
-              animationPerJoint[jointInd][frameInd].localRotation;
+          motion->poses.push_back(pose);
         }
-        motion->poses.push_back(pose);
+        motion->UpdatePackedFrames();
+        if (!Animation::SaveMotionCache(*motion, modelPath, MotionCacheDir))
+          LOG_F(WARNING, "failed to write motion cache of %s",
+                modelPath.c_str());
       }
     }
   }
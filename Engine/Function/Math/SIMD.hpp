@@ -0,0 +1,217 @@
+/**
+ * A thin wrapper over the widest float vector available at compile time,
+ * AVX (8 lanes) when the engine is built with `AENGINE_ENABLE_AVX2`, SSE
+ * (4 lanes) on any x86_64 target, and a plain float otherwise.
+ *
+ * Kernels are written once against `Math::FloatN` and process
+ * `FloatN::Width` elements per iteration, the tail is handled by padding
+ * the data to `SIMD_PADDING` floats.
+ *
+ * No fused multiply-add is ever emitted here, so a kernel that replicates
+ * glm's operation order produces bit-identical results to the scalar code.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define AENGINE_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) ||                                 \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AENGINE_SIMD_SSE
+#endif
+
+namespace aEngine {
+
+namespace Math {
+
+// Every SoA buffer consumed by SIMD kernels pads its rows to a multiple of
+// this, so that the widest vector never reads past the end of a row.
+constexpr int SIMD_PADDING = 8;
+
+inline int PadToSIMD(int n) {
+  return (n + SIMD_PADDING - 1) / SIMD_PADDING * SIMD_PADDING;
+}
+
+#if defined(AENGINE_SIMD_AVX)
+
+struct FloatN {
+  static constexpr int Width = 8;
+  __m256 v;
+
+  FloatN() = default;
+  FloatN(__m256 x) : v(x) {}
+  explicit FloatN(float x) : v(_mm256_set1_ps(x)) {}
+
+  static FloatN Load(const float *p) { return _mm256_loadu_ps(p); }
+  void Store(float *p) const { _mm256_storeu_ps(p, v); }
+
+  friend FloatN operator+(FloatN a, FloatN b) { return _mm256_add_ps(a.v, b.v); }
+  friend FloatN operator-(FloatN a, FloatN b) { return _mm256_sub_ps(a.v, b.v); }
+  friend FloatN operator*(FloatN a, FloatN b) { return _mm256_mul_ps(a.v, b.v); }
+  friend FloatN operator/(FloatN a, FloatN b) { return _mm256_div_ps(a.v, b.v); }
+  friend FloatN operator-(FloatN a) {
+    return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f));
+  }
+  friend FloatN operator&(FloatN a, FloatN b) { return _mm256_and_ps(a.v, b.v); }
+  friend FloatN operator^(FloatN a, FloatN b) { return _mm256_xor_ps(a.v, b.v); }
+  friend FloatN operator<(FloatN a, FloatN b) {
+    return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ);
+  }
+  friend FloatN operator>(FloatN a, FloatN b) {
+    return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ);
+  }
+};
+
+inline FloatN Sqrt(FloatN a) { return _mm256_sqrt_ps(a.v); }
+inline FloatN Min(FloatN a, FloatN b) { return _mm256_min_ps(a.v, b.v); }
+inline FloatN Max(FloatN a, FloatN b) { return _mm256_max_ps(a.v, b.v); }
+// Lanes with `mask` set take `a`, the rest take `b`.
+inline FloatN Select(FloatN mask, FloatN a, FloatN b) {
+  return _mm256_blendv_ps(b.v, a.v, mask.v);
+}
+// Bit mask of the lanes set in `mask`, lane 0 is the lowest bit.
+inline int MoveMask(FloatN mask) { return _mm256_movemask_ps(mask.v); }
+// Lane i takes `base[indices[i]]`.
+inline FloatN Gather(const float *base, const int *indices) {
+#if defined(__AVX2__)
+  return _mm256_i32gather_ps(
+      base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices)),
+      4);
+#else
+  return _mm256_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]],
+                        base[indices[3]], base[indices[4]], base[indices[5]],
+                        base[indices[6]], base[indices[7]]);
+#endif
+}
+
+#elif defined(AENGINE_SIMD_SSE)
+
+struct FloatN {
+  static constexpr int Width = 4;
+  __m128 v;
+
+  FloatN() = default;
+  FloatN(__m128 x) : v(x) {}
+  explicit FloatN(float x) : v(_mm_set1_ps(x)) {}
+
+  static FloatN Load(const float *p) { return _mm_loadu_ps(p); }
+  void Store(float *p) const { _mm_storeu_ps(p, v); }
+
+  friend FloatN operator+(FloatN a, FloatN b) { return _mm_add_ps(a.v, b.v); }
+  friend FloatN operator-(FloatN a, FloatN b) { return _mm_sub_ps(a.v, b.v); }
+  friend FloatN operator*(FloatN a, FloatN b) { return _mm_mul_ps(a.v, b.v); }
+  friend FloatN operator/(FloatN a, FloatN b) { return _mm_div_ps(a.v, b.v); }
+  friend FloatN operator-(FloatN a) {
+    return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f));
+  }
+  friend FloatN operator&(FloatN a, FloatN b) { return _mm_and_ps(a.v, b.v); }
+  friend FloatN operator^(FloatN a, FloatN b) { return _mm_xor_ps(a.v, b.v); }
+  friend FloatN operator<(FloatN a, FloatN b) { return _mm_cmplt_ps(a.v, b.v); }
+  friend FloatN operator>(FloatN a, FloatN b) { return _mm_cmpgt_ps(a.v, b.v); }
+};
+
+inline FloatN Sqrt(FloatN a) { return _mm_sqrt_ps(a.v); }
+inline FloatN Min(FloatN a, FloatN b) { return _mm_min_ps(a.v, b.v); }
+inline FloatN Max(FloatN a, FloatN b) { return _mm_max_ps(a.v, b.v); }
+inline FloatN Select(FloatN mask, FloatN a, FloatN b) {
+  return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+inline int MoveMask(FloatN mask) { return _mm_movemask_ps(mask.v); }
+inline FloatN Gather(const float *base, const int *indices) {
+  return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]],
+                     base[indices[3]]);
+}
+
+#else
+
+// Scalar fallback, comparison results are stored as all-ones bit patterns
+// just like the vector versions so that the bit operations behave the same.
+struct FloatN {
+  static constexpr int Width = 1;
+  float v;
+
+  FloatN() = default;
+  explicit FloatN(float x) : v(x) {}
+
+  static FloatN Load(const float *p) { return FloatN(*p); }
+  void Store(float *p) const { *p = v; }
+
+  static uint32_t Bits(float x) {
+    uint32_t b;
+    std::memcpy(&b, &x, sizeof(float));
+    return b;
+  }
+  static FloatN FromBits(uint32_t b) {
+    float x;
+    std::memcpy(&x, &b, sizeof(float));
+    return FloatN(x);
+  }
+
+  friend FloatN operator+(FloatN a, FloatN b) { return FloatN(a.v + b.v); }
+  friend FloatN operator-(FloatN a, FloatN b) { return FloatN(a.v - b.v); }
+  friend FloatN operator*(FloatN a, FloatN b) { return FloatN(a.v * b.v); }
+  friend FloatN operator/(FloatN a, FloatN b) { return FloatN(a.v / b.v); }
+  friend FloatN operator-(FloatN a) { return FloatN(-a.v); }
+  friend FloatN operator&(FloatN a, FloatN b) {
+    return FromBits(Bits(a.v) & Bits(b.v));
+  }
+  friend FloatN operator^(FloatN a, FloatN b) {
+    return FromBits(Bits(a.v) ^ Bits(b.v));
+  }
+  friend FloatN operator<(FloatN a, FloatN b) {
+    return FromBits(a.v < b.v ? 0xffffffffu : 0u);
+  }
+  friend FloatN operator>(FloatN a, FloatN b) {
+    return FromBits(a.v > b.v ? 0xffffffffu : 0u);
+  }
+};
+
+inline FloatN Sqrt(FloatN a) { return FloatN(std::sqrt(a.v)); }
+inline FloatN Min(FloatN a, FloatN b) { return FloatN(b.v < a.v ? b.v : a.v); }
+inline FloatN Max(FloatN a, FloatN b) { return FloatN(a.v < b.v ? b.v : a.v); }
+inline FloatN Select(FloatN mask, FloatN a, FloatN b) {
+  return FloatN::Bits(mask.v) ? a : b;
+}
+inline int MoveMask(FloatN mask) { return FloatN::Bits(mask.v) >> 31; }
+inline FloatN Gather(const float *base, const int *indices) {
+  return FloatN(base[indices[0]]);
+}
+
+#endif
+
+inline FloatN Abs(FloatN a) { return a ^ (a & FloatN(-0.0f)); }
+// The sign bit of each lane, xor a value with it to copy the sign over.
+inline FloatN SignBit(FloatN a) { return a & FloatN(-0.0f); }
+
+// Shortest path nlerp between quaternions `(x, y, z, w)` and
+// `(bx, by, bz, bw)`, the result is written to `(x, y, z, w)`. The
+// parameter is corrected so that the angular velocity closely matches
+// slerp, see https://zeux.io/2015/07/23/approximating-slerp/
+inline void QuatNlerp(FloatN &x, FloatN &y, FloatN &z, FloatN &w, FloatN bx,
+                      FloatN by, FloatN bz, FloatN bw, FloatN t) {
+  const FloatN one(1.0f);
+  FloatN cosTheta = x * bx + y * by + z * bz + w * bw;
+  FloatN sign = SignBit(cosTheta);
+  bx = bx ^ sign, by = by ^ sign, bz = bz ^ sign, bw = bw ^ sign;
+  FloatN d = Abs(cosTheta);
+  FloatN A = FloatN(1.0904f) +
+             d * (FloatN(-3.2452f) + d * (FloatN(3.55645f) - d * FloatN(1.43519f)));
+  FloatN B =
+      FloatN(0.848013f) + d * (FloatN(-1.06021f) + d * FloatN(0.215638f));
+  FloatN tc = t - FloatN(0.5f);
+  FloatN k = A * tc * tc + B;
+  FloatN ot = t + t * tc * (t - one) * k;
+  x = x + (bx - x) * ot, y = y + (by - y) * ot, z = z + (bz - z) * ot,
+  w = w + (bw - w) * ot;
+  FloatN invLen = one / Sqrt(x * x + y * y + z * z + w * w);
+  x = x * invLen, y = y * invLen, z = z * invLen, w = w * invLen;
+}
+
+}; // namespace Math
+
+}; // namespace aEngine
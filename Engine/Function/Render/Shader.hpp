@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Global.hpp"
+#include "Base/Name.hpp"
 #include "Function/AssetsType.hpp"
 
 namespace aEngine {
@@ -9,7 +10,7 @@ namespace Render {
 
 class Shader {
 public:
-  std::string identifier;
+  Name identifier;
   unsigned int ID = 0;
   // do nothing at the constructor
   Shader() {}
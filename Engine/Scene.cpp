@@ -58,20 +58,37 @@ void Scene::Update() {
   float t0 = GetTime();
   // update the transforms first
   refreshEntities();
+  // publish the settled transforms of last frame as a readonly snapshot
+  float ts = GetTime();
+  snapshot.Capture(entities, Context);
   float t1 = GetTime();
 
+  // deliver the events from input callbacks and last frame
+  Events.Dispatch(EventPhase::FrameBegin);
   // pre-update the readonly variables for Update
   for (auto &system : registeredSystems)
     system.second->PreUpdate(Context.deltaTime);
   // the main update for all systems
   for (auto &system : registeredSystems)
     system.second->Update(Context.deltaTime);
+  Events.Dispatch(EventPhase::PostUpdate);
 
   // call late update
   GetSystemInstance<NativeScriptSystem>()->LateUpdate(Context.deltaTime);
+  Events.Dispatch(EventPhase::PostLateUpdate);
   float t2 = GetTime();
-  Context.hierarchyUpdateTime = t1 - t0;
+
+  // run time sliced tasks with the time left, the render time of last frame
+  // is used as an estimation to the render time of this frame
+  float available = Context.targetFrameTime - (t2 - t0) - Context.renderTime -
+                    Context.debugDrawTime;
+  Scheduler.Run(available * 1000.0f);
+  float t3 = GetTime();
+
+  Context.hierarchyUpdateTime = ts - t0;
+  Context.snapshotTime = t1 - ts;
   Context.updateTime = t2 - t1;
+  Context.schedulerTime = t3 - t2;
 
   // do the rendering
   ForceRender();
@@ -122,6 +139,9 @@ void Scene::Reset() {
   HierarchyRoots.clear();
   entitiesSignatures.clear();
   entities.clear();
+  snapshot.Clear();
+  Scheduler.Clear();
+  Events.Clear();
 
   // reset scene context
   Context.Reset();
@@ -184,7 +204,7 @@ bool Scene::SetActiveCamera(EntityID camera) {
 std::shared_ptr<Entity> Scene::AddNewEntity() {
   const EntityID id = addNewEntity();
   entities.insert(std::make_pair(id, std::make_shared<Entity>(id)));
-  entities[id]->name += std::to_string(id);
+  entities[id]->name = entities[id]->name + std::to_string(id);
   return entities[id];
 }
 
@@ -241,6 +261,7 @@ void Scene::DestroyEntity(const EntityID entity) {
     }
     entityCount--;
     availableEntities.push(id);
+    Events.Publish(EntityDestroyedEvent{id});
   };
 
   while (!s1.empty()) {
@@ -419,10 +440,11 @@ bool Scene::Load(std::string path) {
     ia(Loader.allMaterials);
 
     // 5. Perform some component specific caching
-    //   a. Compute the blend shape data for <DeformRenderer> if any
+    //   a. Compute the blend shape data for <DeformRenderer> if any, the
+    //   buffers are filled across frames by the scheduler
     auto &deformRenderers = GetComponentList<DeformRenderer>();
     for (const auto &deformRenderer : deformRenderers->data)
-      deformRenderer->FillBlendShapeDataBuffer();
+      deformRenderer->ScheduleBlendShapeDataFill();
 
     return true;
   } else {
@@ -437,12 +459,16 @@ void Scene::PlotSceneProfile() {
   static float mainUpdateTime = 0.0f, displayMainUpdateTime = 0.0f;
   static float debugRenderTime = 0.0f, displayDebugRenderTime = 0.0f;
   static float hierarchyUpdateTime = 0.0f, displayHierarchyUpdateTime = 0.0f;
+  static float snapshotTime = 0.0f, displaySnapshotTime = 0.0f;
+  static float schedulerTime = 0.0f, displaySchedulerTime = 0.0f;
   static int frameCounter = 0, displayFPS = 0;
   timeCounter += Context.deltaTime;
   mainUpdateTime += Context.updateTime;
   mainRenderTime += Context.renderTime;
   debugRenderTime += Context.debugDrawTime;
   hierarchyUpdateTime += Context.hierarchyUpdateTime;
+  snapshotTime += Context.snapshotTime;
+  schedulerTime += Context.schedulerTime;
   frameCounter++;
   if (timeCounter >= 0.5f) {
     displayFPS = frameCounter * 2;
@@ -450,10 +476,14 @@ void Scene::PlotSceneProfile() {
     displayMainUpdateTime = mainUpdateTime / frameCounter;
     displayDebugRenderTime = debugRenderTime / frameCounter;
     displayHierarchyUpdateTime = hierarchyUpdateTime / frameCounter;
+    displaySnapshotTime = snapshotTime / frameCounter;
+    displaySchedulerTime = schedulerTime / frameCounter;
     mainRenderTime = 0.0f;
     mainUpdateTime = 0.0f;
     debugRenderTime = 0.0f;
     hierarchyUpdateTime = 0.0f;
+    snapshotTime = 0.0f;
+    schedulerTime = 0.0f;
     frameCounter = 0;
     timeCounter = 0.0f;
   }
@@ -462,8 +492,12 @@ void Scene::PlotSceneProfile() {
   ImGui::Text("%d", displayFPS);
   ImGui::MenuItem("Hierarchy Update:", nullptr, nullptr, false);
   ImGui::Text("%.4f ms", displayHierarchyUpdateTime * 1000);
+  ImGui::MenuItem("Snapshot Capture:", nullptr, nullptr, false);
+  ImGui::Text("%.4f ms", displaySnapshotTime * 1000);
   ImGui::MenuItem("Main Update:", nullptr, nullptr, false);
   ImGui::Text("%.4f ms", displayMainUpdateTime * 1000);
+  ImGui::MenuItem("Time Sliced Tasks:", nullptr, nullptr, false);
+  ImGui::Text("%.4f ms", displaySchedulerTime * 1000);
   ImGui::MenuItem("Main Render:", nullptr, nullptr, false);
   ImGui::Text("%.4f ms", displayMainRenderTime * 1000);
   ImGui::MenuItem("Debug Render:", nullptr, nullptr, false);
@@ -471,6 +505,15 @@ void Scene::PlotSceneProfile() {
   ImGui::MenuItem("Delta Time:", nullptr, nullptr, false);
   ImGui::Text("%.4f ms", 1000.0f / displayFPS);
 
+  ImGui::SeparatorText("Scheduler");
+  float targetFPS = 1.0f / Context.targetFrameTime;
+  if (ImGui::SliderFloat("Target FPS", &targetFPS, 10.0f, 240.0f))
+    Context.targetFrameTime = 1.0f / targetFPS;
+  Scheduler.PlotProfile();
+
+  ImGui::SeparatorText("Animation LOD");
+  GetSystemInstance<AnimationSystem>()->PlotLODProfile();
+
   ImGui::SeparatorText("Objects");
   ImGui::MenuItem("Active Camera:", nullptr, nullptr, false);
   ImGui::Text("Entity ID: %d",
@@ -19,6 +19,11 @@
 #include "Base/Types.hpp"
 
 #include "Global.hpp"
+#include "Snapshot.hpp"
+
+#include "Base/Events.hpp"
+#include "Function/General/EventBus.hpp"
+#include "Function/General/Scheduler.hpp"
 
 namespace aEngine {
 
@@ -52,6 +57,10 @@ struct SceneContext {
   float updateTime;
   float debugDrawTime;
   float hierarchyUpdateTime;
+  float snapshotTime;
+  float schedulerTime;
+  // the time sliced tasks only run when the frame is faster than this
+  float targetFrameTime = 1.0f / 60.0f;
 
   // Update deltaTime
   void Tick() {
@@ -73,6 +82,8 @@ struct SceneContext {
     updateTime = 0.0f;
     debugDrawTime = 0.0f;
     hierarchyUpdateTime = 0.0f;
+    snapshotTime = 0.0f;
+    schedulerTime = 0.0f;
   }
 
   template <typename Archive>
@@ -213,6 +224,18 @@ public:
 
   SceneContext Context;
 
+  // The world as it was at the end of last frame, the snapshot is immutable
+  // during the current frame so it can be read from worker threads.
+  const SnapshotFrame &PreviousFrame() const { return snapshot.Read(); }
+
+  // Resumable tasks spread across frames, executed after the main update
+  // with the time left in current frame.
+  TaskScheduler Scheduler;
+
+  // Events published during the frame are delivered at fixed phases of
+  // `Update`, see `EventPhase`.
+  EventBus Events;
+
   // Call the start function of all the systems,
   // initialize scene context
   void Start();
@@ -330,6 +353,8 @@ private:
 
   void refreshEntities();
 
+  WorldSnapshot snapshot;
+
   // how many entities have been created
   EntityID entityCount;
   std::queue<EntityID> availableEntities;
@@ -1,5 +1,5 @@
 #include "Scripts/Animation/IK/TwoBoneIK.hpp"
-#include "Function/Animation/Motion.hpp"
+#include "Function/Animation/IK.hpp"
 #include "Function/GUI/Helpers.hpp"
 #include "Function/Math/Math.hpp"
 #include "Function/Render/VisUtils.hpp"
@@ -12,32 +12,40 @@ void twoboneikDragableTarget(Entity **joint, std::vector<char> &namebuffer,
 void TwoBoneIK::LateUpdate(float dt) {
   if (joint0 && joint1 && joint2 && target && pole) {
     auto p0 = joint0->Position(), p1 = joint1->Position(),
-         p2 = joint2->Position(), pt = target->Position();
-    auto dir01 = p1 - p0, dir12 = p2 - p1;
-    float dist = glm::length(pt - p0);
-    auto dir = glm::normalize(pt - p0);
-    auto normal =
-        glm::normalize(glm::cross(glm::normalize(pole->Position() - p0),
-                                  glm::normalize(p2 - pole->Position())));
-    if (glm::abs(dist - l01 - l12) < 1e-3f) {
-      p1 = p0 + l01 * dir;
-      p2 = p0 + (l01 + l12) * dir;
-    } else {
-      auto h = glm::normalize(glm::cross(dir, normal));
-      float cosalpha = glm::clamp((l01 * l01 + dist * dist - l12 * l12) /
-                                      (2.0f * l01 * dist),
-                                  0.0f, 1.0f);
-      p1 = glm::sqrt(glm::abs(1.0f - cosalpha * cosalpha)) * l01 * h +
-           cosalpha * l01 * dir + p0;
-      p2 = pt;
+         p2 = joint2->Position();
+    auto r0 = joint0->Rotation(), r1 = joint1->Rotation(),
+         r2 = joint2->Rotation();
+    // the offsets are measured from the global positions so the scale is
+    // included
+    limbOffsets[1] = glm::inverse(r0) * (p1 - p0);
+    limbOffsets[2] = glm::inverse(r1) * (p2 - p1);
+    if (limb.numPoses != 1) {
+      limb.Resize(3, 1);
+      targetPosition.Resize(1);
+      polePosition.Resize(1);
+      limbPose.jointRotations.resize(3);
     }
-    // joint0->SetGlobalRotation(glm::quatLookAt(
-    //     glm::normalize(glm::cross(glm::normalize(p1 - p0), normal)),
-    //     glm::normalize(p1 - p0)));
-    // joint1->SetGlobalRotation(glm::quatLookAt(
-    //     glm::normalize(glm::cross(glm::normalize(p2 - p1), normal)),
-    //     glm::normalize(p2 - p1)));
-    joint2->SetGlobalRotation(target->Rotation());
+    limbPose.rootLocalPosition = p0;
+    limbPose.jointRotations[0] = r0;
+    limbPose.jointRotations[1] = glm::inverse(r0) * r1;
+    limbPose.jointRotations[2] = glm::inverse(r1) * r2;
+    limb.SetPose(0, limbPose);
+    Animation::ForwardKinematics(limbParents, limbOffsets, limb, false);
+    // the target and the pole are moved by other scripts, follow them where
+    // they settled at the end of last frame so the result doesn't depend on
+    // the order of the scripts, entities created in this frame are read live
+    auto &previous = GWORLD.PreviousFrame();
+    auto targetState = previous.Get(target->ID);
+    auto poleState = previous.Get(pole->ID);
+    targetPosition.Set(0, targetState ? targetState->position
+                                      : target->Position());
+    polePosition.Set(0, poleState ? poleState->position : pole->Position());
+    Animation::SolveTwoBone(limbParents, limbOffsets, limb, limbChain,
+                            targetPosition, &polePosition, false);
+    joint0->SetGlobalRotation(limb.GetGlobalRotation(0, 0));
+    joint1->SetGlobalRotation(limb.GetGlobalRotation(0, 1));
+    joint2->SetGlobalRotation(targetState ? targetState->rotation
+                                          : target->Rotation());
   }
 }
 
@@ -62,11 +70,6 @@ void TwoBoneIK::DrawInspectorGUI() {
   twoboneikDragableTarget(&pole, poleNameBuffer, "Pole Object");
   twoboneikDragableTarget(&target, targetNameBuffer, "Target Object");
 
-  if (joint0 && joint1)
-    l01 = glm::length(joint0->Position() - joint1->Position());
-  if (joint1 && joint2)
-    l12 = glm::length(joint2->Position() - joint1->Position());
-
   ImGui::Separator();
   if (ImGui::Button("Create Target and Pole", {-1, 30})) {
     if (joint0 && joint1 && joint2) {
@@ -2,6 +2,8 @@
 
 #include "API.hpp"
 
+#include "Function/Animation/IK.hpp"
+
 namespace aEngine {
 
 class TwoBoneIK : public Scriptable {
@@ -39,7 +41,15 @@ private:
   Entity *joint0 = nullptr, *joint1 = nullptr, *joint2 = nullptr;
   Entity *pole = nullptr, *target = nullptr;
 
-  float visRadius = 0.1f, l01, l12;
+  float visRadius = 0.1f;
+  // the limb solved by `Animation::SolveTwoBone` as a skeleton of its own
+  // rooted at `joint0`, reused across frames
+  std::vector<int> limbParents = {-1, 0, 1};
+  std::vector<glm::vec3> limbOffsets = std::vector<glm::vec3>(3);
+  Animation::TwoBoneChain limbChain{0, 1, 2};
+  Animation::Pose limbPose;
+  Animation::PoseBatch limb;
+  Animation::IKTarget targetPosition, polePosition;
 };
 
 }; // namespace aEngine
\ No newline at end of file
@@ -1,21 +1,42 @@
 #include "Scripts/Animation/MotionMatching.hpp"
+#include "Function/Animation/Kinematics.hpp"
 
 #include "Function/GUI/Helpers.hpp"
+#include "Function/General/Utils.hpp"
 #include "Function/Math/Dampers.hpp"
 
 namespace aEngine {
 
-void buildMotionDatabase(std::string filepath, MotionDatabase &db, int lfoot,
-                         int rfoot, int hip);
-void loadMotionDatabase(std::string filepath, MotionDatabase &db);
-void saveMotionDatabase(std::string filepath, MotionDatabase &db);
+std::string buildMotionDatabase(std::string filepath,
+                                const Animation::FeatureExtractor &extractor);
+
+MotionMatching::MotionMatching() {
+  blockWeights.fill(1.0f);
+  queryJoysticks();
+  joystickSubscription = GWORLD.Events.Subscribe<InputEvent>(
+      EventPhase::FrameBegin, [this](const std::vector<InputEvent> &events) {
+        for (auto &event : events) {
+          if (event.device == InputDevice::Joystick) {
+            queryJoysticks();
+            return;
+          }
+        }
+      });
+}
+
+MotionMatching::~MotionMatching() {
+  GWORLD.Events.Unsubscribe(joystickSubscription);
+  if (pendingSearch != nullptr)
+    pendingSearch->Cancel();
+}
 
 void MotionMatching::Update(float dt) {
   // joystick related
-  queryJoysticks();
-  if (currentJoystick != -1) {
-    int axisCount;
-    const float *axes = glfwGetJoystickAxes(currentJoystick, &axisCount);
+  int axisCount = 0;
+  const float *axes = currentJoystick == -1
+                          ? nullptr
+                          : glfwGetJoystickAxes(currentJoystick, &axisCount);
+  if (axes != nullptr && axisCount >= 4) {
     leftInput = glm::vec2(axes[0], axes[1]);
     rightInput = glm::vec2(axes[2], axes[3]);
   } else {
@@ -55,7 +76,7 @@ void MotionMatching::Update(float dt) {
 void MotionMatching::LateUpdate(float dt) {
   // database query, update animator motion on a fixed frequency
   auto animator = entity->GetComponent<Animator>();
-  if (animator != nullptr && database.features.size() > 0) {
+  if (animator != nullptr && service != nullptr) {
     elapsedTime += dt;
     if (elapsedTime >= fixedUpdateTime) {
       while (elapsedTime >= fixedUpdateTime) {
@@ -90,60 +111,90 @@ void MotionMatching::LateUpdate(float dt) {
 }
 
 void MotionMatching::updateAnimatorMotion(std::shared_ptr<Animator> &animator) {
+  auto &database = service->Database();
   if (deltaRotation.empty())
     deltaRotation.resize(animator->jointEntityMap.size(),
                          glm::quat(1.0f, glm::vec3(0.0f)));
-  searchFrameCounter--;
-  if (searchFrameCounter <= 0 ||
-      (currentFrameInd + 1) >= database.data.size()) {
-    int bestFrameInd = currentFrameInd + 1;
-    glm::vec3 hipvel = database.data[bestFrameInd].velocities[hipIndex];
-    glm::vec3 hippos = database.data[bestFrameInd].positions[hipIndex];
-    std::array<glm::vec3, 2> lfootData{
-        database.data[bestFrameInd].positions[lfootIndex] - hippos,
-        database.data[bestFrameInd].velocities[lfootIndex]};
-    std::array<glm::vec3, 2> rfootData{
-        database.data[bestFrameInd].positions[rfootIndex] - hippos,
-        database.data[bestFrameInd].velocities[rfootIndex]};
-    std::array<glm::vec2, 4> trajData, facingDir;
-    trajData[0] = glm::vec2(0.0f);
-    auto playerPosProj = glm::vec2(playerPosition.x, playerPosition.z);
-    // trajectory relative to root position
-    for (int i = 1; i <= 3; ++i)
-      trajData[i] = glm::vec2(trajPos[i].x, trajPos[i].z) - playerPosProj;
-    // facing directions
-    for (int i = 0; i < 4; ++i)
-      facingDir[i] = glm::vec2(playerFacing.x, playerFacing.z);
-    // compress into a feature
-    auto currentFeature = database.CompressFeature(hipvel, lfootData, rfootData,
-                                                   trajData, facingDir);
-    for (int k = 0; k < database.featureMean.max_size(); ++k)
-      currentFeature[k] = (currentFeature[k] - database.featureMean[k]) /
-                          database.featureStd[k];
-    // query motion database for closest feature
+  if (pendingSearch != nullptr && pendingSearch->IsReady()) {
+    lastSearch = pendingSearch->Result;
+    pendingSearch = nullptr;
     auto oldFrameInd = currentFrameInd;
-    currentFrameInd = tree.BruteForceNearestSearch(currentFeature);
+    // every frame is excluded when all the clips are short, the frames
+    // played while waiting for the batch are skipped in the new clip too
+    if (lastSearch.index != -1)
+      currentFrameInd = lastSearch.index +
+                        std::min(framesSinceSearch, searchFrame - 1);
+    else
+      currentFrameInd = std::min(currentFrameInd + 1, database.NumFrames() - 1);
     // update delta rotations
     for (int i = 0; i < animator->jointEntityMap.size(); ++i) {
-      auto lrot = database.data[oldFrameInd].rotations[i];
-      auto crot = database.data[currentFrameInd].rotations[i];
+      auto lrot = database.Rotations(oldFrameInd)[i];
+      auto crot = database.Rotations(currentFrameInd)[i];
       // from current rotations back to original rotations
       deltaRotation[i] = lrot * glm::inverse(crot);
     }
+  } else {
+    // keep playing the current clip until the result arrives
+    currentFrameInd = std::min(currentFrameInd + 1, database.NumFrames() - 1);
+    if (pendingSearch != nullptr)
+      framesSinceSearch++;
+  }
+
+  // the character has moved on since a result this late was asked for
+  if (pendingSearch != nullptr && framesSinceSearch >= searchFrame) {
+    pendingSearch->Cancel();
+    pendingSearch = nullptr;
+    lateSearches++;
+  }
+
+  searchFrameCounter--;
+  if (pendingSearch == nullptr &&
+      (searchFrameCounter <= 0 ||
+       (currentFrameInd + 1) >= database.NumFrames())) {
+    // search a replacement for the frame played at the next update
+    int nextFrameInd = std::min(currentFrameInd + 1, database.NumFrames() - 1);
+    Animation::FeatureFrame frame;
+    frame.positions = database.Positions(nextFrameInd);
+    frame.velocities = database.Velocities(nextFrameInd);
+    std::array<glm::vec2, Features::TrajectorySamples> trajData, facingDir;
+    auto playerPosProj = glm::vec2(playerPosition.x, playerPosition.z);
+    for (int i = 0; i < Features::TrajectorySamples; ++i) {
+      // trajectory relative to root position
+      glm::vec3 sample = trajPos[std::min(i, trajCount - 1)];
+      trajData[i] = i == 0 ? glm::vec2(0.0f)
+                           : glm::vec2(sample.x, sample.z) - playerPosProj;
+      // facing directions
+      facingDir[i] = glm::vec2(playerFacing.x, playerFacing.z);
+    }
+    frame.trajectory = trajData.data();
+    frame.facing = facingDir.data();
+    auto currentFeature = Features::Pack(frame);
+    for (int k = 0; k < Features::Dim; ++k)
+      currentFeature[k] = (currentFeature[k] - database.featureMean[k]) /
+                          database.featureStd[k];
+    // launched with the queries of the other characters at the end of frame
+    service->ExcludeClipEnds(searchFrame);
+    auto weights = Features::ExpandWeights(blockWeights);
+    pendingSearch = service->Submit(currentFeature.data(), weights.data());
+    framesSinceSearch = 0;
     // reset counter
     searchFrameCounter = searchFrame;
-  } else {
-    currentFrameInd++;
   }
 
   // update character motion, make transition
-  auto motionData = database.data[currentFrameInd];
+  const glm::vec3 *framePositions = database.Positions(currentFrameInd);
+  const glm::quat *frameRotations = database.Rotations(currentFrameInd);
+  // the joints as they were shown last frame, the live transforms could
+  // already be modified by other scripts in this frame
+  auto &previous = GWORLD.PreviousFrame();
   for (int jointInd = 0; jointInd < animator->jointEntityMap.size();
        ++jointInd) {
     auto jointEntity = animator->jointEntityMap[jointInd];
-    auto currentRot = jointEntity->Rotation();
+    auto jointState = previous.Get(jointEntity->ID);
+    auto currentRot =
+        jointState ? jointState->rotation : jointEntity->Rotation();
 
-    auto nextRot = motionData.rotations[jointInd];
+    auto nextRot = frameRotations[jointInd];
     // make sure these rotations are in the same hemisphere
     if (glm::dot(currentRot, nextRot) < 0.0f)
       nextRot *= -1;
@@ -156,7 +207,7 @@ void MotionMatching::updateAnimatorMotion(std::shared_ptr<Animator> &animator) {
 
     if (jointInd == 0) {
       glm::vec3 currentPos = glm::vec3(
-          playerPosition.x, motionData.positions[jointInd].y, playerPosition.z);
+          playerPosition.x, framePositions[jointInd].y, playerPosition.z);
       jointEntity->SetGlobalPosition(currentPos);
     }
     jointEntity->SetGlobalRotation(currentRot);
@@ -186,9 +237,12 @@ void MotionMatching::DrawInspectorGUI() {
       "motionmatchingsourcedir", "Directory Path",
       [&](std::string path) {
         // TODO: make it modifiable in inspector gui
-        buildMotionDatabase(path, database, lfootIndex, rfootIndex, hipIndex);
-        tree.Build(database.features);
-        return true;
+        std::string output =
+            buildMotionDatabase(path, Features::Extractor());
+        if (output.empty())
+          return false;
+        // the characters using the previous database keep it
+        return useService(MotionMatchingService::Acquire(output, true));
       },
       sourceDirBuffer);
 
@@ -197,11 +251,8 @@ void MotionMatching::DrawInspectorGUI() {
   GUIUtils::DragableFileTarget(
       "motionmatchingdatabase", "Database File (data.bin)",
       [&](std::string file) {
-        if (fs::path(file).filename().string() == "data.bin") {
-          loadMotionDatabase(file, database);
-          tree.Build(database.features);
-          return true;
-        }
+        if (fs::path(file).filename().string() == "data.bin")
+          return useService(MotionMatchingService::Acquire(file));
         return false;
       },
       databaseFile);
@@ -228,152 +279,87 @@ void MotionMatching::DrawInspectorGUI() {
   // ImGui::SliderFloat("Trajectory Interval", &trajInterval, 0.1f, 1.0f);
 
   ImGui::SliderInt("Search Frames", &searchFrame, 1, 60);
-}
-
-// ---------------------- Helper functions ----------------------
 
-void saveMotionDatabase(std::string filepath, MotionDatabase &db) {
-  std::ofstream output(filepath, std::ios::binary);
-  cereal::PortableBinaryOutputArchive oa(output);
-  oa(db);
+  ImGui::MenuItem("Feature Weights", nullptr, nullptr, false);
+  static const auto blockNames = Features::BlockNames();
+  for (int b = 0; b < Features::NumBlocks; ++b)
+    ImGui::SliderFloat(blockNames[b].c_str(), &blockWeights[b], 0.0f, 4.0f);
+  ImGui::MenuItem("Search", nullptr, nullptr, false);
+  if (service != nullptr) {
+    // shared by all the characters using this database
+    bool approximate = service->IsApproximate();
+    int probes = service->ApproximateProbes();
+    int rerank = service->ApproximateRerank();
+    bool changed = ImGui::Checkbox("Approximate Search", &approximate);
+    if (approximate) {
+      changed |= ImGui::SliderInt("Probed Cells", &probes, 1, 64);
+      changed |= ImGui::SliderInt("Reranked Rows", &rerank, 1, 256);
+    }
+    if (changed)
+      service->SetApproximate(approximate, probes, rerank);
+    if (service->IsBuildingIndex())
+      ImGui::Text("Building the index, using the exact search");
+    ImGui::Text("Frame %d, cost %.3f, %d late results", lastSearch.index,
+                lastSearch.cost, lateSearches);
+    auto &search = service->Search();
+    ImGui::Text("Batch of %d queries, %d cancelled, %.3f ms",
+                search.LastBatchSize.load(), search.LastBatchCancelled.load(),
+                search.LastBatchTime.load());
+  }
 }
 
-void loadMotionDatabase(std::string filepath, MotionDatabase &db) {
-  std::ifstream input(filepath, std::ios::binary);
-  cereal::PortableBinaryInputArchive ia(input);
-  ia(db);
-}
+// ---------------------- Helper functions ----------------------
 
-void buildMotionDatabase(std::string filepath, MotionDatabase &db, int lfoot,
-                         int rfoot, int hip) {
-  // clear the database
-  db.features.clear();
-  db.range.clear();
-  db.data.clear();
-  // load motion data from the filepath
-  auto processMotionData = [&](std::string file) {
-    Animation::Motion motion;
-    motion.LoadFromBVH(file);
-    std::vector<glm::vec3> lastPositions;
-    std::vector<glm::quat> lastRotations;
-    int start = db.data.size();
-    for (auto &pose : motion.poses) {
-      MotionDatabaseData mdd;
-      mdd.facingDir = pose.GetFacingDirection();
-      mdd.positions = pose.GetGlobalPositionOrientation(mdd.rotations);
-      mdd.velocities.resize(mdd.positions.size(), glm::vec3(0.0f));
-      mdd.angularVel.resize(mdd.positions.size(), glm::vec3(0.0f));
-      if (!lastPositions.empty()) {
-        for (int i = 0; i < mdd.positions.size(); ++i) {
-          mdd.velocities[i] =
-              (mdd.positions[i] - lastPositions[i]) / (float)motion.fps;
-        }
-      }
-      if (!lastRotations.empty()) {
-        for (int i = 0; i < mdd.positions.size(); ++i) {
-          auto delta = mdd.rotations[i] * glm::inverse(lastRotations[i]);
-          mdd.angularVel[i] =
-              2.0f * motion.fps * glm::vec3(delta.x, delta.y, delta.z);
-        }
-      }
-      db.data.push_back(mdd);
-      lastPositions = mdd.positions;
-      lastRotations = mdd.rotations;
-    }
-    int end = db.data.size();
-    db.dataFPS = motion.fps;
-    db.range.push_back(std::make_pair(start, end));
-  };
-  if (fs::exists(filepath) && fs::is_directory(filepath)) {
-    for (const auto &entry : fs::recursive_directory_iterator(filepath)) {
-      if (fs::is_regular_file(entry.path()) &&
-          entry.path().extension().string() == ".bvh") {
-        processMotionData(entry.path().string());
-      }
-    }
-    // calculate motion feature
-    db.ComputeFeatures(lfoot, rfoot, hip);
-    saveMotionDatabase((fs::path(filepath) / fs::path("data.bin")).string(),
-                       db);
-  } else {
+// Build the database of the bvh files in `filepath` and save it as
+// `data.bin` in the same directory, returns the path of the saved file or an
+// empty string on failure.
+std::string buildMotionDatabase(std::string filepath,
+                                const Animation::FeatureExtractor &extractor) {
+  if (!fs::exists(filepath) || !fs::is_directory(filepath)) {
     LOG_F(ERROR, "%s is not a directory", filepath.c_str());
+    return "";
   }
-}
-
-void MotionDatabase::ComputeFeatures(int lfoot, int rfoot, int hip) {
-  int interval = trajInterval * dataFPS;
-  featureMean.fill(0.0f);
-  for (int animInd = 0; animInd < range.size(); ++animInd) {
-    int start = range[animInd].first;
-    int end = range[animInd].second;
-    for (int f = start; f < end; ++f) {
-      glm::vec3 hipVel = data[f].velocities[hip];
-      std::array<glm::vec3, 2> lfootData, rfootData;
-      lfootData[0] = data[f].positions[lfoot] - data[f].positions[hip];
-      lfootData[1] = data[f].velocities[lfoot];
-      rfootData[0] = data[f].positions[rfoot] - data[f].positions[hip];
-      rfootData[1] = data[f].velocities[rfoot];
-      std::array<glm::vec2, 4> trajData;
-      std::array<glm::vec2, 4> facingDir;
-      // sample trajectories
-      auto rootPosProj =
-          glm::vec2(data[f].positions[hip].x, data[f].positions[hip].z);
-      trajData[0] = glm::vec2(0.0f);
-      facingDir[0] = data[f].facingDir;
-      for (int i = 1; i <= 4; ++i) {
-        int sampleF =
-            ((end - 1) < (f + i * interval)) ? (end - 1) : (f + i * interval);
-        glm::vec3 sampleHip = data[sampleF].positions[hip];
-        trajData[i - 1] = glm::vec2(sampleHip.x, sampleHip.z) - rootPosProj;
-      }
-      for (int i = 1; i <= 4; ++i) {
-        int sampleF =
-            ((end - 1) < (f + i * interval)) ? (end - 1) : (f + i * interval);
-        glm::vec3 sampleFacingDir = data[sampleF].facingDir;
-        facingDir[i - 1] = glm::vec2(sampleFacingDir.x, sampleFacingDir.z);
-      }
-      auto newFeature =
-          CompressFeature(hipVel, lfootData, rfootData, trajData, facingDir);
-      for (int k = 0; k < newFeature.max_size(); ++k)
-        featureMean[k] += newFeature[k];
-      features.push_back(newFeature);
+  std::vector<std::string> files;
+  for (const auto &entry : fs::recursive_directory_iterator(filepath)) {
+    if (fs::is_regular_file(entry.path()) &&
+        entry.path().extension().string() == ".bvh") {
+      files.push_back(entry.path().string());
     }
   }
-  for (int i = 0; i < featureMean.max_size(); ++i)
-    featureMean[i] /= features.size();
-  featureStd.fill(0.0f);
-  for (int i = 0; i < features.size(); ++i)
-    for (int k = 0; k < featureMean.max_size(); ++k)
-      featureStd[k] +=
-          (features[i][k] - featureMean[k]) * (features[i][k] - featureMean[k]);
-  for (int i = 0; i < featureStd.max_size(); ++i)
-    featureStd[i] = std::sqrt(featureStd[i] / features.size());
-  for (int i = 0; i < features.size(); ++i)
-    for (int k = 0; k < featureMean.max_size(); ++k)
-      features[i][k] = (features[i][k] - featureMean[k]) / featureStd[k];
+  // the clip order doesn't depend on the file system
+  std::sort(files.begin(), files.end());
+  // only the clips changed since the last build are loaded
+  std::string output = (fs::path(filepath) / fs::path("data.bin")).string();
+  Animation::MotionDatabase db;
+  if (!db.Load(output))
+    db.Clear();
+  Timer timer;
+  int loaded = db.Build(files, extractor);
+  LOG_F(INFO, "motion database built in %.2f ms, %d of %d files loaded",
+        timer.ElapsedMilliseconds(), loaded, (int)files.size());
+  if (!db.Save(output)) {
+    LOG_F(ERROR, "failed to save motion database to %s", output.c_str());
+    return "";
+  }
+  return output;
 }
 
-std::array<float, 31> MotionDatabase::CompressFeature(
-    glm::vec3 &hipvel, std::array<glm::vec3, 2> &lfoot,
-    std::array<glm::vec3, 2> &rfoot, std::array<glm::vec2, 4> &traj,
-    std::array<glm::vec2, 4> &facingDir) {
-  std::array<float, 31> feature;
-  int index = 0;
-  for (int i = 0; i < 3; ++i)
-    feature[index++] = hipvel[i];
-  for (int i = 0; i < 2; ++i)
-    for (int j = 0; j < 3; ++j)
-      feature[index++] = lfoot[i][j];
-  for (int i = 0; i < 2; ++i)
-    for (int j = 0; j < 3; ++j)
-      feature[index++] = rfoot[i][j];
-  for (int i = 0; i < 4; ++i)
-    for (int j = 0; j < 2; ++j)
-      feature[index++] = traj[i][j];
-  for (int i = 0; i < 4; ++i)
-    for (int j = 0; j < 2; ++j)
-      feature[index++] = facingDir[i][j];
-  return feature;
+bool MotionMatching::useService(
+    std::shared_ptr<MotionMatchingService> newService) {
+  if (newService == nullptr)
+    return false;
+  if (newService->Database().FeatureSignature() != Features::Signature) {
+    LOG_F(ERROR, "the motion database was built for another skeleton, "
+                 "rebuild it from the source directory");
+    return false;
+  }
+  service = newService;
+  if (pendingSearch != nullptr)
+    pendingSearch->Cancel();
+  pendingSearch = nullptr;
+  currentFrameInd = 0;
+  searchFrameCounter = 0;
+  return true;
 }
 
 void MotionMatching::queryJoysticks() {
@@ -385,6 +371,16 @@ void MotionMatching::queryJoysticks() {
       joystickNames.push_back(glfwGetJoystickName(jid));
     }
   }
+  // the selected joystick is disconnected
+  auto it = std::find(availableJoysticks.begin(), availableJoysticks.end(),
+                      currentJoystick);
+  if (it == availableJoysticks.end()) {
+    currentJoystick = -1;
+    _cjInd = 0;
+  } else {
+    // the first element of the combo is `None`
+    _cjInd = (it - availableJoysticks.begin()) + 1;
+  }
 }
 
 }; // namespace aEngine
@@ -10,63 +10,25 @@
  * select a motion clip with closest feature to the user input and play it for
  * a while. After playing current clip for a while, perform another query and
  * decide whether to switch current animation clip or not.
+ *
+ * The query is answered on a worker thread by the `MotionMatchingService` of
+ * the database together with the queries of the other characters. The
+ * result is used at the next update if it's there, the current clip keeps
+ * playing until it arrives, and a result later than `searchFrame` frames is
+ * cancelled and searched again from the current state.
  */
 #pragma once
 
 #include "API.hpp"
 
-#include "Function/General/KDTree.hpp"
+#include "Scripts/Animation/MotionMatchingService.hpp"
 
 namespace aEngine {
 
-struct MotionDatabaseData {
-  glm::vec3 facingDir = glm::vec3(0.0f);
-  // global positions
-  std::vector<glm::vec3> positions;
-  // global orientations
-  std::vector<glm::quat> rotations;
-  std::vector<glm::vec3> velocities;
-  std::vector<glm::vec3> angularVel;
-
-  template <typename Archive> void serialize(Archive &ar) {
-    ar(facingDir, positions, rotations, velocities, angularVel);
-  }
-};
-
-struct MotionDatabase {
-  // nframes * ndata_dim
-  std::vector<MotionDatabaseData> data;
-  // nanim * 2 (begin, end)
-  std::vector<std::pair<int, int>> range;
-  // nframes * nfeat_dim
-  // 12: left & right foot position, velocity
-  //  3: hip velocity
-  //  8: trajectory xz positions (4 positions)
-  //  8: facing directions (4 directions)
-  std::vector<std::array<float, 31>> features;
-  std::array<float, 31> featureMean, featureStd;
-
-  int dataFPS = 60;
-  float trajInterval = 0.2f;
-
-  // compute the features based on given joint index
-  void ComputeFeatures(int lfoot, int rfoot, int hip);
-
-  std::array<float, 31> CompressFeature(glm::vec3 &hipvel,
-                                        std::array<glm::vec3, 2> &lfoot,
-                                        std::array<glm::vec3, 2> &rfoot,
-                                        std::array<glm::vec2, 4> &traj,
-                                        std::array<glm::vec2, 4> &facingDir);
-
-  template <typename Archive> void serialize(Archive &ar) {
-    ar(range, data, features, dataFPS, trajInterval, featureMean, featureStd);
-  }
-};
-
 class MotionMatching : public Scriptable {
 public:
-  MotionMatching() {}
-  ~MotionMatching() {}
+  MotionMatching();
+  ~MotionMatching();
 
   void Update(float dt) override;
   void LateUpdate(float dt) override;
@@ -83,6 +45,8 @@ private:
   int _cjInd = 0, currentJoystick = -1;
   glm::vec2 leftInput = glm::vec2(0.0f);
   glm::vec2 rightInput = glm::vec2(0.0f);
+  // joysticks are queried only when some joystick connects or disconnects
+  SubscriptionID joystickSubscription = 0;
   void queryJoysticks();
 
   // player related
@@ -103,10 +67,23 @@ private:
   std::vector<glm::vec3> trajSpeed;
 
   // query related
-  KDTree<float, 31> tree;
-  MotionDatabase database;
-  // for pfnn mocap only
-  int lfootIndex = 4, rfootIndex = 9, hipIndex = 0;
+  // the database shared with the other characters, frames close to the end
+  // of a clip are excluded so the playback never runs into the next clip
+  std::shared_ptr<MotionMatchingService> service;
+  // the query waiting for its batch, and the frames played since it was
+  // submitted
+  std::shared_ptr<FeatureSearchTicket> pendingSearch;
+  int framesSinceSearch = 0;
+  // results cancelled for arriving too late
+  int lateSearches = 0;
+  // Switch to another database, false if it's nullptr or built with
+  // another schema. The pending search is cancelled.
+  bool useService(std::shared_ptr<MotionMatchingService> newService);
+  // the features of the skeleton driven by this script and the weights of
+  // their blocks
+  using Features = Animation::PFNNFeatures;
+  Features::BlockWeights blockWeights;
+  FeatureMatrix::SearchResult lastSearch;
   glm::vec3 oldHipPos = glm::vec3(0.0f), oldLfootPos = glm::vec3(0.0f),
             oldRfootPos = glm::vec3(0.0f);
   int currentFrameInd = 0, targetMotionFPS = 60;
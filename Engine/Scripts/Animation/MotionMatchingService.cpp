@@ -0,0 +1,125 @@
+#include "Scripts/Animation/MotionMatchingService.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Scene.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace aEngine {
+
+// the services alive, by database file
+static std::mutex servicesMutex;
+static std::map<std::string, std::weak_ptr<MotionMatchingService>> services;
+static uint64_t nextServiceID = 1;
+
+std::shared_ptr<MotionMatchingService>
+MotionMatchingService::Acquire(const std::string &path, bool reload) {
+  std::lock_guard<std::mutex> lock(servicesMutex);
+  // forget the databases no character uses anymore
+  for (auto it = services.begin(); it != services.end();)
+    it = it->second.expired() ? services.erase(it) : std::next(it);
+  auto &cached = services[path];
+  if (!reload) {
+    if (auto service = cached.lock())
+      return service;
+  }
+  std::shared_ptr<MotionMatchingService> service(new MotionMatchingService());
+  if (!service->database.Load(path)) {
+    LOG_F(ERROR, "failed to load %s, rebuild it from the source directory",
+          path.c_str());
+    return nullptr;
+  }
+  service->id = nextServiceID++;
+  service->featureMatrix.Build(service->database.Features(),
+                               service->database.NumFrames(),
+                               service->database.FeatureDim());
+  // the boxes reject most of the blocks for every query of a batch
+  service->featureMatrix.BuildBounds();
+  // the queries of the whole frame are launched at once
+  auto raw = service.get();
+  service->subscription = GWORLD.Events.Subscribe<MotionMatchingQuery>(
+      EventPhase::PostLateUpdate,
+      [raw](const std::vector<MotionMatchingQuery> &queries) {
+        raw->launchBatch(queries);
+      });
+  cached = service;
+  return service;
+}
+
+MotionMatchingService::~MotionMatchingService() {
+  if (subscription != 0)
+    GWORLD.Events.Unsubscribe(subscription);
+  // the build reads the features of the database
+  if (indexBuild.valid())
+    indexBuild.wait();
+}
+
+std::shared_ptr<FeatureSearchTicket>
+MotionMatchingService::Submit(const float *features, const float *weights,
+                              float maxCost) {
+  int dim = database.FeatureDim();
+  MotionMatchingQuery event;
+  event.service = id;
+  event.query.features.assign(features, features + dim);
+  event.query.weights.assign(weights, weights + dim);
+  event.query.maxCost = maxCost;
+  event.query.ticket = std::make_shared<FeatureSearchTicket>();
+  GWORLD.Events.Publish(event);
+  return event.query.ticket;
+}
+
+void MotionMatchingService::ExcludeClipEnds(int frames) {
+  if (frames <= excludedClipEnd)
+    return;
+  search.Wait();
+  excludedClipEnd = frames;
+  featureMatrix.ClearExcluded();
+  featureMatrix.ExcludeRangeEnds(database.range, excludedClipEnd);
+}
+
+void MotionMatchingService::SetApproximate(bool value, int probes,
+                                           int rerank) {
+  search.Wait();
+  approximate = value;
+  approximateIndex.Probes = probes;
+  approximateIndex.Rerank = rerank;
+  if (approximate && approximateIndex.NumCells() == 0 &&
+      !indexBuild.valid()) {
+    // takes seconds on large databases, the editor keeps running meanwhile
+    const float *features = database.Features();
+    int numFrames = database.NumFrames(), dim = database.FeatureDim();
+    indexBuild = ThreadPool::Ref().Submit([features, numFrames, dim]() {
+      ApproximateFeatureIndex index;
+      index.Build(features, numFrames, dim,
+                  ApproximateFeatureIndex::Settings());
+      return index;
+    });
+  }
+  bool ready = approximate && approximateIndex.NumCells() > 0;
+  search.UseApproximate(ready ? &approximateIndex : nullptr);
+}
+
+void MotionMatchingService::finishIndexBuild() {
+  if (!indexBuild.valid() || indexBuild.wait_for(std::chrono::seconds(0)) !=
+                                 std::future_status::ready)
+    return;
+  auto index = indexBuild.get();
+  index.Probes = approximateIndex.Probes;
+  index.Rerank = approximateIndex.Rerank;
+  search.Wait();
+  approximateIndex = std::move(index);
+  search.UseApproximate(approximate ? &approximateIndex : nullptr);
+}
+
+void MotionMatchingService::launchBatch(
+    const std::vector<MotionMatchingQuery> &queries) {
+  finishIndexBuild();
+  // the queries of all the services are delivered to each of them
+  std::vector<FeatureSearchQuery> own;
+  for (auto &event : queries)
+    if (event.service == id)
+      own.push_back(event.query);
+  search.Launch(std::move(own));
+}
+
+}; // namespace aEngine
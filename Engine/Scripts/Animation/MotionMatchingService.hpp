@@ -0,0 +1,92 @@
+/**
+ * Motion matching queries of all the characters sharing a database, answered
+ * in one batch per frame on a worker thread.
+ *
+ * Characters submit their queries during `LateUpdate`, the queries are
+ * published on `GWORLD.Events` and collected by the service at
+ * `EventPhase::PostLateUpdate`, where they are launched as one
+ * `FeatureMatrix::SearchBatch` on an `AsyncFeatureSearch`, so each block of
+ * the database goes through the cache once for the whole crowd and the
+ * frame never waits for the search. The result is written to the ticket
+ * returned by `Submit`, usually before the next update of the character.
+ *
+ * Services are shared by database file, all the characters loading the same
+ * `data.bin` share its frames, its feature matrix and its batch.
+ */
+#pragma once
+
+#include "Function/Animation/MotionDatabase.hpp"
+#include "Function/General/AsyncFeatureSearch.hpp"
+#include "Function/General/EventBus.hpp"
+
+#include <future>
+
+namespace aEngine {
+
+// Published by `MotionMatchingService::Submit`.
+struct MotionMatchingQuery {
+  uint64_t service = 0;
+  FeatureSearchQuery query;
+};
+
+class MotionMatchingService {
+public:
+  ~MotionMatchingService();
+  MotionMatchingService(const MotionMatchingService &) = delete;
+  const MotionMatchingService &
+  operator=(const MotionMatchingService &) = delete;
+
+  // The service of the database stored at `path`, the file is mapped by the
+  // first character asking for it. Pass `reload` after rebuilding the file,
+  // characters holding the previous service keep using it. Returns nullptr
+  // if the file can't be loaded.
+  static std::shared_ptr<MotionMatchingService>
+  Acquire(const std::string &path, bool reload = false);
+
+  const Animation::MotionDatabase &Database() const { return database; }
+  const FeatureMatrix &Features() const { return featureMatrix; }
+
+  // Queue a query with `Database().FeatureDim()` normalized `features` and
+  // weights for the batch of this frame, the batch is launched at
+  // `PostLateUpdate`. Cancel the ticket if the result isn't needed anymore.
+  std::shared_ptr<FeatureSearchTicket>
+  Submit(const float *features, const float *weights,
+         float maxCost = std::numeric_limits<float>::infinity());
+
+  // Exclude at least the last `frames` frames of every clip from the
+  // search, the largest exclusion asked by any character is used. Waits for
+  // the running batch when the exclusion grows.
+  void ExcludeClipEnds(int frames);
+
+  // Answer the queries with an `ApproximateFeatureIndex`, built on the
+  // thread pool the first time it's enabled, the queries are answered by the
+  // exact search until the index is ready. Waits for the running batch.
+  void SetApproximate(bool approximate, int probes, int rerank);
+  bool IsApproximate() const { return approximate; }
+  bool IsBuildingIndex() const { return indexBuild.valid(); }
+  int ApproximateProbes() const { return approximateIndex.Probes; }
+  int ApproximateRerank() const { return approximateIndex.Rerank; }
+
+  // statistics of the last batch
+  const AsyncFeatureSearch &Search() const { return search; }
+
+private:
+  MotionMatchingService() {}
+
+  uint64_t id = 0;
+  Animation::MotionDatabase database;
+  FeatureMatrix featureMatrix;
+  int excludedClipEnd = 0;
+  bool approximate = false;
+  ApproximateFeatureIndex approximateIndex;
+  // moved to `approximateIndex` by the first batch launched once it's done
+  std::future<ApproximateFeatureIndex> indexBuild;
+  SubscriptionID subscription = 0;
+  // destroyed first, waits for the batch reading the members above
+  AsyncFeatureSearch search{featureMatrix};
+
+  void launchBatch(const std::vector<MotionMatchingQuery> &queries);
+  void finishIndexBuild();
+};
+
+}; // namespace aEngine
@@ -1,4 +1,5 @@
 #include "Scripts/Animation/SAMERetarget.hpp"
+#include "Function/Animation/Kinematics.hpp"
 
 namespace aEngine {
 
@@ -66,6 +67,8 @@ void SAMERetarget::receiveDataFromServer() {
 
 void SAMERetarget::fitRetargetMotion(Animation::Motion *source,
                                      Animation::Skeleton *target) {
+  // the motion may come from a cache file, poses are modified in place
+  source->EnsurePoses();
   // remove end effector with no offset from source motion
   std::set<int> eeToBeRemoved;
   for (int i = 0; i < source->skeleton.GetNumJoints(); ++i) {
@@ -153,10 +156,13 @@ void SAMERetarget::fitRetargetMotion(Animation::Motion *source,
   if (fbxStyleTarget) {
     // the source motion is bvh-style, apply global rotation at each frame
     int numFrames = source->poses.size();
-    std::vector<glm::quat> oldOrien,
+    std::vector<glm::vec3> allPositions;
+    std::vector<glm::quat> allOrien,
         newOrien(jointNum, glm::quat(1.0f, glm::vec3(0.0f)));
+    Animation::ForwardKinematics(source->skeleton, source->poses, allPositions,
+                                 allOrien);
     for (int frameInd = 0; frameInd < numFrames; ++frameInd) {
-      source->poses[frameInd].GetGlobalPositionOrientation(oldOrien);
+      auto oldOrien = allOrien.begin() + frameInd * jointNum;
       for (int jointInd = 0; jointInd < jointNum; ++jointInd) {
         // oldOrien = newOrien * inv(initialOrien)
         newOrien[jointInd] = oldOrien[jointInd] * targetJointOrien[jointInd];
@@ -174,6 +180,8 @@ void SAMERetarget::fitRetargetMotion(Animation::Motion *source,
       }
     }
   }
+  // both the skeleton and the poses may have changed
+  source->UpdatePackedFrames();
 }
 
 void SAMERetarget::handleLoadMotion(std::string motionPath) {
@@ -216,7 +224,7 @@ void SAMERetarget::DrawInspectorGUI() {
   ImGui::MenuItem("Motion", nullptr, nullptr, false);
   ImGui::TextWrapped("FPS: %d", motion == nullptr ? -1 : motion->fps);
   ImGui::TextWrapped("Duration: %d",
-                     motion == nullptr ? -1 : motion->poses.size());
+                     motion == nullptr ? -1 : motion->NumFrames());
   if (ImGui::Button("Export BVH Motion##same", {-1, 30})) {
     if (motion != nullptr)
       motion->SaveToBVH("./save_motion.bvh");
@@ -0,0 +1,61 @@
+#include "Snapshot.hpp"
+#include "Entity.hpp"
+#include "Scene.hpp"
+
+namespace aEngine {
+
+WorldSnapshot::WorldSnapshot() : front(0) {
+  for (auto &frame : frames)
+    frame.states.resize(MAX_ENTITY_COUNT + 1);
+}
+
+void WorldSnapshot::Capture(
+    const std::map<EntityID, std::shared_ptr<Entity>> &entities,
+    const SceneContext &context) {
+  int back = 1 - front.load(std::memory_order_relaxed);
+  auto &frame = frames[back];
+  // only the entities alive two frames ago are marked valid in this buffer
+  for (auto id : frame.alive)
+    frame.states[id].valid = false;
+  frame.alive.clear();
+
+  for (auto &entity : entities) {
+    auto ent = entity.second.get();
+    auto &state = frame.states[ent->ID];
+    state.valid = true;
+    state.enabled = ent->Enabled;
+    state.parent = ent->parent == nullptr ? (EntityID)(0) : ent->parent->ID;
+    state.position = ent->m_position;
+    state.rotation = ent->m_rotation;
+    state.scale = ent->m_scale;
+    state.localPosition = ent->localPosition;
+    state.localRotation = ent->localRotation;
+    state.localScale = ent->localScale;
+    state.globalTransform = ent->globalTransform;
+    frame.alive.push_back(ent->ID);
+  }
+
+  frame.frameIndex = captured++;
+  frame.time = context.lastTime;
+  frame.deltaTime = context.deltaTime;
+  frame.hasActiveCamera = context.hasActiveCamera;
+  frame.activeCamera = context.activeCamera;
+
+  // publish the filled buffer, readers of the old front buffer are done
+  // since the last frame has ended
+  front.store(back, std::memory_order_release);
+}
+
+void WorldSnapshot::Clear() {
+  for (auto &frame : frames) {
+    for (auto id : frame.alive)
+      frame.states[id].valid = false;
+    frame.alive.clear();
+    frame.frameIndex = 0;
+    frame.hasActiveCamera = false;
+    frame.activeCamera = (EntityID)(0);
+  }
+  captured = 0;
+}
+
+}; // namespace aEngine
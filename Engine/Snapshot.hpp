@@ -0,0 +1,88 @@
+/**
+ * A read-only copy of the world taken at the frame boundary. The scene owns
+ * two buffers, `Capture` fills the back buffer with the transforms and states
+ * of all entities after the hierarchy update, then publishes it as the front
+ * buffer. During the frame, systems, scripts and jobs on worker threads can
+ * read the previous frame from the front buffer without any locking, while
+ * the main thread keeps writing the live entities.
+ *
+ * A reference to the front buffer is valid until the next frame boundary, any
+ * job reading the snapshot should finish before `Scene::Update` is called
+ * again.
+ */
+#pragma once
+
+#include "Base/Types.hpp"
+#include "Global.hpp"
+
+#include <atomic>
+
+namespace aEngine {
+
+class Entity;
+struct SceneContext;
+
+struct EntityState {
+  bool valid = false;
+  bool enabled = true;
+  EntityID parent = (EntityID)(0);
+
+  glm::vec3 position = glm::vec3(0.0f);
+  glm::quat rotation = glm::quat(1.0f, glm::vec3(0.0f));
+  glm::vec3 scale = glm::vec3(1.0f);
+
+  glm::vec3 localPosition = glm::vec3(0.0f);
+  glm::quat localRotation = glm::quat(1.0f, glm::vec3(0.0f));
+  glm::vec3 localScale = glm::vec3(1.0f);
+
+  glm::mat4 globalTransform = glm::mat4(1.0f);
+};
+
+struct SnapshotFrame {
+  // how many frames have been captured before this one
+  uint64_t frameIndex = 0;
+  float time = 0.0f;
+  float deltaTime = 0.0f;
+
+  bool hasActiveCamera = false;
+  EntityID activeCamera = (EntityID)(0);
+
+  // all the entities alive at the time of capture
+  std::vector<EntityID> alive;
+
+  // returns nullptr if the entity is not alive in this frame
+  const EntityState *Get(EntityID entity) const {
+    if (entity >= states.size() || !states[entity].valid)
+      return nullptr;
+    return &states[entity];
+  }
+
+  // indexed by EntityID, entity 0 is always invalid
+  std::vector<EntityState> states;
+};
+
+class WorldSnapshot {
+public:
+  WorldSnapshot();
+
+  // The frame published at the last frame boundary, safe to read from any
+  // thread during the current frame.
+  const SnapshotFrame &Read() const {
+    return frames[front.load(std::memory_order_acquire)];
+  }
+
+  // Copy the state of all the entities into the back buffer and swap it to the
+  // front, only call this from the main thread at the frame boundary.
+  void Capture(const std::map<EntityID, std::shared_ptr<Entity>> &entities,
+               const SceneContext &context);
+
+  // Invalidate both buffers, used when the scene is reset.
+  void Clear();
+
+private:
+  SnapshotFrame frames[2];
+  std::atomic<int> front;
+  uint64_t captured = 0;
+};
+
+}; // namespace aEngine
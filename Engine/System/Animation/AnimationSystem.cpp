@@ -3,6 +3,8 @@
 #include "Component/Camera.hpp"
 #include "Function/Animation/Deform.hpp"
 #include "Function/Animation/Motion.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/General/Utils.hpp"
 #include "Function/Render/Mesh.hpp"
 #include "Function/Render/VisUtils.hpp"
 #include "Scene.hpp"
@@ -36,19 +38,200 @@ void AnimationSystem::Update(float dt) {
     while (SystemCurrentFrame > SystemEndFrame)
       SystemCurrentFrame -= duration;
   }
+  // the graphs keep their own clock, pausing the system freezes them
+  float graphDt = EnableAutoPlay ? dt : 0.0f;
+  EntityID cameraID;
+  bool hasCamera = EnableLOD && GWORLD.GetActiveCamera(cameraID);
+  glm::vec3 cameraPosition(0.0f);
+  glm::mat4 cameraVP(1.0f);
+  if (hasCamera) {
+    auto camera = GWORLD.EntityFromID(cameraID);
+    cameraPosition = camera->Position();
+    cameraVP = camera->GetComponent<Camera>()->VP;
+  }
+  lodProfile.levelCounts.assign(LODLevels.size(), 0);
+  lodProfile.updated = lodProfile.skipped = lodProfile.frozen = 0;
+  // collect the animators to update on this thread, the scene lookups and
+  // the repacking of modified motions are not safe to run concurrently
+  activeAnimators.clear();
   for (auto id : entities) {
     auto entity = GWORLD.EntityFromID(id);
     auto animator = entity->GetComponent<Animator>();
-    if (animator->skeleton != nullptr && animator->motion != nullptr &&
-        GWORLD.EntityValid(animator->skeleton->ID)) {
-      int nFrames = animator->motion->poses.size();
-      if (nFrames != 0) {
+    if (animator->skeleton == nullptr ||
+        !GWORLD.EntityValid(animator->skeleton->ID))
+      continue;
+    if (animator->graph == nullptr) {
+      if (animator->motion == nullptr || animator->motion->NumFrames() == 0)
+        continue;
+      animator->motion->EnsurePackedFrames();
+    }
+    if (updateLOD(animator.get(), hasCamera, cameraPosition, cameraVP,
+                  graphDt))
+      activeAnimators.push_back(animator.get());
+  }
+  // each animator only writes to its own pose and joint entities
+  activePoses.resize(activeAnimators.size());
+  auto samplePoses = [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      auto animator = activeAnimators[i];
+      if (animator->graph != nullptr) {
+        activePoses[i] = &animator->graph->Evaluate(animator->SkippedTime);
+        animator->SkippedTime = 0.0f;
+      } else {
         // sample animation from motion data of each animator
-        Animation::Pose CurrentPose = animator->motion->At(SystemCurrentFrame);
-        animator->ApplyPoseToSkeleton(CurrentPose);
+        animator->motion->SampleInto(SystemCurrentFrame, animator->poseBuffer);
+        activePoses[i] = &animator->poseBuffer;
       }
     }
+  };
+  auto applyPoses = [&](int begin, int end) {
+    for (int i = begin; i < end; ++i)
+      activeAnimators[i]->ApplyPoseToSkeleton(*activePoses[i]);
+  };
+  Timer timer;
+  if (ParallelUpdate)
+    ThreadPool::Ref().ParallelFor(0, activeAnimators.size(), 8, samplePoses);
+  else
+    samplePoses(0, activeAnimators.size());
+  // between sampling and applying, so the joint entities are written once
+  plantFeet();
+  if (ParallelUpdate)
+    ThreadPool::Ref().ParallelFor(0, activeAnimators.size(), 8, applyPoses);
+  else
+    applyPoses(0, activeAnimators.size());
+  lodProfile.updateTime = timer.ElapsedMilliseconds();
+  lodProfile.updated = activeAnimators.size();
+  if (lodProfile.updated > 0)
+    lodProfile.updateCost =
+        0.9f * lodProfile.updateCost +
+        0.1f * lodProfile.updateTime / lodProfile.updated;
+}
+
+void AnimationSystem::plantFeet() {
+  Timer timer;
+  for (auto &group : footPlantingGroups)
+    group.animators.clear();
+  for (int i = 0; i < activeAnimators.size(); ++i) {
+    auto planting = activeAnimators[i]->footPlanting.get();
+    auto skeleton = activePoses[i]->skeleton;
+    if (planting == nullptr || skeleton == nullptr)
+      continue;
+    auto group = std::find_if(
+        footPlantingGroups.begin(), footPlantingGroups.end(),
+        [&](const FootPlantingGroup &g) {
+          return g.planting == planting && g.skeleton == skeleton;
+        });
+    if (group == footPlantingGroups.end()) {
+      group = footPlantingGroups.insert(group, FootPlantingGroup());
+      group->planting = planting;
+      group->skeleton = skeleton;
+    }
+    group->animators.push_back(i);
   }
+  // the pointers of a group are only valid while it has animators
+  footPlantingGroups.erase(
+      std::remove_if(footPlantingGroups.begin(), footPlantingGroups.end(),
+                     [](const FootPlantingGroup &g) {
+                       return g.animators.empty();
+                     }),
+      footPlantingGroups.end());
+  for (auto &group : footPlantingGroups) {
+    int numPoses = group.animators.size();
+    group.batch.Resize(group.skeleton->GetNumJoints(), numPoses);
+    group.toWorld.resize(numPoses);
+    for (int p = 0; p < numPoses; ++p) {
+      int i = group.animators[p];
+      group.batch.SetPose(p, *activePoses[i]);
+      auto parent = activeAnimators[i]->skeleton->parent;
+      group.toWorld[p] =
+          parent == nullptr ? glm::mat4(1.0f) : parent->GlobalTransformMatrix();
+    }
+    try {
+      group.planting->Solve(group.skeleton->jointParent,
+                            group.skeleton->jointOffset, group.batch,
+                            group.toWorld, ParallelUpdate);
+    } catch (std::exception &e) {
+      LOG_F(ERROR, "foot planting disabled for %d animators: %s", numPoses,
+            e.what());
+      for (int i : group.animators)
+        activeAnimators[i]->footPlanting = nullptr;
+      continue;
+    }
+    for (int p = 0; p < numPoses; ++p)
+      group.batch.GetPose(p, *activePoses[group.animators[p]]);
+  }
+  lodProfile.footPlantingTime = timer.ElapsedMilliseconds();
+}
+
+bool AnimationSystem::updateLOD(Animator *animator, bool hasCamera,
+                                glm::vec3 cameraPosition,
+                                const glm::mat4 &cameraVP, float dt) {
+  int level = 0;
+  bool frozen = false;
+  if (hasCamera) {
+    glm::vec3 rootPosition = animator->skeleton->Position();
+    float distance = glm::length(rootPosition - cameraPosition);
+    while (level + 1 < LODLevels.size() &&
+           distance >= LODLevels[level + 1].Distance)
+      level++;
+    if (FreezeOffscreen) {
+      glm::vec4 clip = cameraVP * glm::vec4(rootPosition, 1.0f);
+      float extent = clip.w * (1.0f + OffscreenMargin);
+      frozen = clip.w <= 0.0f || std::abs(clip.x) > extent ||
+               std::abs(clip.y) > extent;
+    }
+  }
+  AnimationLOD lod;
+  if (level < LODLevels.size())
+    lod = LODLevels[level];
+  int interval = std::max(lod.UpdateInterval, 1);
+  if (interval != animator->UpdateInterval) {
+    animator->UpdateInterval = interval;
+    // spread the updates of the animators at the same level across frames
+    animator->FramesSinceUpdate = animator->GetID() % interval;
+  }
+  animator->LOD = level;
+  animator->Frozen = frozen;
+  animator->SetSkippedLeafLevels(lod.SkippedLeafLevels);
+  animator->SkippedTime += dt;
+  if (level < lodProfile.levelCounts.size())
+    lodProfile.levelCounts[level]++;
+  if (frozen) {
+    lodProfile.frozen++;
+    return false;
+  }
+  if (++animator->FramesSinceUpdate >= interval)
+    animator->FramesSinceUpdate = 0;
+  if (animator->FramesSinceUpdate != 0) {
+    lodProfile.skipped++;
+    return false;
+  }
+  return true;
+}
+
+void AnimationSystem::PlotLODProfile() {
+  ImGui::Checkbox("Enable LOD", &EnableLOD);
+  ImGui::SameLine();
+  ImGui::Checkbox("Freeze Offscreen", &FreezeOffscreen);
+  for (int level = 0; level < LODLevels.size(); ++level) {
+    auto &lod = LODLevels[level];
+    ImGui::PushID(level);
+    ImGui::Text("LOD %d: %d animators", level,
+                level < lodProfile.levelCounts.size()
+                    ? lodProfile.levelCounts[level]
+                    : 0);
+    if (level > 0)
+      ImGui::DragFloat("Distance", &lod.Distance, 0.1f, 0.0f, 1000.0f);
+    ImGui::SliderInt("Update Interval", &lod.UpdateInterval, 1, 8);
+    ImGui::SliderInt("Skipped Leaf Levels", &lod.SkippedLeafLevels, 0, 4);
+    ImGui::PopID();
+  }
+  ImGui::Text("Updated: %d, Skipped: %d, Frozen: %d", lodProfile.updated,
+              lodProfile.skipped, lodProfile.frozen);
+  ImGui::Text("Animation Update: %.4f ms", lodProfile.updateTime);
+  ImGui::Text("Foot Planting: %.4f ms", lodProfile.footPlantingTime);
+  ImGui::Text("Saved (estimated): %.4f ms",
+              lodProfile.updateCost * (lodProfile.skipped + lodProfile.frozen));
 }
 
 void AnimationSystem::collectSkeletonDrawQueue(
@@ -134,26 +317,24 @@ void AnimationSystem::DebugRender() {
 
         // draw trajectory for the animation
         if (animator->ShowTrajectory && animator->motion != nullptr) {
-          int start = 0, end = animator->motion->poses.size();
-          int interval = animator->motion->fps * animator->TrajInterval;
+          auto motion = animator->motion;
+          motion->EnsureRootTrack();
+          int end = motion->rootTrack.size();
+          int interval = motion->fps * animator->TrajInterval;
           int currentF = SystemCurrentFrame;
           currentF = currentF < 0 ? 0 : currentF;
-          currentF = currentF > animator->motion->poses.size()
-                         ? animator->motion->poses.size()
-                         : currentF;
-          std::vector<glm::vec3> trajPos, trajFacingDir;
-          for (int i = 0; i <= animator->TrajCount; ++i) {
+          currentF = currentF > end ? end : currentF;
+          std::vector<glm::vec3> trajPos;
+          for (int i = 0; i <= animator->TrajCount && end > 0; ++i) {
             int sampleF = ((end - 1) <= (i * interval + currentF))
                               ? (end - 1)
                               : (i * interval + currentF);
-            auto rootPos = animator->motion->poses[sampleF].rootLocalPosition;
-            rootPos.y = 0.0f;
-            auto facingDir =
-                animator->motion->poses[sampleF].GetFacingDirection();
-            trajPos.push_back(rootPos);
-            trajFacingDir.push_back(facingDir);
-            VisUtils::DrawWireSphere(rootPos, vp, 0.02f, VisUtils::Red);
-            VisUtils::DrawArrow(rootPos, rootPos + 0.5f * facingDir, vp,
+            auto &sample = motion->rootTrack[sampleF];
+            trajPos.push_back(sample.position);
+            VisUtils::DrawWireSphere(sample.position, vp, 0.02f,
+                                     VisUtils::Red);
+            VisUtils::DrawArrow(sample.position,
+                                sample.position + 0.5f * sample.facing, vp,
                                 VisUtils::Yellow, 0.02f);
           }
           VisUtils::DrawLineStrip3D(trajPos, vp, VisUtils::Red);
@@ -196,6 +377,8 @@ void AnimationSystem::DrawSequencer() {
   // play back properties
   ImGui::Checkbox("Auto Play", &EnableAutoPlay);
   ImGui::SameLine();
+  ImGui::Checkbox("Parallel", &ParallelUpdate);
+  ImGui::SameLine();
   int se[2] = {SystemStartFrame, SystemEndFrame};
   if (ImGui::InputInt2("##Start & End", se)) {
     SystemStartFrame = se[0];
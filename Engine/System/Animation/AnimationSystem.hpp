@@ -6,6 +6,17 @@
 
 namespace aEngine {
 
+// One level of animation detail, the levels are sorted by `Distance`.
+struct AnimationLOD {
+  // used when the active camera is at least this far from the character
+  float Distance = 0.0f;
+  // sample and apply the pose every `UpdateInterval` frames, skinned meshes
+  // interpolate the bone matrices in between
+  int UpdateInterval = 1;
+  // joints with fewer levels of descendants are not updated
+  int SkippedLeafLevels = 0;
+};
+
 class AnimationSystem : public aEngine::BaseSystem {
 public:
   AnimationSystem() {
@@ -28,6 +39,7 @@ public:
     SystemStartFrame = 0;
     SystemEndFrame = 1000;
     SystemCurrentFrame = 0.0f;
+    ParallelUpdate = true;
   }
 
   int SystemFPS = 30;
@@ -36,9 +48,26 @@ public:
   // automatically increase systemCurrentFrame according to dt and systemFPS
   bool EnableAutoPlay = false;
   bool ShowSequencer = false;
+  // update the animators on the thread pool, turn this off to update them
+  // one by one on the main thread when debugging
+  bool ParallelUpdate = true;
 
   void DrawSequencer();
 
+  // Choose the level of detail of each animator by its distance to the
+  // active camera.
+  bool EnableLOD = true;
+  std::vector<AnimationLOD> LODLevels = {{0.0f, 1, 0}, {15.0f, 2, 0},
+                                         {40.0f, 4, 2}};
+  // Don't update the characters whose root is out of the view, `Offscreen
+  // Margin` extends the view by this fraction of the screen.
+  bool FreezeOffscreen = false;
+  float OffscreenMargin = 0.25f;
+
+  // Show the number of animators at each level and the time saved, and the
+  // settings above.
+  void PlotLODProfile();
+
   template <typename Archive> void serialize(Archive &ar) {
     ar(cereal::base_class<BaseSystem>(this));
     ar(SystemFPS, SystemCurrentFrame, SystemStartFrame, SystemEndFrame,
@@ -46,6 +75,37 @@ public:
   }
 
 private:
+  // animators updated in the current frame and their sampled poses, reused
+  // across frames
+  std::vector<Animator *> activeAnimators;
+  std::vector<Animation::PoseBuffer *> activePoses;
+
+  // Animators sharing a foot planting and a skeleton.
+  struct FootPlantingGroup {
+    Animation::FootPlanting *planting = nullptr;
+    Animation::Skeleton *skeleton = nullptr;
+    // indices in `activeAnimators`
+    std::vector<int> animators;
+    std::vector<glm::mat4> toWorld;
+    Animation::PoseBatch batch;
+  };
+  std::vector<FootPlantingGroup> footPlantingGroups;
+  // solve the sampled poses of each group in one batch
+  void plantFeet();
+
+  struct LODProfile {
+    std::vector<int> levelCounts;
+    int updated = 0, skipped = 0, frozen = 0;
+    // wall time of the update in milliseconds, foot planting included
+    float updateTime = 0.0f, footPlantingTime = 0.0f;
+    // running average of the cost of one update
+    float updateCost = 0.0f;
+  } lodProfile;
+  // set the level of detail of `animator`, returns whether it's updated in
+  // this frame
+  bool updateLOD(Animator *animator, bool hasCamera, glm::vec3 cameraPosition,
+                 const glm::mat4 &cameraVP, float dt);
+
   void collectSkeletonDrawQueue(
       std::shared_ptr<Animator> animator,
       std::vector<std::pair<glm::vec3, glm::vec3>> &drawQueue);
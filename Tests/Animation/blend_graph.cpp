@@ -0,0 +1,118 @@
+/**
+ * Measure the cost of evaluating a blend graph per character,
+ * usage: test_blend_graph [characters] [frames]
+ */
+#include "Function/Animation/BlendGraph.hpp"
+#include "Function/General/Utils.hpp"
+
+using namespace aEngine;
+using namespace aEngine::Animation;
+
+float randFloat() { return rand() / (float)RAND_MAX - 0.5f; }
+
+void randomSkeleton(Skeleton &skeleton, int numJoints) {
+  for (int i = 0; i < numJoints; ++i) {
+    skeleton.jointNames.push_back("joint" + std::to_string(i));
+    skeleton.jointParent.push_back(i == 0 ? -1 : rand() % i);
+    skeleton.jointOffset.push_back(
+        glm::vec3(randFloat(), randFloat(), randFloat()));
+  }
+}
+
+void randomMotion(Motion &motion, Skeleton &skeleton, int numFrames) {
+  motion.fps = 30;
+  motion.skeleton = skeleton;
+  motion.poses.resize(numFrames);
+  for (auto &pose : motion.poses) {
+    pose.skeleton = &motion.skeleton;
+    pose.rootLocalPosition = glm::vec3(randFloat(), 0.0f, randFloat());
+    for (int i = 0; i < skeleton.GetNumJoints(); ++i)
+      pose.jointRotations.push_back(glm::normalize(
+          glm::quat(randFloat(), randFloat(), randFloat(), randFloat())));
+  }
+  motion.UpdatePackedFrames();
+}
+
+float maxDifference(PoseBuffer &a, PoseBuffer &b) {
+  float diff = glm::length(a.rootLocalPosition - b.rootLocalPosition);
+  // q and -q are the same rotation
+  for (int j = 0; j < a.numJoints; ++j)
+    diff = std::max(diff, 1.0f - std::abs(glm::dot(a.GetRotation(j),
+                                                   b.GetRotation(j))));
+  return diff;
+}
+
+int main(int argc, char **argv) {
+  int numCharacters = argc > 1 ? std::max(1, atoi(argv[1])) : 200;
+  int numFrames = argc > 2 ? std::max(1, atoi(argv[2])) : 300;
+  Skeleton skeleton;
+  randomSkeleton(skeleton, 30);
+  std::vector<Motion> clips(6);
+  for (int i = 0; i < clips.size(); ++i)
+    randomMotion(clips[i], skeleton, 40 + 13 * i);
+
+  // locomotion on two parameters, shared as a subgraph
+  auto locomotion = std::make_shared<BlendGraph>(&skeleton);
+  int idle = locomotion->AddClip(&clips[0]);
+  int walk = locomotion->AddClip(&clips[1]);
+  int run = locomotion->AddClip(&clips[2]);
+  int strafe = locomotion->AddClip(&clips[3]);
+  locomotion->AddBlendSpace2D("speed", "direction",
+                              {{{0.0f, 0.0f}, idle},
+                               {{1.0f, 0.0f}, walk},
+                               {{2.0f, 0.0f}, run},
+                               {{1.0f, 1.0f}, strafe}});
+
+  auto graph = std::make_shared<BlendGraph>(&skeleton);
+  int base = graph->AddSubgraph(locomotion);
+  int aim = graph->AddClip(&clips[4]);
+  int upperBody = graph->AddAdditiveLayer(base, aim, clips[4].poses[0], "aim",
+                                          graph->MaskFromJoint("joint1"));
+  int action = graph->AddClip(&clips[5], 1.0f, false);
+  graph->AddSelector("action", {upperBody, action}, 0.25f);
+
+  std::vector<std::unique_ptr<BlendGraphInstance>> characters;
+  for (int i = 0; i < numCharacters; ++i) {
+    characters.push_back(std::make_unique<BlendGraphInstance>(graph));
+    characters[i]->SetParameter("aim", 0.5f);
+  }
+  printf("%d characters, %d joints, %d nodes\n", numCharacters,
+         skeleton.GetNumJoints(), graph->NumNodes());
+
+  Timer timer;
+  double evaluationTime = 0.0;
+  for (int frame = 0; frame < numFrames; ++frame) {
+    for (int i = 0; i < numCharacters; ++i) {
+      auto &character = *characters[i];
+      float t = (frame + i) * 0.01f;
+      character.SetParameter("speed", 1.0f + std::sin(t));
+      character.SetParameter("direction", 0.5f + 0.5f * std::cos(t));
+      character.SetParameter("action", (frame + i) / 60 % 2);
+      character.Evaluate(1.0f / 30.0f);
+      evaluationTime += character.EvaluationTime;
+    }
+  }
+  double ms = timer.ElapsedMilliseconds();
+  printf("%.2f us per character per frame, %.2f us measured by instances\n",
+         ms * 1e3 / numCharacters / numFrames,
+         evaluationTime / numCharacters / numFrames);
+
+  // a blend space at the position of one of its samples plays that clip
+  auto single = std::make_shared<BlendGraph>(&skeleton);
+  int walk1 = single->AddClip(&clips[1]);
+  int run1 = single->AddClip(&clips[2]);
+  single->AddBlendSpace1D("speed", {{1.0f, walk1}, {2.0f, run1}}, false);
+  BlendGraphInstance instance(single);
+  instance.SetParameter("speed", 1.0f);
+  PoseBuffer expected;
+  float difference = 0.0f, time = 0.0f;
+  for (int frame = 1; frame <= 100; ++frame) {
+    instance.Evaluate(1.0f / 60.0f);
+    // accumulate the time the same way as the clip node does
+    time = std::fmod(time + 1.0f / 60.0f, (clips[1].NumFrames() - 1) / 30.0f);
+    clips[1].SampleInto(time * 30.0f, expected);
+    difference = std::max(difference, maxDifference(instance.Output, expected));
+  }
+  printf("max difference to the sampled clip %g\n", difference);
+  return difference > 1e-5f;
+}
@@ -0,0 +1,116 @@
+/**
+ * Check the packing of feature schemas against the hand written pfnn
+ * layout, build a database with another schema and measure the packing
+ * cost, usage: test_feature_schema [frames]
+ */
+#include "Function/Animation/MotionDatabase.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <filesystem>
+#include <random>
+
+using namespace aEngine;
+using namespace aEngine::Animation;
+
+// a skeleton with the root at joint 1 and a single tracked joint
+using OtherFeatures =
+    FeatureSchema<1, JointPosition<3>, JointVelocity<3>,
+                  TrajectoryPositions<2>>;
+
+static_assert(PFNNFeatures::Dim == 31, "pfnn features have 31 dimensions");
+static_assert(PFNNFeatures::Offsets[5] == 15 && PFNNFeatures::Offsets[6] == 23,
+              "trajectory and facing start after the joints");
+static_assert(OtherFeatures::Dim == 10 && OtherFeatures::TrajectorySamples == 2,
+              "dimension of a custom schema");
+static_assert(OtherFeatures::Signature != PFNNFeatures::Signature,
+              "schemas of different skeletons have different signatures");
+
+// the layout of the features before the schemas
+std::array<float, 31> handWritten(const FeatureFrame &frame) {
+  std::array<float, 31> feature;
+  int index = 0;
+  auto push = [&](glm::vec3 v) {
+    for (int i = 0; i < 3; ++i)
+      feature[index++] = v[i];
+  };
+  const glm::vec3 *p = frame.positions, *v = frame.velocities;
+  push(v[0]);
+  push(p[4] - p[0]), push(v[4]);
+  push(p[9] - p[0]), push(v[9]);
+  for (int i = 0; i < 4; ++i)
+    feature[index++] = frame.trajectory[i].x,
+    feature[index++] = frame.trajectory[i].y;
+  for (int i = 0; i < 4; ++i)
+    feature[index++] = frame.facing[i].x, feature[index++] = frame.facing[i].y;
+  return feature;
+}
+
+int main(int argc, char **argv) {
+  int numFrames = argc > 1 ? std::max(100, atoi(argv[1])) : 100000;
+  const int numJoints = 20;
+  std::mt19937 gen(42);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  std::vector<glm::vec3> positions((size_t)numFrames * numJoints),
+      velocities(positions.size()), facing(numFrames);
+  std::vector<glm::quat> rotations(positions.size(), glm::quat(1, 0, 0, 0));
+  for (auto &p : positions)
+    p = glm::vec3(noise(gen), noise(gen), noise(gen));
+  for (auto &v : velocities)
+    v = glm::vec3(noise(gen), noise(gen), noise(gen));
+  for (auto &f : facing)
+    f = glm::normalize(glm::vec3(noise(gen), 0.0f, noise(gen)));
+  std::array<glm::vec2, 4> trajectory, directions;
+  for (int i = 0; i < 4; ++i) {
+    trajectory[i] = glm::vec2(noise(gen), noise(gen));
+    directions[i] = glm::vec2(noise(gen), noise(gen));
+  }
+
+  // packing
+  FeatureFrame frame;
+  frame.trajectory = trajectory.data();
+  frame.facing = directions.data();
+  bool ok = true;
+  std::vector<float> rows((size_t)numFrames * PFNNFeatures::Dim);
+  Timer timer;
+  for (int f = 0; f < numFrames; ++f) {
+    frame.positions = positions.data() + (size_t)f * numJoints;
+    frame.velocities = velocities.data() + (size_t)f * numJoints;
+    PFNNFeatures::Pack(frame, rows.data() + (size_t)f * PFNNFeatures::Dim);
+  }
+  float packTime = timer.ElapsedMilliseconds();
+  for (int f = 0; ok && f < numFrames; ++f) {
+    frame.positions = positions.data() + (size_t)f * numJoints;
+    frame.velocities = velocities.data() + (size_t)f * numJoints;
+    auto reference = handWritten(frame);
+    ok = std::equal(reference.begin(), reference.end(),
+                    rows.begin() + (size_t)f * PFNNFeatures::Dim);
+  }
+  printf("packed %d pfnn features in %.2f ms, %s the hand written layout\n",
+         numFrames, packTime, ok ? "matching" : "not matching");
+
+  auto weights = PFNNFeatures::ExpandWeights({1, 2, 3, 4, 5, 6, 7});
+  ok = ok && weights[0] == 1 && weights[3] == 2 && weights[14] == 5 &&
+       weights[15] == 6 && weights[30] == 7;
+
+  // a database with another schema keeps it through a save and a load
+  MotionDatabase database;
+  database.AddClip(numFrames, numJoints, positions.data(), rotations.data(),
+                   facing.data(), 60);
+  timer.Reset();
+  database.ComputeFeatures(OtherFeatures::Extractor());
+  printf("%d features of %d dimensions computed in %.2f ms\n", numFrames,
+         database.FeatureDim(), timer.ElapsedMilliseconds());
+  std::string path =
+      (std::filesystem::temp_directory_path() / "test_feature_schema.bin")
+          .string();
+  MotionDatabase loaded;
+  ok = ok && database.Save(path) && loaded.Load(path) &&
+       loaded.FeatureDim() == OtherFeatures::Dim &&
+       loaded.FeatureSignature() == OtherFeatures::Signature &&
+       std::equal(loaded.Features(),
+                  loaded.Features() + (size_t)numFrames * OtherFeatures::Dim,
+                  database.Features());
+  std::filesystem::remove(path);
+  printf(ok ? "passed\n" : "failed\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+/**
+ * Batched ik on a crowd of bipeds, checks that the two bone, FABRIK and CCD
+ * solvers reach their targets within the joint limits, and times foot
+ * planting on a sine terrain against the 1 ms budget of a frame,
+ * usage: test_ik [characters]
+ */
+#include "Function/Animation/IK.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <random>
+
+using namespace aEngine;
+using namespace aEngine::Animation;
+
+enum Joint {
+  Hips,
+  LeftUpLeg,
+  LeftLeg,
+  LeftFoot,
+  LeftToe,
+  RightUpLeg,
+  RightLeg,
+  RightFoot,
+  RightToe,
+  Spine,
+  Chest,
+  LeftShoulder,
+  LeftArm,
+  LeftForeArm,
+  LeftHand,
+  RightShoulder,
+  RightArm,
+  RightForeArm,
+  RightHand,
+  Head,
+  NumJoints
+};
+
+// the knees and elbows bend around x, the character faces +z
+void buildSkeleton(Skeleton &skeleton) {
+  std::pair<int, glm::vec3> joints[NumJoints] = {
+      {-1, {0.0f, 0.0f, 0.0f}},          {Hips, {0.1f, 0.0f, 0.0f}},
+      {LeftUpLeg, {0.0f, -0.45f, 0.0f}}, {LeftLeg, {0.0f, -0.45f, 0.0f}},
+      {LeftFoot, {0.0f, -0.05f, 0.12f}}, {Hips, {-0.1f, 0.0f, 0.0f}},
+      {RightUpLeg, {0.0f, -0.45f, 0.0f}}, {RightLeg, {0.0f, -0.45f, 0.0f}},
+      {RightFoot, {0.0f, -0.05f, 0.12f}}, {Hips, {0.0f, 0.2f, 0.0f}},
+      {Spine, {0.0f, 0.2f, 0.0f}},       {Chest, {0.15f, 0.1f, 0.0f}},
+      {LeftShoulder, {0.15f, 0.0f, 0.0f}}, {LeftArm, {0.0f, -0.28f, 0.0f}},
+      {LeftForeArm, {0.0f, -0.25f, 0.0f}}, {Chest, {-0.15f, 0.1f, 0.0f}},
+      {RightShoulder, {-0.15f, 0.0f, 0.0f}}, {RightArm, {0.0f, -0.28f, 0.0f}},
+      {RightForeArm, {0.0f, -0.25f, 0.0f}}, {Chest, {0.0f, 0.25f, 0.0f}}};
+  for (int i = 0; i < NumJoints; ++i) {
+    skeleton.jointNames.push_back("joint" + std::to_string(i));
+    skeleton.jointParent.push_back(joints[i].first);
+    skeleton.jointOffset.push_back(joints[i].second);
+  }
+}
+
+glm::quat aroundX(float angle) {
+  return glm::angleAxis(angle, glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+// a walking like pose, the hips are 0.95 above the ground
+Pose randomPose(Skeleton &skeleton, std::mt19937 &gen) {
+  std::uniform_real_distribution<float> swing(-0.5f, 0.5f), bend(0.0f, 1.0f),
+      small(-0.1f, 0.1f);
+  Pose pose;
+  pose.skeleton = &skeleton;
+  pose.rootLocalPosition = glm::vec3(small(gen), 0.95f, small(gen));
+  for (int i = 0; i < NumJoints; ++i)
+    pose.jointRotations.push_back(
+        glm::normalize(glm::quat(1.0f, small(gen), small(gen), small(gen))));
+  for (int knee : {LeftLeg, RightLeg, LeftForeArm, RightForeArm})
+    pose.jointRotations[knee] = aroundX(bend(gen));
+  pose.jointRotations[LeftUpLeg] = aroundX(swing(gen));
+  pose.jointRotations[RightUpLeg] = aroundX(swing(gen));
+  return pose;
+}
+
+// Distances from the effectors to the targets after running forward
+// kinematics again on the written local rotations.
+struct TargetError {
+  float mean = 0.0f;
+  // fraction of the effectors closer than 1 cm
+  float reached = 0.0f;
+};
+
+TargetError targetError(Skeleton &skeleton, PoseBatch &batch,
+                        const std::vector<int> &effectors,
+                        const std::vector<IKTarget> &targets) {
+  ForwardKinematics(skeleton.jointParent, skeleton.jointOffset, batch);
+  TargetError error;
+  for (int p = 0; p < batch.numPoses; ++p)
+    for (int e = 0; e < effectors.size(); ++e) {
+      auto &t = targets[e].positions;
+      glm::vec3 target(t[p], t[batch.poseStride + p],
+                       t[2 * batch.poseStride + p]);
+      float distance =
+          glm::length(batch.GetGlobalPosition(p, effectors[e]) - target);
+      error.mean += distance;
+      error.reached += distance < 0.01f;
+    }
+  int count = batch.numPoses * effectors.size();
+  error.mean /= count, error.reached /= count;
+  return error;
+}
+
+float groundHeight(float x, float z) {
+  return 0.15f * std::sin(1.3f * x) * std::cos(0.9f * z) + 0.05f * x;
+}
+
+int main(int argc, char **argv) {
+  int numCharacters = argc > 1 ? std::max(1, atoi(argv[1])) : 1000;
+  Skeleton skeleton;
+  buildSkeleton(skeleton);
+  auto &parents = skeleton.jointParent;
+  auto &offsets = skeleton.jointOffset;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<Pose> poses;
+  for (int i = 0; i < numCharacters; ++i)
+    poses.push_back(randomPose(skeleton, gen));
+  PoseBatch animated;
+  animated.Resize(NumJoints, numCharacters);
+  for (int i = 0; i < numCharacters; ++i)
+    animated.SetPose(i, poses[i]);
+  ForwardKinematics(parents, offsets, animated);
+  printf("%d characters, %d joints, %d threads\n", numCharacters, NumJoints,
+         ThreadPool::Ref().NumThreads());
+  bool ok = true;
+  Timer timer;
+
+  // two bone: reachable targets around the hip, every fourth character
+  // keeps its animated pose
+  TwoBoneChain leg;
+  leg.upper = LeftUpLeg, leg.middle = LeftLeg, leg.end = LeftFoot;
+  leg.BendAxis = glm::vec3(-1.0f, 0.0f, 0.0f);
+  IKTarget target, pole;
+  target.Resize(numCharacters);
+  pole.Resize(numCharacters);
+  for (int p = 0; p < numCharacters; ++p) {
+    glm::vec3 hip = animated.GetGlobalPosition(p, LeftUpLeg);
+    glm::vec3 dir = glm::normalize(glm::vec3(0.3f * unit(gen), -1.0f,
+                                             0.3f * unit(gen)));
+    target.Set(p, hip + (0.5f + 0.35f * (unit(gen) + 1.0f) * 0.5f) * dir,
+               p % 4 == 0 ? 0.0f : 1.0f);
+    pole.Set(p, hip + glm::vec3(unit(gen), 0.0f, 1.0f));
+  }
+  PoseBatch batch = animated;
+  timer.Reset();
+  SolveTwoBone(parents, offsets, batch, leg, target, &pole);
+  printf("two bone: %.4f ms\n", timer.ElapsedMilliseconds());
+  int twoBoneFailures = 0;
+  for (int p = 0; p < numCharacters; ++p) {
+    glm::quat before = animated.GetGlobalRotation(p, LeftFoot);
+    if (target.weights[p] == 0.0f) {
+      for (int i = 0; i < 4 * NumJoints; ++i)
+        if (batch.localRotations[i * batch.poseStride + p] !=
+            animated.localRotations[i * batch.poseStride + p])
+          twoBoneFailures++;
+      continue;
+    }
+    // recompute the foot from the written local rotations
+    Pose solved = poses[p];
+    for (int joint : {LeftUpLeg, LeftLeg, LeftFoot}) {
+      auto &rot = batch.localRotations;
+      int s = batch.poseStride;
+      solved.jointRotations[joint] =
+          glm::quat(rot[(joint * 4 + 3) * s + p], rot[joint * 4 * s + p],
+                    rot[(joint * 4 + 1) * s + p], rot[(joint * 4 + 2) * s + p]);
+    }
+    std::vector<glm::quat> orientations;
+    auto positions = solved.GetGlobalPositionOrientation(orientations);
+    glm::vec3 t(target.positions[p], target.positions[batch.poseStride + p],
+                target.positions[2 * batch.poseStride + p]);
+    glm::vec3 pl(pole.positions[p], pole.positions[batch.poseStride + p],
+                 pole.positions[2 * batch.poseStride + p]);
+    // the knee is on the side of the pole
+    glm::vec3 a = positions[LeftUpLeg], n = glm::normalize(t - a);
+    glm::vec3 knee = positions[LeftLeg] - a, toPole = pl - a;
+    knee -= n * glm::dot(knee, n);
+    toPole -= n * glm::dot(toPole, n);
+    float facing = glm::dot(glm::normalize(knee), glm::normalize(toPole));
+    float rotError =
+        1.0f - std::abs(glm::dot(orientations[LeftFoot], before));
+    if (glm::length(positions[LeftFoot] - t) > 1e-3f || facing < 0.999f ||
+        rotError > 1e-5f)
+      twoBoneFailures++;
+  }
+  printf("two bone: %d failures\n", twoBoneFailures);
+  ok = ok && twoBoneFailures == 0;
+
+  // FABRIK and CCD: both hands pulled by the spine, the targets come from
+  // random poses within the limits so they are reachable
+  IKChain arms;
+  arms.Build(parents, Spine, {LeftHand, RightHand});
+  for (int elbow : {LeftForeArm, RightForeArm}) {
+    IKJointLimit hinge;
+    hinge.joint = elbow;
+    hinge.TwistAxis = glm::vec3(1.0f, 0.0f, 0.0f);
+    hinge.MaxSwing = 0.0f;
+    hinge.MinTwist = 0.0f, hinge.MaxTwist = 2.5f;
+    arms.limits.push_back(hinge);
+  }
+  for (int joint : {Spine, Chest}) {
+    IKJointLimit spine;
+    spine.joint = joint;
+    spine.MaxSwing = 0.4f;
+    spine.MinTwist = -0.3f, spine.MaxTwist = 0.3f;
+    arms.limits.push_back(spine);
+  }
+  PoseBatch reachable = animated;
+  for (int p = 0; p < numCharacters; ++p) {
+    Pose pose = poses[p];
+    auto randomRotation = [&](float spread) {
+      float x = unit(gen), y = unit(gen), z = unit(gen);
+      return glm::normalize(glm::quat(1.0f, spread * glm::vec3(x, y, z)));
+    };
+    for (int joint : {Spine, Chest})
+      pose.jointRotations[joint] = randomRotation(0.1f);
+    for (int joint : {LeftShoulder, LeftArm, RightShoulder, RightArm})
+      pose.jointRotations[joint] = randomRotation(0.4f);
+    for (int elbow : {LeftForeArm, RightForeArm})
+      pose.jointRotations[elbow] = aroundX(1.2f * (unit(gen) + 1.0f));
+    reachable.SetPose(p, pose);
+  }
+  ForwardKinematics(parents, offsets, reachable);
+  std::vector<IKTarget> hands(2);
+  for (int e = 0; e < 2; ++e) {
+    hands[e].Resize(numCharacters);
+    for (int p = 0; p < numCharacters; ++p)
+      hands[e].Set(p, reachable.GetGlobalPosition(p, arms.effectors[e]));
+  }
+  for (int solver = 0; solver < 2; ++solver) {
+    batch = animated;
+    timer.Reset();
+    if (solver == 0)
+      SolveFABRIK(parents, offsets, batch, arms, hands);
+    else
+      SolveCCD(parents, offsets, batch, arms, hands);
+    float time = timer.ElapsedMilliseconds();
+    auto before = targetError(skeleton, animated, arms.effectors, hands);
+    auto after = targetError(skeleton, batch, arms.effectors, hands);
+    // the elbows only bend within the hinge limit
+    int violations = 0;
+    for (int p = 0; p < numCharacters; ++p)
+      for (int elbow : {LeftForeArm, RightForeArm}) {
+        auto &rot = batch.localRotations;
+        int s = batch.poseStride;
+        glm::quat q(rot[(elbow * 4 + 3) * s + p], rot[elbow * 4 * s + p],
+                    rot[(elbow * 4 + 1) * s + p],
+                    rot[(elbow * 4 + 2) * s + p]);
+        if (q.w < 0.0f)
+          q = -q;
+        float angle = 2.0f * std::atan2(q.x, q.w);
+        if (std::abs(q.y) > 1e-4f || std::abs(q.z) > 1e-4f ||
+            angle < -1e-3f || angle > 2.5f + 1e-3f)
+          violations++;
+      }
+    printf("%s: %.4f ms, mean error %.4f -> %.4f, %.1f%% reached, %d limit "
+           "violations\n",
+           solver == 0 ? "FABRIK" : "CCD", time, before.mean, after.mean,
+           100.0f * after.reached, violations);
+    ok = ok && after.mean < 0.005f && after.reached > 0.9f && violations == 0;
+  }
+
+  // foot planting, the characters are scattered and turned on the terrain
+  FootPlanting planting;
+  TwoBoneChain rightLeg = leg;
+  rightLeg.upper = RightUpLeg, rightLeg.middle = RightLeg,
+  rightLeg.end = RightFoot;
+  planting.Legs = {leg, rightLeg};
+  planting.GroundHeight = groundHeight;
+  std::vector<glm::mat4> toWorld(numCharacters);
+  for (int p = 0; p < numCharacters; ++p) {
+    glm::vec3 position(20.0f * unit(gen), 0.0f, 20.0f * unit(gen));
+    position.y = groundHeight(position.x, position.z);
+    toWorld[p] = glm::rotate(glm::translate(glm::mat4(1.0f), position),
+                             3.0f * unit(gen), glm::vec3(0.0f, 1.0f, 0.0f));
+  }
+  const int frames = 20;
+  double planted = 0.0;
+  for (int frame = 0; frame < frames; ++frame) {
+    batch = animated;
+    timer.Reset();
+    planting.Solve(parents, offsets, batch, toWorld);
+    planted += timer.ElapsedMilliseconds();
+  }
+  int plantFailures = 0;
+  for (int p = 0; p < numCharacters; ++p)
+    for (int foot : {LeftFoot, RightFoot}) {
+      glm::vec3 before = animated.GetGlobalPosition(p, foot);
+      glm::vec3 world = toWorld[p] * glm::vec4(before, 1.0f);
+      float expected = before.y + groundHeight(world.x, world.z);
+      glm::vec3 after =
+          toWorld[p] * glm::vec4(batch.GetGlobalPosition(p, foot), 1.0f);
+      if (std::abs(after.y - expected) > 1e-3f ||
+          glm::length(glm::vec2(after.x - world.x, after.z - world.z)) >
+              1e-3f)
+        plantFailures++;
+    }
+  double perFrame = planted / frames;
+  printf("foot planting: %.4f ms per frame (%s the 1 ms budget), %d "
+         "failures\n",
+         perFrame, perFrame <= 1.0 ? "within" : "over", plantFailures);
+  ok = ok && plantFailures == 0;
+
+  // partly filled chains are rejected instead of read out of range
+  auto rejected = [](auto &&solve) {
+    try {
+      solve();
+    } catch (const std::runtime_error &) {
+      return true;
+    }
+    return false;
+  };
+  TwoBoneChain partial;
+  partial.upper = LeftUpLeg;
+  IKChain handBuilt;
+  handBuilt.joints = {Spine, Chest, LeftShoulder, LeftArm};
+  handBuilt.effectors = {LeftShoulder};
+  std::vector<IKTarget> handBuiltTargets(1);
+  handBuiltTargets[0].Resize(numCharacters);
+  bool invalidRejected =
+      rejected([&]() {
+        SolveTwoBone(parents, offsets, batch, partial, target);
+      }) &&
+      rejected([&]() {
+        SolveFABRIK(parents, offsets, batch, handBuilt, handBuiltTargets);
+      }) &&
+      rejected([&]() {
+        SolveCCD(parents, offsets, batch, handBuilt, handBuiltTargets);
+      });
+  printf("invalid chains %s\n", invalidRejected ? "rejected" : "accepted");
+  ok = ok && invalidRejected;
+
+  printf(ok ? "passed\n" : "failed\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+/**
+ * Compare batched forward kinematics against the per pose version,
+ * pass a bvh file to use real motion data, random poses are used otherwise.
+ */
+#include "Function/Animation/Kinematics.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/General/Utils.hpp"
+
+using namespace aEngine;
+using namespace aEngine::Animation;
+
+float randFloat() { return rand() / (float)RAND_MAX - 0.5f; }
+
+void randomMotion(Motion &motion, int numJoints, int numFrames) {
+  motion.fps = 30;
+  for (int i = 0; i < numJoints; ++i) {
+    motion.skeleton.jointNames.push_back("joint" + std::to_string(i));
+    motion.skeleton.jointParent.push_back(i == 0 ? -1 : rand() % i);
+    motion.skeleton.jointOffset.push_back(
+        glm::vec3(randFloat(), randFloat(), randFloat()));
+  }
+  motion.poses.resize(numFrames);
+  for (auto &pose : motion.poses) {
+    pose.skeleton = &motion.skeleton;
+    pose.rootLocalPosition = glm::vec3(randFloat(), 0.0f, randFloat());
+    for (int i = 0; i < numJoints; ++i)
+      pose.jointRotations.push_back(glm::normalize(
+          glm::quat(randFloat(), randFloat(), randFloat(), randFloat())));
+  }
+}
+
+int main(int argc, char **argv) {
+  Motion motion;
+  if (argc > 1)
+    motion.LoadFromBVH(argv[1]);
+  else
+    randomMotion(motion, 24, 20000);
+  int numJoints = motion.skeleton.GetNumJoints(),
+      numFrames = motion.poses.size();
+  printf("%d frames, %d joints, %d threads\n", numFrames, numJoints,
+         ThreadPool::Ref().NumThreads());
+
+  Timer timer;
+  std::vector<std::vector<glm::vec3>> scalarPositions(numFrames);
+  std::vector<std::vector<glm::quat>> scalarOrientations(numFrames);
+  for (int i = 0; i < numFrames; ++i)
+    scalarPositions[i] =
+        motion.poses[i].GetGlobalPositionOrientation(scalarOrientations[i]);
+  printf("per pose fk %lf ms\n", timer.ElapsedMilliseconds());
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::quat> orientations;
+  // warm up the thread pool
+  ForwardKinematics(motion.skeleton, motion.poses, positions, orientations);
+  timer.Reset();
+  ForwardKinematics(motion.skeleton, motion.poses, positions, orientations);
+  printf("batched fk %lf ms\n", timer.ElapsedMilliseconds());
+
+  PoseBatch batch;
+  batch.Resize(numJoints, numFrames);
+  for (int i = 0; i < numFrames; ++i)
+    batch.SetPose(i, motion.poses[i]);
+  timer.Reset();
+  ForwardKinematics(motion.skeleton.jointParent, motion.skeleton.jointOffset,
+                    batch);
+  printf("batched fk kernel only %lf ms\n", timer.ElapsedMilliseconds());
+
+  int mismatch = 0;
+  for (int i = 0; i < numFrames; ++i) {
+    for (int j = 0; j < numJoints; ++j) {
+      if (positions[i * numJoints + j] != scalarPositions[i][j] ||
+          orientations[i * numJoints + j] != scalarOrientations[i][j] ||
+          batch.GetGlobalPosition(i, j) != scalarPositions[i][j])
+        mismatch++;
+    }
+  }
+  printf("%d mismatched joints\n", mismatch);
+  return mismatch != 0;
+}
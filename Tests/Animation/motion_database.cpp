@@ -0,0 +1,90 @@
+/**
+ * Save a synthetic motion database, map it back and compare the frames and
+ * features, usage: test_motion_database [frames] [joints]
+ */
+#include "Function/Animation/MotionDatabase.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+using namespace aEngine;
+
+int main(int argc, char **argv) {
+  int numFrames = argc > 1 ? std::max(2, atoi(argv[1])) : 500000;
+  int numJoints = argc > 2 ? std::max(10, atoi(argv[2])) : 31;
+  const int clipFrames = 1000;
+  std::mt19937 gen(42);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+
+  Timer timer;
+  Animation::MotionDatabase database;
+  std::vector<glm::vec3> positions, facing;
+  std::vector<glm::quat> rotations;
+  for (int start = 0; start < numFrames; start += clipFrames) {
+    int frames = std::min(clipFrames, numFrames - start);
+    positions.resize((size_t)frames * numJoints);
+    rotations.resize(positions.size());
+    facing.resize(frames);
+    for (auto &p : positions)
+      p = glm::vec3(noise(gen), noise(gen), noise(gen));
+    for (auto &r : rotations)
+      r = glm::normalize(glm::quat(noise(gen), noise(gen), noise(gen),
+                                   noise(gen)));
+    for (auto &f : facing)
+      f = glm::normalize(glm::vec3(noise(gen), 0.0f, noise(gen)));
+    database.AddClip(frames, numJoints, positions.data(), rotations.data(),
+                     facing.data(), 60);
+  }
+  database.ComputeFeatures(Animation::PFNNFeatures::Extractor());
+  printf("%d frames of %d joints, built in %.2f ms\n", numFrames, numJoints,
+         timer.ElapsedMilliseconds());
+
+  std::string path =
+      (std::filesystem::temp_directory_path() / "test_motion_database.bin")
+          .string();
+  timer.Reset();
+  if (!database.Save(path)) {
+    printf("failed to save %s\n", path.c_str());
+    return 1;
+  }
+  printf("saved %.1f MB in %.2f ms\n",
+         std::filesystem::file_size(path) / (1024.0f * 1024.0f),
+         timer.ElapsedMilliseconds());
+
+  Animation::MotionDatabase loaded;
+  timer.Reset();
+  bool ok = loaded.Load(path);
+  printf("loaded in %.3f ms\n", timer.ElapsedMilliseconds());
+
+  size_t n = (size_t)numFrames * numJoints;
+  ok = ok && loaded.IsMapped() && loaded.NumFrames() == numFrames &&
+       loaded.NumJoints() == numJoints && loaded.range == database.range &&
+       loaded.clipHashes == database.clipHashes &&
+       loaded.FeatureDim() == database.FeatureDim() &&
+       loaded.FeatureSignature() == Animation::PFNNFeatures::Signature &&
+       loaded.featureMean == database.featureMean &&
+       loaded.featureStd == database.featureStd;
+  ok = ok &&
+       !std::memcmp(loaded.Positions(0), database.Positions(0),
+                    sizeof(glm::vec3) * n) &&
+       !std::memcmp(loaded.Rotations(0), database.Rotations(0),
+                    sizeof(glm::quat) * n) &&
+       !std::memcmp(loaded.Velocities(0), database.Velocities(0),
+                    sizeof(glm::vec3) * n) &&
+       !std::memcmp(loaded.AngularVelocities(0),
+                    database.AngularVelocities(0), sizeof(glm::vec3) * n) &&
+       !std::memcmp(loaded.Features(), database.Features(),
+                    sizeof(float) * database.FeatureDim() * numFrames);
+  for (int f = 0; ok && f < numFrames; ++f)
+    ok = loaded.FacingDir(f) == database.FacingDir(f);
+
+  // a truncated file must be rejected
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+  Animation::MotionDatabase truncated;
+  ok = ok && !truncated.Load(path);
+  std::filesystem::remove(path);
+  printf(ok ? "passed\n" : "failed\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/**
+ * Compare the cpu skinning against a scalar copy of the skinning compute
+ * shaders and measure its cost, usage: test_skinning [vertices] [bones]
+ */
+#include "Function/Animation/Skinning.hpp"
+#include "Function/General/Utils.hpp"
+
+using namespace aEngine;
+
+float randFloat() { return rand() / (float)RAND_MAX - 0.5f; }
+
+// same operations as the skinning shaders in Deform.cpp, with the dense
+// blend shape table the engine used before the sparse one
+Vertex shaderSkinning(const Vertex &vtx,
+                      const std::vector<BoneMatrixBlock> &transforms,
+                      const std::vector<glm::vec4> &offsets = {},
+                      const std::vector<float> &weights = {}) {
+  glm::vec4 newPosition(0.0f), newNormal(0.0f);
+  glm::vec4 blendedPosition = vtx.Position;
+  for (int j = 0; j < weights.size(); ++j)
+    blendedPosition += weights[j] * offsets[j];
+  for (int i = 0; i < MAX_BONES; ++i) {
+    int boneId = vtx.BoneId[i];
+    float weight = vtx.BoneWeight[i];
+    if (weight > 0.0f) {
+      glm::mat4 boneMatrix = transforms[boneId].BoneModelMatrix *
+                             transforms[boneId].BoneOffsetMatrix;
+      newPosition += boneMatrix * blendedPosition * weight;
+      newNormal += boneMatrix * vtx.Normal * weight;
+    }
+  }
+  Vertex result = vtx;
+  result.Position = newPosition;
+  result.Normal = glm::normalize(newNormal);
+  return result;
+}
+
+glm::mat4 randomTransform() {
+  glm::quat q = glm::normalize(
+      glm::quat(randFloat(), randFloat(), randFloat(), randFloat()));
+  return glm::translate(glm::mat4(1.0f),
+                        glm::vec3(randFloat(), randFloat(), randFloat())) *
+         glm::mat4_cast(q);
+}
+
+int main(int argc, char **argv) {
+  int numVertices = argc > 1 ? std::max(1, atoi(argv[1])) : 100000;
+  int numBones = argc > 2 ? std::max(1, atoi(argv[2])) : 60;
+  std::vector<Vertex> vertices(numVertices);
+  for (auto &vertex : vertices) {
+    vertex.Position = glm::vec4(randFloat(), randFloat(), randFloat(), 1.0f);
+    vertex.Normal = glm::vec4(
+        glm::normalize(glm::vec3(randFloat(), randFloat(), randFloat())),
+        0.0f);
+    float total = 0.0f;
+    for (int b = 0; b < MAX_BONES; ++b) {
+      vertex.BoneId[b] = rand() % numBones;
+      // some vertices use fewer bones, the unused slots have garbage ids
+      vertex.BoneWeight[b] = rand() % 3 == 0 ? 0.0f : randFloat() + 0.5f;
+      if (vertex.BoneWeight[b] == 0.0f)
+        vertex.BoneId[b] = -1;
+      total += vertex.BoneWeight[b];
+    }
+    if (total == 0.0f) {
+      vertex.BoneId[0] = 0;
+      vertex.BoneWeight[0] = total = 1.0f;
+    }
+    for (int b = 0; b < MAX_BONES; ++b)
+      vertex.BoneWeight[b] /= total;
+  }
+  std::vector<BoneMatrixBlock> transforms(numBones);
+  for (auto &transform : transforms) {
+    transform.BoneModelMatrix = randomTransform();
+    transform.BoneOffsetMatrix = glm::inverse(randomTransform());
+  }
+
+  SkinnedMeshCPU skinning;
+  skinning.Build(vertices);
+  skinning.Deform(transforms);
+  float difference = 0.0f;
+  for (int i = 0; i < numVertices; ++i) {
+    Vertex expected = shaderSkinning(vertices[i], transforms);
+    for (int c = 0; c < 4; ++c)
+      difference = std::max(
+          {difference,
+           std::abs(expected.Position[c] - skinning.Output[i].Position[c]),
+           std::abs(expected.Normal[c] - skinning.Output[i].Normal[c])});
+  }
+  printf("%d vertices, %d bones, max difference to the shader %g\n",
+         numVertices, numBones, difference);
+
+  const int repeats = 50;
+  Timer timer;
+  for (int i = 0; i < repeats; ++i)
+    skinning.Deform(transforms);
+  double simdTime = timer.ElapsedMilliseconds() / repeats;
+  timer.Reset();
+  std::vector<Vertex> output(numVertices);
+  for (int i = 0; i < numVertices; ++i)
+    output[i] = shaderSkinning(vertices[i], transforms);
+  double scalarTime = timer.ElapsedMilliseconds();
+  printf("%.3f ms per deform, %.3f ms single threaded scalar\n", simdTime,
+         scalarTime);
+
+  // a facial rig, each shape moves a small patch of the mesh
+  const int numShapes = MAX_BLEND_SHAPES;
+  std::vector<BlendShape> shapes(numShapes);
+  for (auto &shape : shapes) {
+    shape.data.resize(numVertices, {glm::vec3(0.0f), glm::vec3(0.0f)});
+    int start = rand() % numVertices, size = numVertices / 50 + 1;
+    for (int i = start; i < std::min(numVertices, start + size); ++i)
+      shape.data[i].BlendShapeOffset =
+          0.1f * glm::vec3(randFloat(), randFloat(), randFloat());
+  }
+  SparseBlendShapes sparse;
+  sparse.Build(shapes, numVertices);
+  std::vector<float> weights(numShapes, 0.0f);
+  for (int j = 0; j < numShapes; j += 5)
+    weights[j] = randFloat() + 0.5f;
+  skinning.Deform(transforms, sparse, weights);
+  float blendDifference = 0.0f;
+  std::vector<glm::vec4> offsets(numShapes);
+  for (int i = 0; i < numVertices; ++i) {
+    for (int j = 0; j < numShapes; ++j)
+      offsets[j] = glm::vec4(shapes[j].data[i].BlendShapeOffset, 0.0f);
+    Vertex expected =
+        shaderSkinning(vertices[i], transforms, offsets, weights);
+    for (int c = 0; c < 4; ++c)
+      blendDifference = std::max(
+          {blendDifference,
+           std::abs(expected.Position[c] - skinning.Output[i].Position[c]),
+           std::abs(expected.Normal[c] - skinning.Output[i].Normal[c])});
+  }
+  // the blended positions are restored for the next deformation
+  skinning.Deform(transforms);
+  for (int i = 0; i < numVertices; ++i)
+    blendDifference =
+        std::max(blendDifference,
+                 glm::length(skinning.Output[i].Position -
+                             shaderSkinning(vertices[i], transforms).Position));
+  double denseBytes = (double)numVertices * 2 * MAX_BLEND_SHAPES * 16;
+  printf("%d blend shapes, %.1f KB sparse, %.1f KB dense, max difference %g\n",
+         numShapes, sparse.MemoryBytes() / 1024.0, denseBytes / 1024.0,
+         blendDifference);
+  timer.Reset();
+  for (int i = 0; i < repeats; ++i)
+    skinning.Deform(transforms, sparse, weights);
+  printf("%.3f ms per deform with blend shapes\n",
+         timer.ElapsedMilliseconds() / repeats);
+  return difference > 1e-4f || blendDifference > 1e-4f;
+}
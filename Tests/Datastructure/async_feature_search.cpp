@@ -0,0 +1,148 @@
+/**
+ * Searches of a crowd answered on a worker thread while the main thread
+ * keeps ticking, against the same searches run inline on the main thread,
+ * usage: test_async_feature_search [rows] [agents] [ticks]
+ */
+#include "Function/General/AsyncFeatureSearch.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+
+using namespace aEngine;
+
+const int dataDim = 31;
+// the rest of a 60 fps frame, spent waiting for the gpu
+const auto frameWait = std::chrono::milliseconds(16);
+
+// smooth random walks, consecutive rows are close like motion frames
+std::vector<std::array<float, dataDim>> generateData(int numRows,
+                                                     std::mt19937 &gen) {
+  std::normal_distribution<float> step(0.0f, 0.05f);
+  std::vector<std::array<float, dataDim>> data(numRows);
+  std::array<float, dataDim> current{};
+  for (int i = 0; i < numRows; ++i) {
+    for (int j = 0; j < dataDim; ++j)
+      current[j] = 0.98f * current[j] + step(gen);
+    data[i] = current;
+  }
+  return data;
+}
+
+int main(int argc, char **argv) {
+  int numRows = argc > 1 ? std::max(1, atoi(argv[1])) : 100000;
+  int numAgents = argc > 2 ? std::max(1, atoi(argv[2])) : 32;
+  int numTicks = argc > 3 ? std::max(1, atoi(argv[3])) : 60;
+  std::mt19937 gen(42);
+  auto data = generateData(numRows, gen);
+  FeatureMatrix matrix;
+  matrix.Build(data);
+
+  std::uniform_int_distribution<int> pick(0, numRows - 1);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  auto makeQuery = [&]() {
+    FeatureSearchQuery query;
+    auto &row = data[pick(gen)];
+    for (int j = 0; j < dataDim; ++j) {
+      query.features.push_back(row[j] + noise(gen));
+      query.weights.push_back(j < 15 ? 1.0f : 2.0f);
+    }
+    query.ticket = std::make_shared<FeatureSearchTicket>();
+    return query;
+  };
+  auto matches = [&](const FeatureSearchQuery &query) {
+    auto expected =
+        matrix.Search(query.features.data(), query.weights.data());
+    return std::abs(expected.cost - query.ticket->Result.cost) <=
+           1e-4f * std::max(1.0f, expected.cost);
+  };
+  bool ok = true;
+
+  // every agent searches every tick on the main thread
+  Timer timer;
+  double inlineStall = 0.0;
+  std::vector<float> features((size_t)numAgents * dataDim),
+      weights(features.size());
+  std::vector<FeatureMatrix::SearchResult> results(numAgents);
+  for (int tick = 0; tick < numTicks; ++tick) {
+    for (int a = 0; a < numAgents; ++a) {
+      auto query = makeQuery();
+      std::copy(query.features.begin(), query.features.end(),
+                features.begin() + (size_t)a * dataDim);
+      std::copy(query.weights.begin(), query.weights.end(),
+                weights.begin() + (size_t)a * dataDim);
+    }
+    timer.Reset();
+    matrix.SearchBatch(features.data(), numAgents, weights.data(), nullptr,
+                       results.data());
+    inlineStall += timer.ElapsedMilliseconds();
+    std::this_thread::sleep_for(frameWait);
+  }
+  printf("inline: %.3f ms per tick on the main thread\n",
+         inlineStall / numTicks);
+
+  // submitted at tick N and used at tick N + 1, a result later than
+  // `maxLate` ticks is cancelled and searched again
+  const int maxLate = 4;
+  AsyncFeatureSearch search(matrix);
+  std::vector<FeatureSearchQuery> pending(numAgents);
+  std::vector<int> submitted(numAgents, -1);
+  int onTime = 0, late = 0, cancelled = 0, checked = 0;
+  double asyncStall = 0.0;
+  for (int tick = 0; tick < numTicks; ++tick) {
+    std::vector<FeatureSearchQuery> launch;
+    for (int a = 0; a < numAgents; ++a) {
+      auto &query = pending[a];
+      if (submitted[a] != -1 && query.ticket->IsReady()) {
+        (tick - submitted[a] <= 1 ? onTime : late)++;
+        // checking every result would dominate the test
+        if (a == 0) {
+          ok = ok && matches(query);
+          checked++;
+        }
+        submitted[a] = -1;
+      } else if (submitted[a] != -1 && tick - submitted[a] > maxLate) {
+        query.ticket->Cancel();
+        cancelled++;
+        submitted[a] = -1;
+      }
+      if (submitted[a] == -1) {
+        query = makeQuery();
+        submitted[a] = tick;
+        launch.push_back(query);
+      }
+    }
+    timer.Reset();
+    search.Launch(std::move(launch));
+    asyncStall += timer.ElapsedMilliseconds();
+    std::this_thread::sleep_for(frameWait);
+  }
+  search.Wait();
+  printf("async: %.3f ms per tick on the main thread, last batch %.3f ms\n",
+         asyncStall / numTicks, search.LastBatchTime.load());
+  printf("%d results on time, %d late, %d cancelled, %d checked\n", onTime,
+         late, cancelled, checked);
+
+  // queries cancelled while the worker is busy are never searched
+  std::vector<FeatureSearchQuery> busy, stale;
+  for (int a = 0; a < numAgents; ++a) {
+    busy.push_back(makeQuery());
+    stale.push_back(makeQuery());
+  }
+  search.Launch(busy);
+  search.Launch(stale);
+  for (auto &query : stale)
+    query.ticket->Cancel();
+  search.Wait();
+  int skipped = 0;
+  for (auto &query : busy)
+    ok = ok && query.ticket->IsReady() && matches(query);
+  for (auto &query : stale)
+    skipped += !query.ticket->IsReady();
+  printf("%d of %d cancelled queries skipped\n", skipped, numAgents);
+
+  printf(ok ? "passed\n" : "failed\n");
+  return ok ? 0 : 1;
+}
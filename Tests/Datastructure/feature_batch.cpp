@@ -0,0 +1,86 @@
+/**
+ * Throughput of motion matching queries for crowds, one `Search` per agent
+ * against a single `SearchBatch` for all of them, with and without the
+ * bounding boxes, usage: test_feature_batch [rows]
+ */
+#include "Function/General/FeatureMatrix.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <cmath>
+#include <random>
+
+using namespace aEngine;
+
+const int dataDim = 31;
+
+// smooth random walks, consecutive rows are close like motion frames
+std::vector<std::array<float, dataDim>> generateData(int numRows,
+                                                     std::mt19937 &gen) {
+  std::normal_distribution<float> step(0.0f, 0.05f);
+  std::vector<std::array<float, dataDim>> data(numRows);
+  std::array<float, dataDim> current{};
+  for (int i = 0; i < numRows; ++i) {
+    for (int j = 0; j < dataDim; ++j)
+      current[j] = 0.98f * current[j] + step(gen);
+    data[i] = current;
+  }
+  return data;
+}
+
+int main(int argc, char **argv) {
+  int numRows = argc > 1 ? std::max(1, atoi(argv[1])) : 1000000;
+  std::mt19937 gen(42);
+  auto data = generateData(numRows, gen);
+  FeatureMatrix matrix;
+  matrix.Build(data);
+  std::vector<std::pair<int, int>> ranges;
+  for (int start = 0; start < numRows; start += 1000)
+    ranges.push_back({start, std::min(numRows, start + 1000)});
+  matrix.ExcludeRangeEnds(ranges, 20);
+  FeatureMatrix bounded = matrix;
+  bounded.BuildBounds();
+
+  std::uniform_int_distribution<int> pick(0, numRows - 1);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  int mismatches = 0;
+  for (int crowd : {1, 10, 100, 1000}) {
+    // every agent has its own query and weights
+    std::vector<float> queries((size_t)crowd * dataDim),
+        weights((size_t)crowd * dataDim);
+    for (int q = 0; q < crowd; ++q) {
+      auto &row = data[pick(gen)];
+      for (int j = 0; j < dataDim; ++j) {
+        queries[(size_t)q * dataDim + j] = row[j] + noise(gen);
+        weights[(size_t)q * dataDim + j] = j < 15 ? 1.0f : 2.0f;
+      }
+    }
+    std::vector<FeatureMatrix::SearchResult> single(crowd), batch(crowd),
+        boxes(crowd);
+    Timer timer;
+    for (int q = 0; q < crowd; ++q)
+      single[q] = matrix.Search(queries.data() + (size_t)q * dataDim,
+                                weights.data() + (size_t)q * dataDim);
+    double singleTime = timer.ElapsedMilliseconds();
+    timer.Reset();
+    matrix.SearchBatch(queries.data(), crowd, weights.data(), nullptr,
+                       batch.data());
+    double batchTime = timer.ElapsedMilliseconds();
+    timer.Reset();
+    bounded.SearchBatch(queries.data(), crowd, weights.data(), nullptr,
+                        boxes.data());
+    double boxesTime = timer.ElapsedMilliseconds();
+    auto differs = [](float a, float b) {
+      return std::abs(a - b) > 1e-4f * std::max(1.0f, a);
+    };
+    for (int q = 0; q < crowd; ++q)
+      if (differs(single[q].cost, batch[q].cost) ||
+          differs(single[q].cost, boxes[q].cost))
+        mismatches++;
+    printf("%4d agents: single %9.0f, batch %9.0f, batch with boxes %9.0f "
+           "queries/s\n",
+           crowd, crowd * 1000.0 / singleTime, crowd * 1000.0 / batchTime,
+           crowd * 1000.0 / boxesTime);
+  }
+  printf("%d mismatches\n", mismatches);
+  return mismatches != 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * Compare the brute force, bounding box and approximate searches of a motion
+ * database on recall, latency and memory, usage:
+ * test_feature_index [rows] [queries]
+ */
+#include "Function/General/FeatureIndex.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <random>
+
+using namespace aEngine;
+
+const int dataDim = 31;
+
+// smooth random walks, consecutive rows are close like motion frames
+std::vector<std::array<float, dataDim>> generateData(int numRows,
+                                                     std::mt19937 &gen) {
+  std::normal_distribution<float> step(0.0f, 0.05f);
+  std::vector<std::array<float, dataDim>> data(numRows);
+  std::array<float, dataDim> current{};
+  for (int i = 0; i < numRows; ++i) {
+    for (int j = 0; j < dataDim; ++j)
+      current[j] = 0.98f * current[j] + step(gen);
+    data[i] = current;
+  }
+  return data;
+}
+
+int main(int argc, char **argv) {
+  int numRows = argc > 1 ? std::max(1, atoi(argv[1])) : 1000000;
+  int numQueries = argc > 2 ? std::max(1, atoi(argv[2])) : 200;
+  std::mt19937 gen(42);
+  auto data = generateData(numRows, gen);
+  std::vector<std::pair<int, int>> ranges;
+  for (int start = 0; start < numRows; start += 1000)
+    ranges.push_back({start, std::min(numRows, start + 1000)});
+  std::array<float, dataDim> weights;
+  for (int j = 0; j < dataDim; ++j)
+    weights[j] = j < 15 ? 1.0f : 2.0f;
+
+  Timer timer;
+  FeatureMatrix exact, bounded;
+  exact.Build(data);
+  exact.ExcludeRangeEnds(ranges, 20);
+  bounded.Build(data);
+  bounded.ExcludeRangeEnds(ranges, 20);
+  timer.Reset();
+  bounded.BuildBounds();
+  printf("%d rows, bounds built in %.2f ms\n", numRows,
+         timer.ElapsedMilliseconds());
+  ApproximateFeatureIndex approximate;
+  timer.Reset();
+  approximate.Build(data, ApproximateFeatureIndex::Settings());
+  printf("%d cells, index built in %.2f ms\n", approximate.NumCells(),
+         timer.ElapsedMilliseconds());
+
+  std::vector<std::array<float, dataDim>> queries(numQueries);
+  std::vector<FeatureMatrix::SearchResult> expected(numQueries);
+  std::uniform_int_distribution<int> pick(0, numRows - 1);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  for (auto &query : queries) {
+    query = data[pick(gen)];
+    for (auto &x : query)
+      x += noise(gen);
+  }
+
+  // recall is the fraction of queries answered with the exact cost
+  auto report = [&](const char *name, size_t memory, auto &&search) {
+    int hits = 0;
+    timer.Reset();
+    std::vector<FeatureMatrix::SearchResult> results(numQueries);
+    for (int q = 0; q < numQueries; ++q)
+      results[q] = search(queries[q].data());
+    double latency = timer.ElapsedMilliseconds() / numQueries;
+    for (int q = 0; q < numQueries; ++q)
+      if (results[q].cost <= expected[q].cost * (1.0f + 1e-4f))
+        hits++;
+    printf("%-24s recall %.3f, %.4f ms per query, %.1f MB\n", name,
+           (float)hits / numQueries, latency, memory / (1024.0f * 1024.0f));
+    return hits;
+  };
+  for (int q = 0; q < numQueries; ++q)
+    expected[q] = exact.Search(queries[q].data(), weights.data());
+
+  int failures = 0;
+  failures += numQueries - report("brute force", exact.MemoryBytes(),
+                                  [&](const float *query) {
+                                    return exact.Search(query, weights.data());
+                                  });
+  failures += numQueries - report("bounding boxes", bounded.MemoryBytes(),
+                                  [&](const float *query) {
+                                    return bounded.Search(query,
+                                                          weights.data());
+                                  });
+  for (int probes : {1, 4, 16, 64}) {
+    approximate.Probes = probes;
+    char name[64];
+    snprintf(name, sizeof(name), "ivf-pq, %d probes", probes);
+    report(name, approximate.MemoryBytes(), [&](const float *query) {
+      return approximate.Search(exact, query, weights.data());
+    });
+  }
+
+  // with most of every clip excluded, a few candidates still find a match
+  // whenever the probed cells hold a row that isn't excluded
+  FeatureMatrix sparse;
+  sparse.Build(data);
+  sparse.ExcludeRangeEnds(ranges, 990);
+  approximate.Probes = 4;
+  int missed = 0;
+  for (auto &query : queries) {
+    approximate.Rerank = numRows;
+    auto reachable = approximate.Search(sparse, query.data(), weights.data());
+    approximate.Rerank = 4;
+    auto result = approximate.Search(sparse, query.data(), weights.data());
+    if (reachable.index != -1 &&
+        (result.index == -1 || sparse.IsExcluded(result.index)))
+      missed++;
+  }
+  printf("%d of %d queries without a match on a sparse matrix\n", missed,
+         numQueries);
+  failures += missed;
+  return failures != 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * Compare `FeatureMatrix::Search` against a scalar brute force search and
+ * measure the query latency, usage: test_feature_matrix [rows] [queries]
+ */
+#include "Function/General/FeatureMatrix.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <cmath>
+#include <random>
+
+using namespace aEngine;
+
+const int dataDim = 31;
+
+// smooth random walks, consecutive rows are close like motion frames
+std::vector<std::array<float, dataDim>> generateData(int numRows,
+                                                     std::mt19937 &gen) {
+  std::normal_distribution<float> step(0.0f, 0.05f);
+  std::vector<std::array<float, dataDim>> data(numRows);
+  std::array<float, dataDim> current{};
+  for (int i = 0; i < numRows; ++i) {
+    for (int j = 0; j < dataDim; ++j)
+      current[j] = 0.98f * current[j] + step(gen);
+    data[i] = current;
+  }
+  return data;
+}
+
+std::pair<int, float>
+scalarSearch(const std::vector<std::array<float, dataDim>> &data,
+             const std::vector<bool> &excluded, const float *query,
+             const float *weights) {
+  std::pair<int, float> best(-1, std::numeric_limits<float>::infinity());
+  for (int i = 0; i < data.size(); ++i) {
+    if (excluded[i])
+      continue;
+    float cost = 0.0f;
+    for (int j = 0; j < dataDim; ++j)
+      cost += weights[j] * (data[i][j] - query[j]) * (data[i][j] - query[j]);
+    if (cost < best.second)
+      best = {i, cost};
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  int numRows = argc > 1 ? std::max(1, atoi(argv[1])) : 1000000;
+  int numQueries = argc > 2 ? std::max(1, atoi(argv[2])) : 100;
+  std::mt19937 gen(42);
+  auto data = generateData(numRows, gen);
+
+  // clips of 1000 frames, the last 20 frames of each are excluded
+  std::vector<std::pair<int, int>> ranges;
+  for (int start = 0; start < numRows; start += 1000)
+    ranges.push_back({start, std::min(numRows, start + 1000)});
+  std::vector<bool> excluded(numRows, false);
+  for (auto &range : ranges)
+    for (int i = std::max(range.first, range.second - 20); i < range.second;
+         ++i)
+      excluded[i] = true;
+  std::array<float, dataDim> weights;
+  for (int j = 0; j < dataDim; ++j)
+    weights[j] = j < 15 ? 1.0f : 2.0f;
+
+  Timer timer;
+  FeatureMatrix matrix;
+  matrix.Build(data);
+  matrix.ExcludeRangeEnds(ranges, 20);
+  printf("%d rows, built in %.2f ms\n", numRows, timer.ElapsedMilliseconds());
+
+  std::uniform_int_distribution<int> pick(0, numRows - 1);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  int mismatches = 0;
+  double scalarTime = 0.0, simdTime = 0.0, boundedTime = 0.0;
+  for (int q = 0; q < numQueries; ++q) {
+    // a query close to some frame, as when the character keeps moving
+    int current = pick(gen);
+    std::array<float, dataDim> query = data[current];
+    for (auto &x : query)
+      x += noise(gen);
+
+    timer.Reset();
+    auto expected = scalarSearch(data, excluded, query.data(), weights.data());
+    scalarTime += timer.ElapsedMilliseconds();
+    timer.Reset();
+    auto result = matrix.Search(query.data(), weights.data());
+    simdTime += timer.ElapsedMilliseconds();
+    // start from the cost of continuing the current frame
+    timer.Reset();
+    float currentCost = matrix.Cost(current, query.data(), weights.data());
+    auto bounded = matrix.Search(query.data(), weights.data(), currentCost);
+    if (bounded.index == -1)
+      bounded = {current, currentCost};
+    boundedTime += timer.ElapsedMilliseconds();
+
+    float tolerance = 1e-4f * std::max(1.0f, expected.second);
+    if (result.index != expected.first &&
+        std::abs(result.cost - expected.second) > tolerance)
+      mismatches++;
+    if (!excluded[current] &&
+        std::abs(bounded.cost - expected.second) > tolerance)
+      mismatches++;
+  }
+  printf("scalar %.3f ms, simd %.3f ms, simd from the current cost %.3f ms "
+         "per query\n",
+         scalarTime / numQueries, simdTime / numQueries,
+         boundedTime / numQueries);
+  printf("%d mismatches in %d queries\n", mismatches, numQueries);
+  return mismatches != 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Build a motion database from a folder of bvh files, rebuild it
+ * incrementally and check the features against a serial reference,
+ * usage: test_build_motion_database <bvh folder>, the clips must use the
+ * pfnn skeleton
+ */
+#include "Function/Animation/MotionDatabase.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+using namespace std;
+using namespace aEngine;
+using namespace aEngine::Animation;
+namespace fs = std::filesystem;
+
+bool sameFeatures(const MotionDatabase &a, const MotionDatabase &b) {
+  return a.NumFrames() == b.NumFrames() && a.range == b.range &&
+         a.FeatureDim() == b.FeatureDim() &&
+         equal(a.Features(),
+               a.Features() + (size_t)a.NumFrames() * a.FeatureDim(),
+               b.Features());
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("usage: %s <bvh folder>\n", argv[0]);
+    return 1;
+  }
+  auto extractor = PFNNFeatures::Extractor();
+  vector<string> files;
+  for (auto &entry : fs::recursive_directory_iterator(argv[1]))
+    if (entry.path().extension() == ".bvh")
+      files.push_back(entry.path().string());
+  sort(files.begin(), files.end());
+  if (files.size() < 2) {
+    printf("at least two bvh files are needed\n");
+    return 1;
+  }
+
+  Timer timer;
+  MotionDatabase database;
+  int loaded = database.Build(files, extractor);
+  printf("full build: %d files, %d frames in %.2f ms\n", loaded,
+         database.NumFrames(), timer.ElapsedMilliseconds());
+  bool ok = loaded == files.size() && database.NumFrames() > 0;
+
+  // the mean and deviation of the features against a serial two pass
+  // reduction of the unnormalized features
+  double maxError = 0.0;
+  for (int k = 0; k < database.FeatureDim(); ++k) {
+    double mean = 0.0, var = 0.0;
+    for (int f = 0; f < database.NumFrames(); ++f)
+      mean += database.Feature(f)[k] * database.featureStd[k] +
+              database.featureMean[k];
+    mean /= database.NumFrames();
+    for (int f = 0; f < database.NumFrames(); ++f) {
+      double x = database.Feature(f)[k] * database.featureStd[k] +
+                 database.featureMean[k];
+      var += (x - mean) * (x - mean);
+    }
+    double std = sqrt(var / database.NumFrames());
+    // constant dimensions keep a deviation of 1
+    if (std == 0.0)
+      std = 1.0;
+    double scale = max(1.0, std);
+    maxError = max({maxError, abs(mean - database.featureMean[k]) / scale,
+                    abs(std - database.featureStd[k]) / scale});
+  }
+  printf("max relative error of the feature mean and deviation %g\n",
+         maxError);
+  ok = ok && maxError < 1e-4;
+
+  // nothing changed, every clip is reused
+  MotionDatabase rebuilt;
+  rebuilt.Build(files, extractor);
+  timer.Reset();
+  loaded = database.Build(files, extractor);
+  printf("unchanged rebuild: %d files loaded in %.2f ms\n", loaded,
+         timer.ElapsedMilliseconds());
+  ok = ok && loaded == 0 && sameFeatures(database, rebuilt);
+
+  // remove the first file, the result matches a full build of the rest
+  vector<string> rest(files.begin() + 1, files.end());
+  timer.Reset();
+  loaded = database.Build(rest, extractor);
+  printf("one file removed: %d files loaded in %.2f ms\n", loaded,
+         timer.ElapsedMilliseconds());
+  MotionDatabase reference;
+  reference.Build(rest, extractor);
+  ok = ok && loaded == 0 && sameFeatures(database, reference);
+
+  // add it back, only that file is loaded
+  loaded = database.Build(files, extractor);
+  printf("one file added: %d files loaded\n", loaded);
+  ok = ok && loaded == 1 && sameFeatures(database, rebuilt);
+
+  printf(ok ? "passed\n" : "failed\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/**
+ * Report the compression ratio and error of motion clips, each clip is also
+ * compressed from its `.amot` cache, which only holds the packed frames,
+ * usage: test_compress_motion <bvh file or folder> [max error] [scale]
+ */
+#include "Function/Animation/Compression.hpp"
+#include "Function/Animation/MotionCache.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <filesystem>
+
+using namespace std;
+using namespace aEngine;
+using namespace aEngine::Animation;
+namespace fs = std::filesystem;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("usage: %s <bvh file or folder> [max error] [scale]\n", argv[0]);
+    return 1;
+  }
+  CompressionSettings settings;
+  if (argc > 2)
+    settings.maxPositionError = stof(argv[2]);
+  float scale = argc > 3 ? stof(argv[3]) : 1.0f;
+  vector<string> files;
+  if (fs::is_directory(argv[1])) {
+    for (auto &entry : fs::recursive_directory_iterator(argv[1]))
+      if (entry.path().extension() == ".bvh")
+        files.push_back(entry.path().string());
+    sort(files.begin(), files.end());
+  } else
+    files.push_back(argv[1]);
+
+  size_t totalRaw = 0, totalCompressed = 0;
+  float worstError = 0.0f;
+  int cacheMismatches = 0;
+  string cacheDir = (fs::temp_directory_path() / "compress_motion").string();
+  Timer timer;
+  for (auto &file : files) {
+    Motion motion;
+    if (!motion.LoadFromBVH(file, scale))
+      continue;
+    timer.Reset();
+    auto compressed = CompressMotion(motion, settings);
+    double compressMs = timer.ElapsedMilliseconds();
+    auto report = EvaluateCompression(motion, compressed);
+    totalRaw += report.rawBytes;
+    totalCompressed += report.compressedBytes;
+    worstError = max(worstError, report.maxError);
+    printf("%s: %d frames, ratio %.2f, max error %f (frame %d, %s), mean "
+           "error %f, %.1f ms\n",
+           fs::path(file).filename().string().c_str(), compressed.numFrames,
+           report.ratio, report.maxError, report.maxErrorFrame,
+           motion.skeleton.jointNames[report.maxErrorJoint].c_str(),
+           report.meanError, compressMs);
+
+    // the cached clip must compress to the same frames
+    Motion cached;
+    if (!SaveMotionCache(motion, file, cacheDir) ||
+        !LoadMotionCache(cached, file, cacheDir)) {
+      printf("%s: cache not written\n", file.c_str());
+      cacheMismatches++;
+      continue;
+    }
+    auto fromCache = CompressMotion(cached, settings);
+    auto cacheReport = EvaluateCompression(cached, fromCache);
+    if (fromCache.numFrames != compressed.numFrames ||
+        cacheReport.maxError > settings.maxPositionError) {
+      printf("%s: %d frames from the cache, max error %f\n", file.c_str(),
+             fromCache.numFrames, cacheReport.maxError);
+      cacheMismatches++;
+    }
+  }
+  printf("%zu clips, %zu bytes -> %zu bytes, ratio %.2f, max error %f\n",
+         files.size(), totalRaw, totalCompressed,
+         totalCompressed == 0 ? 0.0f : totalRaw / (float)totalCompressed,
+         worstError);
+  printf("%d clips compressed differently from the cache\n",
+         cacheMismatches);
+  return cacheMismatches != 0;
+}
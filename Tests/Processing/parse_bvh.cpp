@@ -0,0 +1,64 @@
+/**
+ * Measure the throughput of the bvh parser,
+ * usage: test_parse_bvh <bvh file or folder> [repeat]
+ */
+#include "Function/Animation/Motion.hpp"
+#include "Function/General/ThreadPool.hpp"
+#include "Function/General/Utils.hpp"
+
+#include <filesystem>
+
+using namespace std;
+using namespace aEngine;
+using namespace aEngine::Animation;
+namespace fs = std::filesystem;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("usage: %s <bvh file or folder> [repeat]\n", argv[0]);
+    return 1;
+  }
+  int repeat = argc > 2 ? max(1, stoi(argv[2])) : 3;
+  vector<string> files;
+  if (fs::is_directory(argv[1])) {
+    for (auto &entry : fs::recursive_directory_iterator(argv[1]))
+      if (entry.path().extension() == ".bvh")
+        files.push_back(entry.path().string());
+    sort(files.begin(), files.end());
+  } else
+    files.push_back(argv[1]);
+
+  printf("%d threads\n", ThreadPool::Ref().NumThreads());
+  size_t totalBytes = 0, totalFrames = 0;
+  double totalMs = 0.0;
+  Timer timer;
+  for (auto &file : files) {
+    size_t bytes = fs::file_size(file);
+    // the best of several runs, the first one also warms up the page cache
+    double bestMs = 0.0;
+    int frames = 0;
+    for (int i = 0; i < repeat; ++i) {
+      Motion motion;
+      timer.Reset();
+      if (!motion.LoadFromBVH(file))
+        break;
+      double ms = timer.ElapsedMilliseconds();
+      bestMs = i == 0 ? ms : min(bestMs, ms);
+      frames = motion.NumFrames();
+    }
+    if (frames == 0)
+      continue;
+    totalBytes += bytes;
+    totalFrames += frames;
+    totalMs += bestMs;
+    printf("%s: %d frames, %.2f MB in %.1f ms, %.1f MB/s\n",
+           fs::path(file).filename().string().c_str(), frames, bytes / 1e6,
+           bestMs, bytes / 1e3 / bestMs);
+  }
+  printf("%zu clips, %zu frames, %.2f MB in %.1f ms, %.1f MB/s, %.0f "
+         "frames/s\n",
+         files.size(), totalFrames, totalBytes / 1e6, totalMs,
+         totalMs == 0.0 ? 0.0 : totalBytes / 1e3 / totalMs,
+         totalMs == 0.0 ? 0.0 : totalFrames * 1e3 / totalMs);
+  return 0;
+}